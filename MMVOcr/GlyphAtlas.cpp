@@ -0,0 +1,500 @@
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "GlyphAtlas.hpp"
+#include "GrayImage.hpp"
+#include "ReadLine.hpp"
+
+static const char *ATLAS_HEADER = "MMVOcr glyph atlas";
+
+/* Masks for counting bits a word at a time. */
+static const uint64 POP_1 = ~(uint64)(0) / 3;
+static const uint64 POP_2 = ~(uint64)(0) / 5;
+static const uint64 POP_4 = ~(uint64)(0) / 17;
+static const uint64 POP_BYTES = ~(uint64)(0) / 255;
+
+static unsigned int popcount(uint64 x)
+{
+	x -= (x >> 1) & POP_1;
+	x = (x & POP_2) + ((x >> 2) & POP_2);
+	x = (x + (x >> 4)) & POP_4;
+
+	return (unsigned int)((x * POP_BYTES) >> 56);
+}
+
+GlyphAtlas::GlyphAtlas():
+	height(0),
+	column_words(0),
+	word_gap(-1),
+	space_gap(-1) {}
+
+/* Splits a row into glyphs, from left to right. */
+void GlyphAtlas::segment(const GrayImage &row, std::vector<Found> *found) const
+{
+	found->clear();
+
+	int width = row.width;
+	int height = row.height;
+	unsigned int words = (height + 63) / 64;
+
+	/* The text is whichever of light and dark there is less of. */
+
+	size_t light = 0;
+
+	for(size_t i = 0; i < row.pixels.size(); ++i)
+	{
+		light += row.pixels[i] >= 128;
+	}
+
+	std::vector<unsigned char> ink(row.pixels.size());
+
+	for(size_t i = 0; i < row.pixels.size(); ++i)
+	{
+		ink[i] = (row.pixels[i] >= 128) == (light * 2 < row.pixels.size());
+	}
+
+	/* Label the blobs of ink, going down each column in turn so they are
+	 * found in order of their leftmost column.
+	*/
+
+	std::vector<int> blob(row.pixels.size(), -1);
+	std::vector<int> blob_left, blob_right;
+	std::vector<size_t> stack;
+
+	for(int x = 0; x < width; ++x)
+	{
+		for(int y = 0; y < height; ++y)
+		{
+			size_t p = (size_t)(y) * width + x;
+
+			if(!ink[p] || blob[p] >= 0)
+			{
+				continue;
+			}
+
+			int b = blob_left.size();
+			blob_left.push_back(x);
+			blob_right.push_back(x);
+
+			blob[p] = b;
+			stack.push_back(p);
+
+			while(!stack.empty())
+			{
+				size_t q = stack.back();
+				stack.pop_back();
+
+				int qx = q % width;
+				int qy = q / width;
+
+				if(qx > blob_right[b])
+				{
+					blob_right[b] = qx;
+				}
+
+				for(int ny = qy - 1; ny <= qy + 1; ++ny)
+				{
+					for(int nx = qx - 1; nx <= qx + 1; ++nx)
+					{
+						if(nx < 0 || nx >= width || ny < 0 || ny >= height)
+						{
+							continue;
+						}
+
+						size_t r = (size_t)(ny) * width + nx;
+
+						if(ink[r] && blob[r] < 0)
+						{
+							blob[r] = b;
+							stack.push_back(r);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	/* Blobs which mostly overlap the one before are part of the same
+	 * glyph. Letters which only overlap a little (like "Ty") are kerned.
+	*/
+
+	std::vector<size_t> glyph_of(blob_left.size());
+
+	for(size_t b = 0; b < blob_left.size(); ++b)
+	{
+		if(!found->empty())
+		{
+			Found &prev = found->back();
+
+			int overlap = std::min(prev.right, blob_right[b]) - blob_left[b] + 1;
+			int narrower = std::min(prev.right - prev.left, blob_right[b] - blob_left[b]) + 1;
+
+			if(overlap > 0 && overlap * 2 >= narrower)
+			{
+				prev.right = std::max(prev.right, blob_right[b]);
+				glyph_of[b] = found->size() - 1;
+
+				continue;
+			}
+		}
+
+		found->push_back(Found());
+		found->back().left = blob_left[b];
+		found->back().right = blob_right[b];
+
+		glyph_of[b] = found->size() - 1;
+	}
+
+	for(size_t i = 0; i < found->size(); ++i)
+	{
+		Glyph &g = (*found)[i].glyph;
+
+		g.width = (*found)[i].right - (*found)[i].left + 1;
+		g.ink = 0;
+		g.bits.assign(g.width * words, 0);
+	}
+
+	for(int y = 0; y < height; ++y)
+	{
+		for(int x = 0; x < width; ++x)
+		{
+			int b = blob[(size_t)(y) * width + x];
+
+			if(b >= 0)
+			{
+				Found &f = (*found)[glyph_of[b]];
+
+				f.glyph.bits[((x - f.left) * words) + (y / 64)] |= (uint64)(1) << (y % 64);
+				++(f.glyph.ink);
+			}
+		}
+	}
+}
+
+/* Finds the template most like a glyph, which may be up to a column wider or
+ * narrower. Returns how alike they are from 0 to 1, best is set to NULL if
+ * there is nothing of about the same width.
+*/
+double GlyphAtlas::match(const Glyph &glyph, const Glyph **best) const
+{
+	*best = NULL;
+	double best_score = 0.0;
+
+	unsigned int min_width = glyph.width > 0 ? glyph.width - 1 : 0;
+
+	for(unsigned int w = min_width; w <= glyph.width + 1 && w < by_width.size(); ++w)
+	{
+		for(size_t i = 0; i < by_width[w].size(); ++i)
+		{
+			const Glyph &t = glyphs[by_width[w][i]];
+
+			const Glyph &wide = t.width >= glyph.width ? t : glyph;
+			const Glyph &narrow = t.width >= glyph.width ? glyph : t;
+
+			unsigned int total_ink = wide.ink + narrow.ink;
+
+			/* Any more differences than this and it can't beat the best. */
+			unsigned int max_diff = (unsigned int)((1.0 - best_score) * total_ink);
+
+			for(unsigned int offset = 0; offset <= wide.width - narrow.width; ++offset)
+			{
+				unsigned int diff = 0;
+
+				for(unsigned int x = 0; x < wide.width && diff <= max_diff; ++x)
+				{
+					const uint64 *a = &(wide.bits[x * column_words]);
+					const uint64 *b = x >= offset && x - offset < narrow.width
+						? &(narrow.bits[(x - offset) * column_words])
+						: NULL;
+
+					for(unsigned int k = 0; k < column_words; ++k)
+					{
+						diff += popcount(b != NULL ? a[k] ^ b[k] : a[k]);
+					}
+				}
+
+				double score = 1.0 - ((double)(diff) / (double)(total_ink));
+
+				if(diff <= max_diff && (*best == NULL || score > best_score))
+				{
+					*best = &t;
+					best_score = score;
+					max_diff = diff;
+				}
+			}
+		}
+	}
+
+	return best_score;
+}
+
+bool GlyphAtlas::is_space(int gap) const
+{
+	if(space_gap < 0)
+	{
+		/* Never seen a space, anything much wider than the gaps between
+		 * letters will have to do.
+		*/
+		return word_gap >= 0 && gap > word_gap * 2;
+	}
+
+	if(word_gap < 0)
+	{
+		return gap >= space_gap;
+	}
+
+	return gap * 2 > word_gap + space_gap;
+}
+
+void GlyphAtlas::add(const Glyph &glyph)
+{
+	if(glyph.width >= by_width.size())
+	{
+		by_width.resize(glyph.width + 1);
+	}
+
+	std::vector<size_t> &same_width = by_width[glyph.width];
+
+	for(size_t i = 0; i < same_width.size(); ++i)
+	{
+		if(glyphs[same_width[i]].bits == glyph.bits)
+		{
+			/* Already got it. */
+			return;
+		}
+	}
+
+	glyphs.push_back(glyph);
+	same_width.push_back(glyphs.size() - 1);
+}
+
+bool GlyphAtlas::learn(const GrayImage &row, const std::string &text)
+{
+	if(height == 0)
+	{
+		height = row.height;
+		column_words = (height + 63) / 64;
+	}
+	else if(row.height != height)
+	{
+		return false;
+	}
+
+	/* Split the text into (UTF-8) characters, noting which come after a
+	 * space.
+	*/
+
+	std::vector<std::string> chars;
+	std::vector<bool> after_space;
+
+	bool space = false;
+
+	for(size_t i = 0; i < text.length();)
+	{
+		if(text[i] == ' ')
+		{
+			space = true;
+			++i;
+
+			continue;
+		}
+
+		size_t len = 1;
+		while(i + len < text.length() && (text[i + len] & 0xC0) == 0x80)
+		{
+			++len;
+		}
+
+		chars.push_back(text.substr(i, len));
+		after_space.push_back(space);
+
+		space = false;
+		i += len;
+	}
+
+	std::vector<Found> found;
+	segment(row, &found);
+
+	if(found.size() != chars.size())
+	{
+		return false;
+	}
+
+	for(size_t i = 0; i < found.size(); ++i)
+	{
+		if(i > 0)
+		{
+			int gap = found[i].left - found[i - 1].right - 1;
+
+			if(after_space[i])
+			{
+				space_gap = space_gap < 0 ? gap : std::min(space_gap, gap);
+			}
+			else{
+				word_gap = std::max(word_gap, gap);
+			}
+		}
+
+		found[i].glyph.text = chars[i];
+		add(found[i].glyph);
+	}
+
+	return true;
+}
+
+bool GlyphAtlas::read(const GrayImage &row, std::string *text, double *confidence) const
+{
+	text->erase();
+	*confidence = 0.0;
+
+	if(row.height != height || glyphs.empty())
+	{
+		return false;
+	}
+
+	std::vector<Found> found;
+	segment(row, &found);
+
+	double worst = 1.0;
+
+	for(size_t i = 0; i < found.size(); ++i)
+	{
+		if(i > 0 && is_space(found[i].left - found[i - 1].right - 1))
+		{
+			text->append(" ");
+		}
+
+		const Glyph *best;
+		double score = match(found[i].glyph, &best);
+
+		if(best == NULL)
+		{
+			return false;
+		}
+
+		text->append(best->text);
+		worst = std::min(worst, score);
+	}
+
+	*confidence = worst;
+	return true;
+}
+
+bool GlyphAtlas::load(const char *filename)
+{
+	FILE *f = fopen(filename, "r");
+	if(f == NULL)
+	{
+		return false;
+	}
+
+	*this = GlyphAtlas();
+
+	std::string line;
+	bool ok = read_line(f, &line) && line == ATLAS_HEADER
+		&& read_line(f, &line) && sscanf(line.c_str(), "height %u", &height) == 1
+		&& read_line(f, &line) && sscanf(line.c_str(), "gaps %d %d", &word_gap, &space_gap) == 2;
+
+	column_words = (height + 63) / 64;
+
+	/* Each glyph is a "glyph <text> <width>" line followed by a line of "#"
+	 * (ink) and "." for each row of pixels.
+	*/
+
+	while(ok && read_line(f, &line))
+	{
+		if(line.empty())
+		{
+			continue;
+		}
+
+		size_t last_space = line.rfind(' ');
+
+		if(line.compare(0, 6, "glyph ") != 0 || last_space <= 6)
+		{
+			ok = false;
+			break;
+		}
+
+		Glyph g;
+		g.text = line.substr(6, last_space - 6);
+		g.width = strtoul(line.c_str() + last_space + 1, NULL, 10);
+		g.ink = 0;
+		g.bits.assign(g.width * column_words, 0);
+
+		for(unsigned int y = 0; ok && y < height; ++y)
+		{
+			if(!read_line(f, &line) || line.length() != g.width)
+			{
+				ok = false;
+				break;
+			}
+
+			for(unsigned int x = 0; x < g.width; ++x)
+			{
+				if(line[x] == '#')
+				{
+					g.bits[(x * column_words) + (y / 64)] |= (uint64)(1) << (y % 64);
+					++(g.ink);
+				}
+			}
+		}
+
+		if(ok)
+		{
+			add(g);
+		}
+	}
+
+	fclose(f);
+
+	return ok;
+}
+
+bool GlyphAtlas::save(const char *filename) const
+{
+	FILE *f = fopen(filename, "w");
+	if(f == NULL)
+	{
+		return false;
+	}
+
+	fprintf(f, "%s\nheight %u\ngaps %d %d\n", ATLAS_HEADER, height, word_gap, space_gap);
+
+	std::string line;
+
+	for(size_t i = 0; i < glyphs.size(); ++i)
+	{
+		const Glyph &g = glyphs[i];
+
+		fprintf(f, "\nglyph %s %u\n", g.text.c_str(), g.width);
+
+		for(unsigned int y = 0; y < height; ++y)
+		{
+			line.assign(g.width, '.');
+
+			for(unsigned int x = 0; x < g.width; ++x)
+			{
+				if((g.bits[(x * column_words) + (y / 64)] >> (y % 64)) & 1)
+				{
+					line[x] = '#';
+				}
+			}
+
+			fprintf(f, "%s\n", line.c_str());
+		}
+	}
+
+	bool ok = !ferror(f);
+
+	if(fclose(f) != 0)
+	{
+		ok = false;
+	}
+
+	return ok;
+}
@@ -0,0 +1,91 @@
+#ifndef MMVOCR_GLYPHATLAS_HPP
+#define MMVOCR_GLYPHATLAS_HPP
+
+#include <string>
+#include <vector>
+
+#include "GrayImage.hpp"
+#include "IntTypes.hpp"
+
+/* Pictures of every glyph in the one font the index is drawn in, learned from
+ * rows whose text is known, for reading rows without Tesseract.
+ *
+ * A row is split into glyphs by finding the connected blobs of ink in it and
+ * putting together blobs which sit over each other (like the dot and stem of
+ * an "i"). Each glyph is compared with the templates of about the same width
+ * by counting the pixels which differ, a machine word of a column at a time.
+ * Gaps between glyphs wider than any seen inside a word while learning are
+ * spaces.
+ *
+ * Learning only uses rows which split into as many glyphs as their text has
+ * characters (not counting spaces), so each glyph can be paired up with its
+ * character. Rows where letters touch are skipped.
+ *
+ * The atlas is saved as text, each glyph drawn with "#" for ink, so mistakes
+ * in the labels can be found and fixed by hand.
+*/
+class GlyphAtlas
+{
+private:
+	struct Glyph
+	{
+		std::string text;
+		unsigned int width;
+		unsigned int ink;  /* Pixels set. */
+
+		/* column_words words for each column, bit y of the column set for
+		 * ink in row y.
+		*/
+		std::vector<uint64> bits;
+	};
+
+	/* A glyph found in a row, and the columns it spans. */
+	struct Found
+	{
+		Glyph glyph;
+		int left, right;
+	};
+
+	unsigned int height;
+	unsigned int column_words;
+
+	std::vector<Glyph> glyphs;
+	std::vector<std::vector<size_t> > by_width;
+
+	/* Widest gap between the glyphs of a word and narrowest gap between
+	 * words seen while learning (-1 if none yet).
+	*/
+	int word_gap;
+	int space_gap;
+
+	void segment(const GrayImage &row, std::vector<Found> *found) const;
+	double match(const Glyph &glyph, const Glyph **best) const;
+	bool is_space(int gap) const;
+	void add(const Glyph &glyph);
+
+public:
+	GlyphAtlas();
+
+	/* Learns the glyphs in a prepared row (see prepare_row()) with the given
+	 * text. Returns false if the row couldn't be lined up with the text.
+	*/
+	bool learn(const GrayImage &row, const std::string &text);
+
+	/* Reads the text in a prepared row. confidence is set to how well the
+	 * worst matching glyph matched, from 0 to 1. Returns false if the row
+	 * has glyphs unlike anything in the atlas or is a different height.
+	*/
+	bool read(const GrayImage &row, std::string *text, double *confidence) const;
+
+	/* Loads an atlas saved by save(). Returns false if it can't be read. */
+	bool load(const char *filename);
+
+	bool save(const char *filename) const;
+
+	size_t size() const
+	{
+		return glyphs.size();
+	}
+};
+
+#endif /* !MMVOCR_GLYPHATLAS_HPP */
@@ -0,0 +1,411 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "Clock.hpp"
+#include "GlyphAtlas.hpp"
+#include "OcrCache.hpp"
+#include "OcrPool.hpp"
+#include "ReadLine.hpp"
+#include "RowImage.hpp"
+#include "RowLayout.hpp"
+
+/* Default number of threads (and Tesseract instances) to read rows with, if
+ * not the number of processors.
+*/
+// #define OCR_THREADS 4
+
+/* How sure a glyph atlas (-g) must be of a row to use what it reads instead
+ * of asking Tesseract. This is how much the worst matching glyph in the row
+ * looks like its template, from 0 to 1.
+*/
+#define GLYPH_CONFIDENCE 0.9
+
+/* Text read from each row is kept in this cache, and rows which look exactly
+ * like one in it aren't read again. Sharing one cache between runs and titles
+ * saves the most.
+*/
+// #define OCR_CACHE "mmvocr.cache"
+
+/* Rows at the start of the tree listing used to work out where the text
+ * starts at each depth (see RowLayout). Without it, rows are cropped the way
+ * ocr.pl did.
+*/
+#define CALIBRATION_ROWS 300
+
+/* A row of a tree listing. text is anything after the two spaces following
+ * the ID in a listing MMVOcr wrote.
+*/
+struct ListedRow
+{
+	std::string indent;
+	std::string id;
+	std::string text;
+};
+
+static unsigned int count_processors()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+
+	return info.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? n : 1;
+#endif
+}
+
+/* Splits up a line of a tree listing. Returns false for lines without an ID,
+ * like "Printed page ...".
+*/
+static bool parse_row(const std::string &line, ListedRow *row)
+{
+	size_t i = 0;
+	while(i < line.length() && isspace((unsigned char)(line[i])))
+	{
+		++i;
+	}
+
+	size_t digits = i;
+	while(digits < line.length() && isdigit((unsigned char)(line[digits])))
+	{
+		++digits;
+	}
+
+	if(digits == i)
+	{
+		return false;
+	}
+
+	row->indent.assign(line, 0, i);
+	row->id.assign(line, i, digits - i);
+	row->text.assign(line.compare(digits, 2, "  ") == 0 ? line.substr(digits + 2) : "");
+
+	return true;
+}
+
+/* Calibrates layout from the screenshots of up to max_rows rows. */
+static void calibrate_layout(const std::vector<ListedRow> &rows, size_t max_rows, RowLayout *layout)
+{
+	if(max_rows == 0)
+	{
+		return;
+	}
+
+	std::string error;
+
+	for(size_t i = 0; i < rows.size() && i < max_rows; ++i)
+	{
+		/* Any missing screenshots will be complained about later. */
+
+		GrayImage shot;
+
+		if(load_screenshot(rows[i].id, &shot, &error))
+		{
+			layout->sample(shot, rows[i].indent.length());
+		}
+	}
+
+	layout->calibrate();
+	layout->report();
+}
+
+/* Learns the glyphs of the rows in a listing written by MMVOcr (or ocr.pl)
+ * which has been checked and corrected by hand, adding them to the atlas in
+ * atlas_file.
+*/
+static int learn_glyphs(const char *listing, const char *atlas_file, size_t calibration_rows)
+{
+	GlyphAtlas atlas;
+
+	FILE *existing = fopen(atlas_file, "r");
+	if(existing != NULL)
+	{
+		fclose(existing);
+
+		if(!atlas.load(atlas_file))
+		{
+			fprintf(stderr, "Unable to read glyph atlas %s\n", atlas_file);
+			return 1;
+		}
+	}
+
+	FILE *f = fopen(listing, "r");
+	if(f == NULL)
+	{
+		fprintf(stderr, "Unable to open %s\n", listing);
+		return 1;
+	}
+
+	std::vector<ListedRow> rows;
+	std::string line;
+	ListedRow r;
+
+	while(read_line(f, &line))
+	{
+		if(parse_row(line, &r))
+		{
+			rows.push_back(r);
+		}
+	}
+
+	fclose(f);
+
+	RowLayout layout;
+	calibrate_layout(rows, calibration_rows, &layout);
+
+	size_t known = atlas.size();
+	unsigned long learned = 0, skipped = 0;
+
+	std::string error;
+
+	for(size_t i = 0; i < rows.size(); ++i)
+	{
+		const std::string &id = rows[i].id;
+		const std::string &text = rows[i].text;
+
+		GrayImage shot;
+
+		if(!load_screenshot(id, &shot, &error))
+		{
+			fprintf(stderr, "%s\n", error.c_str());
+
+			++skipped;
+			continue;
+		}
+
+		GrayImage row;
+		prepare_row(shot, layout.crop(rows[i].indent.length()), &row);
+
+		if(atlas.learn(row, text))
+		{
+			++learned;
+		}
+		else{
+			fprintf(stderr, "Couldn't line up the glyphs of %s with \"%s\"\n", id.c_str(), text.c_str());
+			++skipped;
+		}
+	}
+
+	if(!atlas.save(atlas_file))
+	{
+		fprintf(stderr, "Unable to write glyph atlas %s\n", atlas_file);
+		return 1;
+	}
+
+	fprintf(stderr, "Learned %u new glyphs from %lu rows (%lu skipped), %u glyphs in the atlas\n",
+		(unsigned)(atlas.size() - known), learned, skipped, (unsigned)(atlas.size()));
+
+	return 0;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [options] < tree.lst > titles.lst\n", argv0);
+	fprintf(stderr, "       %s -g <atlas> -l <titles.lst>  (learn glyphs from corrected titles)\n", argv0);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "  -j <threads>     Number of Tesseract instances to run at once\n");
+	fprintf(stderr, "                   (defaults to the number of processors)\n");
+	fprintf(stderr, "  -t <path>        Directory to load Tesseract's language data from\n");
+	fprintf(stderr, "  -g <atlas>       Read rows with a glyph atlas, only using Tesseract for\n");
+	fprintf(stderr, "                   rows it isn't sure of\n");
+	fprintf(stderr, "  -m <confidence>  Override GLYPH_CONFIDENCE\n");
+	fprintf(stderr, "  -c <cache>       Override OCR_CACHE\n");
+	fprintf(stderr, "  -r <rows>        Override CALIBRATION_ROWS (0 crops rows like ocr.pl)\n");
+}
+
+int main(int argc, char **argv)
+{
+#ifdef OCR_THREADS
+	unsigned int threads = OCR_THREADS;
+#else
+	unsigned int threads = count_processors();
+#endif
+
+	const char *datapath = NULL;
+	const char *atlas_file = NULL;
+	const char *listing = NULL;
+	double min_confidence = GLYPH_CONFIDENCE;
+
+	size_t calibration_rows = 0;
+#ifdef CALIBRATION_ROWS
+	calibration_rows = CALIBRATION_ROWS;
+#endif
+
+	const char *cache_file = NULL;
+#ifdef OCR_CACHE
+	cache_file = OCR_CACHE;
+#endif
+
+	int arg = 1;
+
+	while(arg + 1 < argc && (strcmp(argv[arg], "-j") == 0 || strcmp(argv[arg], "-t") == 0
+		|| strcmp(argv[arg], "-g") == 0 || strcmp(argv[arg], "-l") == 0 || strcmp(argv[arg], "-m") == 0 || strcmp(argv[arg], "-c") == 0
+		|| strcmp(argv[arg], "-r") == 0))
+	{
+		if(argv[arg][1] == 'j')
+		{
+			unsigned int value = strtoul(argv[arg + 1], NULL, 10);
+			threads = value > 0 ? value : 1;
+		}
+		else if(argv[arg][1] == 't')
+		{
+			datapath = argv[arg + 1];
+		}
+		else if(argv[arg][1] == 'g')
+		{
+			atlas_file = argv[arg + 1];
+		}
+		else if(argv[arg][1] == 'l')
+		{
+			listing = argv[arg + 1];
+		}
+		else if(argv[arg][1] == 'c')
+		{
+			cache_file = argv[arg + 1];
+		}
+		else if(argv[arg][1] == 'r')
+		{
+			calibration_rows = strtoul(argv[arg + 1], NULL, 10);
+		}
+		else{
+			min_confidence = strtod(argv[arg + 1], NULL);
+		}
+
+		arg += 2;
+	}
+
+	if(arg != argc || (listing != NULL && atlas_file == NULL))
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	if(listing != NULL)
+	{
+		return learn_glyphs(listing, atlas_file, calibration_rows);
+	}
+
+	GlyphAtlas atlas;
+
+	if(atlas_file != NULL && !atlas.load(atlas_file))
+	{
+		fprintf(stderr, "Unable to read glyph atlas %s\n", atlas_file);
+		return 1;
+	}
+
+	OcrCache cache;
+
+	if(cache_file != NULL && !cache.open(cache_file, TesseractEngine::describe(datapath)))
+	{
+		fprintf(stderr, "Unable to open OCR cache %s\n", cache_file);
+		return 1;
+	}
+
+	/* Each instance gets a processor to itself, so stop Tesseract starting
+	 * threads of its own which would only get in each other's way.
+	*/
+	static char omp_thread_limit[] = "OMP_THREAD_LIMIT=1";
+
+	if(getenv("OMP_THREAD_LIMIT") == NULL)
+	{
+		putenv(omp_thread_limit);
+	}
+
+	uint64 start_us = clock_us();
+
+	/* Each line of the tree listing is an ID indented by its depth, anything
+	 * else (like "Printed page ...") is left out. The first few rows are
+	 * read before starting, to work out how to crop them.
+	*/
+
+	std::vector<ListedRow> first_rows;
+	std::string line;
+	ListedRow r;
+
+	bool more = true;
+
+	while(first_rows.size() < calibration_rows && (more = read_line(stdin, &line)))
+	{
+		if(parse_row(line, &r))
+		{
+			first_rows.push_back(r);
+		}
+	}
+
+	RowLayout layout;
+	calibrate_layout(first_rows, calibration_rows, &layout);
+
+	OcrPool pool(stdout, &layout);
+
+	if(atlas_file != NULL)
+	{
+		pool.set_atlas(&atlas, min_confidence);
+	}
+
+	if(cache_file != NULL)
+	{
+		pool.set_cache(&cache);
+	}
+
+	if(!pool.start(threads, datapath))
+	{
+		fprintf(stderr, "Unable to load Tesseract\n");
+		return 1;
+	}
+
+	bool added = true;
+
+	for(size_t i = 0; added && i < first_rows.size(); ++i)
+	{
+		added = pool.add(first_rows[i].indent, first_rows[i].id);
+	}
+
+	while(added && more && read_line(stdin, &line))
+	{
+		if(parse_row(line, &r))
+		{
+			added = pool.add(r.indent, r.id);
+		}
+	}
+
+	bool ok = pool.finish();
+
+	double elapsed = (double)(clock_us() - start_us) / 1000000.0;
+	OcrPool::Stats s = pool.get_stats();
+
+	fprintf(stderr, "Read %lu rows with %u threads in %.1f s (%.1f rows/s)\n",
+		s.rows, threads, elapsed, elapsed > 0.0 ? (double)(s.rows) / elapsed : 0.0);
+
+	if(atlas_file != NULL)
+	{
+		fprintf(stderr, "Read %lu rows from the glyph atlas, %lu with Tesseract\n",
+			s.glyph_rows, s.rows - s.glyph_rows);
+	}
+
+	if(cache_file != NULL)
+	{
+		OcrCache::Stats cs = cache.get_stats();
+
+		fprintf(stderr, "Found %lu of %lu rows in the OCR cache (%.1f%%), saving about %.1f s of reading, %u rows cached\n",
+			cs.hits, cs.lookups, cs.lookups > 0 ? (double)(cs.hits) * 100.0 / (double)(cs.lookups) : 0.0,
+			(double)(cs.saved_us) / 1000000.0, cache.size());
+	}
+
+	fprintf(stderr, "Time spent by all threads: %.1f s loading screenshots, %.1f s preparing them, %.1f s in the cache, %.1f s matching glyphs, %.1f s in Tesseract\n",
+		(double)(s.load_us) / 1000000.0, (double)(s.prepare_us) / 1000000.0, (double)(s.cache_us) / 1000000.0,
+		(double)(s.glyph_us) / 1000000.0, (double)(s.recognise_us) / 1000000.0);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,588 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include "OcrCache.hpp"
+
+static const char INDEX_MAGIC[8] = { 'M', 'M', 'V', 'O', 'c', 'r', 'I', 'x' };
+
+static const unsigned int INITIAL_SLOTS = 4096;
+
+/* Longer records are taken to be garbage when going over the log. */
+static const unsigned int MAX_TEXT_LENGTH = 65536;
+
+/* The furthest fseek() can go, which the log isn't allowed to grow past. */
+static const uint64 MAX_LOG_SIZE = LONG_MAX;
+
+/* FNV-1a's 64-bit offset basis and prime and the golden ratio, put together
+ * from halves as Visual C++ 6 has no 64-bit literals.
+*/
+static const uint64 FNV_BASIS = ((uint64)(0xCBF29CE4) << 32) | 0x84222325;
+static const uint64 FNV_PRIME = ((uint64)(0x00000100) << 32) | 0x000001B3;
+static const uint64 GOLDEN = ((uint64)(0x9E3779B9) << 32) | 0x7F4A7C15;
+
+static bool truncate_file(const char *filename, uint64 length)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFile(filename, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LONG high = (LONG)(length >> 32);
+	DWORD low = SetFilePointer(file, (LONG)(length & 0xFFFFFFFF), &high, FILE_BEGIN);
+
+	bool ok = (low != 0xFFFFFFFF || GetLastError() == NO_ERROR) && SetEndOfFile(file);
+
+	CloseHandle(file);
+
+	return ok;
+#else
+	return truncate(filename, (off_t)(length)) == 0;
+#endif
+}
+
+OcrCache::OcrCache():
+	log_in(NULL),
+	log_out(NULL),
+	log_size(0),
+	write_failed(false),
+	salt(FNV_BASIS),
+#ifdef _WIN32
+	index_file(INVALID_HANDLE_VALUE),
+	index_mapping(NULL),
+#else
+	index_fd(-1),
+#endif
+	index_size(0),
+	header(NULL),
+	slots(NULL)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+OcrCache::~OcrCache()
+{
+	close();
+}
+
+bool OcrCache::open(const char *filename, const std::string &reader)
+{
+	close();
+
+	log_name = filename;
+	index_name = log_name + ".idx";
+
+	salt = FNV_BASIS;
+
+	for(size_t i = 0; i < reader.length(); ++i)
+	{
+		salt = (salt ^ (unsigned char)(reader[i])) * FNV_PRIME;
+	}
+
+	if(!open_log())
+	{
+		close();
+		return false;
+	}
+
+	write_failed = false;
+
+	bool index_ok = map_index(0)
+		&& memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0
+		&& header->slots > 0 && (header->slots & (header->slots - 1)) == 0
+		&& index_size == sizeof(IndexHeader) + ((size_t)(header->slots) * sizeof(Slot))
+		&& header->used < header->slots
+		&& header->log_end <= log_size;
+
+	if(!index_ok)
+	{
+		if(log_size > 0)
+		{
+			fprintf(stderr, "Rebuilding OCR cache index %s\n", index_name.c_str());
+		}
+
+		if(!reset_index(INITIAL_SLOTS))
+		{
+			close();
+			return false;
+		}
+	}
+
+	if(!replay_log())
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void OcrCache::close()
+{
+	unmap_index();
+	close_log();
+}
+
+/* Opens the log for reading and appending, creating it if there isn't one
+ * yet, and gets its size.
+*/
+bool OcrCache::open_log()
+{
+	log_out = fopen(log_name.c_str(), "ab");
+	log_in = fopen(log_name.c_str(), "rb");
+
+	if(log_out == NULL || log_in == NULL || fseek(log_in, 0, SEEK_END) != 0)
+	{
+		close_log();
+		return false;
+	}
+
+	/* ftell() fails past LONG_MAX. */
+
+	long end = ftell(log_in);
+
+	if(end < 0)
+	{
+		fprintf(stderr, "OCR cache %s is too big to read\n", log_name.c_str());
+
+		close_log();
+		return false;
+	}
+
+	log_size = (uint64)(end);
+
+	return true;
+}
+
+void OcrCache::close_log()
+{
+	if(log_in != NULL)
+	{
+		fclose(log_in);
+		log_in = NULL;
+	}
+
+	if(log_out != NULL)
+	{
+		fclose(log_out);
+		log_out = NULL;
+	}
+}
+
+/* Maps the index, resizing it to hold num_slots (which are cleared) first if
+ * num_slots isn't zero.
+*/
+bool OcrCache::map_index(unsigned int num_slots)
+{
+	unmap_index();
+
+	size_t size = sizeof(IndexHeader) + ((size_t)(num_slots) * sizeof(Slot));
+
+#ifdef _WIN32
+	index_file = CreateFile(index_name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL,
+		(num_slots > 0 ? CREATE_ALWAYS : OPEN_EXISTING), FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if(index_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	if(num_slots == 0)
+	{
+		DWORD size_high;
+		size = GetFileSize(index_file, &size_high);
+
+		if(size_high != 0 || size < sizeof(IndexHeader))
+		{
+			unmap_index();
+			return false;
+		}
+	}
+
+	/* Creating the mapping extends a new file to size with zeros. */
+	index_mapping = CreateFileMapping(index_file, NULL, PAGE_READWRITE, 0, size, NULL);
+	if(index_mapping == NULL)
+	{
+		unmap_index();
+		return false;
+	}
+
+	void *base = MapViewOfFile(index_mapping, FILE_MAP_WRITE, 0, 0, 0);
+	if(base == NULL)
+	{
+		unmap_index();
+		return false;
+	}
+#else
+	index_fd = ::open(index_name.c_str(), (num_slots > 0 ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR), 0666);
+	if(index_fd == -1)
+	{
+		return false;
+	}
+
+	if(num_slots > 0)
+	{
+		/* Extended with zeros. */
+
+		if(ftruncate(index_fd, (off_t)(size)) != 0)
+		{
+			unmap_index();
+			return false;
+		}
+	}
+	else{
+		struct stat st;
+
+		if(fstat(index_fd, &st) != 0 || (size_t)(st.st_size) < sizeof(IndexHeader))
+		{
+			unmap_index();
+			return false;
+		}
+
+		size = st.st_size;
+	}
+
+	void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, index_fd, 0);
+	if(base == MAP_FAILED)
+	{
+		unmap_index();
+		return false;
+	}
+#endif
+
+	index_size = size;
+	header = (IndexHeader*)(base);
+	slots = (Slot*)(header + 1);
+
+	return true;
+}
+
+void OcrCache::unmap_index()
+{
+#ifdef _WIN32
+	if(header != NULL)
+	{
+		UnmapViewOfFile(header);
+	}
+
+	if(index_mapping != NULL)
+	{
+		CloseHandle(index_mapping);
+		index_mapping = NULL;
+	}
+
+	if(index_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(index_file);
+		index_file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if(header != NULL)
+	{
+		munmap(header, index_size);
+	}
+
+	if(index_fd != -1)
+	{
+		::close(index_fd);
+		index_fd = -1;
+	}
+#endif
+
+	header = NULL;
+	slots = NULL;
+	index_size = 0;
+}
+
+/* Replaces the index with an empty one of num_slots. */
+bool OcrCache::reset_index(unsigned int num_slots)
+{
+	if(!map_index(num_slots))
+	{
+		return false;
+	}
+
+	memcpy(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	header->slots = num_slots;
+	header->used = 0;
+	header->log_end = 0;
+
+	return true;
+}
+
+/* Doubles the number of slots in the index. If this is interrupted, the index
+ * is left saying it doesn't cover any of the log and will be rebuilt.
+*/
+bool OcrCache::grow_index()
+{
+	std::vector<Slot> old;
+	old.reserve(header->used);
+
+	for(unsigned int i = 0; i < header->slots; ++i)
+	{
+		if(slots[i].offset != 0)
+		{
+			old.push_back(slots[i]);
+		}
+	}
+
+	uint64 log_end = header->log_end;
+
+	if(!reset_index(header->slots * 2))
+	{
+		return false;
+	}
+
+	for(size_t i = 0; i < old.size(); ++i)
+	{
+		Key k;
+		k.hash = old[i].hash;
+		k.check = old[i].check;
+		k.size = old[i].size;
+
+		*find_slot(k) = old[i];
+	}
+
+	header->used = old.size();
+	header->log_end = log_end;
+
+	return true;
+}
+
+/* Adds any records in the log the index doesn't cover yet, and cuts off a
+ * partial record left at the end by a crash.
+*/
+bool OcrCache::replay_log()
+{
+	uint64 pos = header->log_end;
+
+	while(fseek(log_in, (long)(pos), SEEK_SET) == 0)
+	{
+		LogRecord r;
+
+		if(fread(&r, sizeof(r), 1, log_in) != 1
+			|| r.length > MAX_TEXT_LENGTH
+			|| pos + sizeof(r) + r.length > log_size)
+		{
+			break;
+		}
+
+		Key k;
+		k.hash = r.hash;
+		k.check = r.check;
+		k.size = r.size;
+
+		if(!insert(k, pos, r.us))
+		{
+			return false;
+		}
+
+		pos += sizeof(r) + r.length;
+		header->log_end = pos;
+	}
+
+	if(pos < log_size)
+	{
+		fprintf(stderr, "Discarding partial record at the end of OCR cache %s\n", log_name.c_str());
+
+		/* Windows won't open the log to truncate it while it is open. */
+
+		close_log();
+
+		if(!truncate_file(log_name.c_str(), pos) || !open_log())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Finds the slot with key in it, or the empty slot it would go in. */
+OcrCache::Slot *OcrCache::find_slot(const Key &key)
+{
+	unsigned int mask = header->slots - 1;
+	unsigned int i = (unsigned int)(key.hash) & mask;
+
+	while(slots[i].offset != 0
+		&& (slots[i].hash != key.hash || slots[i].check != key.check || slots[i].size != key.size))
+	{
+		i = (i + 1) & mask;
+	}
+
+	return &(slots[i]);
+}
+
+/* Adds the record at offset in the log to the index, if the key isn't there
+ * already.
+*/
+bool OcrCache::insert(const Key &key, uint64 offset, unsigned int us)
+{
+	if((header->used + 1) * 2 > header->slots && !grow_index())
+	{
+		return false;
+	}
+
+	Slot *s = find_slot(key);
+
+	if(s->offset == 0)
+	{
+		s->hash = key.hash;
+		s->check = key.check;
+		s->size = key.size;
+		s->us = us;
+		s->offset = offset + 1;
+
+		++(header->used);
+	}
+
+	return true;
+}
+
+OcrCache::Key OcrCache::key(const GrayImage &row) const
+{
+	Key k;
+	k.hash = salt;
+	k.check = salt;
+	k.size = (row.width << 16) | (row.height & 0xFFFF);
+
+	const unsigned char *p = row.pixels.empty() ? NULL : &(row.pixels[0]);
+	size_t len = row.pixels.size();
+	size_t i = 0;
+
+	/* FNV-1a a word at a time, and a rotating multiplicative hash for the
+	 * check. Then the leftover bytes.
+	*/
+
+	for(; i + 8 <= len; i += 8)
+	{
+		uint64 word;
+		memcpy(&word, p + i, 8);
+
+		k.hash = (k.hash ^ word) * FNV_PRIME;
+
+		k.check = (k.check ^ word) * GOLDEN;
+		k.check = (k.check << 31) | (k.check >> 33);
+	}
+
+	for(; i < len; ++i)
+	{
+		k.hash = (k.hash ^ p[i]) * FNV_PRIME;
+		k.check = (k.check ^ p[i]) * GOLDEN;
+	}
+
+	/* Whole words only move bits upwards, mix the top ones back down so the
+	 * low bits used to pick a slot depend on all of them.
+	*/
+	k.hash ^= k.hash >> 32;
+	k.hash *= GOLDEN;
+	k.hash ^= k.hash >> 29;
+
+	return k;
+}
+
+bool OcrCache::find(const Key &key, std::string *text)
+{
+	MutexLock l(lock);
+
+	++(stats.lookups);
+
+	if(header == NULL)
+	{
+		return false;
+	}
+
+	Slot *s = find_slot(key);
+
+	if(s->offset == 0)
+	{
+		return false;
+	}
+
+	LogRecord r;
+
+	if(fseek(log_in, (long)(s->offset - 1), SEEK_SET) != 0
+		|| fread(&r, sizeof(r), 1, log_in) != 1)
+	{
+		return false;
+	}
+
+	text->resize(r.length);
+
+	if(r.length > 0 && fread(&((*text)[0]), 1, r.length, log_in) != r.length)
+	{
+		return false;
+	}
+
+	++(stats.hits);
+	stats.saved_us += s->us;
+
+	return true;
+}
+
+void OcrCache::add(const Key &key, const std::string &text, unsigned int us)
+{
+	MutexLock l(lock);
+
+	if(header == NULL || write_failed || text.length() > MAX_TEXT_LENGTH || find_slot(key)->offset != 0)
+	{
+		return;
+	}
+
+	LogRecord r;
+	memset(&r, 0, sizeof(r));
+
+	r.hash = key.hash;
+	r.check = key.check;
+	r.size = key.size;
+	r.us = us;
+	r.length = text.length();
+
+	if(log_size + sizeof(r) + text.length() > MAX_LOG_SIZE)
+	{
+		fprintf(stderr, "OCR cache %s is full, not adding anything else to it\n", log_name.c_str());
+
+		write_failed = true;
+		return;
+	}
+
+	/* The record has to be in the log before the index can point at it. */
+
+	if(fwrite(&r, sizeof(r), 1, log_out) != 1
+		|| fwrite(text.data(), 1, text.length(), log_out) != text.length()
+		|| fflush(log_out) != 0)
+	{
+		fprintf(stderr, "Unable to write to OCR cache %s, not adding anything else to it\n", log_name.c_str());
+
+		write_failed = true;
+		return;
+	}
+
+	uint64 offset = log_size;
+	log_size += sizeof(r) + text.length();
+
+	if(insert(key, offset, us))
+	{
+		header->log_end = log_size;
+	}
+	else{
+		fprintf(stderr, "Unable to grow OCR cache index %s, not adding anything else to it\n", index_name.c_str());
+
+		write_failed = true;
+	}
+}
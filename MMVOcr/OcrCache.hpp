@@ -0,0 +1,164 @@
+#ifndef MMVOCR_OCRCACHE_HPP
+#define MMVOCR_OCRCACHE_HPP
+
+#include <stdio.h>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "GrayImage.hpp"
+#include "IntTypes.hpp"
+#include "Threading.hpp"
+
+/* Text read from rows seen before, looked up by a hash of the prepared row
+ * (see prepare_row()), so rows which look exactly the same don't have to be
+ * read again. That covers titles like "Overview" which appear all over an
+ * index at the same depth, and every row when going over an index again.
+ * Nothing about the title goes into the key, so one cache can be shared
+ * between titles. What read the rows does (see open()), so rows read by a
+ * different version of Tesseract or with a different model aren't found. How
+ * a row was cropped is in the pixels (and width) already.
+ *
+ * The cache is two files. The log (the filename given) has a record of each
+ * row's key and text appended as it is read. The index (the same name with
+ * ".idx" on the end) is an open addressed hash table of where each key is in
+ * the log, which is mapped into memory and doubled in size whenever it gets
+ * half full. If the index is missing, damaged or doesn't cover the whole log
+ * (after a crash), it is brought up to date from the log when the cache is
+ * opened.
+ *
+ * The log is read with the C library's seeks, which only go up to LONG_MAX
+ * (2 GB on Windows), so nothing more is added once it gets that big.
+ *
+ * Threads may share a cache, but only one process may use it at a time.
+*/
+class OcrCache
+{
+public:
+	struct Key
+	{
+		uint64 hash;
+		uint64 check;  /* A second hash, to make collisions vanishingly rare. */
+		unsigned int size;  /* Width and height. */
+	};
+
+	struct Stats
+	{
+		unsigned long lookups;
+		unsigned long hits;
+
+		/* Time the rows found in the cache took to read originally. */
+		uint64 saved_us;
+	};
+
+private:
+	/* What the index says about a key. offset is the position of its
+	 * record in the log plus one, zero for an empty slot.
+	*/
+	struct Slot
+	{
+		uint64 hash;
+		uint64 check;
+		uint64 offset;
+		unsigned int size;
+		unsigned int us;
+	};
+
+	struct IndexHeader
+	{
+		char magic[8];
+		unsigned int slots;
+		unsigned int used;
+		uint64 log_end;  /* How much of the log is in the index. */
+		unsigned int reserved[2];
+	};
+
+	/* Each record in the log is one of these followed by the text. */
+	struct LogRecord
+	{
+		uint64 hash;
+		uint64 check;
+		unsigned int size;
+		unsigned int us;
+		unsigned int length;
+		unsigned int reserved;
+	};
+
+	Mutex lock;
+
+	std::string log_name;
+	std::string index_name;
+
+	FILE *log_in;
+	FILE *log_out;
+	uint64 log_size;
+	bool write_failed;
+
+	/* Hash of what reads the rows, which every key starts from. */
+	uint64 salt;
+
+#ifdef _WIN32
+	HANDLE index_file;
+	HANDLE index_mapping;
+#else
+	int index_fd;
+#endif
+
+	size_t index_size;
+	IndexHeader *header;
+	Slot *slots;
+
+	Stats stats;
+
+	bool open_log();
+	void close_log();
+	bool map_index(unsigned int num_slots);
+	void unmap_index();
+	bool reset_index(unsigned int num_slots);
+	bool grow_index();
+	bool replay_log();
+	Slot *find_slot(const Key &key);
+	bool insert(const Key &key, uint64 offset, unsigned int us);
+
+	/* Not copyable. */
+	OcrCache(const OcrCache&);
+	OcrCache &operator=(const OcrCache&);
+
+public:
+	OcrCache();
+	~OcrCache();
+
+	/* Opens (or creates) a cache. reader describes whatever reads the rows
+	 * added to it, like the Tesseract version and model, and only rows added
+	 * with the same reader are found. Returns false if it can't be opened.
+	 * Opening and closing aren't thread safe.
+	*/
+	bool open(const char *filename, const std::string &reader);
+	void close();
+
+	/* Works out the key of a prepared row. */
+	Key key(const GrayImage &row) const;
+
+	/* Looks up the text of a row, returns false if it isn't in the cache. */
+	bool find(const Key &key, std::string *text);
+
+	/* Adds the text of a row, which took us microseconds to read. */
+	void add(const Key &key, const std::string &text, unsigned int us);
+
+	Stats get_stats()
+	{
+		MutexLock l(lock);
+		return stats;
+	}
+
+	/* Number of rows in the cache. */
+	unsigned int size()
+	{
+		MutexLock l(lock);
+		return header != NULL ? header->used : 0;
+	}
+};
+
+#endif /* !MMVOCR_OCRCACHE_HPP */
@@ -0,0 +1,278 @@
+#include <assert.h>
+#include <deque>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Clock.hpp"
+#include "GrayImage.hpp"
+#include "OcrPool.hpp"
+#include "RowImage.hpp"
+
+OcrPool::OcrPool(FILE *out, const RowLayout *layout):
+	out(out),
+	layout(layout),
+	atlas(NULL),
+	min_confidence(1.0),
+	cache(NULL),
+	first(0),
+	next(0),
+	closed(false),
+	failed(false)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+OcrPool::~OcrPool()
+{
+	finish();
+
+	for(size_t i = 0; i < workers.size(); ++i)
+	{
+		delete workers[i];
+	}
+}
+
+bool OcrPool::start(unsigned int threads, const char *datapath)
+{
+	assert(workers.empty());
+
+	for(unsigned int i = 0; i < threads; ++i)
+	{
+		Worker *w = new Worker(this);
+
+		if(!w->engine.init(datapath))
+		{
+			delete w;
+			return false;
+		}
+
+		workers.push_back(w);
+	}
+
+	for(size_t i = 0; i < workers.size(); ++i)
+	{
+		bool started = workers[i]->start();
+		assert(started);
+	}
+
+	return true;
+}
+
+bool OcrPool::add(const std::string &indent, const std::string &id)
+{
+	{
+		MutexLock l(lock);
+
+		if(failed)
+		{
+			return false;
+		}
+
+		rows.push_back(Row());
+
+		Row &r = rows.back();
+		r.indent = indent;
+		r.id = id;
+		r.done = false;
+	}
+
+	work.post();
+
+	return true;
+}
+
+bool OcrPool::finish()
+{
+	{
+		MutexLock l(lock);
+
+		if(closed)
+		{
+			return !failed;
+		}
+
+		closed = true;
+	}
+
+	for(size_t i = 0; i < workers.size(); ++i)
+	{
+		work.post();
+	}
+
+	for(size_t i = 0; i < workers.size(); ++i)
+	{
+		workers[i]->join();
+	}
+
+	fflush(out);
+
+	return !failed;
+}
+
+void OcrPool::worker_main(TesseractEngine *engine)
+{
+	while(true)
+	{
+		work.wait();
+
+		lock.lock();
+
+		if(failed || next == first + rows.size())
+		{
+			bool stop = closed;
+			lock.unlock();
+
+			if(stop)
+			{
+				break;
+			}
+
+			continue;
+		}
+
+		size_t n = next++;
+
+		/* Rows aren't removed until they have been printed, and this one
+		 * can't be printed until it is done, so it stays put.
+		*/
+		Row &row = rows[n - first];
+
+		std::string id = row.id;
+		size_t indent = row.indent.length();
+
+		lock.unlock();
+
+		std::string text, error;
+		bool ok = read_row(engine, id, indent, &text, &error);
+
+		MutexLock l(lock);
+
+		row.done = true;
+
+		if(ok)
+		{
+			row.text = text;
+		}
+		else{
+			row.error = error;
+		}
+
+		print_done();
+	}
+}
+
+/* Reads the text of one row, returns false and sets error if it can't. */
+bool OcrPool::read_row(TesseractEngine *engine, const std::string &id, size_t indent, std::string *text, std::string *error)
+{
+	uint64 start_us = clock_us();
+
+	GrayImage shot;
+
+	if(!load_screenshot(id, &shot, error))
+	{
+		return false;
+	}
+
+	uint64 loaded_us = clock_us();
+
+	GrayImage row;
+	prepare_row(shot, layout->crop(indent), &row);
+
+	uint64 prepared_us = clock_us();
+
+	/* The atlas goes first, so rows it reads never come from the cache and
+	 * learning more glyphs takes effect straight away. Only what Tesseract
+	 * reads is cached.
+	*/
+
+	std::string raw;
+	bool matched = false;
+
+	if(atlas != NULL)
+	{
+		double confidence;
+		matched = atlas->read(row, &raw, &confidence) && confidence >= min_confidence;
+	}
+
+	uint64 matched_us = clock_us();
+	uint64 looked_up_us = matched_us;
+
+	OcrCache::Key key;
+	bool cached = false;
+
+	if(!matched && cache != NULL)
+	{
+		key = cache->key(row);
+		cached = cache->find(key, text);
+
+		looked_up_us = clock_us();
+	}
+
+	if(!cached)
+	{
+		if(!matched && !engine->recognise(row, &raw))
+		{
+			*error = "Tesseract couldn't read the screenshot of " + id;
+			return false;
+		}
+
+		/* ocr.pl took the first line of the output file and stripped the
+		 * line ending and any "|" Tesseract mistook the edge of the row for.
+		*/
+
+		text->assign(raw, 0, raw.find('\n'));
+
+		if(!text->empty() && (*text)[text->length() - 1] == '|')
+		{
+			text->erase(text->length() - 1);
+		}
+	}
+
+	uint64 done_us = clock_us();
+
+	if(!matched && !cached && cache != NULL)
+	{
+		cache->add(key, *text, (unsigned int)(done_us - looked_up_us));
+	}
+
+	MutexLock l(lock);
+
+	++(stats.rows);
+	stats.load_us += loaded_us - start_us;
+	stats.prepare_us += prepared_us - loaded_us;
+	stats.glyph_us += matched_us - prepared_us;
+	stats.cache_us += looked_up_us - matched_us;
+	stats.recognise_us += done_us - looked_up_us;
+
+	if(matched)
+	{
+		++(stats.glyph_rows);
+	}
+
+	return true;
+}
+
+/* Prints any rows at the front which are done. Call with the lock held. */
+void OcrPool::print_done()
+{
+	while(!failed && !rows.empty() && rows.front().done)
+	{
+		Row &r = rows.front();
+
+		if(!r.error.empty())
+		{
+			fflush(out);
+			fprintf(stderr, "%s\n", r.error.c_str());
+
+			failed = true;
+			break;
+		}
+
+		fprintf(out, "%s%s  %s\n", r.indent.c_str(), r.id.c_str(), r.text.c_str());
+
+		rows.pop_front();
+		++first;
+	}
+}
@@ -0,0 +1,159 @@
+#ifndef MMVOCR_OCRPOOL_HPP
+#define MMVOCR_OCRPOOL_HPP
+
+#include <deque>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "GlyphAtlas.hpp"
+#include "IntTypes.hpp"
+#include "OcrCache.hpp"
+#include "RowLayout.hpp"
+#include "TesseractEngine.hpp"
+#include "Threading.hpp"
+
+/* Reads the text of index rows on several threads at once, each with its own
+ * TesseractEngine, and prints the new tree listing in the original order.
+ *
+ * Rows are added as the tree listing is read and handed out to whichever
+ * thread is free. Each row's screenshot is loaded, cropped (see RowLayout)
+ * and negated in memory like ocr.pl had convert do to it, and the first line of whatever
+ * Tesseract reads from it printed the way ocr.pl printed it:
+ *
+ *   <indent><id>  <text>
+ *
+ * If there is a GlyphAtlas, each row is read with that first and only given
+ * to Tesseract if the atlas isn't confident of what it says.
+ *
+ * If there is an OcrCache, rows the atlas couldn't read are looked up in it
+ * before going to Tesseract, and what Tesseract reads is added to it.
+ *
+ * If a row can't be read, the rows before it are printed and nothing after
+ * it, like ocr.pl dying part of the way through.
+*/
+class OcrPool
+{
+public:
+	struct Stats
+	{
+		unsigned long rows;
+		unsigned long glyph_rows;  /* Read from the atlas, without Tesseract. */
+
+		/* Added up across all the threads. */
+		uint64 load_us;
+		uint64 prepare_us;
+		uint64 cache_us;
+		uint64 glyph_us;
+		uint64 recognise_us;
+	};
+
+private:
+	class Worker: public Thread
+	{
+	private:
+		OcrPool *pool;
+
+	protected:
+		virtual void run()
+		{
+			pool->worker_main(&engine);
+		}
+
+	public:
+		TesseractEngine engine;
+
+		Worker(OcrPool *pool):
+			pool(pool) {}
+	};
+
+	struct Row
+	{
+		std::string indent;
+		std::string id;
+
+		bool done;
+		std::string text;
+		std::string error;  /* Why it couldn't be read, if it couldn't. */
+	};
+
+	FILE *out;
+	const RowLayout *layout;
+
+	const GlyphAtlas *atlas;
+	double min_confidence;
+
+	OcrCache *cache;
+
+	std::vector<Worker*> workers;
+
+	Mutex lock;
+	Semaphore work;  /* Posted for each row added, and for each worker when closed. */
+
+	/* Rows which haven't been printed yet, first being the number of the
+	 * one at the front.
+	*/
+	std::deque<Row> rows;
+	size_t first;
+	size_t next;
+
+	bool closed;
+	bool failed;
+
+	Stats stats;
+
+	void worker_main(TesseractEngine *engine);
+	bool read_row(TesseractEngine *engine, const std::string &id, size_t indent, std::string *text, std::string *error);
+	void print_done();
+
+	/* Not copyable. */
+	OcrPool(const OcrPool&);
+	OcrPool &operator=(const OcrPool&);
+
+public:
+	/* Prints to out, cropping the rows as layout says. */
+	OcrPool(FILE *out, const RowLayout *layout);
+
+	/* Waits for the threads to finish. */
+	~OcrPool();
+
+	/* Loads an engine for each of threads and starts them. Returns false if
+	 * Tesseract couldn't be loaded from datapath (see TesseractEngine).
+	*/
+	bool start(unsigned int threads, const char *datapath);
+
+	/* Reads rows with atlas before trying Tesseract, using what it reads if
+	 * it is at least min_confidence sure (see GlyphAtlas::read()). Call
+	 * before start().
+	*/
+	void set_atlas(const GlyphAtlas *atlas, double min_confidence)
+	{
+		this->atlas = atlas;
+		this->min_confidence = min_confidence;
+	}
+
+	/* Looks rows up in cache before reading them with Tesseract, and adds
+	 * the ones which weren't there. Call before start().
+	*/
+	void set_cache(OcrCache *cache)
+	{
+		this->cache = cache;
+	}
+
+	/* Adds a row from the tree listing to be read. Returns false if a row
+	 * couldn't be read and there is no point adding any more.
+	*/
+	bool add(const std::string &indent, const std::string &id);
+
+	/* Waits for every row to be read and printed. Returns false if one
+	 * couldn't be.
+	*/
+	bool finish();
+
+	Stats get_stats() const
+	{
+		return stats;
+	}
+};
+
+#endif /* !MMVOCR_OCRPOOL_HPP */
@@ -0,0 +1,24 @@
+#include <stdio.h>
+#include <string>
+
+#include "ReadLine.hpp"
+
+bool read_line(FILE *f, std::string *line)
+{
+	line->erase();
+
+	char buf[1024];
+
+	while(fgets(buf, sizeof(buf), f) != NULL)
+	{
+		line->append(buf);
+
+		if(!line->empty() && (*line)[line->length() - 1] == '\n')
+		{
+			line->erase(line->length() - 1);
+			return true;
+		}
+	}
+
+	return !line->empty();
+}
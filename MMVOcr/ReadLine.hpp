@@ -0,0 +1,12 @@
+#ifndef MMVOCR_READLINE_HPP
+#define MMVOCR_READLINE_HPP
+
+#include <stdio.h>
+#include <string>
+
+/* Reads a line from f into line, without the line ending. Returns false at
+ * the end of the file.
+*/
+bool read_line(FILE *f, std::string *line);
+
+#endif /* !MMVOCR_READLINE_HPP */
@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <string>
+
+#include "GrayImage.hpp"
+#include "RowImage.hpp"
+
+/* Screenshot formats to look for, in order. MMVRipper now saves grayscale PGM
+ * (or 1-bit PBM) screenshots, older versions saved 32-bit BMPs.
+*/
+static const char *const SCREENSHOT_EXTENSIONS[] = { "pgm", "pbm", "bmp" };
+
+bool load_screenshot(const std::string &id, GrayImage *shot, std::string *error)
+{
+	std::string filename;
+	FILE *f = NULL;
+
+	for(size_t i = 0; i < sizeof(SCREENSHOT_EXTENSIONS) / sizeof(*SCREENSHOT_EXTENSIONS); ++i)
+	{
+		filename = id + "." + SCREENSHOT_EXTENSIONS[i];
+
+		if((f = fopen(filename.c_str(), "rb")) != NULL)
+		{
+			break;
+		}
+	}
+
+	if(f == NULL)
+	{
+		*error = "No screenshot of " + id + " found";
+		return false;
+	}
+
+	fclose(f);
+
+	if(!shot->load(filename.c_str()))
+	{
+		*error = "Unable to read " + filename;
+		return false;
+	}
+
+	return true;
+}
+
+void prepare_row(const GrayImage &shot, unsigned int crop, GrayImage *row)
+{
+	/* The colour space is already gray. */
+
+	row->crop(shot, crop, 0, shot.width, shot.height);
+	row->invert();
+}
@@ -0,0 +1,20 @@
+#ifndef MMVOCR_ROWIMAGE_HPP
+#define MMVOCR_ROWIMAGE_HPP
+
+#include <string>
+
+#include "GrayImage.hpp"
+
+/* Loads the screenshot of the index entry id from the working directory,
+ * whichever of the formats MMVRipper has saved it in. Returns false and sets
+ * error if there isn't one or it can't be read.
+*/
+bool load_screenshot(const std::string &id, GrayImage *shot, std::string *error);
+
+/* Prepares a screenshot for OCR the way ocr.pl had convert do it: crop pixels
+ * (see RowLayout) are cropped off the left to leave out the icon and tree
+ * lines, and the image is negated.
+*/
+void prepare_row(const GrayImage &shot, unsigned int crop, GrayImage *row);
+
+#endif /* !MMVOCR_ROWIMAGE_HPP */
@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <stdio.h>
+#include <vector>
+
+#include "GrayImage.hpp"
+#include "RowLayout.hpp"
+
+/* The crops ocr.pl used: pixels cropped from the left edge of a row at the
+ * top of the tree, and for each level deeper. These were based on the font
+ * and DPI used when the index was ripped, where the text really started at:
+ *
+ * 0: 19px
+ * 1: 35px +16
+ * 2: 51px +16
+ * 3: 68px +17
+ * 4: 83px +15
+*/
+static const unsigned int CROP_BASE = 20;
+static const unsigned int CROP_PER_LEVEL = 16;
+
+/* Rows needed at a depth to work out where its text starts. */
+static const unsigned int MIN_ROWS = 10;
+
+/* Columns with ink in no more than one in this many rows still count as
+ * blank, so the odd speck doesn't throw things off.
+*/
+static const unsigned int BLANK_RATIO = 50;
+
+/* The text is taken to start at the first stretch of columns with ink which
+ * is this many times wider than the rows are tall. Icons are about square and
+ * the tree lines leading up to them are shorter than that.
+*/
+static const unsigned int TEXT_STRETCH = 3;
+
+/* Blank stretches no wider than the rows are tall over this are taken to be
+ * between letters, so a first letter which is the same width in every row
+ * (like "WM_" at the start of them all) isn't mistaken for the icon.
+*/
+static const unsigned int LETTER_GAP_RATIO = 10;
+
+/* The last stretch of ink before the gap in front of the text must be at
+ * least the rows' height over this wide to be the icon. Anything narrower is
+ * tree lines, with the icon run into the text.
+*/
+static const unsigned int ICON_RATIO = 3;
+
+/* Blank columns to leave before the text, if there are that many. */
+static const int TEXT_MARGIN = 3;
+
+RowLayout::RowLayout():
+	fitted(false),
+	fit_base(0.0),
+	fit_per_level(0.0) {}
+
+void RowLayout::sample(const GrayImage &shot, size_t indent)
+{
+	size_t depth = indent / 2;
+
+	if(depth >= samples.size())
+	{
+		samples.resize(depth + 1);
+	}
+
+	Sample &s = samples[depth];
+
+	if(s.rows == 0)
+	{
+		s.height = shot.height;
+	}
+	else if(shot.height != s.height)
+	{
+		return;
+	}
+
+	if(s.inked.size() < shot.width)
+	{
+		s.inked.resize(shot.width, 0);
+	}
+
+	if(shot.width == 0)
+	{
+		return;
+	}
+
+	/* The text is whichever of light and dark there is less of. */
+
+	size_t dark = 0;
+
+	for(size_t i = 0; i < shot.pixels.size(); ++i)
+	{
+		dark += shot.pixels[i] < 128;
+	}
+
+	/* Flipping the pixels with this makes the ink dark. */
+	unsigned char flip = dark * 2 <= shot.pixels.size() ? 0x00 : 0xFF;
+
+	/* OR each row into a profile of which columns have ink. Kept to plain
+	 * byte arithmetic across the row so the compiler can vectorise it.
+	*/
+
+	std::vector<unsigned char> profile(shot.width, 0);
+	unsigned char *p = &(profile[0]);
+
+	for(unsigned int y = 0; y < shot.height; ++y)
+	{
+		const unsigned char *src = shot.row(y);
+
+		for(unsigned int x = 0; x < shot.width; ++x)
+		{
+			p[x] |= (unsigned char)((src[x] ^ flip) < 128);
+		}
+	}
+
+	for(unsigned int x = 0; x < shot.width; ++x)
+	{
+		s.inked[x] += p[x];
+	}
+
+	++(s.rows);
+}
+
+/* Whether column x has ink in few enough rows to count as blank. */
+bool RowLayout::is_blank(const Sample &s, int x)
+{
+	return s.inked[x] * BLANK_RATIO <= s.rows;
+}
+
+/* Finds where the text and the blank gap before it start at one depth. */
+bool RowLayout::calibrate_depth(const Sample &s, int *text, int *gap) const
+{
+	if(s.rows < MIN_ROWS)
+	{
+		return false;
+	}
+
+	int stretch = TEXT_STRETCH * s.height;
+	int run_start = -1;
+	int width = s.inked.size();
+
+	int x;
+
+	for(x = 0; x < width; ++x)
+	{
+		if(is_blank(s, x))
+		{
+			run_start = -1;
+		}
+		else{
+			if(run_start < 0)
+			{
+				run_start = x;
+			}
+
+			if(x - run_start + 1 >= stretch)
+			{
+				break;
+			}
+		}
+	}
+
+	if(x == width)
+	{
+		return false;
+	}
+
+	/* Take in any letters before it. */
+
+	int letter_gap = std::max(1, (int)(s.height / LETTER_GAP_RATIO));
+	int g;
+
+	for(;;)
+	{
+		g = run_start;
+
+		while(g > 0 && is_blank(s, g - 1))
+		{
+			--g;
+		}
+
+		if(g == 0 || run_start - g > letter_gap)
+		{
+			break;
+		}
+
+		run_start = g;
+
+		while(run_start > 0 && !is_blank(s, run_start - 1))
+		{
+			--run_start;
+		}
+	}
+
+	/* Going back from the gap should come to the icon. If there is nothing
+	 * there, or only something too narrow, the text runs straight into it.
+	*/
+
+	int icon = g;
+
+	while(icon > 0 && !is_blank(s, icon - 1))
+	{
+		--icon;
+	}
+
+	if((g - icon) * (int)(ICON_RATIO) < (int)(s.height))
+	{
+		return false;
+	}
+
+	*text = run_start;
+	*gap = g;
+
+	return true;
+}
+
+unsigned int RowLayout::calibrate()
+{
+	text_start.assign(samples.size(), -1);
+	gap_start.assign(samples.size(), -1);
+
+	unsigned int n = 0;
+	double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+
+	for(size_t d = 0; d < samples.size(); ++d)
+	{
+		if(calibrate_depth(samples[d], &(text_start[d]), &(gap_start[d])))
+		{
+			++n;
+
+			sx += d;
+			sy += text_start[d];
+			sxx += (double)(d) * d;
+			sxy += (double)(d) * text_start[d];
+		}
+	}
+
+	/* Least squares line through the depths found, or a line with ocr.pl's
+	 * spacing through the only one.
+	*/
+
+	fitted = n > 0;
+
+	if(n >= 2)
+	{
+		fit_per_level = ((n * sxy) - (sx * sy)) / ((n * sxx) - (sx * sx));
+		fit_base = (sy - (fit_per_level * sx)) / n;
+	}
+	else if(n == 1)
+	{
+		fit_per_level = CROP_PER_LEVEL;
+		fit_base = sy - (fit_per_level * sx);
+	}
+
+	return n;
+}
+
+unsigned int RowLayout::crop(size_t indent) const
+{
+	size_t depth = indent / 2;
+
+	if(depth < text_start.size() && text_start[depth] >= 0)
+	{
+		return std::max(gap_start[depth], text_start[depth] - TEXT_MARGIN);
+	}
+
+	if(fitted)
+	{
+		int start = (int)(fit_base + (fit_per_level * depth) + 0.5) - TEXT_MARGIN;
+		return start > 0 ? start : 0;
+	}
+
+	/* ocr.pl worked the depth out as half the indent, so odd indents get
+	 * half a level.
+	*/
+	return CROP_BASE + ((indent * CROP_PER_LEVEL) / 2);
+}
+
+void RowLayout::report() const
+{
+	for(size_t d = 0; d < samples.size(); ++d)
+	{
+		if(text_start[d] >= 0)
+		{
+			fprintf(stderr, "Text starts %d px in at depth %u, cropping %u px (from %u rows)\n",
+				text_start[d], (unsigned)(d), crop(d * 2), samples[d].rows);
+		}
+		else{
+			fprintf(stderr, "Couldn't find the text at depth %u, cropping %u px (from %u rows)\n",
+				(unsigned)(d), crop(d * 2), samples[d].rows);
+		}
+	}
+
+	if(fitted)
+	{
+		fprintf(stderr, "Depths without enough rows are cropped %.1f px further in for each level\n", fit_per_level);
+	}
+}
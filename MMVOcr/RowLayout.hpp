@@ -0,0 +1,79 @@
+#ifndef MMVOCR_ROWLAYOUT_HPP
+#define MMVOCR_ROWLAYOUT_HPP
+
+#include <stddef.h>
+#include <vector>
+
+#include "GrayImage.hpp"
+
+/* Works out how much to crop off the left of the screenshots of the rows at
+ * each depth of the index to leave out the tree lines and icon, which depends
+ * on the font and DPI the index was ripped with.
+ *
+ * Every row at the same depth has its icon and text in the same place, but
+ * different text. So going down each column of a sample of rows at a depth,
+ * the columns between the icon and the text are blank in every row, while
+ * once the text starts hardly any column is blank in all of them until the
+ * longest titles run out. The text starts at the first long stretch of
+ * columns with ink in some row, taking in any letters just before it, and
+ * must have a gap between it and the icon.
+ *
+ * Depths with too few rows in the sample are worked out from a straight line
+ * through the ones which had enough. Until it has been calibrated, the crops
+ * are the fixed ones ocr.pl used.
+*/
+class RowLayout
+{
+private:
+	/* How many rows at a depth have been sampled, how tall they were and
+	 * how many had ink in each column.
+	*/
+	struct Sample
+	{
+		unsigned int rows;
+		unsigned int height;
+		std::vector<unsigned int> inked;
+
+		Sample():
+			rows(0),
+			height(0) {}
+	};
+
+	std::vector<Sample> samples;
+
+	/* Where the text starts and the blank gap before it starts, for each
+	 * depth which was calibrated (or -1).
+	*/
+	std::vector<int> text_start;
+	std::vector<int> gap_start;
+
+	/* Straight line through text_start, for the other depths. */
+	bool fitted;
+	double fit_base, fit_per_level;
+
+	static bool is_blank(const Sample &s, int x);
+	bool calibrate_depth(const Sample &s, int *text, int *gap) const;
+
+public:
+	RowLayout();
+
+	/* Adds the screenshot of a row indented by indent characters in the tree
+	 * listing to the sample to calibrate from.
+	*/
+	void sample(const GrayImage &shot, size_t indent);
+
+	/* Works out the crops from the rows sampled so far. Returns the number
+	 * of depths which had enough rows to go on.
+	*/
+	unsigned int calibrate();
+
+	/* Pixels to crop off the left of the screenshot of a row indented by
+	 * indent characters in the tree listing.
+	*/
+	unsigned int crop(size_t indent) const;
+
+	/* Prints where the text was found to start at each depth to stderr. */
+	void report() const;
+};
+
+#endif /* !MMVOCR_ROWLAYOUT_HPP */
@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <string>
+#include <tesseract/capi.h>
+
+#include "GrayImage.hpp"
+#include "TesseractEngine.hpp"
+
+/* -l and --dpi as ocr.pl gave them. */
+static const char LANGUAGE[] = "eng";
+static const char DPI[] = "240";
+
+TesseractEngine::TesseractEngine():
+	api(TessBaseAPICreate()) {}
+
+TesseractEngine::~TesseractEngine()
+{
+	TessBaseAPIEnd(api);
+	TessBaseAPIDelete(api);
+}
+
+bool TesseractEngine::init(const char *datapath)
+{
+	if(TessBaseAPIInit3(api, datapath, LANGUAGE) != 0)
+	{
+		return false;
+	}
+
+	/* --psm 7, treat the image as a single text line. */
+	TessBaseAPISetPageSegMode(api, PSM_SINGLE_LINE);
+
+	/* --dpi 240, which the tesseract program also just sets as a variable. */
+	TessBaseAPISetVariable(api, "user_defined_dpi", DPI);
+
+	return true;
+}
+
+std::string TesseractEngine::describe(const char *datapath)
+{
+	/* Tesseract looks here when not given a datapath. */
+	if(datapath == NULL)
+	{
+		datapath = getenv("TESSDATA_PREFIX");
+	}
+
+	std::string d = "Tesseract ";
+	d += TessVersion();
+	d += std::string(" -l ") + LANGUAGE + " --dpi " + DPI + " --psm 7 ";
+	d += datapath != NULL ? datapath : "(default datapath)";
+
+	return d;
+}
+
+bool TesseractEngine::recognise(const GrayImage &image, std::string *text)
+{
+	text->erase();
+
+	if(image.width == 0 || image.height == 0)
+	{
+		return true;
+	}
+
+	TessBaseAPISetImage(api, &(image.pixels[0]), image.width, image.height, 1, image.width);
+
+	char *utf8 = TessBaseAPIGetUTF8Text(api);
+	if(utf8 == NULL)
+	{
+		TessBaseAPIClear(api);
+		return false;
+	}
+
+	text->assign(utf8);
+
+	TessDeleteText(utf8);
+	TessBaseAPIClear(api);
+
+	return true;
+}
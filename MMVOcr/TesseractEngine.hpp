@@ -0,0 +1,46 @@
+#ifndef MMVOCR_TESSERACTENGINE_HPP
+#define MMVOCR_TESSERACTENGINE_HPP
+
+#include <string>
+#include <tesseract/capi.h>
+
+#include "GrayImage.hpp"
+
+/* One Tesseract instance, set up to read a single line of text the way
+ * ocr.pl ran the tesseract program:
+ *
+ *   tesseract --dpi 240 -l eng --psm 7 <image> <output>
+ *
+ * The language model is loaded once when the engine is created rather than
+ * for every row. An engine can only be used by one thread at a time.
+*/
+class TesseractEngine
+{
+private:
+	TessBaseAPI *api;
+
+	/* Not copyable. */
+	TesseractEngine(const TesseractEngine&);
+	TesseractEngine &operator=(const TesseractEngine&);
+
+public:
+	TesseractEngine();
+	~TesseractEngine();
+
+	/* Loads the English model from datapath (NULL for wherever Tesseract
+	 * looks by default). Returns false if it can't be loaded.
+	*/
+	bool init(const char *datapath);
+
+	/* Describes the engine init(datapath) would load, for OcrCache: the
+	 * Tesseract version, where the model comes from and how it is set up.
+	*/
+	static std::string describe(const char *datapath);
+
+	/* Reads the text in an image, like the tesseract program would have
+	 * written to its output file. Returns false if recognition failed.
+	*/
+	bool recognise(const GrayImage &image, std::string *text);
+};
+
+#endif /* !MMVOCR_TESSERACTENGINE_HPP */
@@ -0,0 +1,73 @@
+#ifndef MMVRIPPER_ARTIFACTSTORE_HPP
+#define MMVRIPPER_ARTIFACTSTORE_HPP
+
+#include <stddef.h>
+#include <string>
+
+#include "ChunkPool.hpp"
+#include "IntTypes.hpp"
+
+/* Somewhere to put the things saved for each index entry. Each artifact is
+ * identified by the internal page ID and a kind of up to three characters
+ * ("bmp", "txt", "ps").
+*/
+class ArtifactStore
+{
+public:
+	virtual ~ArtifactStore() {}
+
+	virtual bool exists(unsigned int id, const char *kind) = 0;
+
+	virtual bool write(unsigned int id, const char *kind, const void *data, size_t len) = 0;
+
+	/* Stores a print job. The job is cleared afterwards. */
+	virtual bool write(unsigned int id, const char *kind, PrintJob &job) = 0;
+
+	/* Stores the contents of a string, which is cleared afterwards (so a
+	 * store can take it rather than copying it).
+	*/
+	virtual bool write(unsigned int id, const char *kind, std::string &data)
+	{
+		bool ok = write(id, kind, data.data(), data.length());
+		data.erase();
+
+		return ok;
+	}
+
+	/* Whether write() and exists() can be called from several threads at
+	 * once, for different artifacts.
+	*/
+	virtual bool thread_safe() const
+	{
+		return false;
+	}
+
+	/* Stores which finish writing after write() returns (see AsyncStore)
+	 * number each write in the order they were made. submitted() returns
+	 * the number of the last write made, completed() the number of the
+	 * last one which it and everything before it have finished. Stores
+	 * which write straight away return zero for both.
+	*/
+	virtual uint64 submitted()
+	{
+		return 0;
+	}
+
+	virtual uint64 completed()
+	{
+		return 0;
+	}
+
+	/* Waits for every write made so far to finish. */
+	virtual void flush() {}
+
+	/* Returns the next write which failed after write() returned, false
+	 * if there are none.
+	*/
+	virtual bool get_error(unsigned int *, std::string *)
+	{
+		return false;
+	}
+};
+
+#endif /* !MMVRIPPER_ARTIFACTSTORE_HPP */
@@ -0,0 +1,299 @@
+#include <assert.h>
+#include <deque>
+#include <set>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AsyncStore.hpp"
+
+AsyncStore::AsyncStore(ArtifactStore *backing, unsigned int threads, unsigned int max_queued):
+	backing(backing),
+	serialise(!backing->thread_safe()),
+	slots(max_queued),
+	last_submitted(0),
+	last_completed(0),
+	outstanding(0),
+	flush_waiting(false),
+	tracer(NULL)
+{
+	assert(threads > 0);
+	assert(max_queued > 0);
+
+	memset(&stats, 0, sizeof(stats));
+
+	for(unsigned int i = 0; i < threads; ++i)
+	{
+		Worker *w = new Worker(this);
+
+		if(w->start())
+		{
+			workers.push_back(w);
+		}
+		else{
+			delete w;
+		}
+	}
+
+	/* Can't do anything without at least one worker. */
+	assert(!workers.empty());
+}
+
+AsyncStore::~AsyncStore()
+{
+	/* Stop requests go after everything already queued, so the workers
+	 * finish that first. They don't take a slot, so this never waits for
+	 * space.
+	*/
+
+	for(size_t i = 0; i < workers.size(); ++i)
+	{
+		Request *req = new Request;
+		req->stop = true;
+
+		{
+			MutexLock l(lock);
+			queue.push_back(req);
+		}
+
+		queued.post();
+	}
+
+	for(size_t i = 0; i < workers.size(); ++i)
+	{
+		workers[i]->join();
+		delete workers[i];
+	}
+}
+
+void AsyncStore::submit(Request *req, size_t size)
+{
+	req->stop = false;
+
+	if(!slots.try_wait())
+	{
+		/* Queue is full, wait for a worker to catch up. */
+
+		{
+			MutexLock l(lock);
+			++(stats.full);
+		}
+
+		slots.wait();
+	}
+
+	{
+		MutexLock l(lock);
+
+		req->seq = ++last_submitted;
+
+		queue.push_back(req);
+		pending.insert(std::make_pair(req->id, req->kind));
+		++outstanding;
+
+		++(stats.writes);
+		stats.bytes += size;
+
+		if(queue.size() > stats.max_queued)
+		{
+			stats.max_queued = queue.size();
+		}
+	}
+
+	queued.post();
+}
+
+void AsyncStore::worker_main()
+{
+	while(true)
+	{
+		queued.wait();
+
+		Request *req;
+
+		{
+			MutexLock l(lock);
+
+			req = queue.front();
+			queue.pop_front();
+		}
+
+		if(req->stop)
+		{
+			delete req;
+			break;
+		}
+
+		slots.post();
+
+		bool ok;
+
+		{
+			TraceScope trace(tracer, TRACE_WRITE, req->id);
+
+			if(serialise)
+			{
+				backing_lock.lock();
+			}
+
+			ok = req->is_job
+				? backing->write(req->id, req->kind.c_str(), req->job)
+				: backing->write(req->id, req->kind.c_str(), req->data.data(), req->data.length());
+
+			if(serialise)
+			{
+				backing_lock.unlock();
+			}
+		}
+
+		{
+			MutexLock l(lock);
+
+			pending.erase(pending.find(std::make_pair(req->id, req->kind)));
+
+			if(!ok)
+			{
+				errors.push_back(std::make_pair(req->id, req->kind));
+				++(stats.errors);
+			}
+
+			/* Errors are queued before the write counts as completed, so
+			 * anyone who sees it completed can see the error too.
+			*/
+
+			if(req->seq == last_completed + 1)
+			{
+				++last_completed;
+
+				while(!completed_early.empty() && *(completed_early.begin()) == last_completed + 1)
+				{
+					completed_early.erase(completed_early.begin());
+					++last_completed;
+				}
+			}
+			else{
+				completed_early.insert(req->seq);
+			}
+
+			if(--outstanding == 0 && flush_waiting)
+			{
+				flush_waiting = false;
+				idle.post();
+			}
+		}
+
+		delete req;
+	}
+}
+
+AsyncStore::Stats AsyncStore::get_stats()
+{
+	MutexLock l(lock);
+	return stats;
+}
+
+bool AsyncStore::exists(unsigned int id, const char *kind)
+{
+	{
+		MutexLock l(lock);
+
+		if(pending.find(std::make_pair(id, std::string(kind))) != pending.end())
+		{
+			return true;
+		}
+	}
+
+	if(serialise)
+	{
+		MutexLock l(backing_lock);
+		return backing->exists(id, kind);
+	}
+	else{
+		return backing->exists(id, kind);
+	}
+}
+
+bool AsyncStore::write(unsigned int id, const char *kind, const void *data, size_t len)
+{
+	Request *req = new Request;
+	req->id = id;
+	req->kind = kind;
+	req->data.assign((const char*)(data), len);
+	req->is_job = false;
+
+	submit(req, len);
+
+	return true;
+}
+
+bool AsyncStore::write(unsigned int id, const char *kind, PrintJob &job)
+{
+	Request *req = new Request;
+	req->id = id;
+	req->kind = kind;
+	req->job.swap(job);
+	req->is_job = true;
+
+	submit(req, req->job.size());
+
+	return true;
+}
+
+bool AsyncStore::write(unsigned int id, const char *kind, std::string &data)
+{
+	Request *req = new Request;
+	req->id = id;
+	req->kind = kind;
+	req->data.swap(data);
+	req->is_job = false;
+
+	submit(req, req->data.length());
+
+	return true;
+}
+
+uint64 AsyncStore::submitted()
+{
+	MutexLock l(lock);
+	return last_submitted;
+}
+
+uint64 AsyncStore::completed()
+{
+	MutexLock l(lock);
+	return last_completed;
+}
+
+void AsyncStore::flush()
+{
+	{
+		MutexLock l(lock);
+
+		if(outstanding == 0)
+		{
+			return;
+		}
+
+		flush_waiting = true;
+	}
+
+	idle.wait();
+}
+
+bool AsyncStore::get_error(unsigned int *id, std::string *kind)
+{
+	MutexLock l(lock);
+
+	if(errors.empty())
+	{
+		return false;
+	}
+
+	*id = errors.front().first;
+	*kind = errors.front().second;
+
+	errors.pop_front();
+
+	return true;
+}
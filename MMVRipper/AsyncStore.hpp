@@ -0,0 +1,136 @@
+#ifndef MMVRIPPER_ASYNCSTORE_HPP
+#define MMVRIPPER_ASYNCSTORE_HPP
+
+#include <deque>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ArtifactStore.hpp"
+#include "ChunkPool.hpp"
+#include "IntTypes.hpp"
+#include "Threading.hpp"
+#include "Tracer.hpp"
+
+/* Hands writes to another ArtifactStore over to a pool of worker threads, so
+ * the thread driving the viewer doesn't have to wait for the disk.
+ *
+ * write() takes the data (the string or print job is swapped out rather than
+ * copied) and returns straight away, unless max_queued writes are already
+ * waiting, in which case it waits for one to finish. Errors are reported
+ * later through get_error(), and submitted()/completed() say which writes
+ * have finished so the journal isn't told about an artifact before it is on
+ * disk.
+ *
+ * If the store being written to isn't thread safe, only one worker writes to
+ * it at a time.
+*/
+class AsyncStore: public ArtifactStore
+{
+public:
+	struct Stats
+	{
+		unsigned long writes;
+		unsigned long errors;
+		unsigned long full;        /* Writes which had to wait for space. */
+		unsigned long max_queued;
+		uint64 bytes;
+	};
+
+private:
+	struct Request
+	{
+		uint64 seq;
+		unsigned int id;
+		std::string kind;
+
+		std::string data;
+		PrintJob job;
+		bool is_job;
+
+		bool stop;  /* Tells a worker to exit. */
+	};
+
+	class Worker: public Thread
+	{
+	private:
+		AsyncStore *store;
+
+	protected:
+		virtual void run()
+		{
+			store->worker_main();
+		}
+
+	public:
+		Worker(AsyncStore *store):
+			store(store) {}
+	};
+
+	ArtifactStore *backing;
+	Mutex backing_lock;
+	bool serialise;
+
+	Mutex lock;
+	std::deque<Request*> queue;
+	Semaphore slots;   /* Free space in the queue. */
+	Semaphore queued;  /* Requests in the queue. */
+
+	/* Artifacts queued or being written, so exists() knows about them. */
+	std::multiset< std::pair<unsigned int, std::string> > pending;
+
+	uint64 last_submitted;
+	uint64 last_completed;
+	std::set<uint64> completed_early;  /* Finished out of order. */
+
+	std::deque< std::pair<unsigned int, std::string> > errors;
+
+	unsigned int outstanding;
+	bool flush_waiting;
+	Semaphore idle;
+
+	std::vector<Worker*> workers;
+
+	Tracer *tracer;
+
+	Stats stats;
+
+	void submit(Request *req, size_t size);
+	void worker_main();
+
+	AsyncStore(const AsyncStore&);
+	AsyncStore &operator=(const AsyncStore&);
+
+public:
+	AsyncStore(ArtifactStore *backing, unsigned int threads, unsigned int max_queued);
+
+	/* Waits for anything still queued to be written. */
+	~AsyncStore();
+
+	Stats get_stats();
+
+	/* Records each write to tracer. Call before writing anything. */
+	void set_tracer(Tracer *tracer)
+	{
+		this->tracer = tracer;
+	}
+
+	virtual bool exists(unsigned int id, const char *kind);
+
+	virtual bool write(unsigned int id, const char *kind, const void *data, size_t len);
+	virtual bool write(unsigned int id, const char *kind, PrintJob &job);
+	virtual bool write(unsigned int id, const char *kind, std::string &data);
+
+	virtual bool thread_safe() const
+	{
+		return true;
+	}
+
+	virtual uint64 submitted();
+	virtual uint64 completed();
+	virtual void flush();
+	virtual bool get_error(unsigned int *id, std::string *kind);
+};
+
+#endif /* !MMVRIPPER_ASYNCSTORE_HPP */
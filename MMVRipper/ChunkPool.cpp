@@ -0,0 +1,419 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "ChunkPool.hpp"
+
+ChunkPool::ChunkPool(size_t max_free_chunks):
+	max_free_chunks(max_free_chunks)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+ChunkPool::~ChunkPool()
+{
+	for(size_t i = 0; i < free_chunks.size(); ++i)
+	{
+		free(free_chunks[i]);
+	}
+}
+
+unsigned char *ChunkPool::get()
+{
+	MutexLock l(lock);
+
+	if(!free_chunks.empty())
+	{
+		unsigned char *chunk = free_chunks.back();
+		free_chunks.pop_back();
+
+		++(stats.chunks_reused);
+
+		return chunk;
+	}
+
+	unsigned char *chunk = (unsigned char*)(malloc(CHUNK_SIZE));
+	if(chunk == NULL)
+	{
+		abort();
+	}
+
+	++(stats.chunks_allocated);
+
+	return chunk;
+}
+
+void ChunkPool::put(unsigned char *chunk)
+{
+	MutexLock l(lock);
+
+	if(free_chunks.size() < max_free_chunks)
+	{
+		free_chunks.push_back(chunk);
+	}
+	else{
+		free(chunk);
+		++(stats.chunks_freed);
+	}
+}
+
+void ChunkPool::count_received(size_t bytes)
+{
+	MutexLock l(lock);
+	stats.bytes_received += bytes;
+}
+
+void ChunkPool::count_copied(size_t bytes)
+{
+	MutexLock l(lock);
+	stats.bytes_copied += bytes;
+}
+
+void ChunkPool::count_spooled(size_t bytes)
+{
+	MutexLock l(lock);
+	stats.bytes_spooled += bytes;
+}
+
+ChunkPool::Stats ChunkPool::get_stats()
+{
+	MutexLock l(lock);
+	return stats;
+}
+
+PrintJob::PrintJob(ChunkPool *pool):
+	pool(pool),
+	length(0),
+	spooled(0),
+	spool_file(NULL),
+	spool_max_buffered(0),
+	spool_error(false) {}
+
+PrintJob::~PrintJob()
+{
+	clear();
+}
+
+void PrintJob::swap(PrintJob &other)
+{
+	ChunkPool *tmp_pool = pool;
+	pool = other.pool;
+	other.pool = tmp_pool;
+
+	chunks.swap(other.chunks);
+
+	size_t tmp_length = length;
+	length = other.length;
+	other.length = tmp_length;
+
+	size_t tmp_spooled = spooled;
+	spooled = other.spooled;
+	other.spooled = tmp_spooled;
+
+	spool_path.swap(other.spool_path);
+
+	FILE *tmp_spool_file = spool_file;
+	spool_file = other.spool_file;
+	other.spool_file = tmp_spool_file;
+
+	size_t tmp_spool_max_buffered = spool_max_buffered;
+	spool_max_buffered = other.spool_max_buffered;
+	other.spool_max_buffered = tmp_spool_max_buffered;
+
+	bool tmp_spool_error = spool_error;
+	spool_error = other.spool_error;
+	other.spool_error = tmp_spool_error;
+}
+
+void PrintJob::clear()
+{
+	for(size_t i = 0; i < chunks.size(); ++i)
+	{
+		pool->put(chunks[i]);
+	}
+
+	chunks.clear();
+	length = 0;
+	spooled = 0;
+
+	if(spool_file != NULL)
+	{
+		fclose(spool_file);
+		spool_file = NULL;
+	}
+
+	if(!spool_path.empty())
+	{
+		remove(spool_path.c_str());
+		spool_path.clear();
+	}
+
+	spool_error = false;
+}
+
+unsigned char *PrintJob::append_space(size_t *space)
+{
+	assert(pool != NULL);
+
+	size_t buffered = length - spooled;
+	size_t used = buffered % ChunkPool::CHUNK_SIZE;
+
+	if(chunks.size() * ChunkPool::CHUNK_SIZE == buffered)
+	{
+		/* Last chunk is full (or we don't have one). */
+		chunks.push_back(pool->get());
+		used = 0;
+	}
+
+	*space = ChunkPool::CHUNK_SIZE - used;
+	return chunks.back() + used;
+}
+
+void PrintJob::commit(size_t len)
+{
+	assert((length - spooled) + len <= chunks.size() * ChunkPool::CHUNK_SIZE);
+	length += len;
+
+	if(spool_file != NULL && (length - spooled) > spool_max_buffered)
+	{
+		/* Write out every full chunk, keep the partial one at the end. */
+		spool_chunks((length - spooled) / ChunkPool::CHUNK_SIZE);
+	}
+}
+
+void PrintJob::append(const unsigned char *data, size_t len)
+{
+	pool->count_copied(len);
+
+	while(len > 0)
+	{
+		size_t space;
+		unsigned char *dest = append_space(&space);
+
+		size_t n = len < space ? len : space;
+		memcpy(dest, data, n);
+		commit(n);
+
+		data += n;
+		len -= n;
+	}
+}
+
+const unsigned char *PrintJob::chunk(size_t idx, size_t *len) const
+{
+	assert(idx < chunks.size());
+
+	if(idx + 1 < chunks.size())
+	{
+		*len = ChunkPool::CHUNK_SIZE;
+	}
+	else{
+		*len = (length - spooled) - (idx * ChunkPool::CHUNK_SIZE);
+	}
+
+	return chunks[idx];
+}
+
+bool PrintJob::spool_to(const char *path, size_t max_buffered)
+{
+	assert(spool_path.empty());
+
+	spool_file = fopen(path, "wb");
+	if(spool_file == NULL)
+	{
+		return false;
+	}
+
+	/* We only ever write whole chunks, stdio buffering would just add
+	 * another copy.
+	*/
+	setvbuf(spool_file, NULL, _IONBF, 0);
+
+	spool_path = path;
+	spool_max_buffered = max_buffered;
+
+	return true;
+}
+
+void PrintJob::spool_chunks(size_t count)
+{
+	assert(count <= chunks.size());
+
+	size_t written = 0;
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		size_t len;
+		const unsigned char *data = chunk(i, &len);
+
+		if(!spool_error && fwrite(data, 1, len, spool_file) != len)
+		{
+			spool_error = true;
+		}
+
+		written += len;
+		pool->put(chunks[i]);
+	}
+
+	chunks.erase(chunks.begin(), chunks.begin() + count);
+	spooled += written;
+
+	pool->count_spooled(written);
+}
+
+bool PrintJob::finish_spool()
+{
+	if(spool_file == NULL)
+	{
+		return false;
+	}
+
+	spool_chunks(chunks.size());
+
+	if(fclose(spool_file) != 0)
+	{
+		spool_error = true;
+	}
+
+	spool_file = NULL;
+
+	return !spool_error;
+}
+
+/* Moves a file, replacing anything already at to (like a .tmp left behind by
+ * a killed run). rename() won't replace an existing file on Windows, or move
+ * a file to another volume anywhere, so fall back to copying it.
+*/
+static bool move_file(const char *from, const char *to)
+{
+	remove(to);
+
+	if(rename(from, to) == 0)
+	{
+		return true;
+	}
+
+	FILE *in = fopen(from, "rb");
+	if(in == NULL)
+	{
+		return false;
+	}
+
+	FILE *out = fopen(to, "wb");
+	if(out == NULL)
+	{
+		fclose(in);
+		return false;
+	}
+
+	std::vector<unsigned char> buf(ChunkPool::CHUNK_SIZE);
+	bool ok = true;
+
+	size_t len;
+	while(ok && (len = fread(&(buf[0]), 1, buf.size(), in)) > 0)
+	{
+		ok = fwrite(&(buf[0]), 1, len, out) == len;
+	}
+
+	ok = !ferror(in) && ok;
+
+	fclose(in);
+	ok = (fclose(out) == 0) && ok;
+
+	if(!ok)
+	{
+		remove(to);
+		return false;
+	}
+
+	remove(from);
+	return true;
+}
+
+bool PrintJob::save(const char *filename)
+{
+	if(is_spooled())
+	{
+		if(spool_file != NULL || spool_error)
+		{
+			/* Unfinished or broken spool file. */
+			return false;
+		}
+
+		/* As long as the spool directory is on the same volume, this is a
+		 * cheap and atomic rename rather than a copy.
+		*/
+		if(!move_file(spool_path.c_str(), filename))
+		{
+			return false;
+		}
+
+		spool_path.clear();
+		return true;
+	}
+
+	size_t i, len;
+
+#ifdef _WIN32
+	/* WriteFileGather() wants unbuffered, overlapped, page-sized writes which
+	 * don't suit the last chunk, so just write the chunks one after another.
+	*/
+
+	HANDLE file = CreateFile(filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	bool ok = true;
+
+	for(i = 0; i < chunks.size() && ok; ++i)
+	{
+		const unsigned char *data = chunk(i, &len);
+
+		DWORD written;
+		ok = WriteFile(file, data, len, &written, NULL) && written == len;
+	}
+
+	CloseHandle(file);
+#else
+	int fd = open(filename, (O_WRONLY | O_CREAT | O_TRUNC), 0666);
+	if(fd < 0)
+	{
+		return false;
+	}
+
+	bool ok = true;
+
+	for(i = 0; i < chunks.size() && ok;)
+	{
+		struct iovec iov[64];
+		int iovcnt = 0;
+		size_t total = 0;
+
+		for(; i < chunks.size() && iovcnt < 64; ++i, ++iovcnt)
+		{
+			iov[iovcnt].iov_base = (void*)(chunk(i, &len));
+			iov[iovcnt].iov_len = len;
+
+			total += len;
+		}
+
+		ok = writev(fd, iov, iovcnt) == (ssize_t)(total);
+	}
+
+	ok = (close(fd) == 0) && ok;
+#endif
+
+	return ok;
+}
@@ -0,0 +1,152 @@
+#ifndef MMVRIPPER_CHUNKPOOL_HPP
+#define MMVRIPPER_CHUNKPOOL_HPP
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "IntTypes.hpp"
+#include "Threading.hpp"
+
+/* Pool of fixed size buffers for print job data. Chunks are handed back to
+ * the pool when a job is released and reused for the next one, so a run of
+ * similarly sized jobs settles down to no heap allocations at all.
+ *
+ * Safe to use from multiple threads.
+*/
+class ChunkPool
+{
+public:
+	enum { CHUNK_SIZE = 64 * 1024 };
+
+	struct Stats
+	{
+		uint64 chunks_allocated;  /* New chunks allocated from the heap. */
+		uint64 chunks_reused;     /* Requests satisfied from the free list. */
+		uint64 chunks_freed;      /* Chunks returned to the heap. */
+
+		uint64 bytes_received;    /* Bytes read straight into a chunk. */
+		uint64 bytes_copied;      /* Bytes copied from one buffer to another. */
+		uint64 bytes_spooled;     /* Bytes written out to spool files. */
+	};
+
+private:
+	Mutex lock;
+
+	std::vector<unsigned char*> free_chunks;
+	size_t max_free_chunks;
+
+	Stats stats;
+
+	ChunkPool(const ChunkPool&);
+	ChunkPool &operator=(const ChunkPool&);
+
+public:
+	/* Up to max_free_chunks chunks are held for reuse, any more are freed. */
+	ChunkPool(size_t max_free_chunks = 256);
+	~ChunkPool();
+
+	unsigned char *get();
+	void put(unsigned char *chunk);
+
+	void count_received(size_t bytes);
+	void count_copied(size_t bytes);
+	void count_spooled(size_t bytes);
+
+	Stats get_stats();
+};
+
+/* Print job data stored as a list of chunks from a ChunkPool.
+ *
+ * A job may also be spooled to disk as it is received (see spool_to()), in
+ * which case only a bounded amount of it is held in memory at any time and
+ * a completed job is little more than the name of its spool file.
+ *
+ * Jobs can't be copied, use swap() to move one somewhere else.
+*/
+class PrintJob
+{
+private:
+	ChunkPool *pool;
+
+	std::vector<unsigned char*> chunks;
+	size_t length;
+
+	/* Bytes from the start of the job which have been written out to the
+	 * spool file and are no longer held in chunks.
+	*/
+	size_t spooled;
+
+	std::string spool_path;
+	FILE *spool_file;
+	size_t spool_max_buffered;
+	bool spool_error;
+
+	void spool_chunks(size_t count);
+
+	PrintJob(const PrintJob&);
+	PrintJob &operator=(const PrintJob&);
+
+public:
+	/* A job with no pool can't have data appended to it, but can have
+	 * another job swapped into it.
+	*/
+	PrintJob(ChunkPool *pool = NULL);
+	~PrintJob();
+
+	void swap(PrintJob &other);
+
+	/* Releases all data, deleting the spool file if it hasn't been saved. */
+	void clear();
+
+	size_t size() const
+	{
+		return length;
+	}
+
+	/* Returns a pointer to the free space at the end of the job, allocating
+	 * a new chunk if the last one is full. The caller may write up to *space
+	 * bytes there and then call commit() with the number written.
+	*/
+	unsigned char *append_space(size_t *space);
+	void commit(size_t len);
+
+	/* Copies data onto the end of the job. */
+	void append(const unsigned char *data, size_t len);
+
+	/* Number of chunks still held in memory. */
+	size_t chunk_count() const
+	{
+		return chunks.size();
+	}
+
+	const unsigned char *chunk(size_t idx, size_t *len) const;
+
+	/* Starts spooling the job to a new file at path. Whenever more than
+	 * max_buffered bytes are held in memory, the full chunks are written
+	 * out and given back to the pool.
+	*/
+	bool spool_to(const char *path, size_t max_buffered);
+
+	/* Writes out anything still buffered and closes the spool file. */
+	bool finish_spool();
+
+	bool is_spooled() const
+	{
+		return !spool_path.empty();
+	}
+
+	/* Path of the spool file holding the job, if is_spooled(). */
+	const char *spool_filename() const
+	{
+		return spool_path.c_str();
+	}
+
+	/* Writes the job out to a file. A finished spooled job is renamed into
+	 * place, anything else is written straight from the chunks.
+	*/
+	bool save(const char *filename);
+};
+
+#endif /* !MMVRIPPER_CHUNKPOOL_HPP */
@@ -0,0 +1,43 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "Clock.hpp"
+
+uint64 clock_us()
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	if(frequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&frequency);
+	}
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	/* Split up to avoid overflowing with high frequency counters. */
+	uint64 ticks = (uint64)(now.QuadPart);
+	uint64 freq = (uint64)(frequency.QuadPart);
+
+	return ((ticks / freq) * 1000000) + (((ticks % freq) * 1000000) / freq);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64)(ts.tv_sec) * 1000000) + (ts.tv_nsec / 1000);
+#endif
+}
+
+void sleep_ms(unsigned int ms)
+{
+#ifdef _WIN32
+	Sleep(ms);
+#else
+	usleep(ms * 1000);
+#endif
+}
@@ -0,0 +1,13 @@
+#ifndef MMVRIPPER_CLOCK_HPP
+#define MMVRIPPER_CLOCK_HPP
+
+#include "IntTypes.hpp"
+
+/* Monotonic time in microseconds from some arbitrary starting point, for
+ * measuring how long things take.
+*/
+uint64 clock_us();
+
+void sleep_ms(unsigned int ms);
+
+#endif /* !MMVRIPPER_CLOCK_HPP */
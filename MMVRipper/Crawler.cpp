@@ -0,0 +1,1267 @@
+#include <assert.h>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Clock.hpp"
+#include "Crawler.hpp"
+#include "OemTranscoder.hpp"
+#include "ShardCoordinator.hpp"
+
+/* How long the viewer was given to settle after printing before it was
+ * checked, and how long we wait for it until we know better.
+*/
+static const uint64 DEFAULT_SETTLE_LIMIT_US = 500000;
+
+/* Give up if the viewer has to be restarted this many times without getting
+ * any further.
+*/
+static const unsigned int MAX_RECOVERIES = 3;
+
+/* How often to check whether the viewer has settled. */
+static const unsigned int SETTLE_POLL_MS = 2;
+
+/* The viewer has to stay idle for this long to count as settled, it can look
+ * idle for a moment in between the stages of printing.
+*/
+static const uint64 SETTLE_FLOOR_US = 6000;
+
+/* Pixels darker than this are black in 1-bit captures. */
+static const unsigned char PBM_THRESHOLD = 128;
+
+const char *content_pass_name(ContentPass pass)
+{
+	static const char *NAMES[] = { "text", "shots", "prints" };
+	return NAMES[pass];
+}
+
+static void indent_string(char *indent, int depth)
+{
+	indent[0] = '\0';
+
+	for(int i = 0; i < depth; ++i)
+	{
+		strcat(indent, "  ");
+	}
+}
+
+Crawler::Crawler(ViewerDriver *viewer, ArtifactStore *store, const CrawlOptions &options):
+	viewer(viewer),
+	store(store),
+	options(options),
+	listbox(viewer, options.absolute_cursor, options.verify_listbox),
+	viewport(viewer, &listbox),
+	latency(DEFAULT_SETTLE_LIMIT_US),
+	journal(&own_journal),
+	shard(NULL),
+	tracer(NULL),
+	supervisor(NULL),
+	quarantine(NULL),
+	recoveries(0),
+	gave_up(false),
+	message_log(NULL),
+	nodes_visited(0),
+	nodes_skipped(0),
+	captures(0),
+	capture_us(0),
+	capture_us_max(0),
+	store_writes(0),
+	store_us(0),
+	store_us_max(0),
+	store_flush_us(0),
+	start_messages(0),
+	start_navigations(0) {}
+
+void Crawler::reset_listbox_state()
+{
+	/* Expanding or collapsing a group always changes the number of items in
+	 * the listbox and moving always changes the selection, so we only need to
+	 * look at those to see if a key did anything.
+	*/
+
+	viewer->press_key(ViewerDriver::KEY_END);
+
+	unsigned int prev_list_count = viewer->get_count();
+	unsigned int prev_list_sel = viewer->get_cursor();
+
+	while(true)
+	{
+		/* Try collapsing a group. */
+
+		viewer->press_key(ViewerDriver::KEY_LEFT);
+
+		unsigned int new_list_count = viewer->get_count();
+		unsigned int new_list_sel = viewer->get_cursor();
+
+		if(new_list_count != prev_list_count || new_list_sel != prev_list_sel)
+		{
+			/* We collapsed a group. */
+
+			prev_list_count = new_list_count;
+			prev_list_sel = new_list_sel;
+
+			continue;
+		}
+
+		/* Doesn't look like we are in a group, try moving up. */
+
+		viewer->press_key(ViewerDriver::KEY_UP);
+
+		new_list_count = viewer->get_count();
+		new_list_sel = viewer->get_cursor();
+
+		if(new_list_count != prev_list_count || new_list_sel != prev_list_sel)
+		{
+			/* Moved up. */
+
+			prev_list_count = new_list_count;
+			prev_list_sel = new_list_sel;
+
+			continue;
+		}
+
+		/* Looks like everything is now collapsed and we are at the top. */
+		break;
+	}
+
+	listbox.load();
+}
+
+void Crawler::run()
+{
+	start_run();
+	walk(0, listbox.size(), 0, 0);
+
+	if(options.num_passes > 0 && !gave_up)
+	{
+		run_passes();
+	}
+
+	finish_run();
+}
+
+void Crawler::run_shard(ShardCoordinator *shard, Journal *shared_journal, bool first)
+{
+	this->shard = shard;
+	journal = shared_journal;
+
+	start_run();
+
+	if(first)
+	{
+		walk(0, listbox.size(), 0, 0);
+	}
+
+	std::vector<unsigned int> parents;
+	unsigned int id;
+
+	while(!gave_up)
+	{
+		/* The viewer is left alone while we wait for something to steal,
+		 * don't let the watchdog think it has hung.
+		*/
+		if(supervisor != NULL)
+		{
+			supervisor->set_watching(false);
+		}
+
+		if(!shard->steal(&parents, &id))
+		{
+			break;
+		}
+
+		if(supervisor != NULL)
+		{
+			supervisor->set_watching(true);
+		}
+
+		visit_stolen(parents, id);
+	}
+
+	if(gave_up)
+	{
+		/* Let the others have what is left. */
+		shard->leave();
+	}
+
+	/* The tree can't be put together until everyone has finished walking. */
+	if(shard->arrive())
+	{
+		shard->merge_tree();
+		shard->release();
+	}
+
+	for(unsigned int p = 0; p < options.num_passes; ++p)
+	{
+		ContentPass pass = options.passes[p];
+
+		/* Everyone finishes a pass before the next one starts, so the
+		 * first one really is done first.
+		*/
+		if(shard->arrive())
+		{
+			std::vector<IndexEntry> needed;
+			select_needed(pass, shard->get_entries(), &needed);
+
+			shard->start_pass(pass, needed);
+			shard->release();
+		}
+
+		if(supervisor != NULL)
+		{
+			supervisor->set_watching(true);
+		}
+
+		std::vector<IndexEntry> chunk;
+
+		while(!gave_up && shard->take(&chunk))
+		{
+			collect(pass, chunk);
+		}
+
+		if(supervisor != NULL)
+		{
+			supervisor->set_watching(false);
+		}
+	}
+
+	while(!open_path.empty() && !gave_up)
+	{
+		close_group();
+	}
+
+	finish_run();
+
+	this->shard = NULL;
+	journal = &own_journal;
+}
+
+void Crawler::start_run()
+{
+	if(options.message_log != NULL)
+	{
+		message_log = fopen(options.message_log, "w");
+		assert(message_log != NULL);
+	}
+
+	if(options.journal != NULL && journal == &own_journal)
+	{
+		bool opened = journal->open(options.journal);
+		assert(opened);
+	}
+
+	if(options.latency_file != NULL)
+	{
+		latency.load(options.latency_file);
+	}
+
+	if(supervisor != NULL)
+	{
+		supervisor->set_watching(true);
+	}
+
+	start_messages = viewer->get_message_count();
+	start_navigations = viewer->get_navigation_count();
+
+	if(listbox.size() == 0)
+	{
+		listbox.load();
+	}
+}
+
+void Crawler::finish_run()
+{
+	if(supervisor != NULL)
+	{
+		supervisor->set_watching(false);
+	}
+
+	if(gave_up)
+	{
+		fprintf(stderr, "Gave up on the crawl, the viewer died and couldn't be restarted\n");
+	}
+
+	uint64 flush_start = clock_us();
+	store->flush();
+	store_flush_us = clock_us() - flush_start;
+
+	update_journal();
+	journal->sync();
+
+	if(options.latency_file != NULL && !latency.save(options.latency_file))
+	{
+		fprintf(stderr, "Unable to save %s\n", options.latency_file);
+	}
+
+	if(nodes_skipped > 0)
+	{
+		fprintf(stderr, "Skipped %lu index entries finished in a previous run\n", nodes_skipped);
+	}
+
+	unsigned long messages = viewer->get_message_count() - start_messages;
+	unsigned long navigations = viewer->get_navigation_count() - start_navigations;
+
+	fprintf(stderr, "Visited %lu index entries using %lu messages (%.2f per entry), %lu to move the cursor (%.2f per entry)\n",
+		nodes_visited, messages, (nodes_visited > 0 ? (double)(messages) / nodes_visited : 0.0),
+		navigations, (nodes_visited > 0 ? (double)(navigations) / nodes_visited : 0.0));
+
+	print_stats();
+
+	if(message_log != NULL)
+	{
+		fclose(message_log);
+		message_log = NULL;
+	}
+}
+
+/* Walks the listbox rows from begin to end, which are all at the same depth
+ * and collapsed.
+*/
+void Crawler::walk(unsigned int begin, unsigned int end, int depth, unsigned int parent)
+{
+	/* Like scanning down the listbox used to, we stop at the first item that
+	 * has been seen before.
+	 *
+	 * When sharing the index with other crawlers, what we have seen depends
+	 * on what we got given, so everything is visited and ShardCoordinator
+	 * works out where a single crawler would have stopped.
+	*/
+
+	std::vector<unsigned int> new_items;
+
+	for(unsigned int r = begin; r < end; ++r)
+	{
+		if(seen_items.find(listbox.item(r)) != seen_items.end())
+		{
+			if(shard == NULL)
+			{
+				break;
+			}
+		}
+		else{
+			seen_items.insert(listbox.item(r));
+		}
+
+		new_items.push_back(listbox.item(r));
+	}
+
+	int group = -1;
+
+	if(shard != NULL)
+	{
+		shard->record_walked(path, new_items);
+		group = shard->add_group(path, new_items);
+	}
+
+	for(size_t i = 0; i < new_items.size() && !gave_up; ++i)
+	{
+		if(group >= 0 && !shard->claim(group, i))
+		{
+			/* Another crawler took the rest, so whoever is above us doesn't
+			 * get marked as done until everything under it is in the
+			 * journal again.
+			*/
+			if(parent != 0)
+			{
+				failed.insert(parent);
+			}
+
+			break;
+		}
+
+		visit(begin + i, new_items[i], depth, parent);
+	}
+}
+
+/* Visits the item at row idx, and everything under it. */
+void Crawler::visit(unsigned int idx, unsigned int id, int depth, unsigned int parent)
+{
+	const Journal::Node *jn = journal->find(id);
+	if(jn != NULL && jn->done_before)
+	{
+		/* Finished this whole subtree in a previous run, just print what we
+		 * found under it then.
+		*/
+		replay(id, depth);
+		return;
+	}
+
+	unsigned long start_messages = viewer->get_message_count();
+
+	if(shard == NULL)
+	{
+		char indent[128];
+		indent_string(indent, depth);
+
+		printf("%s%u\n", indent, id);
+	}
+
+	if(options.journal != NULL)
+	{
+		journal->visited(id, parent, depth);
+	}
+
+	uint64 row_capture_us = 0;
+	unsigned int num_children;
+
+	while(true)
+	{
+		{
+			TraceScope trace(tracer, TRACE_NAVIGATE, id);
+			listbox.move_to(idx);
+		}
+
+		if(options.index_screenshots && options.num_passes == 0)
+		{
+			TraceScope trace(tracer, TRACE_CAPTURE, id);
+			row_capture_us = capture(idx, id);
+		}
+
+		{
+			TraceScope trace(tracer, TRACE_EXPAND, id);
+			num_children = listbox.expand();
+		}
+
+		if(viewer->is_alive())
+		{
+			break;
+		}
+
+		/* It died under us, have another go with a new one. */
+		if(!recover(0))
+		{
+			return;
+		}
+	}
+
+	if(shard == NULL && options.num_passes > 0)
+	{
+		add_entry(id, num_children > 0);
+	}
+
+	if(num_children > 0)
+	{
+		viewport.invalidate();
+
+		path.push_back(id);
+
+		unsigned long child_messages = viewer->get_message_count();
+		walk(idx + 1, idx + 1 + num_children, depth + 1, id);
+		start_messages += viewer->get_message_count() - child_messages;
+
+		path.pop_back();
+
+		if(gave_up)
+		{
+			return;
+		}
+
+		{
+			TraceScope trace(tracer, TRACE_COLLAPSE, id);
+			listbox.collapse(idx, num_children);
+		}
+
+		viewport.invalidate();
+	}
+	else if(options.num_passes == 0)
+	{
+		visit_page(id, options.page_text, options.page_printout);
+	}
+
+	if(gave_up)
+	{
+		return;
+	}
+
+	mark(id, "");
+
+	recoveries = 0;
+	++nodes_visited;
+
+	if(shard != NULL)
+	{
+		shard->progress();
+	}
+	else if(tracer != NULL)
+	{
+		tracer->progress(nodes_visited + nodes_skipped, seen_items.size());
+	}
+
+	if(message_log != NULL)
+	{
+		fprintf(message_log, "%u %lu " UINT64_FMT "\n", id, viewer->get_message_count() - start_messages, row_capture_us);
+	}
+}
+
+/* Remembers an entry at the end of path for the passes. */
+void Crawler::add_entry(unsigned int id, bool group)
+{
+	entries.push_back(IndexEntry());
+
+	IndexEntry &e = entries.back();
+	e.parents = path;
+	e.id = id;
+	e.group = group;
+}
+
+/* Returns the row between begin and end with the given ID, end if there
+ * isn't one.
+*/
+static unsigned int find_row(const ListboxModel &listbox, unsigned int begin, unsigned int end, unsigned int id)
+{
+	unsigned int r = begin;
+
+	while(r < end && listbox.item(r) != id)
+	{
+		++r;
+	}
+
+	return r;
+}
+
+/* Expands each of the groups in parents, from the top of the index down,
+ * starting with everything collapsed. The rows of the groups and how many
+ * children each had are appended to rows and counts, and the rows of the
+ * last one's children are returned in begin and end. Returns false if one of
+ * them couldn't be found or expanded.
+*/
+bool Crawler::expand_to(const std::vector<unsigned int> &parents, std::vector<unsigned int> *rows,
+	std::vector<unsigned int> *counts, unsigned int *begin, unsigned int *end)
+{
+	*begin = 0;
+	*end = listbox.size();
+
+	for(size_t i = 0; i < parents.size(); ++i)
+	{
+		unsigned int idx = find_row(listbox, *begin, *end, parents[i]);
+		if(idx == *end)
+		{
+			fprintf(stderr, "Unable to find index entry %u\n", parents[i]);
+			return false;
+		}
+
+		{
+			TraceScope trace(tracer, TRACE_NAVIGATE, parents[i]);
+			listbox.move_to(idx);
+		}
+
+		unsigned int num_children;
+
+		{
+			TraceScope trace(tracer, TRACE_EXPAND, parents[i]);
+			num_children = listbox.expand();
+		}
+
+		if(num_children == 0)
+		{
+			fprintf(stderr, "Index entry %u has no children any more\n", parents[i]);
+			return false;
+		}
+
+		rows->push_back(idx);
+		counts->push_back(num_children);
+
+		viewport.invalidate();
+
+		*begin = idx + 1;
+		*end = idx + 1 + num_children;
+	}
+
+	return true;
+}
+
+/* Visits an entry taken from another crawler, expanding the groups above it
+ * (parents, from the top of the index down) to get to it and collapsing them
+ * again afterwards.
+*/
+void Crawler::visit_stolen(const std::vector<unsigned int> &parents, unsigned int id)
+{
+	std::vector<unsigned int> rows;
+	std::vector<unsigned int> counts;
+	unsigned int begin, end;
+
+	if(expand_to(parents, &rows, &counts, &begin, &end))
+	{
+		unsigned int idx = find_row(listbox, begin, end, id);
+
+		if(idx < end)
+		{
+			path = parents;
+			visit(idx, id, parents.size(), (parents.empty() ? 0 : parents.back()));
+			path.clear();
+		}
+		else{
+			fprintf(stderr, "Unable to find index entry %u, skipping it\n", id);
+		}
+	}
+
+	while(!rows.empty() && !gave_up)
+	{
+		/* Whatever we finished on is one of its children. */
+
+		TraceScope trace(tracer, TRACE_COLLAPSE, id);
+		listbox.collapse(rows.back(), counts.back());
+
+		viewport.invalidate();
+
+		rows.pop_back();
+		counts.pop_back();
+	}
+}
+
+/* Called when the viewer has died. Adds culprit (if it isn't zero) to the
+ * quarantine, starts a new viewer and expands the groups we were in the
+ * middle of again, so the crawl can carry on as if nothing happened. Returns
+ * false (and gives up on the crawl) if that isn't possible.
+*/
+bool Crawler::recover(unsigned int culprit)
+{
+	if(culprit != 0)
+	{
+		fprintf(stderr, "The viewer died showing page %u\n", culprit);
+
+		if(quarantine != NULL)
+		{
+			quarantine->add(culprit, "Killed the viewer");
+		}
+	}
+	else{
+		fprintf(stderr, "The viewer died\n");
+	}
+
+	if(supervisor == NULL || ++recoveries > MAX_RECOVERIES)
+	{
+		gave_up = true;
+		return false;
+	}
+
+	ViewerDriver *new_viewer = supervisor->restart();
+	if(new_viewer == NULL)
+	{
+		gave_up = true;
+		return false;
+	}
+
+	fprintf(stderr, "Restarted the viewer, carrying on from where we were\n");
+
+	viewer = new_viewer;
+	listbox.set_viewer(viewer);
+	viewport.set_viewer(viewer);
+
+	reset_listbox_state();
+
+	open_path.clear();
+	open_rows.clear();
+	open_counts.clear();
+
+	std::vector<unsigned int> rows;
+	std::vector<unsigned int> counts;
+	unsigned int begin, end;
+
+	if(!expand_to(path, &rows, &counts, &begin, &end))
+	{
+		gave_up = true;
+		return false;
+	}
+
+	return true;
+}
+
+/* Collects the content in passes over the entries the walk found. */
+void Crawler::run_passes()
+{
+	/* The tree is all there now, so whatever reads it can get going. */
+	fflush(stdout);
+	fprintf(stderr, "Walked the index, found %u entries\n", (unsigned)(entries.size()));
+
+	for(unsigned int p = 0; p < options.num_passes && !gave_up; ++p)
+	{
+		ContentPass pass = options.passes[p];
+		uint64 start = clock_us();
+
+		std::vector<IndexEntry> needed;
+		select_needed(pass, entries, &needed);
+
+		if(tracer != NULL)
+		{
+			tracer->set_stage(content_pass_name(pass));
+		}
+
+		collect(pass, needed);
+
+		fprintf(stderr, "Finished the %s pass over %u entries in %.1f s\n",
+			content_pass_name(pass), (unsigned)(needed.size()), (double)(clock_us() - start) / 1000000.0);
+	}
+
+	while(!open_path.empty() && !gave_up)
+	{
+		close_group();
+	}
+}
+
+void Crawler::select_needed(ContentPass pass, const std::vector<IndexEntry> &entries, std::vector<IndexEntry> *needed)
+{
+	for(size_t i = 0; i < entries.size(); ++i)
+	{
+		if(needs(pass, entries[i]))
+		{
+			needed->push_back(entries[i]);
+		}
+	}
+}
+
+bool Crawler::needs(ContentPass pass, const IndexEntry &entry)
+{
+	if(pass == PASS_SCREENSHOTS)
+	{
+		return !store->exists(entry.id, (options.capture_format == CAPTURE_PBM ? "pbm" : "pgm"));
+	}
+
+	/* Only pages have text or printouts. */
+	if(entry.group || (quarantine != NULL && quarantine->contains(entry.id)))
+	{
+		return false;
+	}
+
+	return !store->exists(entry.id, (pass == PASS_TEXT ? "txt" : "ps"));
+}
+
+/* Collects whatever pass is for from each of entries, which are in the order
+ * the tree was printed in, only expanding and collapsing the groups between
+ * one and the next.
+*/
+void Crawler::collect(ContentPass pass, const std::vector<IndexEntry> &entries)
+{
+	for(size_t i = 0; i < entries.size() && !gave_up; ++i)
+	{
+		const IndexEntry &e = entries[i];
+
+		unsigned int idx;
+		bool found;
+
+		while(true)
+		{
+			found = open_to(e.parents, e.id, &idx);
+
+			if(viewer->is_alive())
+			{
+				break;
+			}
+
+			if(!recover(0))
+			{
+				return;
+			}
+		}
+
+		if(!found)
+		{
+			/* open_to() has said why, carry on with the next one. */
+		}
+		else if(pass == PASS_SCREENSHOTS)
+		{
+			{
+				TraceScope trace(tracer, TRACE_CAPTURE, e.id);
+				capture(idx, e.id);
+			}
+
+			if(!viewer->is_alive())
+			{
+				recover(0);
+			}
+		}
+		else{
+			visit_page(e.id, (pass == PASS_TEXT), (pass == PASS_PRINTOUTS));
+		}
+
+		if(gave_up)
+		{
+			return;
+		}
+
+		recoveries = 0;
+		update_journal();
+
+		if(shard != NULL)
+		{
+			shard->pass_progress();
+		}
+		else if(tracer != NULL)
+		{
+			tracer->progress(i + 1, entries.size());
+		}
+	}
+}
+
+/* Gets the listbox to show the groups in parents (from the top of the index
+ * down) expanded, collapsing any others left open since last time, and
+ * selects id under them. Returns false if it can't be found.
+*/
+bool Crawler::open_to(const std::vector<unsigned int> &parents, unsigned int id, unsigned int *idx)
+{
+	size_t keep = 0;
+
+	while(keep < open_path.size() && keep < parents.size() && open_path[keep] == parents[keep])
+	{
+		++keep;
+	}
+
+	while(open_path.size() > keep)
+	{
+		close_group();
+	}
+
+	unsigned int begin = 0;
+	unsigned int end = listbox.size();
+
+	if(!open_rows.empty())
+	{
+		begin = open_rows.back() + 1;
+		end = begin + open_counts.back();
+	}
+
+	for(size_t i = keep; i < parents.size(); ++i)
+	{
+		unsigned int row = find_row(listbox, begin, end, parents[i]);
+		if(row == end)
+		{
+			fprintf(stderr, "Unable to find index entry %u\n", parents[i]);
+			return false;
+		}
+
+		{
+			TraceScope trace(tracer, TRACE_NAVIGATE, parents[i]);
+			listbox.move_to(row);
+		}
+
+		unsigned int num_children;
+
+		{
+			TraceScope trace(tracer, TRACE_EXPAND, parents[i]);
+			num_children = listbox.expand();
+		}
+
+		if(num_children == 0)
+		{
+			fprintf(stderr, "Index entry %u has no children any more\n", parents[i]);
+			return false;
+		}
+
+		viewport.invalidate();
+
+		open_path.push_back(parents[i]);
+		open_rows.push_back(row);
+		open_counts.push_back(num_children);
+
+		begin = row + 1;
+		end = begin + num_children;
+	}
+
+	*idx = find_row(listbox, begin, end, id);
+	if(*idx == end)
+	{
+		fprintf(stderr, "Unable to find index entry %u\n", id);
+		return false;
+	}
+
+	TraceScope trace(tracer, TRACE_NAVIGATE, id);
+	listbox.move_to(*idx);
+
+	return true;
+}
+
+/* Collapses the last group open_to() expanded. The cursor is always on one of
+ * its children.
+*/
+void Crawler::close_group()
+{
+	TraceScope trace(tracer, TRACE_COLLAPSE, open_path.back());
+	listbox.collapse(open_rows.back(), open_counts.back());
+
+	viewport.invalidate();
+
+	open_path.pop_back();
+	open_rows.pop_back();
+	open_counts.pop_back();
+}
+
+/* Saves a screenshot of a listbox row, returns how long it took. */
+uint64 Crawler::capture(unsigned int idx, unsigned int id)
+{
+	uint64 start = clock_us();
+
+	GrayImage image;
+
+	if(!options.capture_viewport || !viewport.capture_row(idx, id, &image))
+	{
+		ViewerDriver::Rect r = viewer->get_item_rect(idx);
+
+		if(!viewer->capture(r, &image))
+		{
+			return 0;
+		}
+	}
+
+	const char *kind;
+	std::string encoded;
+
+	if(options.capture_format == CAPTURE_PBM)
+	{
+		image.to_pbm(PBM_THRESHOLD, &encoded);
+		kind = "pbm";
+	}
+	else{
+		image.to_pgm(&encoded);
+		kind = "pgm";
+	}
+
+	save(id, kind, encoded);
+
+	uint64 elapsed = clock_us() - start;
+
+	++captures;
+	capture_us += elapsed;
+
+	if(elapsed > capture_us_max)
+	{
+		capture_us_max = elapsed;
+	}
+
+	return elapsed;
+}
+
+/* Hands an artifact to the store. The string or job is cleared. */
+void Crawler::save(unsigned int id, const char *kind, std::string &data)
+{
+	uint64 start = clock_us();
+	bool ok = store->write(id, kind, data);
+
+	saved(id, kind, ok, start);
+}
+
+void Crawler::save(unsigned int id, const char *kind, PrintJob &job)
+{
+	uint64 start = clock_us();
+	bool ok = store->write(id, kind, job);
+
+	saved(id, kind, ok, start);
+}
+
+void Crawler::saved(unsigned int id, const char *kind, bool ok, uint64 start)
+{
+	uint64 end = clock_us();
+	uint64 elapsed = end - start;
+
+	if(tracer != NULL)
+	{
+		tracer->record(TRACE_SAVE, id, start, end);
+	}
+
+	++store_writes;
+	store_us += elapsed;
+
+	if(elapsed > store_us_max)
+	{
+		store_us_max = elapsed;
+	}
+
+	if(ok)
+	{
+		mark(id, kind);
+	}
+	else{
+		fprintf(stderr, "Unable to save %u.%s\n", id, kind);
+		failed.insert(id);
+	}
+}
+
+/* Queues a journal record to be written once the store has finished every
+ * write made so far. An empty kind means the entry is done.
+*/
+void Crawler::mark(unsigned int id, const char *kind)
+{
+	if(options.journal != NULL)
+	{
+		JournalMarker m;
+		m.seq = store->submitted();
+		m.id = id;
+		m.kind = kind;
+
+		markers.push_back(m);
+	}
+
+	update_journal();
+}
+
+/* Writes out the journal records the store has caught up with, and reports
+ * any writes which failed since last time.
+*/
+void Crawler::update_journal()
+{
+	/* Read before the errors so any error for a write up to here has been
+	 * queued by the time we look.
+	*/
+	uint64 completed = store->completed();
+
+	unsigned int id;
+	std::string kind;
+
+	while(store->get_error(&id, &kind))
+	{
+		fprintf(stderr, "Unable to save %u.%s\n", id, kind.c_str());
+		failed.insert(id);
+	}
+
+	while(!markers.empty() && markers.front().seq <= completed)
+	{
+		const JournalMarker &m = markers.front();
+
+		if(failed.find(m.id) != failed.end())
+		{
+			/* Leave it to be done again next time, along with everything
+			 * above it.
+			*/
+			const Journal::Node *jn = journal->find(m.id);
+
+			if(m.kind.empty() && jn != NULL && jn->parent != 0)
+			{
+				failed.insert(jn->parent);
+			}
+		}
+		else if(m.kind.empty())
+		{
+			journal->done(m.id);
+		}
+		else{
+			journal->artifact(m.id, m.kind.c_str());
+		}
+
+		markers.pop_front();
+	}
+}
+
+void Crawler::replay(unsigned int id, int depth)
+{
+	const Journal::Node *jn = journal->find(id);
+
+	if(shard == NULL)
+	{
+		char indent[128];
+		indent_string(indent, depth);
+
+		printf("%s%u\n", indent, id);
+
+		if(options.num_passes > 0)
+		{
+			add_entry(id, !jn->children.empty());
+		}
+	}
+
+	path.push_back(id);
+
+	if(shard != NULL)
+	{
+		shard->record_replayed(path, jn->children);
+	}
+
+	++nodes_skipped;
+
+	for(size_t i = 0; i < jn->children.size(); ++i)
+	{
+		if(seen_items.find(jn->children[i]) == seen_items.end())
+		{
+			seen_items.insert(jn->children[i]);
+			replay(jn->children[i], depth + 1);
+		}
+		else if(shard != NULL)
+		{
+			/* ShardCoordinator decides what was seen. */
+			replay(jn->children[i], depth + 1);
+		}
+	}
+
+	path.pop_back();
+}
+
+void Crawler::print_stats()
+{
+	ListboxModel::Stats ls = listbox.get_stats();
+
+	fprintf(stderr, "Listbox: %lu expand tests (%.2f messages each), %lu collapses (%.2f), %lu moves (%.2f), %lu confirms, %lu reloads\n",
+		ls.expand_tests, (ls.expand_tests > 0 ? (double)(ls.expand_messages) / ls.expand_tests : 0.0),
+		ls.collapses, (ls.collapses > 0 ? (double)(ls.collapse_messages) / ls.collapses : 0.0),
+		ls.moves, (ls.moves > 0 ? (double)(ls.move_messages) / ls.moves : 0.0),
+		ls.confirms, ls.resyncs);
+
+	if(captures > 0)
+	{
+		fprintf(stderr, "Captured %lu index entries, " UINT64_FMT " us each on average, " UINT64_FMT " us at most\n",
+			captures, capture_us / captures, capture_us_max);
+	}
+
+	if(store_writes > 0)
+	{
+		fprintf(stderr, "Artifact store: %lu writes, " UINT64_FMT " us waiting for them in total, " UINT64_FMT " us at most, "
+			UINT64_FMT " us waiting for the rest at the end\n",
+			store_writes, store_us, store_us_max, store_flush_us);
+	}
+
+	if(options.capture_viewport)
+	{
+		ViewportCapture::Stats vs = viewport.get_stats();
+
+		fprintf(stderr, "Viewport: %lu frames, %lu rows cut from them, %lu mismatches\n",
+			vs.frames, vs.crops, vs.mismatches);
+	}
+
+	latency.print_stats(stderr);
+
+	if(options.verify_listbox)
+	{
+		fprintf(stderr, "Listbox verification: %lu snapshots (%.2f messages each), %lu mismatches\n",
+			ls.snapshots, (ls.snapshots > 0 ? (double)(ls.snapshot_messages) / ls.snapshots : 0.0),
+			ls.mismatches);
+	}
+}
+
+/* Opens the selected page to save its text and/or a printout, if they aren't
+ * saved already.
+*/
+void Crawler::visit_page(unsigned int id, bool text, bool printout)
+{
+	bool do_txt = text && !store->exists(id, "txt");
+	bool do_ps = printout && !store->exists(id, "ps");
+
+	if(quarantine != NULL && quarantine->contains(id))
+	{
+		do_txt = false;
+		do_ps = false;
+	}
+
+	if(!do_txt && !do_ps)
+	{
+		return;
+	}
+
+	{
+		TraceScope trace(tracer, TRACE_OPEN, id);
+		viewer->open_selected();
+	}
+
+	if(do_txt && viewer->is_alive())
+	{
+		std::string text;
+
+		if(viewer->copy_text(&text))
+		{
+			if(options.text_codepage != 0)
+			{
+				std::string utf8;
+
+				OemTranscoder transcoder(options.text_codepage);
+				transcoder.convert(text.data(), text.length(), &utf8);
+				transcoder.finish(&utf8);
+
+				text.swap(utf8);
+			}
+
+			save(id, "txt", text);
+		}
+		else if(viewer->is_alive())
+		{
+			fprintf(stderr, "Unable to copy the text of page %u\n", id);
+			failed.insert(id);
+		}
+	}
+
+	if(do_ps && viewer->is_alive())
+	{
+		PrintJob print_data;
+		if(viewer->print(&print_data))
+		{
+			save(id, "ps", print_data);
+
+			/* The viewer can break if it is asked to do anything else
+			 * before it has caught up with printing having finished.
+			*/
+			wait_until_idle("print");
+
+			if(shard != NULL)
+			{
+				shard->record_printed(id);
+			}
+			else{
+				printf("Printed page %u\n", id);
+			}
+		}
+		else if(viewer->is_alive())
+		{
+			fprintf(stderr, "Unable to print page %u\n", id);
+			failed.insert(id);
+
+			wait_until_idle("print");
+		}
+	}
+
+	if(!viewer->is_alive())
+	{
+		/* Something about this page killed it (or hung it, and the
+		 * supervisor killed it).
+		*/
+		recover(id);
+	}
+}
+
+/* Waits for the viewer to say it has settled down after an operation (and
+ * keep saying so for SETTLE_FLOOR_US), for as long as the latency model thinks
+ * it could reasonably take.
+*/
+void Crawler::wait_until_idle(const char *op)
+{
+	uint64 start = clock_us();
+	uint64 limit = latency.limit_us(op);
+
+	/* When it last went idle, if it still is. */
+	uint64 idle_since = 0;
+	bool idle = false;
+
+	TraceScope trace(tracer, TRACE_SETTLE);
+
+	while(true)
+	{
+		uint64 now = clock_us();
+
+		if(viewer->is_idle())
+		{
+			if(!idle)
+			{
+				idle = true;
+				idle_since = now;
+			}
+
+			if(now - idle_since >= SETTLE_FLOOR_US)
+			{
+				break;
+			}
+		}
+		else{
+			idle = false;
+
+			uint64 elapsed = now - start;
+
+			if(elapsed >= limit)
+			{
+				fprintf(stderr, "Viewer still busy " UINT64_FMT " ms after %s, carrying on\n", elapsed / 1000, op);
+
+				latency.timed_out(op, elapsed);
+				return;
+			}
+		}
+
+		sleep_ms(SETTLE_POLL_MS);
+	}
+
+	latency.settled(op, idle_since - start);
+}
@@ -0,0 +1,277 @@
+#ifndef MMVRIPPER_CRAWLER_HPP
+#define MMVRIPPER_CRAWLER_HPP
+
+#include <deque>
+#include <set>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "ArtifactStore.hpp"
+#include "IntTypes.hpp"
+#include "Journal.hpp"
+#include "LatencyModel.hpp"
+#include "ListboxModel.hpp"
+#include "Quarantine.hpp"
+#include "Supervisor.hpp"
+#include "Tracer.hpp"
+#include "ViewerDriver.hpp"
+#include "ViewportCapture.hpp"
+
+enum CaptureFormat
+{
+	CAPTURE_PGM,  /* 8-bit grayscale */
+	CAPTURE_PBM   /* 1-bit black and white */
+};
+
+/* What is collected in each pass over the index after it has been walked. */
+enum ContentPass
+{
+	PASS_TEXT,         /* The "txt" of each page. */
+	PASS_SCREENSHOTS,  /* A screenshot of each index entry. */
+	PASS_PRINTOUTS,    /* A "ps" printout of each page. */
+
+	PASS_COUNT
+};
+
+/* Returns "text", "shots" or "prints". */
+const char *content_pass_name(ContentPass pass);
+
+struct CrawlOptions
+{
+	bool index_screenshots;  /* Save a "pgm" or "pbm" of each index entry. */
+	CaptureFormat capture_format;
+
+	/* Cut index screenshots out of a capture of the whole listbox rather
+	 * than capturing each row (see ViewportCapture).
+	*/
+	bool capture_viewport;
+
+	bool page_text;          /* Save the "txt" of each page. */
+	bool page_printout;      /* Save a "ps" printout of each page. */
+
+	/* If not zero, page text is converted from this OEM codepage to UTF-8
+	 * with LF line endings before it is saved (see OemTranscoder).
+	*/
+	unsigned int text_codepage;
+
+	/* If num_passes isn't zero, walking the index only finds the entries
+	 * and prints the tree. The content turned on above is then collected
+	 * afterwards, one pass for each of passes in order, each going over
+	 * just the entries which still need it.
+	*/
+	ContentPass passes[PASS_COUNT];
+	unsigned int num_passes;
+
+	/* Jump straight to listbox items using ViewerDriver::set_cursor() rather
+	 * than pressing arrow keys where it is cheaper.
+	*/
+	bool absolute_cursor;
+
+	/* Check the crawler's copy of the listbox against the real thing after
+	 * every key press. Very slow, for debugging and comparing costs only.
+	*/
+	bool verify_listbox;
+
+	/* If non-NULL, "<id> <messages> <capture time in us>" is appended to
+	 * this file for each index entry visited.
+	*/
+	const char *message_log;
+
+	/* If non-NULL, progress is recorded in this file and index entries which
+	 * it says were finished are skipped (along with everything under them).
+	*/
+	const char *journal;
+
+	/* If non-NULL, how long the viewer takes to settle after printing is
+	 * remembered in this file between runs (see LatencyModel).
+	*/
+	const char *latency_file;
+};
+
+/* An entry found by walking the index. */
+struct IndexEntry
+{
+	std::vector<unsigned int> parents;  /* From the top of the index down. */
+	unsigned int id;
+	bool group;
+};
+
+class ShardCoordinator;
+
+/* Walks the whole index tree of a viewer, printing the tree of page IDs to
+ * standard output and saving whatever CrawlOptions asks for to an
+ * ArtifactStore.
+ *
+ * The crawler keeps its own copy of the listbox (ListboxModel), so it can work
+ * out where everything is without scanning the listbox with the arrow keys.
+*/
+class Crawler
+{
+private:
+	ViewerDriver *viewer;
+	ArtifactStore *store;
+	CrawlOptions options;
+
+	std::set<unsigned int> seen_items;
+
+	ListboxModel listbox;
+	ViewportCapture viewport;
+	LatencyModel latency;
+
+	/* Our own journal, or the one shared with the other crawlers when
+	 * working for a ShardCoordinator.
+	*/
+	Journal own_journal;
+	Journal *journal;
+
+	/* NULL unless working for a ShardCoordinator. path is the IDs from the
+	 * top of the index down to the entry whose children are being walked.
+	*/
+	ShardCoordinator *shard;
+	std::vector<unsigned int> path;
+
+	/* Everything the walk printed, in order, when the content is being
+	 * collected in passes afterwards.
+	*/
+	std::vector<IndexEntry> entries;
+
+	/* The groups expanded to get to where the passes are, from the top of
+	 * the index down, with their rows and how many children they have.
+	*/
+	std::vector<unsigned int> open_path;
+	std::vector<unsigned int> open_rows;
+	std::vector<unsigned int> open_counts;
+
+	/* Journal records waiting for the store to finish the writes before
+	 * them (see ArtifactStore::completed()). A record with no kind is a "D".
+	*/
+	struct JournalMarker
+	{
+		uint64 seq;
+		unsigned int id;
+		std::string kind;
+	};
+
+	std::deque<JournalMarker> markers;
+
+	/* Entries with an artifact which couldn't be saved, or a child which
+	 * wasn't finished because of one (or was stolen by another crawler).
+	 * These never get marked as done.
+	*/
+	std::set<unsigned int> failed;
+
+	Tracer *tracer;
+
+	/* Either may be NULL. Without a supervisor, the crawler gives up when
+	 * the viewer dies.
+	*/
+	Supervisor *supervisor;
+	Quarantine *quarantine;
+
+	/* Times the viewer has been restarted since an entry was last finished,
+	 * and whether we have stopped trying.
+	*/
+	unsigned int recoveries;
+	bool gave_up;
+
+	FILE *message_log;
+	unsigned long nodes_visited;
+	unsigned long nodes_skipped;
+
+	unsigned long captures;
+	uint64 capture_us, capture_us_max;
+
+	unsigned long store_writes;
+	uint64 store_us, store_us_max;
+	uint64 store_flush_us;
+
+	unsigned long start_messages;
+	unsigned long start_navigations;
+
+	void start_run();
+	void finish_run();
+	void print_stats();
+	void walk(unsigned int begin, unsigned int end, int depth, unsigned int parent);
+	void add_entry(unsigned int id, bool group);
+	void visit(unsigned int idx, unsigned int id, int depth, unsigned int parent);
+	void visit_stolen(const std::vector<unsigned int> &parents, unsigned int id);
+	bool expand_to(const std::vector<unsigned int> &parents, std::vector<unsigned int> *rows,
+		std::vector<unsigned int> *counts, unsigned int *begin, unsigned int *end);
+	bool recover(unsigned int culprit);
+
+	void run_passes();
+	bool needs(ContentPass pass, const IndexEntry &entry);
+	void collect(ContentPass pass, const std::vector<IndexEntry> &entries);
+	bool open_to(const std::vector<unsigned int> &parents, unsigned int id, unsigned int *idx);
+	void close_group();
+
+	void replay(unsigned int id, int depth);
+	uint64 capture(unsigned int idx, unsigned int id);
+
+	void save(unsigned int id, const char *kind, std::string &data);
+	void save(unsigned int id, const char *kind, PrintJob &job);
+	void saved(unsigned int id, const char *kind, bool ok, uint64 start);
+
+	void mark(unsigned int id, const char *kind);
+	void update_journal();
+	void visit_page(unsigned int id, bool text, bool printout);
+	void wait_until_idle(const char *op);
+
+public:
+	Crawler(ViewerDriver *viewer, ArtifactStore *store, const CrawlOptions &options);
+
+	/* Records each phase of the crawl to tracer, and has it print progress
+	 * summaries.
+	*/
+	void set_tracer(Tracer *tracer)
+	{
+		this->tracer = tracer;
+	}
+
+	/* Restarts the viewer through supervisor when it dies, and carries on
+	 * from where it was.
+	*/
+	void set_supervisor(Supervisor *supervisor)
+	{
+		this->supervisor = supervisor;
+	}
+
+	/* Skips opening pages in quarantine, and adds any which kill the viewer
+	 * to it.
+	*/
+	void set_quarantine(Quarantine *quarantine)
+	{
+		this->quarantine = quarantine;
+	}
+
+	/* Whether the crawl was abandoned because the viewer died and couldn't
+	 * be restarted.
+	*/
+	bool abandoned() const
+	{
+		return gave_up;
+	}
+
+	/* Collapses every group in the index and selects the first item. */
+	void reset_listbox_state();
+
+	/* Walks the index from the first item, then makes any passes CrawlOptions
+	 * asks for.
+	*/
+	void run();
+
+	/* Picks out the entries which still need what pass collects. */
+	void select_needed(ContentPass pass, const std::vector<IndexEntry> &entries, std::vector<IndexEntry> *needed);
+
+	/* Walks part of the index alongside other crawlers, telling shard what
+	 * it finds rather than printing it. The first crawler starts at the top
+	 * of the index, then everyone takes whatever is left from the others
+	 * until there is nothing left. Any passes are shared out between them the
+	 * same way. The journal (already opened if CrawlOptions asks for one) is
+	 * shared with the other crawlers.
+	*/
+	void run_shard(ShardCoordinator *shard, Journal *shared_journal, bool first);
+};
+
+#endif /* !MMVRIPPER_CRAWLER_HPP */
@@ -0,0 +1,42 @@
+#include <stddef.h>
+
+#include "Crc32.hpp"
+
+static unsigned int crc_table[256];
+static bool crc_table_ready = false;
+
+static void make_crc_table()
+{
+	for(unsigned int n = 0; n < 256; ++n)
+	{
+		unsigned int c = n;
+
+		for(int k = 0; k < 8; ++k)
+		{
+			c = (c & 1) ? (0xEDB88320U ^ (c >> 1)) : (c >> 1);
+		}
+
+		crc_table[n] = c;
+	}
+
+	crc_table_ready = true;
+}
+
+unsigned int crc32(unsigned int crc, const void *data, size_t len)
+{
+	if(!crc_table_ready)
+	{
+		make_crc_table();
+	}
+
+	const unsigned char *p = (const unsigned char*)(data);
+
+	crc = ~crc;
+
+	for(size_t i = 0; i < len; ++i)
+	{
+		crc = crc_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+	}
+
+	return ~crc;
+}
@@ -0,0 +1,11 @@
+#ifndef MMVRIPPER_CRC32_HPP
+#define MMVRIPPER_CRC32_HPP
+
+#include <stddef.h>
+
+/* Standard (zlib/PNG) CRC-32. Pass the result of the previous call as crc to
+ * checksum data in pieces, or 0 to start.
+*/
+unsigned int crc32(unsigned int crc, const void *data, size_t len);
+
+#endif /* !MMVRIPPER_CRC32_HPP */
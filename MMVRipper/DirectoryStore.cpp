@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <string>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "DirectoryStore.hpp"
+
+DirectoryStore::DirectoryStore(const char *dir):
+	dir(dir) {}
+
+std::string DirectoryStore::path(unsigned int id, const char *kind) const
+{
+	char name[32];
+	sprintf(name, "%u.%s", id, kind);
+
+	return dir + "/" + name;
+}
+
+bool DirectoryStore::exists(unsigned int id, const char *kind)
+{
+	struct stat st;
+	return stat(path(id, kind).c_str(), &st) == 0;
+}
+
+bool DirectoryStore::write(unsigned int id, const char *kind, const void *data, size_t len)
+{
+	std::string final_name = path(id, kind);
+	std::string tmp_name = final_name + ".tmp";
+
+	FILE *f = fopen(tmp_name.c_str(), "wb");
+	if(f == NULL)
+	{
+		return false;
+	}
+
+	bool ok = (len == 0 || fwrite(data, len, 1, f) == 1);
+	ok = (fclose(f) == 0) && ok;
+
+	if(!ok)
+	{
+		remove(tmp_name.c_str());
+		return false;
+	}
+
+	remove(final_name.c_str());
+	return rename(tmp_name.c_str(), final_name.c_str()) == 0;
+}
+
+bool DirectoryStore::write(unsigned int id, const char *kind, PrintJob &job)
+{
+	std::string final_name = path(id, kind);
+	std::string tmp_name = final_name + ".tmp";
+
+	bool ok = job.save(tmp_name.c_str());
+	job.clear();
+
+	if(!ok)
+	{
+		remove(tmp_name.c_str());
+		return false;
+	}
+
+	remove(final_name.c_str());
+	return rename(tmp_name.c_str(), final_name.c_str()) == 0;
+}
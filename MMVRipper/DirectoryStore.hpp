@@ -0,0 +1,34 @@
+#ifndef MMVRIPPER_DIRECTORYSTORE_HPP
+#define MMVRIPPER_DIRECTORYSTORE_HPP
+
+#include <string>
+
+#include "ArtifactStore.hpp"
+
+/* Stores each artifact in its own <id>.<kind> file in a directory.
+ *
+ * Files are written under a temporary name and renamed once they are
+ * complete, so one that exists is never a leftover from a crash.
+*/
+class DirectoryStore: public ArtifactStore
+{
+private:
+	std::string dir;
+
+	std::string path(unsigned int id, const char *kind) const;
+
+public:
+	DirectoryStore(const char *dir);
+
+	virtual bool exists(unsigned int id, const char *kind);
+
+	virtual bool write(unsigned int id, const char *kind, const void *data, size_t len);
+	virtual bool write(unsigned int id, const char *kind, PrintJob &job);
+
+	virtual bool thread_safe() const
+	{
+		return true;
+	}
+};
+
+#endif /* !MMVRIPPER_DIRECTORYSTORE_HPP */
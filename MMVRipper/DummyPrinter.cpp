@@ -1,38 +1,22 @@
+#ifdef _WIN32
+
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <winsock2.h>
 #include <windows.h>
 
 #include "DummyPrinter.hpp"
 
-DummyPrinter::DummyPrinter(unsigned short port):
-	running(true)
-{
-	WSADATA wsdata;
-	int status = WSAStartup(MAKEWORD(2, 0), &wsdata);
-	if(status != 0)
-	{
-		abort();
-	}
-
-	server_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-	if(server_socket == SOCKET_ERROR)
-	{
-		abort();
-	}
+/* Maximum amount of each spooled job held in memory before being written. */
+static const size_t SPOOL_MAX_BUFFERED = 256 * 1024;
 
-	struct sockaddr_in bind_addr;
-	bind_addr.sin_family = AF_INET;
-	bind_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
-	bind_addr.sin_port = htons(port);
-
-	if(bind(server_socket, (struct sockaddr*)(&bind_addr), sizeof(bind_addr)) != 0)
-	{
-		abort();
-	}
-
-	if(listen(server_socket, 10) != 0)
+DummyPrinter::DummyPrinter(unsigned short port, const char *spool_dir):
+	server(port, this, &pool)
+{
+	if(spool_dir != NULL)
 	{
-		abort();
+		server.spool_to_disk(spool_dir, SPOOL_MAX_BUFFERED);
 	}
 
 	InitializeCriticalSection(&lock);
@@ -40,6 +24,9 @@ DummyPrinter::DummyPrinter(unsigned short port):
 	print_job_completed_event = CreateEvent(NULL, TRUE, FALSE, NULL);
 	assert(print_job_completed_event != NULL);
 
+	connection_closed_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+	assert(connection_closed_event != NULL);
+
 	DWORD thread_id;
 	print_server_thread = CreateThread(NULL, 0, &print_server_main, this, 0, &thread_id);
 	if(print_server_thread == NULL)
@@ -51,98 +38,51 @@ DummyPrinter::DummyPrinter(unsigned short port):
 
 DummyPrinter::~DummyPrinter()
 {
-	running = false;
+	server.stop();
 
 	WaitForSingleObject(print_server_thread, INFINITE);
 	CloseHandle(print_server_thread);
 
+	discard_prints();
+
+	CloseHandle(connection_closed_event);
 	CloseHandle(print_job_completed_event);
 
-	closesocket(server_socket);
+	DeleteCriticalSection(&lock);
 }
 
 DWORD WINAPI DummyPrinter::print_server_main(LPVOID context)
 {
 	DummyPrinter *self = (DummyPrinter*)(context);
+	self->server.run();
 
-	std::vector<unsigned char> recv_buf(1024);
+	return 0;
+}
 
-	while(self->running)
-	{
-		fd_set read_fds;
-		FD_ZERO(&read_fds);
-
-		FD_SET(self->server_socket, &read_fds);
-		int maxfd = self->server_socket;
-
-		pj_iterator pj;
-		for(pj = self->pending_jobs.begin(); pj != self->pending_jobs.end(); ++pj)
-		{
-			FD_SET(pj->first, &read_fds);
-			
-			if(pj->first > maxfd)
-			{
-				maxfd = pj->first;
-			}
-		}
-
-		struct timeval timeout = { 1, 0 };
-		int s = select((maxfd + 1), &read_fds, NULL, NULL, &timeout);
-
-		if(s > 0)
-		{
-			if(FD_ISSET(self->server_socket, &read_fds))
-			{
-				int client_sock = accept(self->server_socket, NULL, NULL);
-				if(client_sock != SOCKET_ERROR)
-				{
-					self->pending_jobs.insert(std::make_pair(client_sock, std::vector<unsigned char>()));
-				}
-			}
-
-			for(pj = self->pending_jobs.begin(); pj != self->pending_jobs.end();)
-			{
-				if(FD_ISSET(pj->first, &read_fds))
-				{
-					int r = recv(pj->first, (char*)(&(recv_buf[0])), recv_buf.size(), 0);
-					if(r < 0)
-					{
-						/* Read error. Abort the connection. */
-						closesocket(pj->first);
-						pj = self->pending_jobs.erase(pj);
-					}
-					else if(r == 0)
-					{
-						/* Remote end closed down the connection. */
-
-						EnterCriticalSection(&(self->lock));
-						self->completed_jobs.push(pj->second);
-						SetEvent(self->print_job_completed_event);
-						LeaveCriticalSection(&(self->lock));
-
-						closesocket(pj->first);
-						pj = self->pending_jobs.erase(pj);
-					}
-					else{
-						/* Got some data. */
-
-						pj->second.insert(pj->second.end(), &(recv_buf[0]), &(recv_buf[0]) + r);
-						++pj;
-					}
-				}
-				else{
-					++pj;
-				}
-			}
-		}
-	}
+void DummyPrinter::print_job_completed(PrintJob &job, unsigned int connection)
+{
+	CompletedJob completed_job;
+	completed_job.job = new PrintJob();
+	completed_job.job->swap(job);
+	completed_job.connection = connection;
 
-	return 0;
+	EnterCriticalSection(&lock);
+	completed_jobs.push(completed_job);
+	SetEvent(print_job_completed_event);
+	LeaveCriticalSection(&lock);
 }
 
-bool DummyPrinter::wait_for_print(unsigned int seconds)
+void DummyPrinter::connection_closed(unsigned int connection, unsigned int jobs)
 {
-	WaitForSingleObject(print_job_completed_event, seconds * 1000);
+	EnterCriticalSection(&lock);
+	closed_connections[connection] = jobs;
+	SetEvent(connection_closed_event);
+	LeaveCriticalSection(&lock);
+}
+
+bool DummyPrinter::wait_for_print(unsigned int timeout_ms)
+{
+	WaitForSingleObject(print_job_completed_event, timeout_ms);
 
 	EnterCriticalSection(&lock);
 	bool ready = !completed_jobs.empty();
@@ -151,15 +91,13 @@ bool DummyPrinter::wait_for_print(unsigned int seconds)
 	return ready;
 }
 
-std::vector<unsigned char> DummyPrinter::get_next_print()
+unsigned int DummyPrinter::get_next_print(PrintJob *job)
 {
-	std::vector<unsigned char> data;
-
 	EnterCriticalSection(&lock);
 
 	assert(!completed_jobs.empty());
 
-	data = completed_jobs.front();
+	CompletedJob completed_job = completed_jobs.front();
 	completed_jobs.pop();
 
 	if(completed_jobs.empty())
@@ -169,5 +107,67 @@ std::vector<unsigned char> DummyPrinter::get_next_print()
 	
 	LeaveCriticalSection(&lock);
 
-	return data;
+	job->swap(*(completed_job.job));
+	delete completed_job.job;
+
+	return completed_job.connection;
 }
+
+/* Takes the connection out of closed_connections if it is there, along with
+ * any older ones nobody is going to ask about now.
+*/
+bool DummyPrinter::find_closed(unsigned int connection, unsigned int *jobs)
+{
+	EnterCriticalSection(&lock);
+
+	std::map<unsigned int, unsigned int>::iterator c = closed_connections.find(connection);
+	bool found = c != closed_connections.end();
+
+	if(found)
+	{
+		*jobs = c->second;
+		closed_connections.erase(closed_connections.begin(), ++c);
+	}
+
+	LeaveCriticalSection(&lock);
+
+	return found;
+}
+
+bool DummyPrinter::wait_for_close(unsigned int connection, unsigned int timeout_ms, unsigned int *jobs)
+{
+	if(find_closed(connection, jobs))
+	{
+		return true;
+	}
+
+	WaitForSingleObject(connection_closed_event, timeout_ms);
+
+	return find_closed(connection, jobs);
+}
+
+unsigned int DummyPrinter::discard_prints()
+{
+	EnterCriticalSection(&lock);
+
+	unsigned int discarded = completed_jobs.size();
+
+	while(!completed_jobs.empty())
+	{
+		delete completed_jobs.front().job;
+		completed_jobs.pop();
+	}
+
+	ResetEvent(print_job_completed_event);
+
+	LeaveCriticalSection(&lock);
+
+	return discarded;
+}
+
+ChunkPool::Stats DummyPrinter::get_stats()
+{
+	return pool.get_stats();
+}
+
+#endif /* _WIN32 */
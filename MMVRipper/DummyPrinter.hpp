@@ -1,24 +1,38 @@
 #ifndef MMVRIPPER_DUMMYPRINTER_HPP
 #define MMVRIPPER_DUMMYPRINTER_HPP
 
+#ifdef _WIN32
+
 #include <map>
 #include <queue>
-#include <vector>
 
 #include <winsock2.h>
 #include <windows.h>
 
-class DummyPrinter
+#include "ChunkPool.hpp"
+#include "PrintServer.hpp"
+
+class DummyPrinter: public PrintServer::Listener
 {
 private:
-	volatile bool running;
+	ChunkPool pool;
+	PrintServer server;
 
-	int server_socket;
+	/* Jobs are swapped into heap-allocated PrintJob objects rather than
+	 * copied, since they may be many megabytes each.
+	*/
+	struct CompletedJob
+	{
+		PrintJob *job;
+		unsigned int connection;
+	};
 
-	std::map<int, std::vector<unsigned char> > pending_jobs;
-	typedef std::map<int, std::vector<unsigned char> >::iterator pj_iterator;
+	std::queue<CompletedJob> completed_jobs;
 
-	std::queue< std::vector<unsigned char> > completed_jobs;
+	/* How many jobs each connection carried, for the connections which have
+	 * closed since wait_for_close() last looked.
+	*/
+	std::map<unsigned int, unsigned int> closed_connections;
 
 	HANDLE print_server_thread;
 	static DWORD WINAPI print_server_main(LPVOID context);
@@ -26,13 +40,41 @@ private:
 	CRITICAL_SECTION lock;
 
 	HANDLE print_job_completed_event;
+	HANDLE connection_closed_event;
+
+	bool find_closed(unsigned int connection, unsigned int *jobs);
 
 public:
-	DummyPrinter(unsigned short port);
+	/* If spool_dir is given, jobs are streamed into temporary files there as
+	 * they arrive rather than being held in memory. See PrintJob::spool_to().
+	*/
+	DummyPrinter(unsigned short port, const char *spool_dir = NULL);
 	~DummyPrinter();
 
-	bool wait_for_print(unsigned int seconds);
-	std::vector<unsigned char> get_next_print();
+	virtual void print_job_completed(PrintJob &job, unsigned int connection);
+	virtual void connection_closed(unsigned int connection, unsigned int jobs);
+
+	/* Waits up to timeout_ms for a job to finish, returns true if one has. */
+	bool wait_for_print(unsigned int timeout_ms);
+
+	/* Moves the oldest completed job into job, replacing anything that was
+	 * in it before. Returns the number of the connection it came down.
+	*/
+	unsigned int get_next_print(PrintJob *job);
+
+	/* Waits up to timeout_ms for a connection to close. Returns true and
+	 * how many jobs it carried if it has.
+	*/
+	bool wait_for_close(unsigned int connection, unsigned int timeout_ms, unsigned int *jobs);
+
+	/* Throws away any completed jobs which haven't been taken, returning
+	 * how many there were.
+	*/
+	unsigned int discard_prints();
+
+	ChunkPool::Stats get_stats();
 };
 
+#endif /* _WIN32 */
+
 #endif /* !MMVRIPPER_DUMMYPRINTER_HPP */
@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "DumpConverter.hpp"
+#include "PackReader.hpp"
+#include "PackStore.hpp"
+
+/* Text converted from a pack is held in memory until there is this much of
+ * it, then appended to the pack in one go.
+*/
+static const size_t PACK_BATCH_BYTES = 16 * 1024 * 1024;
+
+DumpConverter::DumpConverter(unsigned int codepage):
+	transcoder(codepage)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+/* Converts some text into out, returns false if it already looks converted. */
+bool DumpConverter::convert(const char *data, size_t len, std::string *out)
+{
+	if(OemTranscoder::is_converted(data, len))
+	{
+		++(stats.skipped);
+		return false;
+	}
+
+	out->erase();
+
+	transcoder.convert(data, len, out);
+	transcoder.finish(out);
+
+	return true;
+}
+
+bool DumpConverter::convert_file(const char *filename)
+{
+	FILE *f = fopen(filename, "rb");
+	if(f == NULL)
+	{
+		fprintf(stderr, "Unable to open %s\n", filename);
+
+		++(stats.failed);
+		return false;
+	}
+
+	std::string text;
+	char buf[16384];
+	size_t got;
+
+	while((got = fread(buf, 1, sizeof(buf), f)) > 0)
+	{
+		text.append(buf, got);
+	}
+
+	bool read_ok = !ferror(f);
+	fclose(f);
+
+	if(!read_ok)
+	{
+		fprintf(stderr, "Error reading %s\n", filename);
+
+		++(stats.failed);
+		return false;
+	}
+
+	std::string converted;
+
+	if(!convert(text.data(), text.length(), &converted))
+	{
+		return true;
+	}
+
+	/* Replace the file the same way DirectoryStore writes them. */
+
+	std::string tmp_name = std::string(filename) + ".tmp";
+
+	f = fopen(tmp_name.c_str(), "wb");
+	bool ok = f != NULL;
+
+	if(ok)
+	{
+		ok = (converted.empty() || fwrite(converted.data(), converted.length(), 1, f) == 1);
+		ok = (fclose(f) == 0) && ok;
+	}
+
+	if(ok)
+	{
+		remove(filename);
+		ok = rename(tmp_name.c_str(), filename) == 0;
+	}
+	else{
+		remove(tmp_name.c_str());
+	}
+
+	if(!ok)
+	{
+		fprintf(stderr, "Unable to write %s\n", filename);
+
+		++(stats.failed);
+		return false;
+	}
+
+	++(stats.converted);
+	stats.bytes_in += text.length();
+	stats.bytes_out += converted.length();
+
+	return true;
+}
+
+bool DumpConverter::convert_pack(const char *filename)
+{
+	/* The pack can't be appended to while it is mapped, so the text is
+	 * converted a batch at a time with the pack closed in between.
+	*/
+
+	size_t next = 0;
+
+	while(true)
+	{
+		PackReader reader;
+		if(!reader.open(filename))
+		{
+			fprintf(stderr, "Unable to open %s\n", filename);
+
+			++(stats.failed);
+			return false;
+		}
+
+		std::vector< std::pair<unsigned int, std::string> > batch;
+		size_t batch_bytes = 0;
+		uint64 batch_bytes_in = 0;
+
+		/* Entries are sorted by ID and appending doesn't add any, so next
+		 * still points at the right one after the pack is reopened.
+		*/
+		for(; next < reader.count() && batch_bytes < PACK_BATCH_BYTES; ++next)
+		{
+			const PackReader::Entry &e = reader.entry(next);
+
+			if(strcmp(e.kind, "txt") != 0)
+			{
+				continue;
+			}
+
+			if(!reader.verify(e))
+			{
+				fprintf(stderr, "%u.txt in %s is corrupt, skipping it\n", e.id, filename);
+
+				++(stats.failed);
+				continue;
+			}
+
+			std::string converted;
+
+			if(convert((const char*)(reader.data(e)), (size_t)(e.length), &converted))
+			{
+				batch_bytes += converted.length();
+				batch_bytes_in += e.length;
+
+				batch.push_back(std::make_pair(e.id, converted));
+			}
+		}
+
+		bool last = next >= reader.count();
+
+		reader.close();
+
+		if(batch.empty())
+		{
+			return true;
+		}
+
+		PackStore store;
+		bool ok = store.open(filename);
+
+		for(size_t i = 0; ok && i < batch.size(); ++i)
+		{
+			ok = store.write(batch[i].first, "txt", batch[i].second.data(), batch[i].second.length());
+		}
+
+		ok = store.close() && ok;
+
+		if(!ok)
+		{
+			fprintf(stderr, "Error writing %s\n", filename);
+
+			++(stats.failed);
+			return false;
+		}
+
+		stats.converted += batch.size();
+		stats.bytes_in += batch_bytes_in;
+		stats.bytes_out += batch_bytes;
+
+		if(last)
+		{
+			return true;
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef MMVRIPPER_DUMPCONVERTER_HPP
+#define MMVRIPPER_DUMPCONVERTER_HPP
+
+#include <string>
+
+#include "IntTypes.hpp"
+#include "OemTranscoder.hpp"
+
+/* Converts page text saved without TEXT_CODEPAGE (which is how it is saved
+ * by default) from an OEM codepage to UTF-8 with LF line endings, see
+ * OemTranscoder.
+ *
+ * Text which already looks converted is left alone, so running it twice does
+ * no harm.
+*/
+class DumpConverter
+{
+public:
+	struct Stats
+	{
+		unsigned long converted;
+		unsigned long skipped;   /* Already converted. */
+		unsigned long failed;
+
+		uint64 bytes_in, bytes_out;
+	};
+
+private:
+	OemTranscoder transcoder;
+	Stats stats;
+
+	bool convert(const char *data, size_t len, std::string *out);
+
+	/* Not copyable. */
+	DumpConverter(const DumpConverter&);
+	DumpConverter &operator=(const DumpConverter&);
+
+public:
+	/* codepage must be OemTranscoder::supported(). */
+	DumpConverter(unsigned int codepage);
+
+	/* Converts a text file in place. Returns false on error. */
+	bool convert_file(const char *filename);
+
+	/* Converts every "txt" in a pack, appending the converted text to it
+	 * (see PackStore). Returns false on error.
+	*/
+	bool convert_pack(const char *filename);
+
+	Stats get_stats() const
+	{
+		return stats;
+	}
+};
+
+#endif /* !MMVRIPPER_DUMPCONVERTER_HPP */
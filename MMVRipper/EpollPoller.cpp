@@ -0,0 +1,66 @@
+#ifdef __linux__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "EpollPoller.hpp"
+
+EpollPoller::EpollPoller():
+	events(256)
+{
+	epoll_fd = epoll_create(256);
+	if(epoll_fd < 0)
+	{
+		perror("epoll_create");
+		abort();
+	}
+}
+
+EpollPoller::~EpollPoller()
+{
+	close(epoll_fd);
+}
+
+bool EpollPoller::add(SOCKET sock)
+{
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = sock;
+
+	if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &ev) != 0)
+	{
+		perror("epoll_ctl");
+		return false;
+	}
+
+	return true;
+}
+
+void EpollPoller::remove(SOCKET sock)
+{
+	/* Kernels before 2.6.9 insist on a non-NULL event for EPOLL_CTL_DEL. */
+	struct epoll_event ev;
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, sock, &ev);
+}
+
+void EpollPoller::wait(std::vector<SOCKET> *ready)
+{
+	ready->clear();
+
+	int n = epoll_wait(epoll_fd, &(events[0]), events.size(), -1);
+
+	for(int i = 0; i < n; ++i)
+	{
+		ready->push_back(events[i].data.fd);
+	}
+
+	if((size_t)(n) == events.size())
+	{
+		/* Filled the whole buffer, make room for more next time. */
+		events.resize(events.size() * 2);
+	}
+}
+
+#endif /* __linux__ */
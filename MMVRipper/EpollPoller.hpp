@@ -0,0 +1,32 @@
+#ifndef MMVRIPPER_EPOLLPOLLER_HPP
+#define MMVRIPPER_EPOLLPOLLER_HPP
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+#include <vector>
+
+#include "Poller.hpp"
+
+/* Poller backend using epoll, which doesn't need the whole set of sockets
+ * handing over on every wait and has no limit on descriptor numbers.
+*/
+class EpollPoller: public Poller
+{
+private:
+	int epoll_fd;
+	std::vector<struct epoll_event> events;
+
+public:
+	EpollPoller();
+	virtual ~EpollPoller();
+
+	virtual bool add(SOCKET sock);
+	virtual void remove(SOCKET sock);
+
+	virtual void wait(std::vector<SOCKET> *ready);
+};
+
+#endif /* __linux__ */
+
+#endif /* !MMVRIPPER_EPOLLPOLLER_HPP */
@@ -0,0 +1,93 @@
+#include <string>
+#include <vector>
+
+#include "Clock.hpp"
+#include "FakeWindowEventSource.hpp"
+
+FakeWindowEventSource::FakeWindowEventSource(WindowEvents *events):
+	events(events),
+	stopping(false) {}
+
+void FakeWindowEventSource::schedule(unsigned int delay_ms, void *window, void *parent, const char *title, const char *class_name)
+{
+	Pending p;
+	p.due_us = clock_us() + ((uint64)(delay_ms) * 1000);
+	p.window = window;
+	p.parent = parent;
+	p.title = title;
+	p.class_name = class_name;
+
+	{
+		MutexLock l(lock);
+		pending.push_back(p);
+	}
+
+	wake.post();
+}
+
+void FakeWindowEventSource::stop()
+{
+	{
+		MutexLock l(lock);
+		stopping = true;
+	}
+
+	wake.post();
+	join();
+}
+
+void FakeWindowEventSource::run()
+{
+	while(true)
+	{
+		std::vector<Pending> due;
+		uint64 next_due = 0;
+
+		{
+			MutexLock l(lock);
+
+			if(stopping)
+			{
+				break;
+			}
+
+			uint64 now = clock_us();
+
+			for(size_t i = 0; i < pending.size();)
+			{
+				if(pending[i].due_us <= now)
+				{
+					due.push_back(pending[i]);
+					pending.erase(pending.begin() + i);
+				}
+				else{
+					if(next_due == 0 || pending[i].due_us < next_due)
+					{
+						next_due = pending[i].due_us;
+					}
+
+					++i;
+				}
+			}
+		}
+
+		for(size_t i = 0; i < due.size(); ++i)
+		{
+			events->post(due[i].window, due[i].parent, due[i].title.c_str(), due[i].class_name.c_str());
+		}
+
+		if(!due.empty())
+		{
+			continue;
+		}
+
+		if(next_due == 0)
+		{
+			wake.wait();
+		}
+		else{
+			uint64 now = clock_us();
+			wake.wait(next_due > now ? (unsigned int)((next_due - now + 999) / 1000) : 0);
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef MMVRIPPER_FAKEWINDOWEVENTSOURCE_HPP
+#define MMVRIPPER_FAKEWINDOWEVENTSOURCE_HPP
+
+#include <string>
+#include <vector>
+
+#include "IntTypes.hpp"
+#include "Threading.hpp"
+#include "WindowEvents.hpp"
+
+/* Posts window events to a WindowEvents from its own thread some time after
+ * they are scheduled, like windows appearing in another process, so the
+ * simulator exercises the same waiting as the real viewer.
+*/
+class FakeWindowEventSource: public Thread
+{
+private:
+	struct Pending
+	{
+		uint64 due_us;
+
+		void *window;
+		void *parent;
+		std::string title;
+		std::string class_name;
+	};
+
+	WindowEvents *events;
+
+	Mutex lock;
+	std::vector<Pending> pending;
+	bool stopping;
+
+	Semaphore wake;
+
+protected:
+	virtual void run();
+
+public:
+	FakeWindowEventSource(WindowEvents *events);
+
+	void schedule(unsigned int delay_ms, void *window, void *parent, const char *title, const char *class_name);
+
+	/* Stops the thread, throwing away anything not posted yet. */
+	void stop();
+};
+
+#endif /* !MMVRIPPER_FAKEWINDOWEVENTSOURCE_HPP */
@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "GrayImage.hpp"
+
+void GrayImage::resize(unsigned int width, unsigned int height)
+{
+	this->width = width;
+	this->height = height;
+
+	pixels.resize(width * height);
+}
+
+void GrayImage::from_bgrx(const unsigned char *bgrx, size_t stride, unsigned int width, unsigned int height)
+{
+	resize(width, height);
+
+	for(unsigned int y = 0; y < height; ++y)
+	{
+		const unsigned char *src = bgrx + (y * stride);
+		unsigned char *dst = row(y);
+
+		/* BT.601 luma in 8.8 fixed point. Kept to plain integer arithmetic
+		 * on independent pixels so the compiler can vectorise it.
+		*/
+
+		for(unsigned int x = 0; x < width; ++x)
+		{
+			unsigned int b = src[x * 4];
+			unsigned int g = src[x * 4 + 1];
+			unsigned int r = src[x * 4 + 2];
+
+			dst[x] = (unsigned char)((r * 77 + g * 150 + b * 29 + 128) >> 8);
+		}
+	}
+}
+
+void GrayImage::crop(const GrayImage &src, int x, int y, unsigned int width, unsigned int height)
+{
+	if(x < 0)
+	{
+		width = (unsigned)(-x) < width ? width + x : 0;
+		x = 0;
+	}
+
+	if(y < 0)
+	{
+		height = (unsigned)(-y) < height ? height + y : 0;
+		y = 0;
+	}
+
+	width = (unsigned)(x) < src.width ? std::min(width, src.width - x) : 0;
+	height = (unsigned)(y) < src.height ? std::min(height, src.height - y) : 0;
+
+	if(width == 0)
+	{
+		height = 0;
+	}
+
+	resize(width, height);
+
+	for(unsigned int r = 0; r < height; ++r)
+	{
+		memcpy(row(r), src.row(y + r) + x, width);
+	}
+}
+
+void GrayImage::invert()
+{
+	for(size_t i = 0; i < pixels.size(); ++i)
+	{
+		pixels[i] = 255 - pixels[i];
+	}
+}
+
+void GrayImage::to_pgm(std::string *out) const
+{
+	char header[32];
+	sprintf(header, "P5\n%u %u\n255\n", width, height);
+
+	out->reserve(strlen(header) + pixels.size());
+	out->assign(header);
+
+	if(!pixels.empty())
+	{
+		out->append((const char*)(&pixels[0]), pixels.size());
+	}
+}
+
+void GrayImage::to_pbm(unsigned char threshold, std::string *out) const
+{
+	char header[32];
+	sprintf(header, "P4\n%u %u\n", width, height);
+
+	size_t row_bytes = (width + 7) / 8;
+
+	out->reserve(strlen(header) + (row_bytes * height));
+	out->assign(header);
+
+	std::vector<unsigned char> packed(row_bytes);
+
+	for(unsigned int y = 0; y < height; ++y)
+	{
+		const unsigned char *src = row(y);
+		std::fill(packed.begin(), packed.end(), 0);
+
+		for(unsigned int x = 0; x < width; ++x)
+		{
+			if(src[x] < threshold)
+			{
+				packed[x / 8] |= 0x80 >> (x % 8);
+			}
+		}
+
+		if(row_bytes > 0)
+		{
+			out->append((const char*)(&packed[0]), row_bytes);
+		}
+	}
+}
+
+/* Reads the next number from a PNM header, skipping whitespace and comments.
+ * Returns false if there isn't one.
+*/
+static bool pnm_number(const unsigned char *data, size_t len, size_t *pos, unsigned int *value)
+{
+	while(*pos < len)
+	{
+		if(data[*pos] == '#')
+		{
+			while(*pos < len && data[*pos] != '\n')
+			{
+				++(*pos);
+			}
+		}
+		else if(isspace(data[*pos]))
+		{
+			++(*pos);
+		}
+		else{
+			break;
+		}
+	}
+
+	if(*pos >= len || !isdigit(data[*pos]))
+	{
+		return false;
+	}
+
+	*value = 0;
+
+	while(*pos < len && isdigit(data[*pos]))
+	{
+		*value = (*value * 10) + (data[*pos] - '0');
+		++(*pos);
+	}
+
+	return true;
+}
+
+bool GrayImage::from_pnm(const unsigned char *data, size_t len)
+{
+	if(len < 2 || data[0] != 'P' || (data[1] != '4' && data[1] != '5'))
+	{
+		return false;
+	}
+
+	bool packed = data[1] == '4';
+
+	size_t pos = 2;
+	unsigned int width, height, maxval = 1;
+
+	if(!pnm_number(data, len, &pos, &width)
+		|| !pnm_number(data, len, &pos, &height)
+		|| (!packed && !pnm_number(data, len, &pos, &maxval)))
+	{
+		return false;
+	}
+
+	/* Exactly one whitespace character before the pixels. */
+	++pos;
+
+	size_t row_bytes = packed ? (width + 7) / 8 : width;
+
+	if(maxval != (packed ? 1U : 255U) || pos > len || (len - pos) / (height > 0 ? height : 1) < row_bytes)
+	{
+		return false;
+	}
+
+	resize(width, height);
+
+	for(unsigned int y = 0; y < height; ++y)
+	{
+		const unsigned char *src = data + pos + (y * row_bytes);
+		unsigned char *dst = row(y);
+
+		if(packed)
+		{
+			/* Set bits are black. */
+
+			for(unsigned int x = 0; x < width; ++x)
+			{
+				dst[x] = (src[x / 8] & (0x80 >> (x % 8))) ? 0 : 255;
+			}
+		}
+		else{
+			memcpy(dst, src, width);
+		}
+	}
+
+	return true;
+}
+
+static unsigned int le16(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static unsigned int le32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)(p[3]) << 24);
+}
+
+bool GrayImage::from_bmp(const unsigned char *data, size_t len)
+{
+	/* BITMAPFILEHEADER followed by a BITMAPINFOHEADER (or one of the later
+	 * versions, which start the same way).
+	*/
+
+	if(len < 54 || data[0] != 'B' || data[1] != 'M')
+	{
+		return false;
+	}
+
+	unsigned int offset = le32(data + 10);
+	int width = (int)(le32(data + 18));
+	int height = (int)(le32(data + 22));
+	unsigned int bpp = le16(data + 28);
+	unsigned int compression = le32(data + 30);
+
+	/* Rows are stored bottom-up unless the height is negative. */
+	bool top_down = height < 0;
+	if(top_down)
+	{
+		height = -height;
+	}
+
+	/* BI_RGB, or BI_BITFIELDS with (hopefully) the usual masks. */
+	if(width < 0 || (bpp != 24 && bpp != 32) || (compression != 0 && compression != 3))
+	{
+		return false;
+	}
+
+	size_t stride = (((size_t)(width) * bpp + 31) / 32) * 4;
+
+	if(offset > len || (len - offset) / (height > 0 ? height : 1) < stride)
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> bgrx((size_t)(width) * 4 * height);
+
+	for(int y = 0; y < height; ++y)
+	{
+		const unsigned char *src = data + offset + ((top_down ? y : height - 1 - y) * stride);
+		unsigned char *dst = &bgrx[(size_t)(y) * width * 4];
+
+		if(bpp == 32)
+		{
+			memcpy(dst, src, width * 4);
+		}
+		else{
+			for(int x = 0; x < width; ++x)
+			{
+				dst[x * 4] = src[x * 3];
+				dst[x * 4 + 1] = src[x * 3 + 1];
+				dst[x * 4 + 2] = src[x * 3 + 2];
+				dst[x * 4 + 3] = 0;
+			}
+		}
+	}
+
+	from_bgrx(bgrx.empty() ? NULL : &bgrx[0], width * 4, width, height);
+
+	return true;
+}
+
+bool GrayImage::load(const char *filename)
+{
+	FILE *f = fopen(filename, "rb");
+	if(f == NULL)
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> data;
+	unsigned char buf[16384];
+	size_t got;
+
+	while((got = fread(buf, 1, sizeof(buf), f)) > 0)
+	{
+		data.insert(data.end(), buf, buf + got);
+	}
+
+	bool read_ok = !ferror(f);
+	fclose(f);
+
+	if(!read_ok || data.empty())
+	{
+		return false;
+	}
+
+	return from_pnm(&data[0], data.size()) || from_bmp(&data[0], data.size());
+}
@@ -0,0 +1,65 @@
+#ifndef MMVRIPPER_GRAYIMAGE_HPP
+#define MMVRIPPER_GRAYIMAGE_HPP
+
+#include <string>
+#include <vector>
+
+/* 8-bit grayscale image, top row first. */
+class GrayImage
+{
+public:
+	unsigned int width;
+	unsigned int height;
+
+	std::vector<unsigned char> pixels;
+
+	GrayImage():
+		width(0),
+		height(0) {}
+
+	void resize(unsigned int width, unsigned int height);
+
+	unsigned char *row(unsigned int y)
+	{
+		return &pixels[y * width];
+	}
+
+	const unsigned char *row(unsigned int y) const
+	{
+		return &pixels[y * width];
+	}
+
+	/* Converts 32-bit BGRX pixels (as found in a 32bpp DIB) to grayscale.
+	 * stride is the distance between the start of each row in bytes.
+	*/
+	void from_bgrx(const unsigned char *bgrx, size_t stride, unsigned int width, unsigned int height);
+
+	/* Copies part of another image. The area is clipped to the source. */
+	void crop(const GrayImage &src, int x, int y, unsigned int width, unsigned int height);
+
+	/* Swaps black and white, to undo a selection highlight. */
+	void invert();
+
+	/* Encodes the image as a binary (P5) PGM. */
+	void to_pgm(std::string *out) const;
+
+	/* Encodes the image as a packed 1-bit (P4) PBM, with pixels darker than
+	 * threshold set to black.
+	*/
+	void to_pbm(unsigned char threshold, std::string *out) const;
+
+	/* Decodes a binary PGM (P5) or PBM (P4) like the ones above write.
+	 * Returns false if it isn't one.
+	*/
+	bool from_pnm(const unsigned char *data, size_t len);
+
+	/* Decodes an uncompressed 24 or 32-bit BMP, as saved by older versions
+	 * of MMVRipper. Returns false if it isn't one.
+	*/
+	bool from_bmp(const unsigned char *data, size_t len);
+
+	/* Reads a PGM, PBM or BMP file. Returns false if it can't be read. */
+	bool load(const char *filename);
+};
+
+#endif /* !MMVRIPPER_GRAYIMAGE_HPP */
@@ -0,0 +1,14 @@
+#ifndef MMVRIPPER_INTTYPES_HPP
+#define MMVRIPPER_INTTYPES_HPP
+
+/* Visual C++ 6 has no <stdint.h> or long long. */
+
+#ifdef _MSC_VER
+typedef unsigned __int64 uint64;
+#define UINT64_FMT "%I64u"
+#else
+typedef unsigned long long uint64;
+#define UINT64_FMT "%llu"
+#endif
+
+#endif /* !MMVRIPPER_INTTYPES_HPP */
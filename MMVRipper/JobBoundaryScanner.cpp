@@ -0,0 +1,141 @@
+#include <string.h>
+
+#include "JobBoundaryScanner.hpp"
+
+const size_t JobBoundaryScanner::NO_BOUNDARY = (size_t)(-1);
+
+/* PJL Universal Exit Language. */
+static const char UEL[] = "\x1B%-12345X";
+static const size_t UEL_LEN = sizeof(UEL) - 1;
+
+JobBoundaryScanner::JobBoundaryScanner()
+{
+	reset();
+}
+
+void JobBoundaryScanner::reset()
+{
+	line_len = 0;
+	eof_line_cr = false;
+	uel_matched = 0;
+	document_depth = 0;
+	header = false;
+}
+
+size_t JobBoundaryScanner::scan(const unsigned char *data, size_t len)
+{
+	for(size_t i = 0; i < len; ++i)
+	{
+		unsigned char c = data[i];
+
+		if(eof_line_cr)
+		{
+			/* Previous byte was the "\r" after "%%EOF", pull in the "\n" too
+			 * if this is a "\r\n" line ending.
+			*/
+
+			size_t end = (c == '\n') ? (i + 1) : i;
+
+			reset();
+			return end;
+		}
+
+		if(c == (unsigned char)(UEL[uel_matched]))
+		{
+			if(++uel_matched == UEL_LEN)
+			{
+				uel_matched = 0;
+
+				if(header)
+				{
+					reset();
+					return i + 1;
+				}
+
+				/* A UEL before the job starts is followed by PJL or the
+				 * PostScript header without a line break.
+				*/
+				line_len = 0;
+				continue;
+			}
+		}
+		else{
+			uel_matched = (c == (unsigned char)(UEL[0])) ? 1 : 0;
+		}
+
+		if(c == '\r' || c == '\n')
+		{
+			if(end_line())
+			{
+				if(c == '\r')
+				{
+					eof_line_cr = true;
+					continue;
+				}
+
+				reset();
+				return i + 1;
+			}
+		}
+		else if(c == 0x04 && line_len == 0)
+		{
+			/* Ctrl+D (PostScript end of job) is sent before the header by
+			 * some drivers, ignore it so the header is still at the start of
+			 * the line.
+			*/
+		}
+		else{
+			if(line_len < sizeof(line))
+			{
+				line[line_len] = c;
+			}
+
+			++line_len;
+		}
+	}
+
+	return NO_BOUNDARY;
+}
+
+/* Checks the line which just ended, returns true if it was the end of the job. */
+bool JobBoundaryScanner::end_line()
+{
+	size_t stored = line_len < sizeof(line) ? line_len : sizeof(line);
+	bool eof = false;
+
+	if(stored >= 10 && strncmp(line, "%!PS-Adobe", 10) == 0)
+	{
+		if(document_depth == 0)
+		{
+			header = true;
+		}
+	}
+	else if(stored >= 15 && strncmp(line, "%%BeginDocument", 15) == 0)
+	{
+		++document_depth;
+	}
+	else if(stored >= 13 && strncmp(line, "%%EndDocument", 13) == 0)
+	{
+		if(document_depth > 0)
+		{
+			--document_depth;
+		}
+	}
+	else if(header && document_depth == 0 && line_len == stored
+		&& stored >= 5 && strncmp(line, "%%EOF", 5) == 0)
+	{
+		eof = true;
+
+		for(size_t i = 5; i < stored; ++i)
+		{
+			if(line[i] != ' ' && line[i] != '\t')
+			{
+				eof = false;
+			}
+		}
+	}
+
+	line_len = 0;
+
+	return eof;
+}
@@ -0,0 +1,62 @@
+#ifndef MMVRIPPER_JOBBOUNDARYSCANNER_HPP
+#define MMVRIPPER_JOBBOUNDARYSCANNER_HPP
+
+#include <stddef.h>
+
+/* Incrementally scans a stream of PostScript (optionally wrapped in PJL) for
+ * the end of each print job, so several jobs can be sent down a single
+ * connection.
+ *
+ * Bytes are fed in as they arrive and each byte is only looked at once. A
+ * job ends after:
+ *
+ * - A "%%EOF" line which isn't inside a %%BeginDocument/%%EndDocument block
+ *   (i.e. not the end of an embedded EPS file).
+ *
+ * - A PJL Universal Exit Language sequence.
+ *
+ * Either one only counts once the job has had a "%!PS-Adobe" header.
+*/
+class JobBoundaryScanner
+{
+public:
+	static const size_t NO_BOUNDARY;
+
+private:
+	/* Start of the current line, long enough for the longest DSC comment we
+	 * care about.
+	*/
+	char line[16];
+	size_t line_len;
+
+	bool eof_line_cr;  /* Saw "%%EOF\r", end the job after the "\n" (if any). */
+
+	size_t uel_matched;
+
+	unsigned int document_depth;
+	bool header;
+
+	bool end_line();
+
+public:
+	JobBoundaryScanner();
+
+	/* Forget everything and start looking for a new job. */
+	void reset();
+
+	/* Scans the next len bytes of the stream. Returns the number of bytes up
+	 * to and including the end of the current job, or NO_BOUNDARY if the job
+	 * doesn't end within data. After finding a boundary the scanner is
+	 * reset() ready for the next job, the caller should pass the rest of the
+	 * data in again.
+	*/
+	size_t scan(const unsigned char *data, size_t len);
+
+	/* Returns true if the current job has had a PostScript header. */
+	bool seen_header() const
+	{
+		return header;
+	}
+};
+
+#endif /* !MMVRIPPER_JOBBOUNDARYSCANNER_HPP */
@@ -0,0 +1,225 @@
+#include <assert.h>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "Journal.hpp"
+
+/* Sync the journal to disk after this many records. */
+static const unsigned int SYNC_INTERVAL = 64;
+
+Journal::Journal():
+	file(NULL),
+	unsynced(0) {}
+
+Journal::~Journal()
+{
+	if(file != NULL)
+	{
+		sync();
+		fclose(file);
+	}
+}
+
+/* Cuts the file off after length bytes. */
+static bool truncate_file(const char *filename, long length)
+{
+	FILE *f = fopen(filename, "r+b");
+	if(f == NULL)
+	{
+		return false;
+	}
+
+#ifdef _WIN32
+	bool ok = _chsize(_fileno(f), length) == 0;
+#else
+	bool ok = ftruncate(fileno(f), (off_t)(length)) == 0;
+#endif
+
+	fclose(f);
+
+	return ok;
+}
+
+bool Journal::open(const char *filename)
+{
+	MutexLock l(lock);
+
+	assert(file == NULL);
+
+	FILE *f = fopen(filename, "rb");
+	if(f != NULL)
+	{
+		long complete = load(f);
+		bool partial = fseek(f, 0, SEEK_END) == 0 && ftell(f) > complete;
+
+		fclose(f);
+
+		/* Cut off the partial record left by a crash, rather than finishing
+		 * it off with a newline: "D 1234" cut short could be "D 12".
+		*/
+		if(partial && !truncate_file(filename, complete))
+		{
+			return false;
+		}
+	}
+
+	file = fopen(filename, "ab");
+	if(file == NULL)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+long Journal::load(FILE *f)
+{
+	std::string line;
+	long pos = 0, complete = 0;
+	int c;
+
+	while((c = fgetc(f)) != EOF)
+	{
+		++pos;
+
+		if(c != '\n')
+		{
+			line.push_back((char)(c));
+			continue;
+		}
+
+		complete = pos;
+
+		unsigned int id, parent, depth;
+
+		if(sscanf(line.c_str(), "V %u %u %u", &id, &parent, &depth) == 3)
+		{
+			if(nodes.find(id) == nodes.end())
+			{
+				Node &node = nodes[id];
+				node.parent = parent;
+				node.depth = depth;
+				node.done = false;
+				node.done_before = false;
+
+				if(parent != 0)
+				{
+					nodes[parent].children.push_back(id);
+				}
+			}
+		}
+		else if(sscanf(line.c_str(), "D %u", &id) == 1)
+		{
+			nodes[id].done = true;
+			nodes[id].done_before = true;
+		}
+
+		/* A records are only there for people reading the journal, the
+		 * crawler checks for artifacts on disk.
+		*/
+
+		line.clear();
+	}
+
+	/* Anything left in line is a partial record. */
+	return complete;
+}
+
+void Journal::write(const char *record)
+{
+	fprintf(file, "%s\n", record);
+	fflush(file);
+
+	if(++unsynced >= SYNC_INTERVAL)
+	{
+		commit();
+	}
+}
+
+void Journal::sync()
+{
+	MutexLock l(lock);
+	commit();
+}
+
+/* Syncs the file to disk, with the lock held. */
+void Journal::commit()
+{
+	if(file == NULL || unsynced == 0)
+	{
+		return;
+	}
+
+	fflush(file);
+
+#ifdef _WIN32
+	_commit(_fileno(file));
+#else
+	fsync(fileno(file));
+#endif
+
+	unsynced = 0;
+}
+
+const Journal::Node *Journal::find(unsigned int id)
+{
+	MutexLock l(lock);
+
+	std::map<unsigned int, Node>::const_iterator n = nodes.find(id);
+	return n != nodes.end() ? &(n->second) : NULL;
+}
+
+void Journal::visited(unsigned int id, unsigned int parent, unsigned int depth)
+{
+	MutexLock l(lock);
+
+	if(nodes.find(id) == nodes.end())
+	{
+		Node &node = nodes[id];
+		node.parent = parent;
+		node.depth = depth;
+		node.done = false;
+		node.done_before = false;
+
+		if(parent != 0)
+		{
+			nodes[parent].children.push_back(id);
+		}
+	}
+
+	char record[64];
+	sprintf(record, "V %u %u %u", id, parent, depth);
+
+	write(record);
+}
+
+void Journal::artifact(unsigned int id, const char *type)
+{
+	MutexLock l(lock);
+
+	char record[64];
+	sprintf(record, "A %u %s", id, type);
+
+	write(record);
+}
+
+void Journal::done(unsigned int id)
+{
+	MutexLock l(lock);
+
+	nodes[id].done = true;
+
+	char record[64];
+	sprintf(record, "D %u", id);
+
+	write(record);
+}
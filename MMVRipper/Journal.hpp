@@ -0,0 +1,78 @@
+#ifndef MMVRIPPER_JOURNAL_HPP
+#define MMVRIPPER_JOURNAL_HPP
+
+#include <map>
+#include <stdio.h>
+#include <vector>
+
+#include "Threading.hpp"
+
+/* Append-only record of how far a crawl has got, so it can pick up where it
+ * left off if the viewer or MMVRipper dies.
+ *
+ * Each line is one record:
+ *
+ *   V <id> <parent> <depth>  - Visited an index entry (parent is 0 at the top)
+ *   A <id> <type>            - Finished saving an artifact (bmp, txt or ps)
+ *   D <id>                   - Finished the entry and everything under it
+ *
+ * Records are flushed as they are written and the file is synced to disk
+ * every so often. A partial record at the end of the file (from a crash while
+ * writing it) is cut off when the journal is opened.
+ *
+ * Several crawlers on different threads can share one journal.
+*/
+class Journal
+{
+public:
+	struct Node
+	{
+		unsigned int parent;
+		unsigned int depth;
+		bool done;
+		bool done_before;  /* Was already done when the journal was opened. */
+
+		std::vector<unsigned int> children;
+	};
+
+private:
+	Mutex lock;
+
+	FILE *file;
+	std::map<unsigned int, Node> nodes;
+
+	unsigned int unsynced;
+
+	long load(FILE *f);
+	void write(const char *record);
+	void commit();
+
+	/* Not copyable. */
+	Journal(const Journal&);
+	Journal &operator=(const Journal&);
+
+public:
+	Journal();
+	~Journal();
+
+	/* Reads any existing records from the file and opens it for appending.
+	 * Returns false if it can't be opened (or a partial record can't be cut
+	 * off the end).
+	*/
+	bool open(const char *filename);
+
+	/* Returns the node recorded for an index entry, NULL if it was never
+	 * visited. Only the children of nodes which were done before the journal
+	 * was opened are safe to look at while other crawlers are using it.
+	*/
+	const Node *find(unsigned int id);
+
+	void visited(unsigned int id, unsigned int parent, unsigned int depth);
+	void artifact(unsigned int id, const char *type);
+	void done(unsigned int id);
+
+	/* Flushes any records not yet synced to disk. */
+	void sync();
+};
+
+#endif /* !MMVRIPPER_JOURNAL_HPP */
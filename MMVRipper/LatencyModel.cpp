@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "LatencyModel.hpp"
+
+/* Need this many samples before trusting them over the default. */
+static const size_t MIN_SAMPLES = 8;
+
+/* The limit is the slowest recent sample, plus half again, plus this. Never
+ * less than MIN_LIMIT_US or more than MAX_LIMIT_US.
+*/
+static const uint64 SAFETY_MARGIN_US = 20000;
+static const uint64 MIN_LIMIT_US = 50000;
+static const uint64 MAX_LIMIT_US = 10000000;
+
+LatencyModel::Operation::Operation():
+	next_sample(0),
+	settled(0),
+	timeouts(0)
+{
+	memset(histogram, 0, sizeof(histogram));
+}
+
+LatencyModel::LatencyModel(uint64 default_limit_us):
+	default_limit_us(default_limit_us) {}
+
+void LatencyModel::add_sample(Operation &op, uint64 us)
+{
+	if(op.samples.size() < MAX_SAMPLES)
+	{
+		op.samples.push_back(us);
+	}
+	else{
+		op.samples[op.next_sample] = us;
+		op.next_sample = (op.next_sample + 1) % MAX_SAMPLES;
+	}
+}
+
+bool LatencyModel::load(const char *filename)
+{
+	FILE *f = fopen(filename, "r");
+	if(f == NULL)
+	{
+		return false;
+	}
+
+	/* Each line is an operation name followed by its samples in us. */
+
+	char line[4096];
+
+	while(fgets(line, sizeof(line), f) != NULL)
+	{
+		char *name = strtok(line, " \t\r\n");
+
+		if(name == NULL)
+		{
+			continue;
+		}
+
+		Operation &op = ops[name];
+
+		char *sample;
+		while((sample = strtok(NULL, " \t\r\n")) != NULL)
+		{
+			add_sample(op, (uint64)(strtoul(sample, NULL, 10)));
+		}
+	}
+
+	fclose(f);
+
+	return true;
+}
+
+bool LatencyModel::save(const char *filename) const
+{
+	FILE *f = fopen(filename, "w");
+	if(f == NULL)
+	{
+		return false;
+	}
+
+	for(std::map<std::string, Operation>::const_iterator o = ops.begin(); o != ops.end(); ++o)
+	{
+		fprintf(f, "%s", o->first.c_str());
+
+		/* Oldest first, so loading them back keeps the order. */
+		for(size_t i = 0; i < o->second.samples.size(); ++i)
+		{
+			size_t s = (o->second.next_sample + i) % o->second.samples.size();
+			fprintf(f, " %lu", (unsigned long)(o->second.samples[s]));
+		}
+
+		fprintf(f, "\n");
+	}
+
+	return fclose(f) == 0;
+}
+
+uint64 LatencyModel::limit_us(const char *op) const
+{
+	std::map<std::string, Operation>::const_iterator o = ops.find(op);
+
+	if(o == ops.end() || o->second.samples.size() < MIN_SAMPLES)
+	{
+		return default_limit_us;
+	}
+
+	uint64 slowest = *std::max_element(o->second.samples.begin(), o->second.samples.end());
+	uint64 limit = slowest + (slowest / 2) + SAFETY_MARGIN_US;
+
+	return std::min(std::max(limit, MIN_LIMIT_US), MAX_LIMIT_US);
+}
+
+void LatencyModel::settled(const char *op, uint64 us)
+{
+	Operation &o = ops[op];
+
+	add_sample(o, us);
+	++(o.settled);
+
+	unsigned int bucket = 0;
+	for(uint64 ms = us / 1000; ms > 0 && bucket < HISTOGRAM_BUCKETS - 1; ms /= 2)
+	{
+		++bucket;
+	}
+
+	++(o.histogram[bucket]);
+}
+
+void LatencyModel::timed_out(const char *op, uint64 us)
+{
+	Operation &o = ops[op];
+
+	/* Record it as taking twice as long as we waited, which widens the
+	 * limit for next time.
+	*/
+	add_sample(o, us * 2);
+	++(o.timeouts);
+}
+
+void LatencyModel::print_stats(FILE *out) const
+{
+	for(std::map<std::string, Operation>::const_iterator o = ops.begin(); o != ops.end(); ++o)
+	{
+		if(o->second.settled == 0 && o->second.timeouts == 0)
+		{
+			continue;
+		}
+
+		fprintf(out, "Settle times for %s: %lu settled, %lu timed out, now waiting up to " UINT64_FMT " ms\n",
+			o->first.c_str(), o->second.settled, o->second.timeouts, limit_us(o->first.c_str()) / 1000);
+
+		for(unsigned int b = 0; b < HISTOGRAM_BUCKETS; ++b)
+		{
+			if(o->second.histogram[b] == 0)
+			{
+				continue;
+			}
+
+			unsigned long lo = b == 0 ? 0 : (1UL << (b - 1));
+
+			if(b == HISTOGRAM_BUCKETS - 1)
+			{
+				fprintf(out, "  %6lu ms+      %lu\n", lo, o->second.histogram[b]);
+			}
+			else{
+				fprintf(out, "  %6lu-%-6lu ms %lu\n", lo, (1UL << b), o->second.histogram[b]);
+			}
+		}
+	}
+}
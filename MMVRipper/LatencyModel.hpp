@@ -0,0 +1,66 @@
+#ifndef MMVRIPPER_LATENCYMODEL_HPP
+#define MMVRIPPER_LATENCYMODEL_HPP
+
+#include <map>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "IntTypes.hpp"
+
+/* Learns how long the viewer takes to settle down after each kind of
+ * operation (e.g. "print"), to decide how long to keep waiting for it.
+ *
+ * The limit for an operation is the slowest of its recent settle times with a
+ * safety margin on top, so it tightens as slow ones drop out of the recent
+ * samples and widens again when an operation times out.
+ * Until enough samples have been seen the old fixed delay is used.
+ *
+ * Recent samples are saved to a file so the next run starts where this one
+ * left off.
+*/
+class LatencyModel
+{
+public:
+	enum { MAX_SAMPLES = 128, HISTOGRAM_BUCKETS = 16 };
+
+private:
+	struct Operation
+	{
+		std::vector<uint64> samples;  /* Most recent, in a ring. */
+		size_t next_sample;
+
+		unsigned long settled, timeouts;
+
+		/* Settle times this run: under 1ms, 1-2ms, 2-4ms... */
+		unsigned long histogram[HISTOGRAM_BUCKETS];
+
+		Operation();
+	};
+
+	std::map<std::string, Operation> ops;
+	uint64 default_limit_us;
+
+	void add_sample(Operation &op, uint64 us);
+
+public:
+	/* default_limit_us is used for operations we don't know much about. */
+	LatencyModel(uint64 default_limit_us);
+
+	/* Loads samples saved by save(). Returns false if the file can't be
+	 * read, which is fine the first time.
+	*/
+	bool load(const char *filename);
+	bool save(const char *filename) const;
+
+	/* How long to wait for an operation to settle before giving up. */
+	uint64 limit_us(const char *op) const;
+
+	void settled(const char *op, uint64 us);
+	void timed_out(const char *op, uint64 us);
+
+	/* Prints each operation's limit and histogram of settle times. */
+	void print_stats(FILE *out) const;
+};
+
+#endif /* !MMVRIPPER_LATENCYMODEL_HPP */
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "ListboxModel.hpp"
+
+/* Moving the cursor further than this is cheaper with set_cursor(), which
+ * costs two messages, than with the arrow keys.
+*/
+static const unsigned int MAX_ARROW_MOVE = 2;
+
+/* Rows either side of a change compared when the probes disagree. */
+static const unsigned int CONFIRM_WINDOW = 4;
+
+static unsigned int hash_rows(const unsigned int *rows, size_t count)
+{
+	/* FNV-1a over the item data. */
+
+	unsigned int hash = 2166136261U;
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		for(int b = 0; b < 4; ++b)
+		{
+			hash ^= (rows[i] >> (b * 8)) & 0xFF;
+			hash *= 16777619U;
+		}
+	}
+
+	return hash;
+}
+
+ListboxModel::ListboxModel(ViewerDriver *viewer, bool absolute_cursor, bool verify):
+	viewer(viewer),
+	absolute_cursor(absolute_cursor),
+	verify(verify),
+	cursor(0)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+void ListboxModel::load()
+{
+	unsigned int lb_count = viewer->get_count();
+
+	rows.clear();
+	rows.reserve(lb_count);
+
+	for(unsigned int i = 0; i < lb_count; ++i)
+	{
+		rows.push_back(viewer->get_item_data(i));
+	}
+
+	cursor = viewer->get_cursor();
+}
+
+/* Compares rows begin to end in the listbox with the model. */
+bool ListboxModel::confirm(unsigned int begin, unsigned int end)
+{
+	++(stats.confirms);
+
+	if(end > rows.size())
+	{
+		return false;
+	}
+
+	std::vector<unsigned int> live;
+	live.reserve(end - begin);
+
+	for(unsigned int i = begin; i < end; ++i)
+	{
+		live.push_back(viewer->get_item_data(i));
+	}
+
+	return live.empty() || hash_rows(&live[0], live.size()) == hash_rows(&rows[begin], end - begin);
+}
+
+/* Verification mode, compares the whole listbox with the model. */
+void ListboxModel::check(const char *op)
+{
+	if(!verify)
+	{
+		return;
+	}
+
+	unsigned long start_messages = viewer->get_message_count();
+
+	std::vector<unsigned int> model_rows = rows;
+	unsigned int model_cursor = cursor;
+
+	load();
+
+	++(stats.snapshots);
+	stats.snapshot_messages += viewer->get_message_count() - start_messages;
+
+	if(rows != model_rows || cursor != model_cursor)
+	{
+		fprintf(stderr, "Listbox model was wrong after %s (%u rows, cursor at %u; expected %u rows, cursor at %u)\n",
+			op, (unsigned)(rows.size()), cursor, (unsigned)(model_rows.size()), model_cursor);
+
+		++(stats.mismatches);
+	}
+}
+
+void ListboxModel::move_to(unsigned int idx)
+{
+	if(idx == cursor)
+	{
+		return;
+	}
+
+	unsigned long start_messages = viewer->get_message_count();
+	++(stats.moves);
+
+	unsigned int distance = idx > cursor ? idx - cursor : cursor - idx;
+
+	if(idx == 0 && distance > 1)
+	{
+		viewer->press_key(ViewerDriver::KEY_HOME);
+	}
+	else if(idx == rows.size() - 1 && distance > 1)
+	{
+		viewer->press_key(ViewerDriver::KEY_END);
+	}
+	else if(absolute_cursor && distance > MAX_ARROW_MOVE && viewer->set_cursor(idx))
+	{
+		/* Moved. */
+	}
+	else{
+		if(absolute_cursor && distance > MAX_ARROW_MOVE)
+		{
+			/* The viewer doesn't do set_cursor(), don't ask again. */
+			absolute_cursor = false;
+		}
+
+		for(; cursor < idx; ++cursor)
+		{
+			viewer->press_key(ViewerDriver::KEY_DOWN);
+		}
+
+		for(; cursor > idx; --cursor)
+		{
+			viewer->press_key(ViewerDriver::KEY_UP);
+		}
+	}
+
+	cursor = idx;
+
+	stats.move_messages += viewer->get_message_count() - start_messages;
+
+	check("move");
+}
+
+unsigned int ListboxModel::expand()
+{
+	unsigned long start_messages = viewer->get_message_count();
+	++(stats.expand_tests);
+
+	unsigned int idx = cursor;
+	unsigned int prev_count = rows.size();
+
+	viewer->press_key(ViewerDriver::KEY_RIGHT);
+
+	unsigned int new_count = viewer->get_count();
+	unsigned int num_children = 0;
+
+	if(new_count > prev_count)
+	{
+		/* Expanded a group, its children should have been inserted after it
+		 * and the first one selected.
+		*/
+
+		num_children = new_count - prev_count;
+
+		std::vector<unsigned int> children;
+		children.reserve(num_children);
+
+		for(unsigned int i = 0; i < num_children; ++i)
+		{
+			children.push_back(viewer->get_item_data(idx + 1 + i));
+		}
+
+		rows.insert(rows.begin() + idx + 1, children.begin(), children.end());
+
+		unsigned int after = idx + 1 + num_children;
+
+		bool rows_ok = viewer->get_item_data(idx) == rows[idx]
+			&& (after >= new_count || viewer->get_item_data(after) == rows[after]);
+
+		unsigned int new_cursor = viewer->get_cursor();
+
+		if(rows_ok && new_cursor != idx + 1)
+		{
+			/* Selected something other than the first child, make sure the
+			 * rows around it are what we think they are.
+			*/
+
+			unsigned int begin = idx > CONFIRM_WINDOW ? idx - CONFIRM_WINDOW : 0;
+			unsigned int end = after + CONFIRM_WINDOW < new_count ? after + CONFIRM_WINDOW : new_count;
+
+			rows_ok = confirm(begin, end);
+		}
+
+		cursor = new_cursor;
+
+		if(!rows_ok)
+		{
+			fprintf(stderr, "Listbox changed unexpectedly when expanding row %u, reloading\n", idx);
+
+			++(stats.resyncs);
+			load();
+		}
+	}
+	else if(new_count != prev_count)
+	{
+		fprintf(stderr, "Listbox shrank when expanding row %u, reloading\n", idx);
+
+		++(stats.resyncs);
+		load();
+	}
+
+	stats.expand_messages += viewer->get_message_count() - start_messages;
+
+	check("expand");
+
+	return num_children;
+}
+
+void ListboxModel::collapse(unsigned int idx, unsigned int num_children)
+{
+	unsigned long start_messages = viewer->get_message_count();
+	++(stats.collapses);
+
+	/* Pressing left on any of the (collapsed) children collapses the group
+	 * and selects it again.
+	*/
+	viewer->press_key(ViewerDriver::KEY_LEFT);
+
+	rows.erase(rows.begin() + idx + 1, rows.begin() + idx + 1 + num_children);
+	cursor = idx;
+
+	unsigned int new_count = viewer->get_count();
+	unsigned int new_cursor = viewer->get_cursor();
+
+	if(new_count != rows.size() || (new_cursor != idx && !confirm(idx, idx + 1)))
+	{
+		fprintf(stderr, "Listbox changed unexpectedly when collapsing row %u, reloading\n", idx);
+
+		++(stats.resyncs);
+		load();
+	}
+	else{
+		cursor = new_cursor;
+	}
+
+	stats.collapse_messages += viewer->get_message_count() - start_messages;
+
+	check("collapse");
+}
@@ -0,0 +1,101 @@
+#ifndef MMVRIPPER_LISTBOXMODEL_HPP
+#define MMVRIPPER_LISTBOXMODEL_HPP
+
+#include <vector>
+
+#include "ViewerDriver.hpp"
+
+/* Cached copy of the item data of each row in the index listbox and which
+ * row is selected, kept up to date as the crawler moves around and expands
+ * or collapses groups.
+ *
+ * Changes are detected from the item count and a couple of probes either
+ * side of where the change should have happened. If the probes disagree with
+ * what we expected, the rows around the change are compared against the
+ * model by hash before falling back to reading the whole listbox again.
+ *
+ * In verification mode the whole listbox is read and compared with the model
+ * after every operation, like the crawler used to do.
+*/
+class ListboxModel
+{
+public:
+	struct Stats
+	{
+		unsigned long expand_tests, expand_messages;
+		unsigned long collapses, collapse_messages;
+		unsigned long moves, move_messages;
+
+		unsigned long confirms;  /* Probes disagreed, compared a window by hash. */
+		unsigned long resyncs;   /* Read the whole listbox again. */
+
+		unsigned long snapshots, snapshot_messages;  /* Verification mode. */
+		unsigned long mismatches;
+	};
+
+private:
+	ViewerDriver *viewer;
+
+	bool absolute_cursor;
+	bool verify;
+
+	std::vector<unsigned int> rows;
+	unsigned int cursor;
+
+	Stats stats;
+
+	bool confirm(unsigned int begin, unsigned int end);
+	void check(const char *op);
+
+public:
+	ListboxModel(ViewerDriver *viewer, bool absolute_cursor, bool verify);
+
+	/* Switches to a new viewer, after the old one died. Call load() before
+	 * doing anything else.
+	*/
+	void set_viewer(ViewerDriver *viewer)
+	{
+		this->viewer = viewer;
+	}
+
+	/* Reads the whole listbox. */
+	void load();
+
+	size_t size() const
+	{
+		return rows.size();
+	}
+
+	unsigned int item(unsigned int idx) const
+	{
+		return rows[idx];
+	}
+
+	unsigned int get_cursor() const
+	{
+		return cursor;
+	}
+
+	Stats get_stats() const
+	{
+		return stats;
+	}
+
+	/* Selects the given row, using whichever of the arrow keys, HOME/END or
+	 * ViewerDriver::set_cursor() takes the fewest messages.
+	*/
+	void move_to(unsigned int idx);
+
+	/* Tries to expand the selected row. Returns the number of children which
+	 * appeared after it (with the first one selected), zero if it isn't a
+	 * group.
+	*/
+	unsigned int expand();
+
+	/* Collapses the group at row idx with num_children rows under it, which
+	 * must be collapsed themselves, from one of its children.
+	*/
+	void collapse(unsigned int idx, unsigned int num_children);
+};
+
+#endif /* !MMVRIPPER_LISTBOXMODEL_HPP */
@@ -0,0 +1,27 @@
+#include <string>
+
+#include "LockedStore.hpp"
+
+bool LockedStore::exists(unsigned int id, const char *kind)
+{
+	MutexLock l(lock);
+	return backing->exists(id, kind);
+}
+
+bool LockedStore::write(unsigned int id, const char *kind, const void *data, size_t len)
+{
+	MutexLock l(lock);
+	return backing->write(id, kind, data, len);
+}
+
+bool LockedStore::write(unsigned int id, const char *kind, PrintJob &job)
+{
+	MutexLock l(lock);
+	return backing->write(id, kind, job);
+}
+
+bool LockedStore::write(unsigned int id, const char *kind, std::string &data)
+{
+	MutexLock l(lock);
+	return backing->write(id, kind, data);
+}
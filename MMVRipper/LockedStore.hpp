@@ -0,0 +1,32 @@
+#ifndef MMVRIPPER_LOCKEDSTORE_HPP
+#define MMVRIPPER_LOCKEDSTORE_HPP
+
+#include "ArtifactStore.hpp"
+#include "Threading.hpp"
+
+/* Lets several threads use an ArtifactStore which isn't thread safe (like
+ * PackStore) by only letting one of them in at a time.
+*/
+class LockedStore: public ArtifactStore
+{
+private:
+	ArtifactStore *backing;
+	Mutex lock;
+
+public:
+	LockedStore(ArtifactStore *backing):
+		backing(backing) {}
+
+	virtual bool exists(unsigned int id, const char *kind);
+
+	virtual bool write(unsigned int id, const char *kind, const void *data, size_t len);
+	virtual bool write(unsigned int id, const char *kind, PrintJob &job);
+	virtual bool write(unsigned int id, const char *kind, std::string &data);
+
+	virtual bool thread_safe() const
+	{
+		return true;
+	}
+};
+
+#endif /* !MMVRIPPER_LOCKEDSTORE_HPP */
@@ -1,602 +1,657 @@
 #include <assert.h>
-#include <set>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
 #include <vector>
 
+#ifdef _WIN32
 #include <winsock2.h>
 #include <windows.h>
 
 #include "DummyPrinter.hpp"
-#include "StupidMessageHandler.hpp"
-
-#define DUMP_INDEX_SCREENSHOTS
-#define DUMP_PAGE_TEXT
-// #define DUMP_PAGE_PRINTOUT
-
-static BOOL CALLBACK find_popnav(HWND hWnd, LPARAM lParam);
-static BOOL CALLBACK find_listbox(HWND hWnd, LPARAM lParam);
-static BOOL CALLBACK find_windoc(HWND hWnd, LPARAM lParam);
-static std::vector<DWORD> get_listbox_items_data(HWND listbox);
-static void reset_listbox_state(HWND listbox);
-static void walk_listbox(HWND listbox, std::set<DWORD> *seen_items, int depth);
-static void capture_rect(HWND hWnd, RECT rect, const char *filename);
-static void capture_cleanup();
-
-static int find_menu_item_id(HWND hWnd, const char *name)
+#include "Win32ViewerLauncher.hpp"
+#endif
+
+#include "AsyncStore.hpp"
+#include "Crawler.hpp"
+#include "DirectoryStore.hpp"
+#include "DumpConverter.hpp"
+#include "LockedStore.hpp"
+#include "PackStore.hpp"
+#include "Quarantine.hpp"
+#include "ShardCoordinator.hpp"
+#include "SimulatedViewerLauncher.hpp"
+#include "SlowStore.hpp"
+#include "Supervisor.hpp"
+#include "Tracer.hpp"
+
+/* What to collect for each index entry, any of "text" (the text of each
+ * page), "shots" (a screenshot of each entry in the index) and "prints" (a
+ * PostScript printout of each page). Can be changed with -p or -a.
+*/
+#define CONTENT "text,shots"
+
+/* Walk the whole index first, which only prints the tree, then collect each
+ * of CONTENT in its own pass over the entries which still need it, in the
+ * order listed. Comment out to collect everything while walking the index,
+ * like older versions did.
+*/
+#define CONTENT_PASSES
+
+// #define DUMP_INDEX_SCREENSHOTS_1BIT
+
+/* Convert the text of each page from this OEM codepage (437 or 850) to UTF-8
+ * with LF line endings as it is saved. Left out, it is saved exactly as the
+ * viewer gives it to us, and can be converted later with -u.
+*/
+// #define TEXT_CODEPAGE 437
+
+/* Capture the whole index listbox once per scroll position and cut the
+ * screenshots of each entry out of that, rather than capturing each entry.
+*/
+#define CAPTURE_WHOLE_VIEWPORT
+
+/* Stream each print job into a spool file in the working directory as it is
+ * received instead of holding it in memory, the finished file is renamed to
+ * <id>.ps.
+*/
+#define SPOOL_PAGE_PRINTOUT
+
+/* Jump straight to index entries with LB_SETCURSEL where that takes fewer
+ * messages than the arrow keys. Not every viewer takes it well, so try it
+ * with VERIFY_LISTBOX_MODEL on a title first.
+*/
+// #define ABSOLUTE_CURSOR_MOVES
+
+/* Append everything to this pack file rather than writing each artifact to
+ * its own file in the working directory. Use mmvpack.pl to list or unpack it.
+*/
+// #define PACK_FILE "MMVRipper.pack"
+
+/* Save artifacts from this many background threads so a slow disk doesn't
+ * hold up the crawl, with up to ASYNC_QUEUE_SIZE waiting to be written.
+ * Comment out to save everything as soon as it is captured.
+*/
+#define ASYNC_WRITERS 2
+#define ASYNC_QUEUE_SIZE 64
+
+/* Rip with this many viewers at once, which must all be showing the same
+ * title with their windows arranged so they don't overlap. Each one needs to
+ * print to its own port, starting at 9100 for the viewer started first.
+*/
+#define SHARD_WORKERS 1
+
+/* Record progress in this file, and skip anything it says was finished when
+ * restarted. Delete it to start from scratch.
+*/
+#define JOURNAL_FILE "MMVRipper.journal"
+
+/* Remember how long the viewer takes to settle after printing in this file,
+ * so each run doesn't have to learn it again.
+*/
+#define LATENCY_FILE "MMVRipper.latency"
+
+/* Pages which crash or hang the viewer are added to this file and skipped
+ * from then on. Take one out of it to try the page again.
+*/
+#define QUARANTINE_FILE "MMVRipper.quarantine"
+
+/* Kill the viewer if it doesn't respond for this long (in milliseconds) so it
+ * can be restarted. Comment out to wait for it forever.
+*/
+#define HANG_TIMEOUT_MS 60000
+
+/* Run this to start a new viewer when one dies or is killed, it has to come up
+ * with the index open like the first one. Without it, the crawl stops when the
+ * viewer dies.
+*/
+// #define VIEWER_COMMAND "C:\\MMVIEWER\\MMVIEWER.EXE C:\\TITLE\\TITLE.MVB"
+
+/* Record how long every phase of the crawl takes in this file, which can be
+ * opened with chrome://tracing or Perfetto.
+*/
+#define TRACE_FILE "MMVRipper.trace.json"
+
+/* Print a progress summary this often, in seconds. */
+#define SUMMARY_INTERVAL 60
+
+/* Read back the whole index listbox after every key press to check the
+ * crawler is keeping track of it properly. This is very slow.
+*/
+// #define VERIFY_LISTBOX_MODEL
+
+/* Log how many messages were sent to the viewer for each index entry. */
+// #define MESSAGE_LOG "messages.log"
+
+/* Pages known to crash the viewer, added to the quarantine if they aren't in
+ * it already.
+*/
+static const unsigned int KNOWN_BAD_PAGES[] = {
+	3941378,  /* This solitary page seems to crash the viewer when you load it. */
+};
+
+/* Sets what options collects from a comma separated list of "text", "shots"
+ * and "prints" (or "none"), in passes in that order if passes is true.
+ * Returns false if there is anything else in it.
+*/
+static bool parse_content(const char *list, bool passes, CrawlOptions *options)
 {
-	HMENU windoc_menu = GetMenu(hWnd);
+	options->index_screenshots = false;
+	options->page_text = false;
+	options->page_printout = false;
+	options->num_passes = 0;
 
-	int i, j;
+	if(strcmp(list, "none") == 0)
+	{
+		return true;
+	}
 
-	for(i = 0; i < 10; ++i)
+	std::string rest = list;
+
+	while(!rest.empty())
 	{
-		HMENU submenu = GetSubMenu(windoc_menu, i);
+		size_t comma = rest.find(',');
+		std::string name = rest.substr(0, comma);
 
-		if(submenu != NULL)
-		{
-			int num_menu_items = GetMenuItemCount(submenu);
+		rest = comma == std::string::npos ? "" : rest.substr(comma + 1);
 
-			for(j = 0; j < num_menu_items; ++j)
-			{
-				char item_name[32];
-				int in_len = GetMenuString(submenu, j, item_name, sizeof(item_name), MF_BYPOSITION);
+		ContentPass pass;
 
-				if(in_len > 0 && strcmp(item_name, name) == 0)
-				{
-					return GetMenuItemID(submenu, j);
-				}
-			}
+		if(name == content_pass_name(PASS_TEXT))
+		{
+			pass = PASS_TEXT;
+			options->page_text = true;
+		}
+		else if(name == content_pass_name(PASS_SCREENSHOTS))
+		{
+			pass = PASS_SCREENSHOTS;
+			options->index_screenshots = true;
+		}
+		else if(name == content_pass_name(PASS_PRINTOUTS))
+		{
+			pass = PASS_PRINTOUTS;
+			options->page_printout = true;
+		}
+		else{
+			return false;
+		}
+
+		if(passes && options->num_passes < PASS_COUNT)
+		{
+			options->passes[(options->num_passes)++] = pass;
 		}
 	}
 
-	return -1;
+	return true;
 }
 
-DummyPrinter *print_server;
-
-HWND windoc = NULL;
-
-int main(int argc, char **argv)
+static void usage(const char *argv0)
 {
-	EnumWindows(&find_windoc, (LPARAM)(&windoc));
+	fprintf(stderr, "Usage: %s                     (rip the running viewer)\n", argv0);
+	fprintf(stderr, "       %s -s <tree.lst>       (simulate the index in tree.lst)\n", argv0);
+	fprintf(stderr, "       %s -n <nodes> [<seed>] (simulate a random index)\n", argv0);
+	fprintf(stderr, "       %s -u <codepage> <file.txt|file.pack>...\n", argv0);
+	fprintf(stderr, "              (convert page text saved without TEXT_CODEPAGE to UTF-8)\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options (before the above):\n");
+	fprintf(stderr, "  -p <content>  Walk the index, then collect each of content in its own pass\n");
+	fprintf(stderr, "                (a comma separated list of text, shots and prints, or none)\n");
+	fprintf(stderr, "  -a <content>  Collect content while walking the index\n");
+	fprintf(stderr, "  -j <viewers>  Override SHARD_WORKERS (simulates that many viewers)\n");
+	fprintf(stderr, "  -w <threads>  Override ASYNC_WRITERS (0 to write synchronously)\n");
+	fprintf(stderr, "  -d <ms>       Delay every write, to simulate slow storage\n");
+	fprintf(stderr, "  -c <id>       Simulated viewer crashes when page id is opened\n");
+	fprintf(stderr, "  -h <id>       Simulated viewer hangs when page id is opened\n");
+}
 
-	if(windoc == NULL)
+/* Converts text saved without TEXT_CODEPAGE, in text files or packs. */
+static int convert_dumps(unsigned int codepage, int count, char **filenames)
+{
+	if(!OemTranscoder::supported(codepage))
 	{
-		abort();
+		fprintf(stderr, "Codepage %u isn't supported\n", codepage);
+		return 1;
 	}
 
-	print_server = new DummyPrinter(9100);
-
-	HWND popnav = NULL;
-	EnumWindows(&find_popnav, (LPARAM)(&popnav));
+	DumpConverter converter(codepage);
 
-	if(popnav == NULL)
+	for(int i = 0; i < count; ++i)
 	{
-		fprintf(stderr, "Unable to find PopNav (Index) window\n");
-		return 1;
+		size_t len = strlen(filenames[i]);
+
+		if(len > 5 && strcmp(filenames[i] + len - 5, ".pack") == 0)
+		{
+			converter.convert_pack(filenames[i]);
+		}
+		else{
+			converter.convert_file(filenames[i]);
+		}
 	}
 
-	HWND listbox = NULL;
-	EnumChildWindows(popnav, &find_listbox, (LPARAM)(&listbox));
+	DumpConverter::Stats s = converter.get_stats();
+	fprintf(stderr, "Converted %lu pages (" UINT64_FMT " bytes to " UINT64_FMT " bytes), %lu already converted, %lu errors\n",
+		s.converted, s.bytes_in, s.bytes_out, s.skipped, s.failed);
+
+	return s.failed > 0 ? 1 : 0;
+}
 
-	if(listbox == NULL)
+int main(int argc, char **argv)
+{
+	if(argc >= 3 && strcmp(argv[1], "-u") == 0)
 	{
-		fprintf(stderr, "Unable to find ListBox in PopNav (Index) window\n");
-		return 1;
+		return convert_dumps(strtoul(argv[2], NULL, 10), argc - 3, argv + 3);
 	}
 
-	/* Bring PopNav to the front so it actually draws and we can capture it. */
-	BringWindowToTop(popnav);
+	CrawlOptions options;
+	memset(&options, 0, sizeof(options));
 
-	DWORD pid;
-	GetWindowThreadProcessId(listbox, &pid);
+#ifdef CONTENT_PASSES
+	bool parsed = parse_content(CONTENT, true, &options);
+#else
+	bool parsed = parse_content(CONTENT, false, &options);
+#endif
+	assert(parsed);
 
-	reset_listbox_state(listbox);
+#ifdef DUMP_INDEX_SCREENSHOTS_1BIT
+	options.capture_format = CAPTURE_PBM;
+#endif
 
-	std::set<DWORD> seen_items;
-	walk_listbox(listbox, &seen_items, 0);
+#ifdef TEXT_CODEPAGE
+	options.text_codepage = TEXT_CODEPAGE;
+#endif
 
-	delete print_server;
-	
-	capture_cleanup();
+#ifdef CAPTURE_WHOLE_VIEWPORT
+	options.capture_viewport = true;
+#endif
 
-	return 0;
-}
+#ifdef ABSOLUTE_CURSOR_MOVES
+	options.absolute_cursor = true;
+#endif
 
-static BOOL CALLBACK find_popnav(HWND hWnd, LPARAM lParam)
-{
-	TCHAR class_name[128];
-	if(GetClassName(hWnd, class_name, sizeof(class_name)) == 0)
-	{
-		/* Keep searching. */
-		return TRUE;
-	}
+#ifdef VERIFY_LISTBOX_MODEL
+	options.verify_listbox = true;
+#endif
 
-	if(strcmp(class_name, "PopNav") == 0)
-	{
-		HWND *dest_hwnd = (HWND*)(lParam);
-		*dest_hwnd = hWnd;
-		return FALSE;
-	}
+#ifdef MESSAGE_LOG
+	options.message_log = MESSAGE_LOG;
+#endif
 
-	/* Keep searching. */
-	return TRUE;
-}
+#ifdef JOURNAL_FILE
+	options.journal = JOURNAL_FILE;
+#endif
 
-static BOOL CALLBACK find_listbox(HWND hWnd, LPARAM lParam)
-{
-	TCHAR class_name[128];
-	if(GetClassName(hWnd, class_name, sizeof(class_name)) == 0)
-	{
-		/* Keep searching. */
-		return TRUE;
-	}
+#ifdef LATENCY_FILE
+	options.latency_file = LATENCY_FILE;
+#endif
 
-	if(strcmp(class_name, "ListBox") == 0)
-	{
-		HWND *dest_hwnd = (HWND*)(lParam);
-		*dest_hwnd = hWnd;
-		return FALSE;
-	}
+	unsigned int shard_workers = SHARD_WORKERS;
 
-	/* Keep searching. */
-	return TRUE;
-}
+	unsigned int writer_threads = 0;
+#ifdef ASYNC_WRITERS
+	writer_threads = ASYNC_WRITERS;
+#endif
 
-static BOOL CALLBACK find_windoc(HWND hWnd, LPARAM lParam)
-{
-	TCHAR class_name[128];
-	if(GetClassName(hWnd, class_name, sizeof(class_name)) == 0)
-	{
-		/* Keep searching. */
-		return TRUE;
-	}
+	unsigned int store_delay = 0;
 
-	if(strcmp(class_name, "MS_WINDOC") == 0)
-	{
-		HWND *dest_hwnd = (HWND*)(lParam);
-		*dest_hwnd = hWnd;
-		return FALSE;
-	}
+	std::vector<unsigned int> crash_ids;
+	std::vector<unsigned int> hang_ids;
 
-	/* Keep searching. */
-	return TRUE;
-}
+	int arg = 1;
 
-static BOOL CALLBACK find_copy_dialog(HWND hWnd, LPARAM lParam)
-{
-	char window_text[128];
-	if(GetWindowText(hWnd, window_text, sizeof(window_text)) == 0)
+	while(arg + 1 < argc && (strcmp(argv[arg], "-p") == 0 || strcmp(argv[arg], "-a") == 0
+		|| strcmp(argv[arg], "-j") == 0 || strcmp(argv[arg], "-w") == 0 || strcmp(argv[arg], "-d") == 0
+		|| strcmp(argv[arg], "-c") == 0 || strcmp(argv[arg], "-h") == 0))
 	{
-		/* Keep searching. */
-		return TRUE;
-	}
+		unsigned int value = strtoul(argv[arg + 1], NULL, 10);
 
-	HWND parent = GetParent(hWnd);
+		if(argv[arg][1] == 'p' || argv[arg][1] == 'a')
+		{
+			if(!parse_content(argv[arg + 1], (argv[arg][1] == 'p'), &options))
+			{
+				usage(argv[0]);
+				return 1;
+			}
+		}
+		else if(argv[arg][1] == 'j')
+		{
+			shard_workers = value > 0 ? value : 1;
+		}
+		else if(argv[arg][1] == 'w')
+		{
+			writer_threads = value;
+		}
+		else if(argv[arg][1] == 'c')
+		{
+			crash_ids.push_back(value);
+		}
+		else if(argv[arg][1] == 'h')
+		{
+			hang_ids.push_back(value);
+		}
+		else{
+			store_delay = value;
+		}
 
-	if(strcmp(window_text, "Copy") == 0 && parent == windoc)
-	{
-		HWND *dest_hwnd = (HWND*)(lParam);
-		*dest_hwnd = hWnd;
-		return FALSE;
+		arg += 2;
 	}
 
-	/* Keep searching. */
-	return TRUE;
-}
-
-static BOOL CALLBACK find_copy_edit(HWND hWnd, LPARAM lParam)
-{
-	TCHAR class_name[128];
-	if(GetClassName(hWnd, class_name, sizeof(class_name)) == 0)
-	{
-		/* Keep searching. */
-		return TRUE;
-	}
+	Quarantine quarantine;
 
-	if(strcmp(class_name, "Edit") == 0)
+#ifdef QUARANTINE_FILE
+	if(!quarantine.open(QUARANTINE_FILE))
 	{
-		HWND *dest_hwnd = (HWND*)(lParam);
-		*dest_hwnd = hWnd;
-		return FALSE;
+		fprintf(stderr, "Unable to read %s\n", QUARANTINE_FILE);
+		return 1;
 	}
+#endif
 
-	/* Keep searching. */
-	return TRUE;
-}
-
-static std::vector<DWORD> get_listbox_items_data(HWND listbox)
-{
-	DWORD lb_count = SendMessage(listbox, LB_GETCOUNT, 0, 0);
-	
-	std::vector<DWORD> items_data;
-	items_data.reserve(lb_count);
-
-	for(DWORD i = 0; i < lb_count; ++i)
+	for(size_t i = 0; i < sizeof(KNOWN_BAD_PAGES) / sizeof(*KNOWN_BAD_PAGES); ++i)
 	{
-		DWORD data = SendMessage(listbox, LB_GETITEMDATA, i, 0);
-		items_data.push_back(data);
+		if(!quarantine.contains(KNOWN_BAD_PAGES[i]))
+		{
+			quarantine.add(KNOWN_BAD_PAGES[i], "Known to crash the viewer");
+		}
 	}
 
-	return items_data;
-}
+	unsigned int hang_timeout_ms = 0;
+#ifdef HANG_TIMEOUT_MS
+	hang_timeout_ms = HANG_TIMEOUT_MS;
+#endif
 
-static void reset_listbox_state(HWND listbox)
-{
-	SendMessage(listbox, WM_KEYDOWN, VK_END, 0);
+	/* Each viewer is started by its own launcher and looked after by its own
+	 * supervisor, which restarts it if it dies.
+	*/
+	std::vector<ViewerLauncher*> launchers;
+	std::vector<SimulatedViewerLauncher*> sim_launchers;
 
-	std::vector<DWORD> prev_list_items = get_listbox_items_data(listbox);
-	DWORD prev_list_sel = SendMessage(listbox, LB_GETCURSEL, 0, 0);
+#ifdef _WIN32
+	std::vector<DummyPrinter*> print_servers;
+#endif
 
-	while(true)
+	if(argc - arg >= 2 && (strcmp(argv[arg], "-s") == 0 || strcmp(argv[arg], "-n") == 0))
 	{
-		/* Try collapsing a group. */
-
-		SendMessage(listbox, WM_KEYDOWN, VK_LEFT, 0);
-
-		std::vector<DWORD> new_list_items = get_listbox_items_data(listbox);
-		DWORD new_list_sel = SendMessage(listbox, LB_GETCURSEL, 0, 0);
-
-		if(new_list_items != prev_list_items || new_list_sel != prev_list_sel)
+		for(unsigned int i = 0; i < shard_workers; ++i)
 		{
-			/* We collapsed a group. */
-
-			prev_list_items = new_list_items;
-			prev_list_sel = new_list_sel;
-
-			continue;
-		}
-		
-		/* Doesn't look like we are in a group, try moving up. */
+			SimulatedViewerLauncher *launcher = argv[arg][1] == 's'
+				? new SimulatedViewerLauncher(argv[arg + 1])
+				: new SimulatedViewerLauncher(strtoul(argv[arg + 1], NULL, 10), (argc - arg >= 3 ? strtoul(argv[arg + 2], NULL, 10) : 1));
 
-		SendMessage(listbox, WM_KEYDOWN, VK_UP, 0);
-
-		new_list_items = get_listbox_items_data(listbox);
-		new_list_sel = SendMessage(listbox, LB_GETCURSEL, 0, 0);
-
-		if(new_list_items != prev_list_items || new_list_sel != prev_list_sel)
-		{
-			/* Moved up. */
+			for(size_t c = 0; c < crash_ids.size(); ++c)
+			{
+				launcher->add_crash(crash_ids[c], false);
+			}
 
-			prev_list_items = new_list_items;
-			prev_list_sel = new_list_sel;
+			for(size_t h = 0; h < hang_ids.size(); ++h)
+			{
+				launcher->add_crash(hang_ids[h], true);
+			}
 
-			continue;
+			sim_launchers.push_back(launcher);
+			launchers.push_back(launcher);
 		}
-
-		/* Looks like everything is now collapsed and we are at the top. */
-		break;
 	}
-}
-
-static void walk_listbox(HWND listbox, std::set<DWORD> *seen_items, int depth)
-{
-	DWORD sel_idx = SendMessage(listbox, LB_GETCURSEL, 0, 0);
-	DWORD sel_item = SendMessage(listbox, LB_GETITEMDATA, sel_idx, 0);
-
-	std::vector<DWORD> new_items;
-
-	while(seen_items->find(sel_item) == seen_items->end())
+	else if(argc > arg)
 	{
-		seen_items->insert(sel_item);
-		new_items.push_back(sel_item);
-
-		SendMessage(listbox, WM_KEYDOWN, VK_DOWN, 0);
+		usage(argv[0]);
+		return 1;
+	}
+	else{
+#ifdef _WIN32
+		for(unsigned int i = 0; i < shard_workers; ++i)
+		{
+#ifdef SPOOL_PAGE_PRINTOUT
+			DummyPrinter *print_server = new DummyPrinter(9100 + i, ".");
+#else
+			DummyPrinter *print_server = new DummyPrinter(9100 + i);
+#endif
+			print_servers.push_back(print_server);
 
-		sel_idx = SendMessage(listbox, LB_GETCURSEL, 0, 0);
-		sel_item = SendMessage(listbox, LB_GETITEMDATA, sel_idx, 0);
+#ifdef VIEWER_COMMAND
+			launchers.push_back(new Win32ViewerLauncher(print_server, i, VIEWER_COMMAND));
+#else
+			launchers.push_back(new Win32ViewerLauncher(print_server, i, NULL));
+#endif
+		}
+#else
+		usage(argv[0]);
+		return 1;
+#endif
 	}
 
-	while(sel_item != new_items[0])
-	{
-		SendMessage(listbox, WM_KEYDOWN, VK_UP, 0);
+#ifdef PACK_FILE
+	PackStore store;
 
-		sel_idx = SendMessage(listbox, LB_GETCURSEL, 0, 0);
-		sel_item = SendMessage(listbox, LB_GETITEMDATA, sel_idx, 0);
+	if(!store.open(PACK_FILE))
+	{
+		fprintf(stderr, "Unable to open %s\n", PACK_FILE);
+		return 1;
 	}
+#else
+	DirectoryStore store(".");
+#endif
 
-	size_t i;
+	Tracer tracer(SUMMARY_INTERVAL);
 
-	char indent[128] = {'\0'};
-	for(i = 0; i < depth; ++i)
+#ifdef TRACE_FILE
+	if(!tracer.open(TRACE_FILE))
 	{
-		strcat(indent, "  ");
+		fprintf(stderr, "Unable to create %s\n", TRACE_FILE);
 	}
+#endif
 
-	for(i = 0; i < new_items.size(); ++i)
+	std::vector<Supervisor*> supervisors;
+	std::vector<ViewerDriver*> viewers;
+
+	for(size_t i = 0; i < launchers.size(); ++i)
 	{
-		printf("%s%u\n", indent, new_items[i]);
+		Supervisor *supervisor = new Supervisor(launchers[i], hang_timeout_ms);
+		supervisor->set_tracer(&tracer);
 
-#ifdef DUMP_INDEX_SCREENSHOTS
-		RECT r;
-		SendMessage(listbox, LB_GETITEMRECT, sel_idx, (LPARAM)(&r));
+		supervisors.push_back(supervisor);
 
-		char name[32];
-		sprintf(name, "%u.bmp", new_items[i]);
+		ViewerDriver *viewer = supervisor->start();
 
-		capture_rect(listbox, r, name);
-#endif
+		if(viewer == NULL)
+		{
+			return 1;
+		}
 
-		std::vector<DWORD> prev_list_items = get_listbox_items_data(listbox);
+		viewers.push_back(viewer);
+	}
 
-		SendMessage(listbox, WM_KEYDOWN, VK_RIGHT, 0);
+	{
+		ArtifactStore *shared_store = &store;
 
-		std::vector<DWORD> new_list_items = get_listbox_items_data(listbox);
+		LockedStore *locked_store = NULL;
+		if(viewers.size() > 1 && !store.thread_safe())
+		{
+			locked_store = new LockedStore(shared_store);
+			shared_store = locked_store;
+		}
 
-		if(new_list_items != prev_list_items)
+		SlowStore *slow_store = NULL;
+		if(store_delay > 0)
 		{
-			walk_listbox(listbox, seen_items, depth + 1);
-			SendMessage(listbox, WM_KEYDOWN, VK_LEFT, 0);
+			slow_store = new SlowStore(shared_store, store_delay);
+			shared_store = slow_store;
 		}
-		else{
-#ifdef DUMP_PAGE_TEXT
-			char txt_name[32];
-			sprintf(txt_name, "%u.txt", new_items[i]);
 
-			DWORD txt_attribs = GetFileAttributes(txt_name);
+		/* Each viewer gets its own writers, so write errors go back to the
+		 * crawler which made them.
+		*/
+		std::vector<AsyncStore*> async_stores;
+		std::vector<ArtifactStore*> crawl_stores;
 
-			bool do_txt = txt_attribs == -1;
-#else
-			bool do_txt = false;
-#endif
+		for(size_t i = 0; i < viewers.size(); ++i)
+		{
+			if(writer_threads > 0)
+			{
+				AsyncStore *async_store = new AsyncStore(shared_store, writer_threads, ASYNC_QUEUE_SIZE);
+				async_store->set_tracer(&tracer);
 
-#ifdef DUMP_PAGE_PRINTOUT
-			char ps_name[32];
-			sprintf(ps_name, "%u.ps", new_items[i]);
+				async_stores.push_back(async_store);
+				crawl_stores.push_back(async_store);
+			}
+			else{
+				crawl_stores.push_back(shared_store);
+			}
+		}
 
-			DWORD ps_attribs = GetFileAttributes(ps_name);
+		if(viewers.size() == 1)
+		{
+			Crawler crawler(viewers[0], crawl_stores[0], options);
+			crawler.set_tracer(&tracer);
+			crawler.set_supervisor(supervisors[0]);
+			crawler.set_quarantine(&quarantine);
 
-			bool do_ps = ps_attribs == -1;
-#else
-			bool do_ps = false;
-#endif
-			
-			/* This solitary page seems to crash the viewer when you load it. */
-			if(new_items[i] == 3941378)
-			{
-				do_txt = false;
-				do_ps = false;
-			}
+			crawler.reset_listbox_state();
+			crawler.run();
+		}
+		else{
+			ShardCoordinator coordinator(options, &tracer);
+			coordinator.set_quarantine(&quarantine);
 
-			if(do_txt || do_ps)
+			for(size_t i = 0; i < viewers.size(); ++i)
 			{
-				/* Pressing enter on the listbox navigates the main window
-				 * to the selected topic.
-				*/
-				SendMessage(listbox, WM_CHAR, '\r', 0);
+				coordinator.add_worker(viewers[i], crawl_stores[i], supervisors[i]);
 			}
 
-#ifdef DUMP_PAGE_TEXT
-			if(do_txt)
+			if(!coordinator.run(stdout))
 			{
-				BOOL x = OpenClipboard(NULL);
-				assert(x);
+				fprintf(stderr, "Unable to open %s\n", options.journal);
+				return 1;
+			}
 
-				EmptyClipboard();
-				CloseClipboard();
+			ShardCoordinator::Stats cs = coordinator.get_stats();
+			fprintf(stderr, "Shared the index between %u viewers: %lu groups offered up, %lu entries stolen\n",
+				(unsigned)(viewers.size()), cs.groups, cs.steals);
+		}
 
-				/* The "Copy" commad from the "Edit" menu... */
-				PostMessage(windoc, WM_COMMAND, 1203, 0);
+		AsyncStore::Stats as;
+		memset(&as, 0, sizeof(as));
 
-				HWND copy_dialog = NULL;
-				while(copy_dialog == NULL)
-				{
-					StupidMessageHandler::run();
-					EnumWindows(&find_copy_dialog, (LPARAM)(&copy_dialog));
-				}
+		for(size_t i = 0; i < async_stores.size(); ++i)
+		{
+			AsyncStore::Stats s = async_stores[i]->get_stats();
 
-				assert(copy_dialog != NULL);
+			as.writes += s.writes;
+			as.bytes += s.bytes;
+			as.full += s.full;
+			as.max_queued = s.max_queued > as.max_queued ? s.max_queued : as.max_queued;
 
-				HWND edit_ctl = NULL;
-				EnumChildWindows(copy_dialog, &find_copy_edit, (LPARAM)(&edit_ctl));
+			/* Finishes any writes before the pack is closed. */
+			delete async_stores[i];
+		}
 
-				SendMessage(edit_ctl, EM_SETSEL, 0, -1);
+		if(!async_stores.empty())
+		{
+			fprintf(stderr, "Background writes: %lu artifacts, " UINT64_FMT " bytes, queue full %lu times, at most %lu queued\n",
+				as.writes, as.bytes, as.full, as.max_queued);
+		}
 
-				SendMessage(copy_dialog, WM_COMMAND, MAKEWPARAM(IDOK, BN_CLICKED), 0);
+		delete slow_store;
+		delete locked_store;
+	}
 
-				x = OpenClipboard(NULL);
+	tracer.close();
 
-				HANDLE clipboard_data = GetClipboardData(CF_OEMTEXT);
-				assert(clipboard_data != NULL);
+#ifdef PACK_FILE
+	if(!store.close())
+	{
+		fprintf(stderr, "Error writing %s\n", PACK_FILE);
+	}
+#endif
 
-				const char *clipboard_text = (const char*)(GlobalLock(clipboard_data));
+	WindowEvents::Stats es;
+	memset(&es, 0, sizeof(es));
 
-				FILE *f = fopen(txt_name, "wb");
-				assert(f != NULL);
-				fwrite(clipboard_text, strlen(clipboard_text), 1, f);
-				fclose(f);
+	for(size_t i = 0; i < supervisors.size(); ++i)
+	{
+		ViewerDriver *viewer = supervisors[i]->get_viewer();
+		if(viewer == NULL)
+		{
+			/* Couldn't be restarted. */
+			continue;
+		}
 
-				GlobalUnlock(clipboard_data);
-				CloseClipboard();
-			}
-#endif
+		WindowEvents::Stats s = viewer->get_event_stats();
 
-#ifdef DUMP_PAGE_PRINTOUT
-			if(do_ps)
-			{
-				/* Command 1103 appears to be a fixed internal command for printing
-				 * the current topic in MMV. There is a dynamically generated ID
-				 * for the "Print Topic" menu command, however this acts as a proxy
-				 * and seems to randomly fail with an unhelpful error if you use it
-				 * enough.
-				*/
-				
-				PostMessage(windoc, WM_COMMAND, 1103, 0);
-
-				bool got_print = false;
-				while(!got_print)
-				{
-					got_print = print_server->wait_for_print(1);
-					StupidMessageHandler::run();
-				}
-
-				/* Give the viewer a chance to catch up to the fact printing has
-				 * finished, or else it can break.
-				*/
-				Sleep(500);
-
-				if(got_print)
-				{
-					std::vector<unsigned char> print_data = print_server->get_next_print();
-
-					FILE *f = fopen(ps_name, "wb");
-					assert(f != NULL);
-					fwrite(&(print_data[0]), print_data.size(), 1, f);
-					fclose(f);
-
-					printf("Printed page %u\n", new_items[i]);
-				}
-			}
-#endif
-		}
+		es.waits += s.waits;
+		es.timeouts += s.timeouts;
+		es.latency_us += s.latency_us;
+		es.latency_us_max = s.latency_us_max > es.latency_us_max ? s.latency_us_max : es.latency_us_max;
+	}
 
-		SendMessage(listbox, WM_KEYDOWN, VK_DOWN, 0);
-		sel_idx = SendMessage(listbox, LB_GETCURSEL, 0, 0);
+	if(es.waits > 0)
+	{
+		fprintf(stderr, "Window events: %lu dialogs waited for, " UINT64_FMT " us from appearing to being noticed on average, "
+			UINT64_FMT " us at most, %lu timeouts\n",
+			es.waits, es.latency_us / es.waits, es.latency_us_max, es.timeouts);
 	}
 
-	sel_idx = SendMessage(listbox, LB_GETCURSEL, 0, 0);
-	sel_item = SendMessage(listbox, LB_GETITEMDATA, sel_idx, 0);
+	Supervisor::Stats vs;
+	memset(&vs, 0, sizeof(vs));
 
-	while(sel_item != new_items[0])
+	for(size_t i = 0; i < supervisors.size(); ++i)
 	{
-		SendMessage(listbox, WM_KEYDOWN, VK_UP, 0);
+		Supervisor::Stats s = supervisors[i]->get_stats();
 
-		sel_idx = SendMessage(listbox, LB_GETCURSEL, 0, 0);
-		sel_item = SendMessage(listbox, LB_GETITEMDATA, sel_idx, 0);
+		vs.restarts += s.restarts;
+		vs.hangs += s.hangs;
 	}
-}
 
-static HDC hdcMemDC = NULL;
-static HBITMAP hbmScreen = NULL;
+	if(vs.restarts > 0 || vs.hangs > 0)
+	{
+		fprintf(stderr, "Viewer restarted %lu times, killed %lu times for not responding, %u pages in quarantine\n",
+			vs.restarts, vs.hangs, (unsigned)(quarantine.size()));
+	}
 
-static void capture_rect(HWND hWnd, RECT rect, const char *filename)
-{
-    HDC hdcScreen;
-    BITMAP bmpScreen;
-    DWORD dwBytesWritten = 0;
-    DWORD dwSizeofDIB = 0;
-    HANDLE hFile = NULL;
-    char* lpbitmap = NULL;
-    HANDLE hDIB = NULL;
-    DWORD dwBmpSize = 0;
-
-    hdcScreen = GetDC(hWnd);
-
-	if(hdcMemDC == NULL)
+	if(!sim_launchers.empty())
 	{
-		// Create a compatible DC, which is used in a BitBlt from the window DC.
-		hdcMemDC = CreateCompatibleDC(hdcScreen);
+		SimulatedViewer::Stats ss;
+		memset(&ss, 0, sizeof(ss));
 
-		if (!hdcMemDC)
+		for(size_t i = 0; i < sim_launchers.size(); ++i)
 		{
-			MessageBox(hWnd, "CreateCompatibleDC has failed", "Failed", MB_OK);
-			goto done;
+			SimulatedViewer::Stats s = sim_launchers[i]->get_stats();
+
+			ss.topics_opened += s.topics_opened;
+			ss.popups += s.popups;
+			ss.busy_violations += s.busy_violations;
 		}
+
+		fprintf(stderr, "Simulated viewer: %lu topics opened, %lu popups, asked to do something while busy %lu times\n",
+			ss.topics_opened, ss.popups, ss.busy_violations);
+	}
+
+	/* The launchers own the viewers, which the supervisors might still be
+	 * watching.
+	*/
+	for(size_t i = 0; i < supervisors.size(); ++i)
+	{
+		delete supervisors[i];
 	}
 
-	if(hbmScreen == NULL)
+	for(size_t i = 0; i < launchers.size(); ++i)
 	{
-		// Create a compatible bitmap from the Window DC.
-		hbmScreen = CreateCompatibleBitmap(hdcScreen, rect.right - rect.left, rect.bottom - rect.top);
+		delete launchers[i];
+	}
 
-		if (!hbmScreen)
+#ifdef _WIN32
+	for(size_t i = 0; i < print_servers.size(); ++i)
+	{
+		if(options.page_printout)
 		{
-			MessageBox(hWnd, "CreateCompatibleBitmap Failed", "Failed", MB_OK);
-			goto done;
+			ChunkPool::Stats ps = print_servers[i]->get_stats();
+			fprintf(stderr, "Print buffers: " UINT64_FMT " chunks allocated, " UINT64_FMT " reused, "
+				UINT64_FMT " bytes received in place, " UINT64_FMT " bytes copied, " UINT64_FMT " bytes spooled\n",
+				ps.chunks_allocated, ps.chunks_reused, ps.bytes_received, ps.bytes_copied, ps.bytes_spooled);
 		}
-	}
 
-    // Select the compatible bitmap into the compatible memory DC.
-    SelectObject(hdcMemDC, hbmScreen);
-
-    // Bit block transfer into our compatible memory DC.
-    if (!BitBlt(hdcMemDC,
-        0, 0,
-        rect.right - rect.left, rect.bottom - rect.top,
-        hdcScreen,
-        rect.left, rect.top,
-        SRCCOPY))
-    {
-        MessageBox(hWnd, "BitBlt has failed", "Failed", MB_OK);
-        goto done;
-    }
-
-    // Get the BITMAP from the HBITMAP.
-    GetObject(hbmScreen, sizeof(BITMAP), &bmpScreen);
-
-    BITMAPFILEHEADER   bmfHeader;
-    BITMAPINFOHEADER   bi;
-
-    bi.biSize = sizeof(BITMAPINFOHEADER);
-    bi.biWidth = bmpScreen.bmWidth;
-    bi.biHeight = bmpScreen.bmHeight;
-    bi.biPlanes = 1;
-    bi.biBitCount = 32;
-    bi.biCompression = BI_RGB;
-    bi.biSizeImage = 0;
-    bi.biXPelsPerMeter = 0;
-    bi.biYPelsPerMeter = 0;
-    bi.biClrUsed = 0;
-    bi.biClrImportant = 0;
-
-    dwBmpSize = ((bmpScreen.bmWidth * bi.biBitCount + 31) / 32) * 4 * bmpScreen.bmHeight;
-
-    // Starting with 32-bit Windows, GlobalAlloc and LocalAlloc are implemented as wrapper functions that 
-    // call HeapAlloc using a handle to the process's default heap. Therefore, GlobalAlloc and LocalAlloc 
-    // have greater overhead than HeapAlloc.
-    hDIB = GlobalAlloc(GHND, dwBmpSize);
-    lpbitmap = (char*)GlobalLock(hDIB);
-
-    // Gets the "bits" from the bitmap, and copies them into a buffer 
-    // that's pointed to by lpbitmap.
-    GetDIBits(hdcScreen, hbmScreen, 0,
-        (UINT)bmpScreen.bmHeight,
-        lpbitmap,
-        (BITMAPINFO*)&bi, DIB_RGB_COLORS);
-
-    // A file is created, this is where we will save the screen capture.
-    hFile = CreateFile(filename,
-        GENERIC_WRITE,
-        0,
-        NULL,
-        CREATE_ALWAYS,
-        FILE_ATTRIBUTE_NORMAL, NULL);
-
-    // Add the size of the headers to the size of the bitmap to get the total file size.
-    dwSizeofDIB = dwBmpSize + sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
-
-	bmfHeader.bfReserved1 = 0;
-	bmfHeader.bfReserved2 = 0;
-
-    // Offset to where the actual bitmap bits start.
-    bmfHeader.bfOffBits = (DWORD)sizeof(BITMAPFILEHEADER) + (DWORD)sizeof(BITMAPINFOHEADER);
-
-    // Size of the file.
-    bmfHeader.bfSize = dwSizeofDIB;
-
-    // bfType must always be BM for Bitmaps.
-    bmfHeader.bfType = 0x4D42; // BM.
-
-    WriteFile(hFile, (LPSTR)&bmfHeader, sizeof(BITMAPFILEHEADER), &dwBytesWritten, NULL);
-    WriteFile(hFile, (LPSTR)&bi, sizeof(BITMAPINFOHEADER), &dwBytesWritten, NULL);
-    WriteFile(hFile, (LPSTR)lpbitmap, dwBmpSize, &dwBytesWritten, NULL);
-
-    // Unlock and Free the DIB from the heap.
-    GlobalUnlock(hDIB);
-    GlobalFree(hDIB);
-
-    // Close the handle for the file that was created.
-    CloseHandle(hFile);
-
-    // Clean up.
-done:
-    ReleaseDC(hWnd, hdcScreen);
-}
+		delete print_servers[i];
+	}
+#endif
 
-static void capture_cleanup()
-{
-	DeleteObject(hbmScreen);
-	DeleteObject(hdcMemDC);
+	return 0;
 }
@@ -86,28 +86,324 @@ LINK32=link.exe
 # PROP Default_Filter "cpp;c;cxx;rc;def;r;odl;idl;hpj;bat"
 # Begin Source File
 
+SOURCE=.\AsyncStore.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ChunkPool.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Clock.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Crawler.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Crc32.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\DirectoryStore.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\DummyPrinter.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\DumpConverter.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\EpollPoller.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\FakeWindowEventSource.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\GrayImage.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\JobBoundaryScanner.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Journal.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\LatencyModel.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ListboxModel.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\LockedStore.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\MMVRipper.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\OemTranscoder.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\PackReader.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\PackStore.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Poller.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\PrintServer.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Quarantine.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\SelectPoller.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ShardCoordinator.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\SimulatedViewer.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\SimulatedViewerLauncher.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\SlowStore.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\StupidMessageHandler.cpp
 # End Source File
+# Begin Source File
+
+SOURCE=.\Supervisor.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Threading.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Tracer.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ViewportCapture.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Win32ViewerDriver.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Win32ViewerLauncher.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Win32WindowEventSource.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\WindowEvents.cpp
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
 # PROP Default_Filter "h;hpp;hxx;hm;inl"
 # Begin Source File
 
+SOURCE=.\ArtifactStore.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\AsyncStore.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ChunkPool.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Clock.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Crawler.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Crc32.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\DirectoryStore.hpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\DummyPrinter.hpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\DumpConverter.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\EpollPoller.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\FakeWindowEventSource.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\GrayImage.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\IntTypes.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\JobBoundaryScanner.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Journal.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\LatencyModel.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ListboxModel.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\LockedStore.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\OemTranscoder.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\PackFormat.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\PackReader.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\PackStore.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Poller.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\PrintServer.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Quarantine.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\SelectPoller.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ShardCoordinator.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\SimulatedViewer.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\SimulatedViewerLauncher.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\SlowStore.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Sockets.hpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\StupidMessageHandler.hpp
 # End Source File
+# Begin Source File
+
+SOURCE=.\Supervisor.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Threading.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Tracer.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ViewerDriver.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ViewerLauncher.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\ViewportCapture.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Win32ViewerDriver.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Win32ViewerLauncher.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\Win32WindowEventSource.hpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\WindowEvents.hpp
+# End Source File
 # End Group
 # Begin Group "Resource Files"
 
@@ -0,0 +1,231 @@
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+
+#include "OemTranscoder.hpp"
+
+/* Unicode code points of bytes 0x80 to 0xFF, the bottom half is ASCII. */
+
+static const unsigned short CP437[128] = {
+	0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+	0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+	0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+	0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+	0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+	0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+	0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+	0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+	0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+	0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+	0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+	0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+	0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4,
+	0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+	0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248,
+	0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0,
+};
+
+static const unsigned short CP850[128] = {
+	0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+	0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+	0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+	0x00FF, 0x00D6, 0x00DC, 0x00F8, 0x00A3, 0x00D8, 0x00D7, 0x0192,
+	0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+	0x00BF, 0x00AE, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+	0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x00C1, 0x00C2, 0x00C0,
+	0x00A9, 0x2563, 0x2551, 0x2557, 0x255D, 0x00A2, 0x00A5, 0x2510,
+	0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x00E3, 0x00C3,
+	0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x00A4,
+	0x00F0, 0x00D0, 0x00CA, 0x00CB, 0x00C8, 0x0131, 0x00CD, 0x00CE,
+	0x00CF, 0x2518, 0x250C, 0x2588, 0x2584, 0x00A6, 0x00CC, 0x2580,
+	0x00D3, 0x00DF, 0x00D4, 0x00D2, 0x00F5, 0x00D5, 0x00B5, 0x00FE,
+	0x00DE, 0x00DA, 0x00DB, 0x00D9, 0x00FD, 0x00DD, 0x00AF, 0x00B4,
+	0x00AD, 0x00B1, 0x2017, 0x00BE, 0x00B6, 0x00A7, 0x00F7, 0x00B8,
+	0x00B0, 0x00A8, 0x00B7, 0x00B9, 0x00B3, 0x00B2, 0x25A0, 0x00A0,
+};
+
+/* A 1 in the bottom bit of every byte of a word, and so on. */
+static const size_t LOW_BITS = ~(size_t)(0) / 0xFF;
+static const size_t HIGH_BITS = LOW_BITS * 0x80;
+static const size_t CR_BYTES = LOW_BITS * '\r';
+
+/* Whether any byte of a word (with no high bits set) is a CR. */
+static bool has_cr(size_t word)
+{
+	size_t x = word ^ CR_BYTES;
+	return ((x - LOW_BITS) & ~x & HIGH_BITS) != 0;
+}
+
+OemTranscoder::OemTranscoder(unsigned int codepage):
+	pending_cr(false)
+{
+	assert(supported(codepage));
+
+	const unsigned short *high = codepage == 850 ? CP850 : CP437;
+
+	for(unsigned int b = 0; b < 256; ++b)
+	{
+		unsigned int c = b < 0x80 ? b : high[b - 0x80];
+		char *seq = utf8[b];
+
+		if(c < 0x80)
+		{
+			seq[0] = (char)(c);
+			seq[3] = 1;
+		}
+		else if(c < 0x800)
+		{
+			seq[0] = (char)(0xC0 | (c >> 6));
+			seq[1] = (char)(0x80 | (c & 0x3F));
+			seq[3] = 2;
+		}
+		else{
+			seq[0] = (char)(0xE0 | (c >> 12));
+			seq[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+			seq[2] = (char)(0x80 | (c & 0x3F));
+			seq[3] = 3;
+		}
+	}
+}
+
+bool OemTranscoder::supported(unsigned int codepage)
+{
+	return codepage == 437 || codepage == 850;
+}
+
+void OemTranscoder::convert(const char *data, size_t len, std::string *out)
+{
+	const unsigned char *p = (const unsigned char*)(data);
+	const unsigned char *end = p + len;
+
+	/* Anything outside ASCII gets longer, but there usually isn't much. */
+	out->reserve(out->size() + len);
+
+	if(pending_cr && p < end)
+	{
+		pending_cr = false;
+		out->push_back('\n');
+
+		if(*p == '\n')
+		{
+			++p;
+		}
+	}
+
+	while(p < end)
+	{
+		/* Copy as much plain ASCII (without any CRs) as we can in one go,
+		 * looking at it a word at a time.
+		*/
+
+		const unsigned char *run = p;
+
+		while((size_t)(end - p) >= sizeof(size_t))
+		{
+			size_t word;
+			memcpy(&word, p, sizeof(word));
+
+			if((word & HIGH_BITS) != 0 || has_cr(word))
+			{
+				break;
+			}
+
+			p += sizeof(word);
+		}
+
+		while(p < end && *p < 0x80 && *p != '\r')
+		{
+			++p;
+		}
+
+		out->append((const char*)(run), p - run);
+
+		if(p == end)
+		{
+			break;
+		}
+
+		if(*p == '\r')
+		{
+			if(p + 1 == end)
+			{
+				/* Wait and see if the next piece starts with an LF. */
+				pending_cr = true;
+				break;
+			}
+
+			out->push_back('\n');
+			p += (p[1] == '\n' ? 2 : 1);
+		}
+		else{
+			const char *seq = utf8[*p];
+			out->append(seq, seq[3]);
+
+			++p;
+		}
+	}
+}
+
+void OemTranscoder::finish(std::string *out)
+{
+	if(pending_cr)
+	{
+		out->push_back('\n');
+		pending_cr = false;
+	}
+}
+
+bool OemTranscoder::is_converted(const char *data, size_t len)
+{
+	const unsigned char *p = (const unsigned char*)(data);
+	const unsigned char *end = p + len;
+
+	while(p < end)
+	{
+		if(*p == '\r')
+		{
+			return false;
+		}
+		else if(*p < 0x80)
+		{
+			++p;
+			continue;
+		}
+
+		size_t follow;
+
+		if((*p & 0xE0) == 0xC0)
+		{
+			follow = 1;
+		}
+		else if((*p & 0xF0) == 0xE0)
+		{
+			follow = 2;
+		}
+		else if((*p & 0xF8) == 0xF0)
+		{
+			follow = 3;
+		}
+		else{
+			return false;
+		}
+
+		if((size_t)(end - p) <= follow)
+		{
+			return false;
+		}
+
+		for(size_t i = 1; i <= follow; ++i)
+		{
+			if((p[i] & 0xC0) != 0x80)
+			{
+				return false;
+			}
+		}
+
+		p += follow + 1;
+	}
+
+	return true;
+}
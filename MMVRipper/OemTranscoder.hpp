@@ -0,0 +1,48 @@
+#ifndef MMVRIPPER_OEMTRANSCODER_HPP
+#define MMVRIPPER_OEMTRANSCODER_HPP
+
+#include <stddef.h>
+#include <string>
+
+/* Converts text in an OEM (DOS) codepage, which is what the viewer puts on the
+ * clipboard, to UTF-8 with LF line endings. Both CRLF and a lone CR become LF.
+ *
+ * Each byte is looked up in a table of UTF-8 sequences built for the codepage,
+ * except for runs of plain ASCII, which are found a word at a time and copied
+ * straight through.
+ *
+ * Text can be fed through in pieces (a CRLF split between two pieces still
+ * comes out as one LF), finish() must be called after the last one.
+*/
+class OemTranscoder
+{
+private:
+	/* UTF-8 sequence for each byte, with its length in the last byte. */
+	char utf8[256][4];
+
+	/* The last piece ended with a CR, which might be half of a CRLF. */
+	bool pending_cr;
+
+public:
+	/* codepage must be supported(). */
+	OemTranscoder(unsigned int codepage);
+
+	/* Codepages 437 (US) and 850 (Western European) are supported. */
+	static bool supported(unsigned int codepage);
+
+	/* Appends the UTF-8 of the next len bytes of text to out. */
+	void convert(const char *data, size_t len, std::string *out);
+
+	/* Appends anything held back from the end of the last piece to out, and
+	 * starts again.
+	*/
+	void finish(std::string *out);
+
+	/* Whether text already looks converted: valid UTF-8 without any CRs.
+	 * Text straight from the viewer always has CRLF line endings, and OEM
+	 * text with anything outside ASCII in it is almost never valid UTF-8.
+	*/
+	static bool is_converted(const char *data, size_t len);
+};
+
+#endif /* !MMVRIPPER_OEMTRANSCODER_HPP */
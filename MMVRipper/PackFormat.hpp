@@ -0,0 +1,82 @@
+#ifndef MMVRIPPER_PACKFORMAT_HPP
+#define MMVRIPPER_PACKFORMAT_HPP
+
+#include <string.h>
+
+#include "IntTypes.hpp"
+
+/* Layout of a pack file, which holds every artifact from a crawl.
+ *
+ * The file is a series of records, each one a header followed by the data:
+ *
+ *   char   magic[4]   "MMVR"
+ *   uint32 id         Internal page ID
+ *   char   kind[4]    "txt", "ps", etc, NUL padded
+ *   uint64 length     Length of the data
+ *   uint32 crc        CRC-32 of the data
+ *
+ * Followed by an index of every record, sorted by ID and kind, each entry:
+ *
+ *   uint32 id
+ *   char   kind[4]
+ *   uint64 offset     Offset of the data (not the record header)
+ *   uint64 length
+ *   uint32 crc
+ *
+ * And finally a trailer:
+ *
+ *   uint64 index_offset
+ *   uint32 index_count
+ *   uint32 index_crc  CRC-32 of the index entries
+ *   char   magic[8]   "MMVPACK1"
+ *
+ * Everything is little endian. The index is only written when the pack is
+ * closed, so a pack left by a crash can still be read (and appended to) by
+ * walking the records from the start.
+ *
+ * If the same ID and kind appear more than once, the last one counts.
+*/
+
+#define PACK_RECORD_MAGIC  "MMVR"
+#define PACK_TRAILER_MAGIC "MMVPACK1"
+
+enum
+{
+	PACK_RECORD_HEADER_SIZE = 24,
+	PACK_INDEX_ENTRY_SIZE   = 28,
+	PACK_TRAILER_SIZE       = 24,
+	PACK_KIND_SIZE          = 4
+};
+
+inline void pack_put32(unsigned char *p, unsigned int v)
+{
+	p[0] = (unsigned char)(v);
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+}
+
+inline void pack_put64(unsigned char *p, uint64 v)
+{
+	pack_put32(p, (unsigned int)(v & 0xFFFFFFFF));
+	pack_put32(p + 4, (unsigned int)(v >> 32));
+}
+
+inline unsigned int pack_get32(const unsigned char *p)
+{
+	return (unsigned int)(p[0]) | ((unsigned int)(p[1]) << 8)
+		| ((unsigned int)(p[2]) << 16) | ((unsigned int)(p[3]) << 24);
+}
+
+inline uint64 pack_get64(const unsigned char *p)
+{
+	return (uint64)(pack_get32(p)) | ((uint64)(pack_get32(p + 4)) << 32);
+}
+
+inline void pack_put_kind(unsigned char *p, const char *kind)
+{
+	memset(p, 0, PACK_KIND_SIZE);
+	strncpy((char*)(p), kind, PACK_KIND_SIZE - 1);
+}
+
+#endif /* !MMVRIPPER_PACKFORMAT_HPP */
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Crc32.hpp"
+#include "PackReader.hpp"
+
+static bool entry_less(const PackReader::Entry &a, const PackReader::Entry &b)
+{
+	if(a.id != b.id)
+	{
+		return a.id < b.id;
+	}
+
+	return memcmp(a.kind, b.kind, PACK_KIND_SIZE) < 0;
+}
+
+static bool entry_same(const PackReader::Entry &a, const PackReader::Entry &b)
+{
+	return a.id == b.id && memcmp(a.kind, b.kind, PACK_KIND_SIZE) == 0;
+}
+
+PackReader::PackReader():
+#ifdef _WIN32
+	file(INVALID_HANDLE_VALUE),
+	mapping(NULL),
+#else
+	fd(-1),
+#endif
+	base(NULL),
+	size(0),
+	end_of_records(0),
+	was_recovered(false) {}
+
+PackReader::~PackReader()
+{
+	close();
+}
+
+bool PackReader::open(const char *filename)
+{
+	close();
+
+#ifdef _WIN32
+	file = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	DWORD size_high;
+	DWORD size_low = GetFileSize(file, &size_high);
+
+	size = ((uint64)(size_high) << 32) | size_low;
+
+	if(size > 0)
+	{
+		if(size_high != 0)
+		{
+			/* Too big to map in a 32-bit process. */
+			close();
+			return false;
+		}
+
+		mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(mapping == NULL)
+		{
+			close();
+			return false;
+		}
+
+		base = (const unsigned char*)(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if(base == NULL)
+		{
+			close();
+			return false;
+		}
+	}
+#else
+	fd = ::open(filename, O_RDONLY);
+	if(fd == -1)
+	{
+		return false;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) != 0)
+	{
+		close();
+		return false;
+	}
+
+	size = st.st_size;
+
+	if(size > 0)
+	{
+		void *m = mmap(NULL, (size_t)(size), PROT_READ, MAP_SHARED, fd, 0);
+		if(m == MAP_FAILED)
+		{
+			close();
+			return false;
+		}
+
+		base = (const unsigned char*)(m);
+	}
+#endif
+
+	if(!load_index())
+	{
+		recover();
+	}
+
+	return true;
+}
+
+void PackReader::close()
+{
+#ifdef _WIN32
+	if(base != NULL)
+	{
+		UnmapViewOfFile((void*)(base));
+	}
+
+	if(mapping != NULL)
+	{
+		CloseHandle(mapping);
+		mapping = NULL;
+	}
+
+	if(file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if(base != NULL)
+	{
+		munmap((void*)(base), (size_t)(size));
+	}
+
+	if(fd != -1)
+	{
+		::close(fd);
+		fd = -1;
+	}
+#endif
+
+	base = NULL;
+	size = 0;
+
+	entries.clear();
+	end_of_records = 0;
+	was_recovered = false;
+}
+
+/* Reads the index written when the pack was closed. */
+bool PackReader::load_index()
+{
+	if(size < PACK_TRAILER_SIZE)
+	{
+		return false;
+	}
+
+	const unsigned char *trailer = base + (size_t)(size - PACK_TRAILER_SIZE);
+
+	if(memcmp(trailer + 16, PACK_TRAILER_MAGIC, 8) != 0)
+	{
+		return false;
+	}
+
+	uint64 index_offset = pack_get64(trailer);
+	uint64 index_count  = pack_get32(trailer + 8);
+	unsigned int index_crc = pack_get32(trailer + 12);
+
+	if(index_offset > size - PACK_TRAILER_SIZE
+		|| (size - PACK_TRAILER_SIZE - index_offset) != index_count * PACK_INDEX_ENTRY_SIZE)
+	{
+		return false;
+	}
+
+	const unsigned char *index = base + (size_t)(index_offset);
+
+	if(crc32(0, index, (size_t)(index_count * PACK_INDEX_ENTRY_SIZE)) != index_crc)
+	{
+		return false;
+	}
+
+	entries.resize((size_t)(index_count));
+
+	for(size_t i = 0; i < entries.size(); ++i)
+	{
+		const unsigned char *p = index + (i * PACK_INDEX_ENTRY_SIZE);
+		Entry &e = entries[i];
+
+		e.id = pack_get32(p);
+		memcpy(e.kind, p + 4, PACK_KIND_SIZE);
+		e.kind[PACK_KIND_SIZE - 1] = '\0';
+		e.offset = pack_get64(p + 8);
+		e.length = pack_get64(p + 16);
+		e.crc = pack_get32(p + 24);
+
+		if(e.offset > index_offset || e.length > index_offset - e.offset)
+		{
+			entries.clear();
+			return false;
+		}
+	}
+
+	end_of_records = index_offset;
+
+	return true;
+}
+
+/* Rebuilds the index by walking the records, stopping at the first one which
+ * is incomplete or damaged.
+*/
+void PackReader::recover()
+{
+	entries.clear();
+	was_recovered = true;
+
+	uint64 offset = 0;
+
+	while(size - offset >= PACK_RECORD_HEADER_SIZE)
+	{
+		const unsigned char *header = base + (size_t)(offset);
+
+		if(memcmp(header, PACK_RECORD_MAGIC, 4) != 0)
+		{
+			break;
+		}
+
+		Entry e;
+		e.id = pack_get32(header + 4);
+		memcpy(e.kind, header + 8, PACK_KIND_SIZE);
+		e.kind[PACK_KIND_SIZE - 1] = '\0';
+		e.offset = offset + PACK_RECORD_HEADER_SIZE;
+		e.length = pack_get64(header + 12);
+		e.crc = pack_get32(header + 20);
+
+		if(e.length > size - e.offset || !verify(e))
+		{
+			break;
+		}
+
+		entries.push_back(e);
+		offset = e.offset + e.length;
+	}
+
+	end_of_records = offset;
+
+	/* Sort, keeping only the last record for each ID and kind. */
+
+	std::stable_sort(entries.begin(), entries.end(), &entry_less);
+
+	std::vector<Entry> unique;
+	unique.reserve(entries.size());
+
+	for(size_t i = 0; i < entries.size(); ++i)
+	{
+		if(i + 1 < entries.size() && entry_same(entries[i], entries[i + 1]))
+		{
+			continue;
+		}
+
+		unique.push_back(entries[i]);
+	}
+
+	entries.swap(unique);
+}
+
+const unsigned char *PackReader::find(unsigned int id, const char *kind, size_t *length) const
+{
+	Entry key;
+	key.id = id;
+	memset(key.kind, 0, PACK_KIND_SIZE);
+	strncpy(key.kind, kind, PACK_KIND_SIZE - 1);
+
+	std::vector<Entry>::const_iterator e = std::lower_bound(entries.begin(), entries.end(), key, &entry_less);
+
+	if(e == entries.end() || !entry_same(*e, key))
+	{
+		return NULL;
+	}
+
+	*length = (size_t)(e->length);
+	return data(*e);
+}
+
+bool PackReader::verify(const Entry &entry) const
+{
+	return crc32(0, data(entry), (size_t)(entry.length)) == entry.crc;
+}
@@ -0,0 +1,104 @@
+#ifndef MMVRIPPER_PACKREADER_HPP
+#define MMVRIPPER_PACKREADER_HPP
+
+#include <stddef.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#endif
+
+#include "IntTypes.hpp"
+#include "PackFormat.hpp"
+
+/* Read-only access to a pack file (see PackFormat.hpp), which is mapped into
+ * memory so artifacts can be returned without copying them.
+ *
+ * The whole file is mapped at once, so on 32-bit Windows a pack needs to fit
+ * in the process's address space along with everything else.
+*/
+class PackReader
+{
+public:
+	struct Entry
+	{
+		unsigned int id;
+		char kind[PACK_KIND_SIZE];
+
+		uint64 offset;
+		uint64 length;
+		unsigned int crc;
+	};
+
+private:
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+
+	const unsigned char *base;
+	uint64 size;
+
+	std::vector<Entry> entries;
+	uint64 end_of_records;
+	bool was_recovered;
+
+	bool load_index();
+	void recover();
+
+	/* Not copyable. */
+	PackReader(const PackReader&);
+	PackReader &operator=(const PackReader&);
+
+public:
+	PackReader();
+	~PackReader();
+
+	/* Maps the pack and reads its index, rebuilding it from the records if
+	 * the pack wasn't closed properly. Returns false if the file can't be
+	 * opened or mapped.
+	*/
+	bool open(const char *filename);
+	void close();
+
+	/* True if the index was rebuilt because the pack has no valid trailer. */
+	bool recovered() const
+	{
+		return was_recovered;
+	}
+
+	/* Offset just after the last complete record. */
+	uint64 records_end() const
+	{
+		return end_of_records;
+	}
+
+	/* Entries sorted by ID and kind, one per ID and kind. */
+	size_t count() const
+	{
+		return entries.size();
+	}
+
+	const Entry &entry(size_t idx) const
+	{
+		return entries[idx];
+	}
+
+	/* Returns a pointer to the data of an artifact within the mapping, or NULL
+	 * if the pack doesn't have it. The pointer is valid until close().
+	*/
+	const unsigned char *find(unsigned int id, const char *kind, size_t *length) const;
+
+	const unsigned char *data(const Entry &entry) const
+	{
+		return base + (size_t)(entry.offset);
+	}
+
+	/* Checks an artifact's data against its CRC. */
+	bool verify(const Entry &entry) const;
+};
+
+#endif /* !MMVRIPPER_PACKREADER_HPP */
@@ -0,0 +1,506 @@
+/* Packs can be bigger than a 32-bit off_t. */
+#define _FILE_OFFSET_BITS 64
+
+#include <algorithm>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include "Crc32.hpp"
+#include "PackFormat.hpp"
+#include "PackStore.hpp"
+
+static bool truncate_file(const char *filename, uint64 length)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFile(filename, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LONG high = (LONG)(length >> 32);
+	DWORD low = SetFilePointer(file, (LONG)(length & 0xFFFFFFFF), &high, FILE_BEGIN);
+
+	bool ok = (low != 0xFFFFFFFF || GetLastError() == NO_ERROR) && SetEndOfFile(file);
+
+	CloseHandle(file);
+
+	return ok;
+#else
+	return truncate(filename, (off_t)(length)) == 0;
+#endif
+}
+
+/* Just enough unbuffered file access to read at 64-bit offsets, which stdio
+ * can't do portably (VC6 has no _fseeki64).
+*/
+
+#ifdef _WIN32
+typedef HANDLE RawFile;
+static const RawFile NO_RAW_FILE = INVALID_HANDLE_VALUE;
+#else
+typedef int RawFile;
+static const RawFile NO_RAW_FILE = -1;
+#endif
+
+static RawFile raw_open(const char *filename)
+{
+#ifdef _WIN32
+	return CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+	return open(filename, O_RDONLY);
+#endif
+}
+
+static void raw_close(RawFile file)
+{
+#ifdef _WIN32
+	CloseHandle(file);
+#else
+	close(file);
+#endif
+}
+
+static bool raw_size(RawFile file, uint64 *size)
+{
+#ifdef _WIN32
+	DWORD size_high;
+	DWORD size_low = GetFileSize(file, &size_high);
+
+	if(size_low == 0xFFFFFFFF && GetLastError() != NO_ERROR)
+	{
+		return false;
+	}
+
+	*size = ((uint64)(size_high) << 32) | size_low;
+	return true;
+#else
+	struct stat st;
+	if(fstat(file, &st) != 0)
+	{
+		return false;
+	}
+
+	*size = st.st_size;
+	return true;
+#endif
+}
+
+static bool raw_read(RawFile file, uint64 offset, void *buf, size_t len)
+{
+#ifdef _WIN32
+	LONG high = (LONG)(offset >> 32);
+	DWORD low = SetFilePointer(file, (LONG)(offset & 0xFFFFFFFF), &high, FILE_BEGIN);
+
+	if(low == 0xFFFFFFFF && GetLastError() != NO_ERROR)
+	{
+		return false;
+	}
+
+	DWORD got;
+	return ReadFile(file, buf, len, &got, NULL) && got == len;
+#else
+	return pread(file, buf, len, (off_t)(offset)) == (ssize_t)(len);
+#endif
+}
+
+/* Finds every complete record in a pack by reading each record header in
+ * turn and seeking over its data, up to the index if the pack was closed
+ * properly. PackReader can't be used here, since it maps the whole pack and
+ * a pack can be far bigger than a 32-bit process can map.
+ *
+ * After a crash the walk stops at the first record which is cut short, and
+ * the last record is checked against its CRC in case it was cut short in a
+ * way that doesn't show (like space allocated but never written to).
+*/
+static bool walk_records(RawFile file, std::vector<PackReader::Entry> *records, uint64 *records_end)
+{
+	uint64 size;
+	if(!raw_size(file, &size))
+	{
+		return false;
+	}
+
+	uint64 end = size;
+	bool closed = false;
+
+	unsigned char trailer[PACK_TRAILER_SIZE];
+
+	if(size >= PACK_TRAILER_SIZE
+		&& raw_read(file, size - PACK_TRAILER_SIZE, trailer, PACK_TRAILER_SIZE)
+		&& memcmp(trailer + 16, PACK_TRAILER_MAGIC, 8) == 0
+		&& pack_get64(trailer) <= size - PACK_TRAILER_SIZE)
+	{
+		end = pack_get64(trailer);
+		closed = true;
+	}
+
+	records->clear();
+
+	uint64 offset = 0;
+
+	while(end - offset >= PACK_RECORD_HEADER_SIZE)
+	{
+		unsigned char header[PACK_RECORD_HEADER_SIZE];
+
+		if(!raw_read(file, offset, header, PACK_RECORD_HEADER_SIZE))
+		{
+			return false;
+		}
+
+		if(memcmp(header, PACK_RECORD_MAGIC, 4) != 0)
+		{
+			break;
+		}
+
+		PackReader::Entry e;
+		e.id = pack_get32(header + 4);
+		memcpy(e.kind, header + 8, PACK_KIND_SIZE);
+		e.kind[PACK_KIND_SIZE - 1] = '\0';
+		e.offset = offset + PACK_RECORD_HEADER_SIZE;
+		e.length = pack_get64(header + 12);
+		e.crc = pack_get32(header + 20);
+
+		if(e.length > end - e.offset)
+		{
+			break;
+		}
+
+		records->push_back(e);
+		offset = e.offset + e.length;
+	}
+
+	if(!closed && !records->empty())
+	{
+		const PackReader::Entry &last = records->back();
+
+		std::vector<unsigned char> buf(ChunkPool::CHUNK_SIZE);
+		unsigned int crc = 0;
+
+		for(uint64 done = 0; done < last.length;)
+		{
+			size_t len = (last.length - done) < buf.size() ? (size_t)(last.length - done) : buf.size();
+
+			if(!raw_read(file, last.offset + done, &(buf[0]), len))
+			{
+				return false;
+			}
+
+			crc = crc32(crc, &(buf[0]), len);
+			done += len;
+		}
+
+		if(crc != last.crc)
+		{
+			offset = last.offset - PACK_RECORD_HEADER_SIZE;
+			records->pop_back();
+		}
+	}
+
+	*records_end = offset;
+
+	return true;
+}
+
+static bool entry_less(const PackReader::Entry &a, const PackReader::Entry &b)
+{
+	if(a.id != b.id)
+	{
+		return a.id < b.id;
+	}
+
+	return memcmp(a.kind, b.kind, PACK_KIND_SIZE) < 0;
+}
+
+PackStore::PackStore():
+	file(NULL),
+	offset(0),
+	broken(false) {}
+
+PackStore::~PackStore()
+{
+	close();
+}
+
+bool PackStore::open(const char *filename)
+{
+	this->filename = filename;
+
+	entries.clear();
+	stored.clear();
+	offset = 0;
+	broken = false;
+
+	RawFile existing = raw_open(filename);
+	if(existing != NO_RAW_FILE)
+	{
+		bool ok = walk_records(existing, &entries, &offset);
+		raw_close(existing);
+
+		if(!ok)
+		{
+			return false;
+		}
+
+		for(size_t i = 0; i < entries.size(); ++i)
+		{
+			stored.insert(std::make_pair(entries[i].id, std::string(entries[i].kind)));
+		}
+
+		/* Chop off the old index (or whatever a crash left behind) so new
+		 * records carry on from the last complete one.
+		*/
+		if(!truncate_file(filename, offset))
+		{
+			return false;
+		}
+	}
+
+	file = fopen(filename, "ab");
+	return file != NULL;
+}
+
+bool PackStore::close()
+{
+	if(file == NULL)
+	{
+		return !broken;
+	}
+
+	if(broken)
+	{
+		/* The records may not be where the index would say they are, leave
+		 * it to be rebuilt from the records next time the pack is opened.
+		*/
+		fclose(file);
+		file = NULL;
+
+		return false;
+	}
+
+	/* Index sorted by ID and kind, keeping the last record of each. */
+
+	std::vector<PackReader::Entry> index = entries;
+	std::stable_sort(index.begin(), index.end(), &entry_less);
+
+	std::vector<unsigned char> index_data;
+	index_data.reserve(index.size() * PACK_INDEX_ENTRY_SIZE);
+
+	for(size_t i = 0; i < index.size(); ++i)
+	{
+		if(i + 1 < index.size() && index[i].id == index[i + 1].id
+			&& memcmp(index[i].kind, index[i + 1].kind, PACK_KIND_SIZE) == 0)
+		{
+			continue;
+		}
+
+		unsigned char e[PACK_INDEX_ENTRY_SIZE];
+		pack_put32(e, index[i].id);
+		pack_put_kind(e + 4, index[i].kind);
+		pack_put64(e + 8, index[i].offset);
+		pack_put64(e + 16, index[i].length);
+		pack_put32(e + 24, index[i].crc);
+
+		index_data.insert(index_data.end(), e, e + PACK_INDEX_ENTRY_SIZE);
+	}
+
+	unsigned int index_count = index_data.size() / PACK_INDEX_ENTRY_SIZE;
+
+	unsigned char trailer[PACK_TRAILER_SIZE];
+	pack_put64(trailer, offset);
+	pack_put32(trailer + 8, index_count);
+	pack_put32(trailer + 12, crc32(0, (index_data.empty() ? NULL : &index_data[0]), index_data.size()));
+	memcpy(trailer + 16, PACK_TRAILER_MAGIC, 8);
+
+	bool ok = index_data.empty() || fwrite(&index_data[0], index_data.size(), 1, file) == 1;
+	ok = fwrite(trailer, sizeof(trailer), 1, file) == 1 && ok;
+	ok = fclose(file) == 0 && ok;
+
+	file = NULL;
+
+	return ok;
+}
+
+void PackStore::add_entry(unsigned int id, const char *kind, uint64 length, unsigned int crc)
+{
+	PackReader::Entry e;
+	e.id = id;
+	memset(e.kind, 0, PACK_KIND_SIZE);
+	strncpy(e.kind, kind, PACK_KIND_SIZE - 1);
+	e.offset = offset + PACK_RECORD_HEADER_SIZE;
+	e.length = length;
+	e.crc = crc;
+
+	entries.push_back(e);
+	stored.insert(std::make_pair(id, std::string(e.kind)));
+}
+
+bool PackStore::write_header(unsigned int id, const char *kind, uint64 length, unsigned int crc)
+{
+	unsigned char header[PACK_RECORD_HEADER_SIZE];
+	memcpy(header, PACK_RECORD_MAGIC, 4);
+	pack_put32(header + 4, id);
+	pack_put_kind(header + 8, kind);
+	pack_put64(header + 12, length);
+	pack_put32(header + 20, crc);
+
+	return fwrite(header, sizeof(header), 1, file) == 1;
+}
+
+/* Throws away whatever part of a record made it out before a write failed,
+ * so the next record goes where the index will say it is. If that fails too,
+ * no more records are written and the pack is closed without an index.
+*/
+void PackStore::rollback()
+{
+	fclose(file);
+	file = NULL;
+
+	if(truncate_file(filename.c_str(), offset))
+	{
+		file = fopen(filename.c_str(), "ab");
+	}
+
+	if(file == NULL)
+	{
+		fprintf(stderr, "Unable to undo a failed write to %s, no more will be added to it\n", filename.c_str());
+		broken = true;
+	}
+}
+
+bool PackStore::exists(unsigned int id, const char *kind)
+{
+	return stored.find(std::make_pair(id, std::string(kind))) != stored.end();
+}
+
+bool PackStore::write(unsigned int id, const char *kind, const void *data, size_t len)
+{
+	if(file == NULL)
+	{
+		return false;
+	}
+
+	unsigned int crc = crc32(0, data, len);
+
+	bool ok = write_header(id, kind, len, crc)
+		&& (len == 0 || fwrite(data, len, 1, file) == 1)
+		&& fflush(file) == 0;
+
+	if(!ok)
+	{
+		rollback();
+		return false;
+	}
+
+	add_entry(id, kind, len, crc);
+	offset += PACK_RECORD_HEADER_SIZE + len;
+
+	return true;
+}
+
+bool PackStore::write(unsigned int id, const char *kind, PrintJob &job)
+{
+	if(file == NULL)
+	{
+		job.clear();
+		return false;
+	}
+
+	uint64 length = job.size();
+	unsigned int crc = 0;
+	bool ok;
+
+	if(job.is_spooled())
+	{
+		/* Read through the spool file once for the CRC and again to copy
+		 * it, the second time should come from the cache.
+		*/
+
+		FILE *spool = fopen(job.spool_filename(), "rb");
+		if(spool == NULL)
+		{
+			job.clear();
+			return false;
+		}
+
+		unsigned char buf[ChunkPool::CHUNK_SIZE];
+		size_t r;
+		uint64 spool_length = 0;
+
+		while((r = fread(buf, 1, sizeof(buf), spool)) > 0)
+		{
+			crc = crc32(crc, buf, r);
+			spool_length += r;
+		}
+
+		if(spool_length != length)
+		{
+			/* Don't start a record we already know can't be finished. */
+			fclose(spool);
+			job.clear();
+
+			return false;
+		}
+
+		rewind(spool);
+
+		ok = write_header(id, kind, length, crc);
+
+		uint64 copied = 0;
+		while(ok && (r = fread(buf, 1, sizeof(buf), spool)) > 0)
+		{
+			ok = fwrite(buf, r, 1, file) == 1;
+			copied += r;
+		}
+
+		ok = ok && copied == length;
+
+		fclose(spool);
+	}
+	else{
+		size_t i, len;
+
+		for(i = 0; i < job.chunk_count(); ++i)
+		{
+			const unsigned char *data = job.chunk(i, &len);
+			crc = crc32(crc, data, len);
+		}
+
+		ok = write_header(id, kind, length, crc);
+
+		for(i = 0; ok && i < job.chunk_count(); ++i)
+		{
+			const unsigned char *data = job.chunk(i, &len);
+			ok = fwrite(data, len, 1, file) == 1;
+		}
+	}
+
+	job.clear();
+
+	ok = ok && fflush(file) == 0;
+
+	if(!ok)
+	{
+		rollback();
+		return false;
+	}
+
+	add_entry(id, kind, length, crc);
+	offset += PACK_RECORD_HEADER_SIZE + length;
+
+	return true;
+}
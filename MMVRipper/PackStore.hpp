@@ -0,0 +1,62 @@
+#ifndef MMVRIPPER_PACKSTORE_HPP
+#define MMVRIPPER_PACKSTORE_HPP
+
+#include <set>
+#include <stdio.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ArtifactStore.hpp"
+#include "IntTypes.hpp"
+#include "PackReader.hpp"
+
+/* Appends every artifact to a single pack file (see PackFormat.hpp) instead
+ * of writing thousands of little files.
+ *
+ * Opening an existing pack carries on adding to it. If it wasn't closed
+ * properly, anything after the last complete record is thrown away first.
+ *
+ * A record which fails to write is cut back off the end of the pack, so
+ * the index written by close() always matches the records.
+*/
+class PackStore: public ArtifactStore
+{
+private:
+	std::string filename;
+	FILE *file;
+	uint64 offset;
+
+	/* A failed record couldn't be cut off again. */
+	bool broken;
+
+	/* Every record in the pack, in the order they were written. */
+	std::vector<PackReader::Entry> entries;
+	std::set< std::pair<unsigned int, std::string> > stored;
+
+	bool write_header(unsigned int id, const char *kind, uint64 length, unsigned int crc);
+	void add_entry(unsigned int id, const char *kind, uint64 length, unsigned int crc);
+	void rollback();
+
+	/* Not copyable. */
+	PackStore(const PackStore&);
+	PackStore &operator=(const PackStore&);
+
+public:
+	PackStore();
+	~PackStore();
+
+	bool open(const char *filename);
+
+	/* Writes the index and closes the pack. Returns false without writing
+	 * the index if a failed write couldn't be undone.
+	*/
+	bool close();
+
+	virtual bool exists(unsigned int id, const char *kind);
+
+	virtual bool write(unsigned int id, const char *kind, const void *data, size_t len);
+	virtual bool write(unsigned int id, const char *kind, PrintJob &job);
+};
+
+#endif /* !MMVRIPPER_PACKSTORE_HPP */
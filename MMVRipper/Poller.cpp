@@ -0,0 +1,16 @@
+#include "Poller.hpp"
+
+#ifdef __linux__
+#include "EpollPoller.hpp"
+#else
+#include "SelectPoller.hpp"
+#endif
+
+Poller *Poller::create()
+{
+#ifdef __linux__
+	return new EpollPoller();
+#else
+	return new SelectPoller();
+#endif
+}
@@ -0,0 +1,31 @@
+#ifndef MMVRIPPER_POLLER_HPP
+#define MMVRIPPER_POLLER_HPP
+
+#include <vector>
+
+#include "Sockets.hpp"
+
+/* Socket readiness backend used by PrintServer. */
+class Poller
+{
+public:
+	virtual ~Poller() {}
+
+	/* Start/stop watching a socket for readability. add() returns false if
+	 * the socket can't be watched (the backend is full), in which case the
+	 * caller should close it.
+	*/
+	virtual bool add(SOCKET sock) = 0;
+	virtual void remove(SOCKET sock) = 0;
+
+	/* Blocks until at least one watched socket is readable and replaces the
+	 * contents of ready with the readable sockets. There is no timeout, the
+	 * caller should watch a socket it can poke if it needs waking up.
+	*/
+	virtual void wait(std::vector<SOCKET> *ready) = 0;
+
+	/* Returns a new instance of the best backend for the host platform. */
+	static Poller *create();
+};
+
+#endif /* !MMVRIPPER_POLLER_HPP */
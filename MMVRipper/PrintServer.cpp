@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "PrintServer.hpp"
+
+PrintServer::PrintServer(unsigned short port, Listener *listener, ChunkPool *pool):
+	listener(listener),
+	pool(pool),
+	running(true),
+	spool_max_buffered(0),
+	spool_seq(0),
+	connections_accepted(0)
+{
+#ifdef _WIN32
+	WSADATA wsdata;
+	int status = WSAStartup(MAKEWORD(2, 0), &wsdata);
+	if(status != 0)
+	{
+		abort();
+	}
+#endif
+
+	server_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if(server_socket == INVALID_SOCKET)
+	{
+		abort();
+	}
+
+	struct sockaddr_in bind_addr;
+	memset(&bind_addr, 0, sizeof(bind_addr));
+	bind_addr.sin_family = AF_INET;
+	bind_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	bind_addr.sin_port = htons(port);
+
+	if(bind(server_socket, (struct sockaddr*)(&bind_addr), sizeof(bind_addr)) != 0)
+	{
+		abort();
+	}
+
+	if(listen(server_socket, SOMAXCONN) != 0)
+	{
+		abort();
+	}
+
+	/* Non-blocking so accept_clients() can drain the whole backlog. */
+	if(!socket_set_nonblocking(server_socket))
+	{
+		abort();
+	}
+
+	wake_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(wake_socket == INVALID_SOCKET)
+	{
+		abort();
+	}
+
+	struct sockaddr_in wake_addr;
+	memset(&wake_addr, 0, sizeof(wake_addr));
+	wake_addr.sin_family = AF_INET;
+	wake_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	wake_addr.sin_port = 0;
+
+	socklen_t wake_addr_len = sizeof(wake_addr);
+
+	if(bind(wake_socket, (struct sockaddr*)(&wake_addr), sizeof(wake_addr)) != 0
+		|| getsockname(wake_socket, (struct sockaddr*)(&wake_addr), &wake_addr_len) != 0
+		|| connect(wake_socket, (struct sockaddr*)(&wake_addr), sizeof(wake_addr)) != 0)
+	{
+		abort();
+	}
+
+	poller = Poller::create();
+
+	if(!poller->add(server_socket) || !poller->add(wake_socket))
+	{
+		abort();
+	}
+}
+
+PrintServer::~PrintServer()
+{
+	while(!pending_jobs.empty())
+	{
+		close_client(pending_jobs.begin());
+	}
+
+	delete poller;
+
+	closesocket(wake_socket);
+	closesocket(server_socket);
+}
+
+unsigned short PrintServer::get_port() const
+{
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+
+	if(getsockname(server_socket, (struct sockaddr*)(&addr), &addr_len) != 0)
+	{
+		return 0;
+	}
+
+	return ntohs(addr.sin_port);
+}
+
+void PrintServer::spool_to_disk(const char *dir, size_t max_buffered)
+{
+	spool_dir = dir;
+	spool_max_buffered = max_buffered;
+}
+
+void PrintServer::run()
+{
+	std::vector<SOCKET> ready;
+
+	while(running)
+	{
+		poller->wait(&ready);
+
+		for(size_t i = 0; i < ready.size(); ++i)
+		{
+			if(ready[i] == server_socket)
+			{
+				accept_clients();
+			}
+			else if(ready[i] == wake_socket)
+			{
+				char c;
+				recv(wake_socket, &c, 1, 0);
+			}
+			else{
+				read_client(ready[i]);
+			}
+		}
+	}
+}
+
+void PrintServer::stop()
+{
+	running = false;
+
+	char c = 0;
+	send(wake_socket, &c, 1, 0);
+}
+
+PrintJob *PrintServer::new_job()
+{
+	PrintJob *job = new PrintJob(pool);
+
+	if(!spool_dir.empty())
+	{
+		char spool_name[64];
+		sprintf(spool_name, "/spool%u.tmp", ++spool_seq);
+
+		if(!job->spool_to((spool_dir + spool_name).c_str(), spool_max_buffered))
+		{
+			fprintf(stderr, "Unable to create spool file in %s\n", spool_dir.c_str());
+		}
+	}
+
+	return job;
+}
+
+void PrintServer::accept_clients()
+{
+	while(true)
+	{
+		SOCKET client_sock = accept(server_socket, NULL, NULL);
+		if(client_sock == INVALID_SOCKET)
+		{
+			break;
+		}
+
+		if(!poller->add(client_sock))
+		{
+			fprintf(stderr, "Dropping print connection, too many open at once\n");
+			closesocket(client_sock);
+
+			continue;
+		}
+
+		Connection *conn = new Connection;
+		conn->number = ++connections_accepted;
+		conn->job = new_job();
+		conn->jobs_completed = 0;
+
+		pending_jobs.insert(std::make_pair(client_sock, conn));
+	}
+}
+
+void PrintServer::read_client(SOCKET sock)
+{
+	pj_iterator pj = pending_jobs.find(sock);
+	if(pj == pending_jobs.end())
+	{
+		/* Closed earlier in this batch of events. */
+		return;
+	}
+
+	Connection *conn = pj->second;
+
+	/* Read directly into the free space at the end of the job. */
+	size_t space;
+	unsigned char *dest = conn->job->append_space(&space);
+
+	int r = recv(pj->first, (char*)(dest), space, 0);
+	if(r < 0)
+	{
+		if(!socket_would_block())
+		{
+			/* Read error. Abort the connection. */
+			close_client(pj);
+		}
+	}
+	else if(r == 0)
+	{
+		/* Remote end closed down the connection. Whatever is left is only a
+		 * job in its own right if it has a header - otherwise it is just the
+		 * PJL/whitespace trailing the last one. If we never found a boundary
+		 * it isn't PostScript we understand and goes out as a single job.
+		*/
+
+		if(conn->scanner.seen_header() || conn->jobs_completed == 0)
+		{
+			complete_job(conn, false);
+		}
+
+		close_client(pj);
+	}
+	else{
+		/* Got some data. */
+
+		pool->count_received(r);
+		received(conn, dest, r);
+	}
+}
+
+/* Handles len bytes which have been written to the free space at the end of
+ * the connection's current job, but not yet committed to it.
+*/
+void PrintServer::received(Connection *conn, unsigned char *data, size_t len)
+{
+	size_t end = conn->scanner.scan(data, len);
+
+	if(end == JobBoundaryScanner::NO_BOUNDARY)
+	{
+		conn->job->commit(len);
+		return;
+	}
+
+	conn->job->commit(end);
+
+	/* Anything after the boundary belongs to the next job. It has to be
+	 * copied out first since the memory belongs to the job being handed
+	 * over, then goes through here again in case it holds more boundaries.
+	*/
+
+	std::vector<unsigned char> tail(data + end, data + len);
+
+	complete_job(conn, true);
+
+	for(size_t done = 0; done < tail.size();)
+	{
+		size_t space;
+		unsigned char *dest = conn->job->append_space(&space);
+
+		size_t n = (tail.size() - done) < space ? (tail.size() - done) : space;
+
+		memcpy(dest, &(tail[done]), n);
+		pool->count_copied(n);
+
+		received(conn, dest, n);
+		done += n;
+	}
+}
+
+void PrintServer::complete_job(Connection *conn, bool start_next)
+{
+	if(conn->job->is_spooled() && !conn->job->finish_spool())
+	{
+		fprintf(stderr, "Error writing print job to spool file\n");
+	}
+
+	listener->print_job_completed(*(conn->job), conn->number);
+	++(conn->jobs_completed);
+
+	delete conn->job;
+	conn->job = start_next ? new_job() : NULL;
+}
+
+void PrintServer::close_client(pj_iterator pj)
+{
+	poller->remove(pj->first);
+	closesocket(pj->first);
+
+	listener->connection_closed(pj->second->number, pj->second->jobs_completed);
+
+	delete pj->second->job;
+	delete pj->second;
+
+	pending_jobs.erase(pj);
+}
@@ -0,0 +1,102 @@
+#ifndef MMVRIPPER_PRINTSERVER_HPP
+#define MMVRIPPER_PRINTSERVER_HPP
+
+#include <map>
+#include <string>
+
+#include "ChunkPool.hpp"
+#include "JobBoundaryScanner.hpp"
+#include "Poller.hpp"
+#include "Sockets.hpp"
+
+/* Platform-neutral core of the emulated raw (port 9100 style) network
+ * printer. Each connection is read straight into a PrintJob made from pooled
+ * chunks and handed over to the Listener as soon as the end of the job is
+ * seen in the stream, so one connection may carry any number of jobs.
+ *
+ * The server doesn't own a thread, the caller should run() it on one and call
+ * stop() from elsewhere to make run() return.
+*/
+class PrintServer
+{
+public:
+	class Listener
+	{
+	public:
+		virtual ~Listener() {}
+
+		/* Called on the thread running the server each time a print job has
+		 * been fully received. The listener should swap() the job out if it
+		 * wants to keep it. Connections are numbered from one in the order
+		 * they were accepted.
+		*/
+		virtual void print_job_completed(PrintJob &job, unsigned int connection) = 0;
+
+		/* Called with the number of a connection and how many jobs it carried
+		 * once it has closed.
+		*/
+		virtual void connection_closed(unsigned int, unsigned int) {}
+	};
+
+private:
+	Listener *listener;
+	ChunkPool *pool;
+
+	volatile bool running;
+
+	SOCKET server_socket;
+
+	/* UDP socket connected to itself, stop() sends a datagram to it to break
+	 * the poller out of its wait.
+	*/
+	SOCKET wake_socket;
+
+	Poller *poller;
+
+	std::string spool_dir;
+	size_t spool_max_buffered;
+	unsigned int spool_seq;
+
+	unsigned int connections_accepted;
+
+	struct Connection
+	{
+		unsigned int number;
+		PrintJob *job;
+		JobBoundaryScanner scanner;
+
+		unsigned int jobs_completed;
+	};
+
+	std::map<SOCKET, Connection*> pending_jobs;
+	typedef std::map<SOCKET, Connection*>::iterator pj_iterator;
+
+	PrintJob *new_job();
+
+	void accept_clients();
+	void read_client(SOCKET sock);
+	void received(Connection *conn, unsigned char *data, size_t len);
+	void complete_job(Connection *conn, bool start_next);
+	void close_client(pj_iterator pj);
+
+public:
+	/* Listens on port on the loopback interface, or on any free port if
+	 * port is zero.
+	*/
+	PrintServer(unsigned short port, Listener *listener, ChunkPool *pool);
+	~PrintServer();
+
+	/* The port being listened on. */
+	unsigned short get_port() const;
+
+	/* Spool every job received from now on to a temporary file in dir,
+	 * holding no more than max_buffered bytes of each in memory. Must be
+	 * called before run().
+	*/
+	void spool_to_disk(const char *dir, size_t max_buffered);
+
+	void run();
+	void stop();
+};
+
+#endif /* !MMVRIPPER_PRINTSERVER_HPP */
@@ -0,0 +1,70 @@
+#include <errno.h>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "Quarantine.hpp"
+
+bool Quarantine::open(const char *filename)
+{
+	MutexLock l(lock);
+
+	this->filename = filename;
+	ids.clear();
+
+	FILE *f = fopen(filename, "r");
+	if(f == NULL)
+	{
+		return errno == ENOENT;
+	}
+
+	char line[256];
+
+	while(fgets(line, sizeof(line), f) != NULL)
+	{
+		char *end;
+		unsigned long id = strtoul(line, &end, 10);
+
+		if(end != line)
+		{
+			ids.insert((unsigned int)(id));
+		}
+	}
+
+	fclose(f);
+
+	return true;
+}
+
+bool Quarantine::contains(unsigned int id)
+{
+	MutexLock l(lock);
+	return ids.find(id) != ids.end();
+}
+
+void Quarantine::add(unsigned int id, const char *why)
+{
+	MutexLock l(lock);
+
+	if(!ids.insert(id).second || filename.empty())
+	{
+		return;
+	}
+
+	FILE *f = fopen(filename.c_str(), "a");
+	if(f == NULL)
+	{
+		fprintf(stderr, "Unable to add page %u to %s\n", id, filename.c_str());
+		return;
+	}
+
+	fprintf(f, "%u  # %s\n", id, why);
+	fclose(f);
+}
+
+size_t Quarantine::size()
+{
+	MutexLock l(lock);
+	return ids.size();
+}
@@ -0,0 +1,45 @@
+#ifndef MMVRIPPER_QUARANTINE_HPP
+#define MMVRIPPER_QUARANTINE_HPP
+
+#include <set>
+#include <stdio.h>
+#include <string>
+
+#include "Threading.hpp"
+
+/* Pages which crash or hang the viewer when they are opened, so the crawler
+ * doesn't try to get the text or a printout of them.
+ *
+ * The list is kept in a file with one page ID per line (anything after a #
+ * is a comment), which pages are added to as they are found so later runs
+ * skip them too. Pages can be taken out again by editing it.
+*/
+class Quarantine
+{
+private:
+	Mutex lock;
+
+	std::string filename;
+	std::set<unsigned int> ids;
+
+	/* Not copyable. */
+	Quarantine(const Quarantine&);
+	Quarantine &operator=(const Quarantine&);
+
+public:
+	Quarantine() {}
+
+	/* Reads the file, if there is one. Pages added later are appended to it.
+	 * Returns false if it exists but can't be read.
+	*/
+	bool open(const char *filename);
+
+	bool contains(unsigned int id);
+
+	/* Adds a page and appends it to the file, with why as a comment. */
+	void add(unsigned int id, const char *why);
+
+	size_t size();
+};
+
+#endif /* !MMVRIPPER_QUARANTINE_HPP */
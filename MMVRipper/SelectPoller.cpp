@@ -0,0 +1,82 @@
+/* Winsock's fd_set is an array of handles rather than a bitmap, so we can
+ * raise the 64 socket default as long as it happens before winsock2.h.
+*/
+#ifdef _WIN32
+#define FD_SETSIZE 1024
+#endif
+
+#include <stdio.h>
+#include <vector>
+
+#include "SelectPoller.hpp"
+
+bool SelectPoller::add(SOCKET sock)
+{
+	/* A Winsock fd_set holds up to FD_SETSIZE handles, a BSD one holds
+	 * descriptors numbered below FD_SETSIZE. FD_SET() doesn't check either.
+	*/
+#ifdef _WIN32
+	bool full = sockets.size() >= FD_SETSIZE;
+#else
+	bool full = sock >= FD_SETSIZE;
+#endif
+
+	if(full)
+	{
+		fprintf(stderr, "Too many sockets for select() (FD_SETSIZE is %d)\n", (int)(FD_SETSIZE));
+		return false;
+	}
+
+	sockets.push_back(sock);
+	return true;
+}
+
+void SelectPoller::remove(SOCKET sock)
+{
+	std::vector<SOCKET>::iterator s;
+	for(s = sockets.begin(); s != sockets.end(); ++s)
+	{
+		if(*s == sock)
+		{
+			*s = sockets.back();
+			sockets.pop_back();
+
+			break;
+		}
+	}
+}
+
+void SelectPoller::wait(std::vector<SOCKET> *ready)
+{
+	ready->clear();
+
+	fd_set read_fds;
+	FD_ZERO(&read_fds);
+
+	SOCKET maxfd = 0;
+
+	size_t i;
+	for(i = 0; i < sockets.size(); ++i)
+	{
+		FD_SET(sockets[i], &read_fds);
+
+		if(sockets[i] > maxfd)
+		{
+			maxfd = sockets[i];
+		}
+	}
+
+	/* No timeout - PrintServer wakes us with its wake socket when needed. */
+	int s = select((maxfd + 1), &read_fds, NULL, NULL, NULL);
+
+	if(s > 0)
+	{
+		for(i = 0; i < sockets.size(); ++i)
+		{
+			if(FD_ISSET(sockets[i], &read_fds))
+			{
+				ready->push_back(sockets[i]);
+			}
+		}
+	}
+}
@@ -0,0 +1,23 @@
+#ifndef MMVRIPPER_SELECTPOLLER_HPP
+#define MMVRIPPER_SELECTPOLLER_HPP
+
+#include <vector>
+
+#include "Poller.hpp"
+
+/* Poller backend using plain select(), for Winsock and anything else which
+ * doesn't have a better interface.
+*/
+class SelectPoller: public Poller
+{
+private:
+	std::vector<SOCKET> sockets;
+
+public:
+	virtual bool add(SOCKET sock);
+	virtual void remove(SOCKET sock);
+
+	virtual void wait(std::vector<SOCKET> *ready);
+};
+
+#endif /* !MMVRIPPER_SELECTPOLLER_HPP */
@@ -0,0 +1,470 @@
+#include <assert.h>
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Clock.hpp"
+#include "Crawler.hpp"
+#include "ShardCoordinator.hpp"
+
+/* Groups this deep or deeper aren't offered up to be stolen, the thief would
+ * spend longer expanding its way down to them than they take to crawl.
+*/
+static const size_t MAX_STEAL_DEPTH = 2;
+
+/* Entries taken at a time in a pass. */
+static const size_t PASS_CHUNK = 32;
+
+ShardCoordinator::ShardCoordinator(const CrawlOptions &options, Tracer *tracer):
+	options(options),
+	tracer(tracer),
+	quarantine(NULL),
+	out(NULL),
+	idle(0),
+	finished(false),
+	merged(false),
+	arrived(0),
+	generation(0),
+	current_pass(-1),
+	pass_next(0),
+	pass_done(0),
+	pass_start_us(0),
+	entries_done(0),
+	entries_known(0)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+ShardCoordinator::~ShardCoordinator()
+{
+	for(size_t i = 0; i < workers.size(); ++i)
+	{
+		delete workers[i];
+	}
+}
+
+void ShardCoordinator::add_worker(ViewerDriver *viewer, ArtifactStore *store, Supervisor *supervisor)
+{
+	workers.push_back(new Worker(this, workers.size(), viewer, store, supervisor));
+}
+
+bool ShardCoordinator::run(FILE *out)
+{
+	if(options.journal != NULL && !journal.open(options.journal))
+	{
+		return false;
+	}
+
+	this->out = out;
+
+	for(size_t i = 0; i < workers.size(); ++i)
+	{
+		bool started = workers[i]->start();
+		assert(started);
+	}
+
+	for(size_t i = 0; i < workers.size(); ++i)
+	{
+		workers[i]->join();
+	}
+
+	finish_pass();
+
+	return true;
+}
+
+void ShardCoordinator::worker_main(unsigned int index, ViewerDriver *viewer, ArtifactStore *store, Supervisor *supervisor)
+{
+	CrawlOptions worker_options = options;
+
+	if(index > 0)
+	{
+		/* Only one of them gets to write to each file. */
+		worker_options.message_log = NULL;
+		worker_options.latency_file = NULL;
+	}
+
+	Crawler crawler(viewer, store, worker_options);
+	crawler.set_tracer(tracer);
+	crawler.set_supervisor(supervisor);
+	crawler.set_quarantine(quarantine);
+
+	crawler.reset_listbox_state();
+	crawler.run_shard(this, &journal, index == 0);
+}
+
+/* Adds the entry id under the groups in path to entries. */
+void ShardCoordinator::add_entry(const Path &path, unsigned int id)
+{
+	Path entry_path = path;
+	entry_path.push_back(id);
+
+	std::map<Path, std::vector<unsigned int> >::const_iterator r = replayed.find(entry_path);
+
+	entries.push_back(IndexEntry());
+
+	IndexEntry &e = entries.back();
+	e.parents = path;
+	e.id = id;
+
+	/* Only groups get walked, and only groups have children in the
+	 * journal.
+	*/
+	e.group = walked.find(entry_path) != walked.end() || (r != replayed.end() && !r->second.empty());
+}
+
+/* Prints the entries under path the way Crawler::walk() and replay() would
+ * have, seen being everything they would have seen so far.
+*/
+void ShardCoordinator::merge(FILE *out, Path &path, int depth, std::set<unsigned int> &seen)
+{
+	std::map<Path, std::vector<unsigned int> >::const_iterator w = walked.find(path);
+	std::map<Path, std::vector<unsigned int> >::const_iterator r = replayed.find(path);
+
+	std::string indent(depth * 2, ' ');
+
+	if(w != walked.end())
+	{
+		/* walk() takes the children up to the first one already seen, then
+		 * visits them.
+		*/
+
+		std::vector<unsigned int> children;
+
+		for(size_t i = 0; i < w->second.size() && seen.find(w->second[i]) == seen.end(); ++i)
+		{
+			seen.insert(w->second[i]);
+			children.push_back(w->second[i]);
+		}
+
+		for(size_t i = 0; i < children.size(); ++i)
+		{
+			fprintf(out, "%s%u\n", indent.c_str(), children[i]);
+
+			if(options.num_passes > 0)
+			{
+				add_entry(path, children[i]);
+			}
+
+			path.push_back(children[i]);
+			merge(out, path, depth + 1, seen);
+			path.pop_back();
+		}
+	}
+	else if(r != replayed.end())
+	{
+		/* replay() goes through every child not seen so far. */
+
+		for(size_t i = 0; i < r->second.size(); ++i)
+		{
+			if(seen.find(r->second[i]) == seen.end())
+			{
+				seen.insert(r->second[i]);
+
+				fprintf(out, "%s%u\n", indent.c_str(), r->second[i]);
+
+				if(options.num_passes > 0)
+				{
+					add_entry(path, r->second[i]);
+				}
+
+				path.push_back(r->second[i]);
+				merge(out, path, depth + 1, seen);
+				path.pop_back();
+			}
+		}
+	}
+	else if(!path.empty() && printed.find(path.back()) != printed.end())
+	{
+		fprintf(out, "Printed page %u\n", path.back());
+	}
+}
+
+int ShardCoordinator::add_group(const std::vector<unsigned int> &path, const std::vector<unsigned int> &items)
+{
+	if(path.size() >= MAX_STEAL_DEPTH || items.empty())
+	{
+		return -1;
+	}
+
+	Group g;
+	g.path = path;
+	g.items = items;
+	g.front = 0;
+	g.back = items.size();
+
+	int group;
+
+	{
+		MutexLock l(lock);
+
+		groups.push_back(g);
+		group = groups.size() - 1;
+
+		++(stats.groups);
+	}
+
+	work.post();
+
+	return group;
+}
+
+bool ShardCoordinator::claim(int group, size_t item)
+{
+	MutexLock l(lock);
+
+	Group &g = groups[group];
+
+	if(item >= g.back)
+	{
+		return false;
+	}
+
+	g.front = item + 1;
+	return true;
+}
+
+bool ShardCoordinator::steal(std::vector<unsigned int> *path, unsigned int *id)
+{
+	lock.lock();
+	++idle;
+
+	while(!finished)
+	{
+		Group *best = NULL;
+
+		for(size_t i = 0; i < groups.size(); ++i)
+		{
+			Group &g = groups[i];
+
+			if(g.front < g.back && (best == NULL || g.path.size() < best->path.size()))
+			{
+				best = &g;
+			}
+		}
+
+		if(best != NULL)
+		{
+			--(best->back);
+
+			*path = best->path;
+			*id = best->items[best->back];
+
+			--idle;
+			++(stats.steals);
+
+			lock.unlock();
+			return true;
+		}
+
+		if(idle == workers.size())
+		{
+			/* Nobody is left to find any more work, wake everyone up to
+			 * tell them.
+			*/
+
+			finished = true;
+
+			for(size_t i = 0; i < workers.size(); ++i)
+			{
+				work.post();
+			}
+
+			break;
+		}
+
+		lock.unlock();
+		work.wait();
+		lock.lock();
+	}
+
+	lock.unlock();
+	return false;
+}
+
+void ShardCoordinator::leave()
+{
+	MutexLock l(lock);
+
+	if(++idle == workers.size())
+	{
+		finished = true;
+
+		for(size_t i = 0; i < workers.size(); ++i)
+		{
+			work.post();
+		}
+	}
+}
+
+void ShardCoordinator::record_walked(const std::vector<unsigned int> &path, const std::vector<unsigned int> &children)
+{
+	MutexLock l(lock);
+
+	walked[path] = children;
+	entries_known += children.size();
+}
+
+void ShardCoordinator::record_replayed(const std::vector<unsigned int> &path, const std::vector<unsigned int> &children)
+{
+	MutexLock l(lock);
+	replayed[path] = children;
+}
+
+void ShardCoordinator::record_printed(unsigned int id)
+{
+	MutexLock l(lock);
+
+	if(merged)
+	{
+		/* Printed in a pass, after the tree. */
+		fprintf(out, "Printed page %u\n", id);
+	}
+	else{
+		printed.insert(id);
+	}
+}
+
+bool ShardCoordinator::arrive()
+{
+	lock.lock();
+
+	if(++arrived == workers.size())
+	{
+		arrived = 0;
+
+		lock.unlock();
+		return true;
+	}
+
+	/* Alternate between the gates, so someone running ahead to the next
+	 * rendezvous can't take the place of someone still leaving this one.
+	*/
+	Semaphore &gate = gates[generation % 2];
+
+	lock.unlock();
+	gate.wait();
+
+	return false;
+}
+
+void ShardCoordinator::release()
+{
+	MutexLock l(lock);
+
+	Semaphore &gate = gates[generation % 2];
+	++generation;
+
+	for(size_t i = 1; i < workers.size(); ++i)
+	{
+		gate.post();
+	}
+}
+
+void ShardCoordinator::merge_tree()
+{
+	Path path;
+	std::set<unsigned int> seen;
+
+	merge(out, path, 0, seen);
+
+	/* The tree is all there now, so whatever reads it can get going. */
+	fflush(out);
+
+	if(options.num_passes > 0)
+	{
+		fprintf(stderr, "Walked the index, found %u entries\n", (unsigned)(entries.size()));
+	}
+
+	MutexLock l(lock);
+	merged = true;
+}
+
+void ShardCoordinator::start_pass(ContentPass pass, const std::vector<IndexEntry> &needed)
+{
+	finish_pass();
+
+	MutexLock l(lock);
+
+	current_pass = pass;
+	pass_entries = needed;
+	pass_next = 0;
+	pass_done = 0;
+	pass_start_us = clock_us();
+
+	if(tracer != NULL)
+	{
+		tracer->set_stage(content_pass_name(pass));
+	}
+}
+
+/* Says how the current pass went, if there is one. Everyone must be done with
+ * it.
+*/
+void ShardCoordinator::finish_pass()
+{
+	if(current_pass < 0)
+	{
+		return;
+	}
+
+	fprintf(stderr, "Finished the %s pass over %u entries in %.1f s\n",
+		content_pass_name((ContentPass)(current_pass)), (unsigned)(pass_entries.size()),
+		(double)(clock_us() - pass_start_us) / 1000000.0);
+
+	current_pass = -1;
+}
+
+bool ShardCoordinator::take(std::vector<IndexEntry> *chunk)
+{
+	MutexLock l(lock);
+
+	if(pass_next >= pass_entries.size())
+	{
+		return false;
+	}
+
+	size_t end = pass_next + PASS_CHUNK < pass_entries.size() ? pass_next + PASS_CHUNK : pass_entries.size();
+
+	chunk->assign(pass_entries.begin() + pass_next, pass_entries.begin() + end);
+	pass_next = end;
+
+	return true;
+}
+
+void ShardCoordinator::pass_progress()
+{
+	unsigned long done, total;
+
+	{
+		MutexLock l(lock);
+
+		done = ++pass_done;
+		total = pass_entries.size();
+	}
+
+	if(tracer != NULL)
+	{
+		tracer->progress(done, total);
+	}
+}
+
+void ShardCoordinator::progress()
+{
+	unsigned long done, known;
+
+	{
+		MutexLock l(lock);
+
+		done = ++entries_done;
+		known = entries_known;
+	}
+
+	if(tracer != NULL)
+	{
+		tracer->progress(done, known);
+	}
+}
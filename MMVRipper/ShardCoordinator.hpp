@@ -0,0 +1,236 @@
+#ifndef MMVRIPPER_SHARDCOORDINATOR_HPP
+#define MMVRIPPER_SHARDCOORDINATOR_HPP
+
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <vector>
+
+#include "ArtifactStore.hpp"
+#include "Crawler.hpp"
+#include "IntTypes.hpp"
+#include "Journal.hpp"
+#include "Quarantine.hpp"
+#include "Supervisor.hpp"
+#include "Threading.hpp"
+#include "Tracer.hpp"
+#include "ViewerDriver.hpp"
+
+/* Crawls the index with several viewers at once, each driven by its own
+ * Crawler on its own thread, and puts together the tree a single crawler
+ * would have printed.
+ *
+ * The first crawler starts walking the index from the top like normal, the
+ * others start out idle. Whenever a crawler expands a group near the top of
+ * the index, the children it found are offered up, and idle crawlers steal
+ * them one at a time from the end of the list while the owner works through
+ * them from the start. A crawler which has run out of work steals from the
+ * shallowest group with anything left, which is probably the biggest bit of
+ * work going.
+ *
+ * Instead of printing the tree, the crawlers tell the coordinator which
+ * children they found under each entry (by its path from the top, as IDs may
+ * appear more than once) and which pages they printed. The tree is printed
+ * from that once everyone has finished, stopping at entries which were
+ * already seen in the same places a single crawler would have, so the output
+ * is the same byte for byte. (Collecting content as it goes, the pages after
+ * one which was already seen in a group still get saved, though they aren't
+ * printed.)
+ *
+ * If the content is being collected in passes after the walk, each pass goes
+ * through the entries which need it in the order they were printed, with the
+ * crawlers taking a few at a time so each one mostly stays in the same part
+ * of the index.
+*/
+class ShardCoordinator
+{
+public:
+	struct Stats
+	{
+		unsigned long groups;  /* Groups offered up to be stolen from. */
+		unsigned long steals;
+	};
+
+private:
+	class Worker: public Thread
+	{
+	private:
+		ShardCoordinator *coordinator;
+		unsigned int index;
+
+		ViewerDriver *viewer;
+		ArtifactStore *store;
+		Supervisor *supervisor;
+
+	protected:
+		virtual void run()
+		{
+			coordinator->worker_main(index, viewer, store, supervisor);
+		}
+
+	public:
+		Worker(ShardCoordinator *coordinator, unsigned int index, ViewerDriver *viewer, ArtifactStore *store, Supervisor *supervisor):
+			coordinator(coordinator),
+			index(index),
+			viewer(viewer),
+			store(store),
+			supervisor(supervisor) {}
+	};
+
+	/* Children of an entry which haven't been visited yet are between front
+	 * and back, the owner takes them from the front and thieves from the
+	 * back.
+	*/
+	struct Group
+	{
+		std::vector<unsigned int> path;
+		std::vector<unsigned int> items;
+		size_t front, back;
+	};
+
+	typedef std::vector<unsigned int> Path;
+
+	CrawlOptions options;
+	Tracer *tracer;
+	Quarantine *quarantine;
+	Journal journal;
+	FILE *out;
+
+	std::vector<Worker*> workers;
+
+	Mutex lock;
+	Semaphore work;  /* Posted whenever there might be something to steal. */
+
+	std::vector<Group> groups;
+	unsigned int idle;
+	bool finished;
+
+	/* What the crawlers found, for merging. walked is the children found
+	 * by expanding an entry, replayed the children the journal says it
+	 * had.
+	*/
+	std::map<Path, std::vector<unsigned int> > walked;
+	std::map<Path, std::vector<unsigned int> > replayed;
+	std::set<unsigned int> printed;
+	bool merged;
+
+	/* Everything in the tree, in order, for the passes. */
+	std::vector<IndexEntry> entries;
+
+	/* Crawlers waiting in arrive(), and which of gates they are waiting on. */
+	unsigned int arrived;
+	unsigned int generation;
+	Semaphore gates[2];
+
+	/* The pass going on now (if current_pass isn't -1), and how far through
+	 * it everyone has got.
+	*/
+	int current_pass;
+	std::vector<IndexEntry> pass_entries;
+	size_t pass_next;
+	unsigned long pass_done;
+	uint64 pass_start_us;
+
+	unsigned long entries_done;
+	unsigned long entries_known;
+
+	Stats stats;
+
+	void worker_main(unsigned int index, ViewerDriver *viewer, ArtifactStore *store, Supervisor *supervisor);
+	void merge(FILE *out, Path &path, int depth, std::set<unsigned int> &seen);
+	void add_entry(const Path &path, unsigned int id);
+	void finish_pass();
+
+	/* Not copyable. */
+	ShardCoordinator(const ShardCoordinator&);
+	ShardCoordinator &operator=(const ShardCoordinator&);
+
+public:
+	ShardCoordinator(const CrawlOptions &options, Tracer *tracer);
+	~ShardCoordinator();
+
+	/* Adds a crawler for a viewer, which saves to store and is restarted by
+	 * supervisor (if not NULL). The viewers must all be showing the same
+	 * index.
+	*/
+	void add_worker(ViewerDriver *viewer, ArtifactStore *store, Supervisor *supervisor);
+
+	/* Shared by all the crawlers, see Crawler::set_quarantine(). */
+	void set_quarantine(Quarantine *quarantine)
+	{
+		this->quarantine = quarantine;
+	}
+
+	/* Crawls the index with every viewer, prints the tree to out, then
+	 * makes any passes CrawlOptions asks for. Returns false if the journal
+	 * can't be opened.
+	*/
+	bool run(FILE *out);
+
+	Stats get_stats() const
+	{
+		return stats;
+	}
+
+	/* Called by the crawlers. */
+
+	/* Offers up the children found under the entry at path to be stolen,
+	 * returns the group number to claim() them with or -1 if it is too deep
+	 * to be worth stealing from (in which case they all belong to the
+	 * caller).
+	*/
+	int add_group(const std::vector<unsigned int> &path, const std::vector<unsigned int> &items);
+
+	/* Claims the next item in a group for its owner. Returns false if it
+	 * (and everything after it) has been stolen.
+	*/
+	bool claim(int group, size_t item);
+
+	/* Waits for an entry to visit, returning the path to its parent and its
+	 * ID. Returns false when every crawler is out of work.
+	*/
+	bool steal(std::vector<unsigned int> *path, unsigned int *id);
+
+	/* Stops waiting for the caller to find more work, it has given up. */
+	void leave();
+
+	void record_walked(const std::vector<unsigned int> &path, const std::vector<unsigned int> &children);
+	void record_replayed(const std::vector<unsigned int> &path, const std::vector<unsigned int> &children);
+	void record_printed(unsigned int id);
+
+	/* Waits for every crawler to get here. The last one to arrive doesn't
+	 * wait, this returns true for it instead and the others are let go
+	 * when it calls release().
+	*/
+	bool arrive();
+	void release();
+
+	/* Prints the tree, once everyone has finished walking the index. */
+	void merge_tree();
+
+	/* Everything in the tree, in the order it was printed. Only filled in
+	 * if there are passes to make.
+	*/
+	const std::vector<IndexEntry> &get_entries() const
+	{
+		return entries;
+	}
+
+	/* Starts a pass over the entries which need it. */
+	void start_pass(ContentPass pass, const std::vector<IndexEntry> &needed);
+
+	/* Takes the next few entries to collect in the current pass. Returns
+	 * false once they have all been taken.
+	*/
+	bool take(std::vector<IndexEntry> *chunk);
+
+	/* Counts an entry as done in the current pass. */
+	void pass_progress();
+
+	/* Counts an entry as done and has the tracer print a progress summary
+	 * if it is time for one.
+	*/
+	void progress();
+};
+
+#endif /* !MMVRIPPER_SHARDCOORDINATOR_HPP */
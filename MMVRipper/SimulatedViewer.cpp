@@ -0,0 +1,641 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Clock.hpp"
+#include "SimulatedViewer.hpp"
+
+/* Deepest folder nesting generate() will produce. */
+static const size_t MAX_GENERATED_DEPTH = 8;
+
+/* generate() makes every this many topics pop up the message. */
+static const unsigned int POPUP_INTERVAL = 97;
+
+/* Window "handles" for the events the simulator posts. */
+static void *const SIM_POPUP_WINDOW = (void*)(1);
+static void *const SIM_COPY_DIALOG = (void*)(2);
+
+/* Park-Miller "minimal standard" generator, so generated indexes don't depend
+ * on the C library's rand().
+*/
+static unsigned int next_random(unsigned int *state)
+{
+	unsigned long hi = 16807UL * (*state >> 16);
+	unsigned long lo = 16807UL * (*state & 0xFFFF);
+
+	lo += (hi & 0x7FFF) << 16;
+	lo += hi >> 15;
+
+	if(lo > 0x7FFFFFFF)
+	{
+		lo -= 0x7FFFFFFF;
+	}
+
+	*state = (unsigned int)(lo);
+	return *state;
+}
+
+static bool read_line(FILE *f, std::string *line)
+{
+	line->clear();
+
+	int c;
+	while((c = fgetc(f)) != EOF && c != '\n')
+	{
+		line->push_back((char)(c));
+	}
+
+	return c != EOF || !line->empty();
+}
+
+SimulatedViewer::SimulatedViewer():
+	cursor(0),
+	top(0),
+	current_topic(-1),
+	popup_open(false),
+	busy_until_us(0),
+	blip_start_us(0),
+	blip_end_us(0),
+	dead(false),
+	killed(false),
+	accept_set_cursor(true),
+	event_source(&events)
+{
+	memset(&stats, 0, sizeof(stats));
+
+	bool started = event_source.start();
+	assert(started);
+}
+
+SimulatedViewer::~SimulatedViewer()
+{
+	event_source.stop();
+}
+
+int SimulatedViewer::add_node(unsigned int id, int parent)
+{
+	Node node;
+	node.id = id;
+	node.parent = parent;
+	node.depth = parent >= 0 ? nodes[parent].depth + 1 : 0;
+	node.expanded = false;
+
+	int idx = nodes.size();
+	nodes.push_back(node);
+
+	if(parent >= 0)
+	{
+		nodes[parent].children.push_back(idx);
+	}
+	else{
+		roots.push_back(idx);
+	}
+
+	return idx;
+}
+
+bool SimulatedViewer::load(const char *filename)
+{
+	FILE *f = fopen(filename, "r");
+	if(f == NULL)
+	{
+		return false;
+	}
+
+	nodes.clear();
+	roots.clear();
+
+	/* Most recent node seen at each depth. */
+	std::vector<int> path;
+
+	std::string line;
+	while(read_line(f, &line))
+	{
+		size_t indent = line.find_first_not_of(' ');
+		if(indent == std::string::npos || line[indent] < '0' || line[indent] > '9')
+		{
+			continue;
+		}
+
+		size_t depth = indent / 2;
+		if(depth > path.size())
+		{
+			/* Skipped a level, treat it as a child of the last node. */
+			depth = path.size();
+		}
+
+		path.resize(depth);
+
+		int parent = depth > 0 ? path[depth - 1] : -1;
+		unsigned int id = strtoul(line.c_str() + indent, NULL, 10);
+
+		path.push_back(add_node(id, parent));
+	}
+
+	fclose(f);
+
+	visible = roots;
+	cursor = 0;
+	top = 0;
+
+	return true;
+}
+
+void SimulatedViewer::generate(unsigned int num_nodes, unsigned int seed)
+{
+	nodes.clear();
+	roots.clear();
+
+	unsigned int rng = seed != 0 ? seed : 1;
+
+	/* Folders we are currently adding children to. */
+	std::vector<int> path;
+	int last = -1;
+
+	for(unsigned int i = 0; i < num_nodes; ++i)
+	{
+		unsigned int r = next_random(&rng) % 100;
+
+		if(last >= 0 && r < 15 && path.size() < MAX_GENERATED_DEPTH)
+		{
+			/* Turn the previous node into a folder. */
+			path.push_back(last);
+		}
+		else if(!path.empty() && r >= 85)
+		{
+			path.pop_back();
+		}
+
+		int parent = path.empty() ? -1 : path.back();
+		last = add_node(0x10000 + i, parent);
+
+		if(i % POPUP_INTERVAL == POPUP_INTERVAL - 1)
+		{
+			add_popup(0x10000 + i);
+		}
+	}
+
+	visible = roots;
+	cursor = 0;
+	top = 0;
+}
+
+void SimulatedViewer::add_popup(unsigned int id)
+{
+	popup_ids.insert(id);
+}
+
+void SimulatedViewer::add_crash(unsigned int id, bool hang)
+{
+	if(hang)
+	{
+		hang_ids.insert(id);
+	}
+	else{
+		crash_ids.insert(id);
+	}
+}
+
+/* Takes the listbox and everything else away, so anything asked of us from
+ * now on fails like it would with a dead window.
+*/
+void SimulatedViewer::die()
+{
+	dead = true;
+
+	visible.clear();
+	cursor = 0;
+	top = 0;
+
+	current_topic = -1;
+	popup_open = false;
+}
+
+void SimulatedViewer::collapse(unsigned int pos)
+{
+	Node &node = nodes[visible[pos]];
+
+	unsigned int end = pos + 1;
+	while(end < visible.size() && nodes[visible[end]].depth > node.depth)
+	{
+		nodes[visible[end]].expanded = false;
+		++end;
+	}
+
+	visible.erase(visible.begin() + pos + 1, visible.begin() + end);
+	node.expanded = false;
+
+	if(cursor > pos && cursor < end)
+	{
+		cursor = pos;
+	}
+	else if(cursor >= end)
+	{
+		cursor -= end - (pos + 1);
+	}
+}
+
+void SimulatedViewer::press_key(Key key)
+{
+	++messages;
+
+	if(key != KEY_LEFT && key != KEY_RIGHT)
+	{
+		++navigations;
+	}
+
+	if(visible.empty())
+	{
+		return;
+	}
+
+	Node &node = nodes[visible[cursor]];
+
+	switch(key)
+	{
+		case KEY_UP:
+			if(cursor > 0)
+			{
+				--cursor;
+			}
+
+			break;
+
+		case KEY_DOWN:
+			if(cursor + 1 < visible.size())
+			{
+				++cursor;
+			}
+
+			break;
+
+		case KEY_HOME:
+			cursor = 0;
+			break;
+
+		case KEY_END:
+			cursor = visible.size() - 1;
+			break;
+
+		case KEY_RIGHT:
+			if(!node.children.empty() && !node.expanded)
+			{
+				node.expanded = true;
+				visible.insert(visible.begin() + cursor + 1, node.children.begin(), node.children.end());
+
+				++cursor;
+			}
+
+			break;
+
+		case KEY_LEFT:
+			if(node.expanded)
+			{
+				collapse(cursor);
+			}
+			else if(node.parent >= 0)
+			{
+				unsigned int pos = cursor;
+				while(visible[pos] != node.parent)
+				{
+					--pos;
+				}
+
+				collapse(pos);
+				cursor = pos;
+			}
+
+			break;
+	}
+
+	scroll_to_cursor();
+}
+
+bool SimulatedViewer::set_cursor(unsigned int idx)
+{
+	if(!accept_set_cursor || idx >= visible.size())
+	{
+		return false;
+	}
+
+	/* LB_SETCURSEL plus the LBN_SELCHANGE notification. */
+	messages += 2;
+	++navigations;
+
+	cursor = idx;
+	scroll_to_cursor();
+
+	return true;
+}
+
+/* Scrolls the listbox as little as possible to make the cursor visible, like
+ * a real one does when the selection moves.
+*/
+void SimulatedViewer::scroll_to_cursor()
+{
+	if(cursor < top)
+	{
+		top = cursor;
+	}
+	else if(cursor >= top + VISIBLE_ROWS)
+	{
+		top = cursor - VISIBLE_ROWS + 1;
+	}
+
+	if(top + VISIBLE_ROWS > visible.size())
+	{
+		top = visible.size() > VISIBLE_ROWS ? visible.size() - VISIBLE_ROWS : 0;
+	}
+}
+
+unsigned int SimulatedViewer::get_top_index()
+{
+	++messages;
+	return top;
+}
+
+void SimulatedViewer::set_top_index(unsigned int idx)
+{
+	++messages;
+
+	top = idx;
+
+	if(top + VISIBLE_ROWS > visible.size())
+	{
+		top = visible.size() > VISIBLE_ROWS ? visible.size() - VISIBLE_ROWS : 0;
+	}
+}
+
+ViewerDriver::Rect SimulatedViewer::get_client_rect()
+{
+	Rect rect = { 0, 0, ROW_WIDTH, VISIBLE_ROWS * ROW_HEIGHT };
+	return rect;
+}
+
+unsigned int SimulatedViewer::get_count()
+{
+	++messages;
+	return visible.size();
+}
+
+unsigned int SimulatedViewer::get_cursor()
+{
+	++messages;
+	return visible.empty() ? (unsigned int)(-1) : cursor;
+}
+
+unsigned int SimulatedViewer::get_item_data(unsigned int idx)
+{
+	++messages;
+	return idx < visible.size() ? nodes[visible[idx]].id : (unsigned int)(-1);
+}
+
+ViewerDriver::Rect SimulatedViewer::get_item_rect(unsigned int idx)
+{
+	++messages;
+
+	int y = ((int)(idx) - (int)(top)) * ROW_HEIGHT;
+
+	Rect rect = { 0, y, ROW_WIDTH, y + ROW_HEIGHT };
+	return rect;
+}
+
+bool SimulatedViewer::capture(const Rect &rect, GrayImage *image)
+{
+	++messages;
+
+	int width = rect.right - rect.left;
+	int height = rect.bottom - rect.top;
+
+	if(width <= 0 || height <= 0)
+	{
+		return false;
+	}
+
+	/* Each row is drawn as its item data in binary, one bit every
+	 * ID_BIT_WIDTH pixels from the left with black for set bits, on a white
+	 * background. The selected row is drawn inverted like the real listbox
+	 * highlight. Anything outside the client area is white.
+	*/
+
+	image->resize(width, height);
+
+	for(int y = 0; y < height; ++y)
+	{
+		int client_y = rect.top + y;
+		unsigned int row = client_y >= 0 && client_y < VISIBLE_ROWS * ROW_HEIGHT
+			? top + (client_y / ROW_HEIGHT)
+			: visible.size();
+
+		unsigned char *dst = image->row(y);
+
+		for(int x = 0; x < width; ++x)
+		{
+			unsigned int bit = (rect.left + x) / ID_BIT_WIDTH;
+			unsigned char pixel = 255;
+
+			if(row < visible.size() && bit < 32 && ((nodes[visible[row]].id >> bit) & 1))
+			{
+				pixel = 0;
+			}
+
+			if(row == cursor && row < visible.size())
+			{
+				pixel = 255 - pixel;
+			}
+
+			dst[x] = pixel;
+		}
+	}
+
+	return true;
+}
+
+void SimulatedViewer::open_selected()
+{
+	++messages;
+	check_idle();
+	++(stats.topics_opened);
+
+	if(visible.empty())
+	{
+		return;
+	}
+
+	current_topic = visible[cursor];
+
+	unsigned int id = nodes[current_topic].id;
+
+	if(hang_ids.find(id) != hang_ids.end())
+	{
+		unhang.wait();
+		die();
+
+		return;
+	}
+
+	if(crash_ids.find(id) != crash_ids.end())
+	{
+		die();
+		return;
+	}
+
+	if(popup_ids.find(nodes[current_topic].id) != popup_ids.end())
+	{
+		popup_open = true;
+		++(stats.popups);
+
+		event_source.schedule(WINDOW_DELAY_MS, SIM_POPUP_WINDOW, NULL, "Navigator", "#32770");
+	}
+}
+
+bool SimulatedViewer::copy_text(std::string *text)
+{
+	++messages;
+	check_idle();
+
+	{
+		TraceScope trace(tracer, TRACE_COPY_WAIT);
+
+		/* The Copy dialog won't open until the popup goes away. */
+		wait_for_popup();
+
+		if(current_topic < 0)
+		{
+			return false;
+		}
+
+		/* Like the real driver, don't take a dialog from a Copy which timed
+		 * out for this one.
+		*/
+		events.discard("Copy", NULL);
+
+		event_source.schedule(WINDOW_DELAY_MS, SIM_COPY_DIALOG, NULL, "Copy", "#32770");
+
+		if(!events.wait_for("Copy", NULL, WINDOW_TIMEOUT_MS, NULL))
+		{
+			return false;
+		}
+	}
+
+	TraceScope trace(tracer, TRACE_CLIPBOARD);
+
+	/* Roughly what the viewer puts on the clipboard, codepage 437 text with
+	 * DOS line endings and the topic ID footer.
+	*/
+
+	char buf[256];
+	sprintf(buf, "Topic %u\r\n\r\nSimulated caf\x82 text for topic %u.\r\n\r\n#:SIM_%u\r\n",
+		nodes[current_topic].id, nodes[current_topic].id, nodes[current_topic].id);
+
+	text->assign(buf);
+
+	return true;
+}
+
+bool SimulatedViewer::print(PrintJob *job)
+{
+	++messages;
+	check_idle();
+
+	TraceScope trace(tracer, TRACE_PRINT_WAIT);
+
+	wait_for_popup();
+
+	if(current_topic < 0)
+	{
+		return false;
+	}
+
+	char buf[256];
+	sprintf(buf, "%%!PS-Adobe-3.0\r\n%%%%Title: Topic %u\r\n%%%%Pages: 1\r\n%%%%EndComments\r\nshowpage\r\n%%%%EOF\r\n",
+		nodes[current_topic].id);
+
+	PrintJob sim_job(&pool);
+	sim_job.append((const unsigned char*)(buf), strlen(buf));
+
+	job->swap(sim_job);
+
+	/* Takes a while to recover from printing, a pseudo-random time for each
+	 * topic.
+	*/
+	unsigned int h = nodes[current_topic].id * 2654435761U;
+	unsigned int settle_ms = (h >> 24) % 200 == 0 ? (unsigned int)(PRINT_SETTLE_SLOW_MS) : 1 + ((h >> 16) % PRINT_SETTLE_MAX_MS);
+
+	uint64 now = clock_us();
+	busy_until_us = now + ((uint64)(settle_ms) * 1000);
+
+	if((h >> 8) % 4 == 0 && settle_ms > 3 * PRINT_BLIP_MS)
+	{
+		blip_start_us = now + ((uint64)(settle_ms) * 1000 / 3);
+		blip_end_us = blip_start_us + ((uint64)(PRINT_BLIP_MS) * 1000);
+	}
+	else{
+		blip_start_us = blip_end_us = 0;
+	}
+
+	return true;
+}
+
+bool SimulatedViewer::is_idle()
+{
+	uint64 now = clock_us();
+	return now >= busy_until_us || (now >= blip_start_us && now < blip_end_us);
+}
+
+void SimulatedViewer::check_idle()
+{
+	/* Looking idle for a moment doesn't mean it is. */
+	if(clock_us() < busy_until_us)
+	{
+		++(stats.busy_violations);
+	}
+}
+
+void SimulatedViewer::dismiss_popups()
+{
+	/* Only dismisses the popup once it has actually appeared, like the
+	 * real thing.
+	*/
+	if(popup_open && events.try_take("Navigator", NULL, NULL))
+	{
+		++messages;
+		popup_open = false;
+	}
+}
+
+bool SimulatedViewer::is_alive()
+{
+	MutexLock l(kill_lock);
+
+	if(killed && !dead)
+	{
+		die();
+	}
+
+	return !dead;
+}
+
+void SimulatedViewer::kill()
+{
+	MutexLock l(kill_lock);
+
+	killed = true;
+	unhang.post();
+}
+
+/* Waits for the popup to appear (if one is on the way) and dismisses it. */
+void SimulatedViewer::wait_for_popup()
+{
+	while(popup_open)
+	{
+		if(events.wait_for("Navigator", NULL, WINDOW_TIMEOUT_MS, NULL))
+		{
+			++messages;
+			popup_open = false;
+		}
+	}
+}
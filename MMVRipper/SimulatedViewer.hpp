@@ -0,0 +1,181 @@
+#ifndef MMVRIPPER_SIMULATEDVIEWER_HPP
+#define MMVRIPPER_SIMULATEDVIEWER_HPP
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ChunkPool.hpp"
+#include "FakeWindowEventSource.hpp"
+#include "IntTypes.hpp"
+#include "Threading.hpp"
+#include "ViewerDriver.hpp"
+#include "WindowEvents.hpp"
+
+/* Deterministic in-process model of the bits of Multimedia Viewer which the
+ * crawler drives, for running (and timing) the crawler off Windows.
+ *
+ * The index listbox behaves like PopNav's: right expands a folder and moves
+ * to its first child, left collapses the folder (or the parent folder of the
+ * selected item) and selects it. Opening certain topics can be made to pop
+ * up the "argument is not valid" message, which blocks the Copy dialog and
+ * printing until it is dismissed. The popup and the Copy dialog "appear" a
+ * little after they are asked for, through the same WindowEvents waiting the
+ * real driver uses.
+ *
+ * Topics can also be made to crash the viewer when opened, or hang it until
+ * kill() is called, after which it behaves like a viewer which has gone away.
+ *
+ * Screenshots show each row's item data as a row of black and white bars, so
+ * it is possible to tell which row ended up in an image.
+*/
+class SimulatedViewer: public ViewerDriver
+{
+public:
+	enum { ROW_HEIGHT = 40, ROW_WIDTH = 1024, VISIBLE_ROWS = 20, ID_BIT_WIDTH = 8 };
+
+	/* How long after being asked for windows appear, and how long to wait
+	 * for them before giving up.
+	*/
+	enum { WINDOW_DELAY_MS = 1, WINDOW_TIMEOUT_MS = 1000 };
+
+	/* The viewer stays busy for up to this long after printing, and
+	 * occasionally for much longer. Some topics look idle for a moment part
+	 * way through, like the real one between the print dialogs closing and
+	 * the job being sent.
+	*/
+	enum { PRINT_SETTLE_MAX_MS = 20, PRINT_SETTLE_SLOW_MS = 150, PRINT_BLIP_MS = 3 };
+
+	struct Stats
+	{
+		unsigned long topics_opened;
+		unsigned long popups;
+
+		/* Asked to do something before it had settled after printing. */
+		unsigned long busy_violations;
+	};
+
+private:
+	struct Node
+	{
+		unsigned int id;
+		int parent;
+		unsigned int depth;
+
+		std::vector<int> children;
+		bool expanded;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<int> roots;
+
+	/* Node indices in listbox order. */
+	std::vector<int> visible;
+	unsigned int cursor;
+	unsigned int top;  /* First row in view. */
+
+	int current_topic;
+	bool popup_open;
+
+	uint64 busy_until_us;
+	uint64 blip_start_us, blip_end_us;  /* Looks idle in between. */
+	void check_idle();
+
+	std::set<unsigned int> popup_ids;
+
+	std::set<unsigned int> crash_ids;
+	std::set<unsigned int> hang_ids;
+
+	bool dead;
+
+	/* kill() can come from another thread, while open_selected() is hung. */
+	Mutex kill_lock;
+	bool killed;
+	Semaphore unhang;
+
+	void die();
+
+	bool accept_set_cursor;
+
+	ChunkPool pool;
+
+	WindowEvents events;
+	FakeWindowEventSource event_source;
+
+	Stats stats;
+
+	int add_node(unsigned int id, int parent);
+	void collapse(unsigned int pos);
+	void scroll_to_cursor();
+	void wait_for_popup();
+
+public:
+	SimulatedViewer();
+	virtual ~SimulatedViewer();
+
+	/* Loads the index from a page ID tree in the format MMVRipper writes to
+	 * standard output. Returns false if the file can't be read.
+	*/
+	bool load(const char *filename);
+
+	/* Generates a random index with the given number of nodes. The same seed
+	 * always gives the same index.
+	*/
+	void generate(unsigned int num_nodes, unsigned int seed);
+
+	/* Opening this topic will pop up the "argument is not valid" message.
+	 * generate() adds one every so often.
+	*/
+	void add_popup(unsigned int id);
+
+	/* Opening this topic kills the viewer, or if hang is true makes it
+	 * stop responding until kill() is called.
+	*/
+	void add_crash(unsigned int id, bool hang);
+
+	/* Makes set_cursor() fail, like a viewer which only follows key presses. */
+	void reject_set_cursor()
+	{
+		accept_set_cursor = false;
+	}
+
+	size_t size() const
+	{
+		return nodes.size();
+	}
+
+	Stats get_stats() const
+	{
+		return stats;
+	}
+
+	virtual void press_key(Key key);
+	virtual bool set_cursor(unsigned int idx);
+
+	virtual unsigned int get_count();
+	virtual unsigned int get_cursor();
+	virtual unsigned int get_item_data(unsigned int idx);
+	virtual Rect get_item_rect(unsigned int idx);
+	virtual unsigned int get_top_index();
+	virtual void set_top_index(unsigned int idx);
+	virtual Rect get_client_rect();
+
+	virtual bool capture(const Rect &rect, GrayImage *image);
+
+	virtual void open_selected();
+	virtual bool copy_text(std::string *text);
+	virtual bool print(PrintJob *job);
+
+	virtual bool is_idle();
+	virtual void dismiss_popups();
+
+	virtual bool is_alive();
+	virtual void kill();
+
+	virtual WindowEvents::Stats get_event_stats()
+	{
+		return events.get_stats();
+	}
+};
+
+#endif /* !MMVRIPPER_SIMULATEDVIEWER_HPP */
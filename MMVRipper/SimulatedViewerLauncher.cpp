@@ -0,0 +1,85 @@
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "SimulatedViewerLauncher.hpp"
+
+SimulatedViewerLauncher::SimulatedViewerLauncher(const char *filename):
+	filename(filename),
+	num_nodes(0),
+	seed(0) {}
+
+SimulatedViewerLauncher::SimulatedViewerLauncher(unsigned int num_nodes, unsigned int seed):
+	num_nodes(num_nodes),
+	seed(seed) {}
+
+SimulatedViewerLauncher::~SimulatedViewerLauncher()
+{
+	for(size_t i = 0; i < viewers.size(); ++i)
+	{
+		delete viewers[i];
+	}
+}
+
+void SimulatedViewerLauncher::add_crash(unsigned int id, bool hang)
+{
+	if(hang)
+	{
+		hang_ids.insert(id);
+	}
+	else{
+		crash_ids.insert(id);
+	}
+}
+
+ViewerDriver *SimulatedViewerLauncher::launch()
+{
+	SimulatedViewer *sim = new SimulatedViewer();
+
+	if(!filename.empty())
+	{
+		if(!sim->load(filename.c_str()))
+		{
+			fprintf(stderr, "Unable to load %s\n", filename.c_str());
+
+			delete sim;
+			return NULL;
+		}
+	}
+	else{
+		sim->generate(num_nodes, seed);
+	}
+
+	for(std::set<unsigned int>::const_iterator i = crash_ids.begin(); i != crash_ids.end(); ++i)
+	{
+		sim->add_crash(*i, false);
+	}
+
+	for(std::set<unsigned int>::const_iterator i = hang_ids.begin(); i != hang_ids.end(); ++i)
+	{
+		sim->add_crash(*i, true);
+	}
+
+	viewers.push_back(sim);
+
+	return sim;
+}
+
+SimulatedViewer::Stats SimulatedViewerLauncher::get_stats() const
+{
+	SimulatedViewer::Stats total;
+	memset(&total, 0, sizeof(total));
+
+	for(size_t i = 0; i < viewers.size(); ++i)
+	{
+		SimulatedViewer::Stats s = viewers[i]->get_stats();
+
+		total.topics_opened += s.topics_opened;
+		total.popups += s.popups;
+		total.busy_violations += s.busy_violations;
+	}
+
+	return total;
+}
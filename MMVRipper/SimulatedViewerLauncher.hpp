@@ -0,0 +1,47 @@
+#ifndef MMVRIPPER_SIMULATEDVIEWERLAUNCHER_HPP
+#define MMVRIPPER_SIMULATEDVIEWERLAUNCHER_HPP
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "SimulatedViewer.hpp"
+#include "ViewerLauncher.hpp"
+
+/* Starts SimulatedViewers, each loaded from the same tree file or generated
+ * with the same seed, and with the same topics set to crash them.
+*/
+class SimulatedViewerLauncher: public ViewerLauncher
+{
+private:
+	std::string filename;
+	unsigned int num_nodes, seed;
+
+	std::set<unsigned int> crash_ids;
+	std::set<unsigned int> hang_ids;
+
+	std::vector<SimulatedViewer*> viewers;
+
+	/* Not copyable. */
+	SimulatedViewerLauncher(const SimulatedViewerLauncher&);
+	SimulatedViewerLauncher &operator=(const SimulatedViewerLauncher&);
+
+public:
+	/* Loads the index from filename (see SimulatedViewer::load()). */
+	SimulatedViewerLauncher(const char *filename);
+
+	/* Generates the index (see SimulatedViewer::generate()). */
+	SimulatedViewerLauncher(unsigned int num_nodes, unsigned int seed);
+
+	virtual ~SimulatedViewerLauncher();
+
+	/* See SimulatedViewer::add_crash(). */
+	void add_crash(unsigned int id, bool hang);
+
+	virtual ViewerDriver *launch();
+
+	/* Adds up the stats of every viewer started so far. */
+	SimulatedViewer::Stats get_stats() const;
+};
+
+#endif /* !MMVRIPPER_SIMULATEDVIEWERLAUNCHER_HPP */
@@ -0,0 +1,19 @@
+#include "Clock.hpp"
+#include "SlowStore.hpp"
+
+bool SlowStore::exists(unsigned int id, const char *kind)
+{
+	return backing->exists(id, kind);
+}
+
+bool SlowStore::write(unsigned int id, const char *kind, const void *data, size_t len)
+{
+	sleep_ms(delay_ms);
+	return backing->write(id, kind, data, len);
+}
+
+bool SlowStore::write(unsigned int id, const char *kind, PrintJob &job)
+{
+	sleep_ms(delay_ms);
+	return backing->write(id, kind, job);
+}
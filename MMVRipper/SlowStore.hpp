@@ -0,0 +1,31 @@
+#ifndef MMVRIPPER_SLOWSTORE_HPP
+#define MMVRIPPER_SLOWSTORE_HPP
+
+#include "ArtifactStore.hpp"
+
+/* Passes everything on to another ArtifactStore after a delay, to see how the
+ * crawler copes with slow disks or network shares.
+*/
+class SlowStore: public ArtifactStore
+{
+private:
+	ArtifactStore *backing;
+	unsigned int delay_ms;
+
+public:
+	SlowStore(ArtifactStore *backing, unsigned int delay_ms):
+		backing(backing),
+		delay_ms(delay_ms) {}
+
+	virtual bool exists(unsigned int id, const char *kind);
+
+	virtual bool write(unsigned int id, const char *kind, const void *data, size_t len);
+	virtual bool write(unsigned int id, const char *kind, PrintJob &job);
+
+	virtual bool thread_safe() const
+	{
+		return backing->thread_safe();
+	}
+};
+
+#endif /* !MMVRIPPER_SLOWSTORE_HPP */
@@ -0,0 +1,52 @@
+#ifndef MMVRIPPER_SOCKETS_HPP
+#define MMVRIPPER_SOCKETS_HPP
+
+/* Just enough glue to let the print server core build against either Winsock
+ * or BSD sockets.
+*/
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+
+typedef int socklen_t;
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef int SOCKET;
+
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR   (-1)
+
+#define closesocket(s) close(s)
+#endif
+
+inline bool socket_set_nonblocking(SOCKET sock)
+{
+#ifdef _WIN32
+	unsigned long nonblocking = 1;
+	return ioctlsocket(sock, FIONBIO, &nonblocking) == 0;
+#else
+	int flags = fcntl(sock, F_GETFL, 0);
+	return flags != -1 && fcntl(sock, F_SETFL, (flags | O_NONBLOCK)) == 0;
+#endif
+}
+
+/* Returns true if the last failed socket call only failed because it would
+ * have blocked (or was interrupted) and should be retried later.
+*/
+inline bool socket_would_block()
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+#endif /* !MMVRIPPER_SOCKETS_HPP */
@@ -1,3 +1,5 @@
+#ifdef _WIN32
+
 #include <stdio.h>
 
 #include "StupidMessageHandler.hpp"
@@ -14,6 +16,20 @@ void StupidMessageHandler::run()
 	}
 }
 
+bool StupidMessageHandler::dismiss(HWND window)
+{
+	HWND stupid_msg = NULL;
+	EnumChildWindows(window, &find_the_stupid_message, (LPARAM)(&stupid_msg));
+
+	if(stupid_msg == NULL)
+	{
+		return false;
+	}
+
+	SendMessage(window, WM_COMMAND, MAKEWPARAM(IDCANCEL, BN_CLICKED), 0);
+	return true;
+}
+
 BOOL CALLBACK StupidMessageHandler::find_the_stupid_dialog(HWND hWnd, LPARAM lParam)
 {
 	char window_text[128];
@@ -71,3 +87,5 @@ BOOL CALLBACK StupidMessageHandler::find_the_stupid_message(HWND hWnd, LPARAM lP
 	/* Keep searching. */
 	return TRUE;
 }
+
+#endif /* _WIN32 */
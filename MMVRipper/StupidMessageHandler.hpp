@@ -1,17 +1,25 @@
 #ifndef MMVRIPPER_STUPIDMESSAGEHANDLER_HPP
 #define MMVRIPPER_STUPIDMESSAGEHANDLER_HPP
 
+#ifdef _WIN32
+
 #include <winsock2.h>
 #include <windows.h>
 
 class StupidMessageHandler
 {
 public:
+	/* Looks for the message and dismisses it. */
 	static void run();
 
+	/* Dismisses the message if it is in window, returns true if it was. */
+	static bool dismiss(HWND window);
+
 private:
 	static BOOL CALLBACK find_the_stupid_dialog(HWND hWnd, LPARAM lParam);
 	static BOOL CALLBACK find_the_stupid_message(HWND hWnd, LPARAM lParam);
 };
 
+#endif /* _WIN32 */
+
 #endif
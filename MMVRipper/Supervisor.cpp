@@ -0,0 +1,129 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Clock.hpp"
+#include "Supervisor.hpp"
+
+/* How often the watchdog looks at the viewer. */
+static const unsigned int WATCHDOG_INTERVAL_MS = 250;
+
+Supervisor::Supervisor(ViewerLauncher *launcher, unsigned int hang_timeout_ms):
+	launcher(launcher),
+	hang_timeout_ms(hang_timeout_ms),
+	tracer(NULL),
+	viewer(NULL),
+	watching(false),
+	watchdog(this),
+	watchdog_running(false)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+Supervisor::~Supervisor()
+{
+	if(watchdog_running)
+	{
+		stop_watchdog.post();
+		watchdog.join();
+	}
+}
+
+ViewerDriver *Supervisor::start()
+{
+	ViewerDriver *v = launcher->launch();
+
+	if(v != NULL && tracer != NULL)
+	{
+		v->set_tracer(tracer);
+	}
+
+	{
+		MutexLock l(lock);
+		viewer = v;
+	}
+
+	if(v != NULL && hang_timeout_ms > 0 && !watchdog_running)
+	{
+		watchdog_running = watchdog.start();
+		assert(watchdog_running);
+	}
+
+	return v;
+}
+
+ViewerDriver *Supervisor::restart()
+{
+	{
+		MutexLock l(lock);
+
+		if(viewer != NULL)
+		{
+			viewer->kill();
+			viewer = NULL;
+		}
+
+		++(stats.restarts);
+	}
+
+	return start();
+}
+
+ViewerDriver *Supervisor::get_viewer()
+{
+	MutexLock l(lock);
+	return viewer;
+}
+
+void Supervisor::set_watching(bool watching)
+{
+	MutexLock l(lock);
+	this->watching = watching;
+}
+
+Supervisor::Stats Supervisor::get_stats()
+{
+	MutexLock l(lock);
+	return stats;
+}
+
+void Supervisor::watchdog_main()
+{
+	ViewerDriver *last_viewer = NULL;
+	unsigned long last_messages = 0;
+	uint64 last_change_us = clock_us();
+
+	while(!stop_watchdog.wait(WATCHDOG_INTERVAL_MS))
+	{
+		MutexLock l(lock);
+
+		uint64 now = clock_us();
+
+		if(viewer == NULL || !watching)
+		{
+			last_viewer = NULL;
+			continue;
+		}
+
+		/* The message count is only ever written by the crawler's thread,
+		 * we just want to see it change.
+		*/
+		unsigned long messages = viewer->get_message_count();
+
+		if(viewer != last_viewer || messages != last_messages)
+		{
+			last_viewer = viewer;
+			last_messages = messages;
+			last_change_us = now;
+		}
+		else if(now - last_change_us >= (uint64)(hang_timeout_ms) * 1000)
+		{
+			fprintf(stderr, "The viewer hasn't done anything for %u ms, killing it\n", hang_timeout_ms);
+
+			viewer->kill();
+			++(stats.hangs);
+
+			last_change_us = now;
+		}
+	}
+}
@@ -0,0 +1,89 @@
+#ifndef MMVRIPPER_SUPERVISOR_HPP
+#define MMVRIPPER_SUPERVISOR_HPP
+
+#include "Threading.hpp"
+#include "Tracer.hpp"
+#include "ViewerDriver.hpp"
+#include "ViewerLauncher.hpp"
+
+/* Looks after the viewer a crawler is driving.
+ *
+ * A watchdog thread kills the viewer if it stops taking messages for longer
+ * than the hang timeout while the crawler is using it, so a hung viewer shows
+ * up as a dead one. When the crawler finds the viewer dead it asks for a new
+ * one with restart(), and puts it back where the old one was.
+*/
+class Supervisor
+{
+public:
+	struct Stats
+	{
+		unsigned long restarts;
+		unsigned long hangs;  /* Killed by the watchdog. */
+	};
+
+private:
+	class Watchdog: public Thread
+	{
+	private:
+		Supervisor *supervisor;
+
+	protected:
+		virtual void run()
+		{
+			supervisor->watchdog_main();
+		}
+
+	public:
+		Watchdog(Supervisor *supervisor):
+			supervisor(supervisor) {}
+	};
+
+	ViewerLauncher *launcher;
+	unsigned int hang_timeout_ms;
+	Tracer *tracer;
+
+	Mutex lock;
+	ViewerDriver *viewer;
+	bool watching;
+
+	Watchdog watchdog;
+	bool watchdog_running;
+	Semaphore stop_watchdog;
+
+	Stats stats;
+
+	void watchdog_main();
+
+	/* Not copyable. */
+	Supervisor(const Supervisor&);
+	Supervisor &operator=(const Supervisor&);
+
+public:
+	/* A hang_timeout_ms of zero turns the watchdog off. */
+	Supervisor(ViewerLauncher *launcher, unsigned int hang_timeout_ms);
+	~Supervisor();
+
+	/* Records what the viewers do to tracer. Call before start(). */
+	void set_tracer(Tracer *tracer)
+	{
+		this->tracer = tracer;
+	}
+
+	/* Launches the first viewer, returns NULL if it can't be. */
+	ViewerDriver *start();
+
+	/* Gets rid of the current viewer (killing it if it is somehow still
+	 * running) and launches another. Returns NULL if it can't be.
+	*/
+	ViewerDriver *restart();
+
+	ViewerDriver *get_viewer();
+
+	/* Only watch for hangs while the crawler is using the viewer. */
+	void set_watching(bool watching);
+
+	Stats get_stats();
+};
+
+#endif /* !MMVRIPPER_SUPERVISOR_HPP */
@@ -0,0 +1,228 @@
+#include <assert.h>
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+#include "Threading.hpp"
+
+#ifdef _WIN32
+
+Mutex::Mutex()
+{
+	InitializeCriticalSection(&cs);
+}
+
+Mutex::~Mutex()
+{
+	DeleteCriticalSection(&cs);
+}
+
+void Mutex::lock()
+{
+	EnterCriticalSection(&cs);
+}
+
+void Mutex::unlock()
+{
+	LeaveCriticalSection(&cs);
+}
+
+Semaphore::Semaphore(unsigned int initial)
+{
+	sem = CreateSemaphore(NULL, initial, 0x7FFFFFFF, NULL);
+	assert(sem != NULL);
+}
+
+Semaphore::~Semaphore()
+{
+	CloseHandle(sem);
+}
+
+void Semaphore::wait()
+{
+	WaitForSingleObject(sem, INFINITE);
+}
+
+bool Semaphore::try_wait()
+{
+	return WaitForSingleObject(sem, 0) == WAIT_OBJECT_0;
+}
+
+bool Semaphore::wait(unsigned int timeout_ms)
+{
+	return WaitForSingleObject(sem, timeout_ms) == WAIT_OBJECT_0;
+}
+
+void Semaphore::post()
+{
+	ReleaseSemaphore(sem, 1, NULL);
+}
+
+DWORD WINAPI Thread::thread_main(LPVOID param)
+{
+	((Thread*)(param))->run();
+	return 0;
+}
+
+bool Thread::start()
+{
+	assert(!running);
+
+	DWORD thread_id;
+	thread = CreateThread(NULL, 0, &thread_main, this, 0, &thread_id);
+
+	running = thread != NULL;
+	return running;
+}
+
+void Thread::join()
+{
+	if(running)
+	{
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+
+		running = false;
+	}
+}
+
+#else
+
+Mutex::Mutex()
+{
+	pthread_mutex_init(&mutex, NULL);
+}
+
+Mutex::~Mutex()
+{
+	pthread_mutex_destroy(&mutex);
+}
+
+void Mutex::lock()
+{
+	pthread_mutex_lock(&mutex);
+}
+
+void Mutex::unlock()
+{
+	pthread_mutex_unlock(&mutex);
+}
+
+Semaphore::Semaphore(unsigned int initial):
+	count(initial)
+{
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&cond, NULL);
+}
+
+Semaphore::~Semaphore()
+{
+	pthread_cond_destroy(&cond);
+	pthread_mutex_destroy(&mutex);
+}
+
+void Semaphore::wait()
+{
+	pthread_mutex_lock(&mutex);
+
+	while(count == 0)
+	{
+		pthread_cond_wait(&cond, &mutex);
+	}
+
+	--count;
+
+	pthread_mutex_unlock(&mutex);
+}
+
+bool Semaphore::try_wait()
+{
+	pthread_mutex_lock(&mutex);
+
+	bool got = count > 0;
+	if(got)
+	{
+		--count;
+	}
+
+	pthread_mutex_unlock(&mutex);
+
+	return got;
+}
+
+bool Semaphore::wait(unsigned int timeout_ms)
+{
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+
+	deadline.tv_sec += timeout_ms / 1000;
+	deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+
+	if(deadline.tv_nsec >= 1000000000)
+	{
+		++(deadline.tv_sec);
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&mutex);
+
+	while(count == 0)
+	{
+		if(pthread_cond_timedwait(&cond, &mutex, &deadline) != 0)
+		{
+			break;
+		}
+	}
+
+	bool got = count > 0;
+	if(got)
+	{
+		--count;
+	}
+
+	pthread_mutex_unlock(&mutex);
+
+	return got;
+}
+
+void Semaphore::post()
+{
+	pthread_mutex_lock(&mutex);
+	++count;
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mutex);
+}
+
+void *Thread::thread_main(void *param)
+{
+	((Thread*)(param))->run();
+	return NULL;
+}
+
+bool Thread::start()
+{
+	assert(!running);
+
+	running = pthread_create(&thread, NULL, &thread_main, this) == 0;
+	return running;
+}
+
+void Thread::join()
+{
+	if(running)
+	{
+		pthread_join(thread, NULL);
+		running = false;
+	}
+}
+
+#endif
+
+Thread::Thread():
+	running(false) {}
+
+Thread::~Thread()
+{
+	assert(!running);
+}
@@ -0,0 +1,120 @@
+#ifndef MMVRIPPER_THREADING_HPP
+#define MMVRIPPER_THREADING_HPP
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/* Minimal mutex wrapper for code which needs to build off Windows too. */
+class Mutex
+{
+private:
+#ifdef _WIN32
+	CRITICAL_SECTION cs;
+#else
+	pthread_mutex_t mutex;
+#endif
+
+	/* Not copyable. */
+	Mutex(const Mutex&);
+	Mutex &operator=(const Mutex&);
+
+public:
+	Mutex();
+	~Mutex();
+
+	void lock();
+	void unlock();
+};
+
+/* Holds a Mutex locked for the lifetime of the object. */
+class MutexLock
+{
+private:
+	Mutex &mutex;
+
+	MutexLock(const MutexLock&);
+	MutexLock &operator=(const MutexLock&);
+
+public:
+	MutexLock(Mutex &mutex):
+		mutex(mutex)
+	{
+		mutex.lock();
+	}
+
+	~MutexLock()
+	{
+		mutex.unlock();
+	}
+};
+
+/* Counting semaphore. */
+class Semaphore
+{
+private:
+#ifdef _WIN32
+	HANDLE sem;
+#else
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	unsigned int count;
+#endif
+
+	Semaphore(const Semaphore&);
+	Semaphore &operator=(const Semaphore&);
+
+public:
+	Semaphore(unsigned int initial = 0);
+	~Semaphore();
+
+	/* Waits until the count is above zero and decrements it. */
+	void wait();
+
+	/* Decrements the count if it is above zero, returns false if not. */
+	bool try_wait();
+
+	/* Like wait(), but gives up and returns false after timeout_ms. */
+	bool wait(unsigned int timeout_ms);
+
+	void post();
+};
+
+/* Thread which calls the run() method of a subclass. */
+class Thread
+{
+private:
+#ifdef _WIN32
+	HANDLE thread;
+
+	static DWORD WINAPI thread_main(LPVOID param);
+#else
+	pthread_t thread;
+
+	static void *thread_main(void *param);
+#endif
+
+	bool running;
+
+	Thread(const Thread&);
+	Thread &operator=(const Thread&);
+
+protected:
+	virtual void run() = 0;
+
+public:
+	Thread();
+
+	/* The thread must have been joined first. */
+	virtual ~Thread();
+
+	bool start();
+
+	/* Waits for run() to return. */
+	void join();
+};
+
+#endif /* !MMVRIPPER_THREADING_HPP */
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <map>
+#include <stdio.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "Clock.hpp"
+#include "Tracer.hpp"
+
+/* Write the trace out once this many events have been buffered. */
+static const size_t FLUSH_EVENTS = 4096;
+
+static const char *const PHASE_NAMES[TRACE_PHASE_COUNT] = {
+	"navigate",
+	"expand",
+	"collapse",
+	"capture",
+	"open",
+	"copy_wait",
+	"clipboard",
+	"print_wait",
+	"settle",
+	"save",
+	"write"
+};
+
+static unsigned long current_thread()
+{
+#ifdef _WIN32
+	return GetCurrentThreadId();
+#else
+	return (unsigned long)(pthread_self());
+#endif
+}
+
+/* Converts a duration in us to milliseconds. */
+static double ms(uint64 us)
+{
+	return (double)(us) / 1000.0;
+}
+
+Tracer::Tracer(unsigned int summary_interval):
+	file(NULL),
+	first_event(true),
+	origin_us(clock_us()),
+	summary_interval_us((uint64)(summary_interval) * 1000000),
+	last_summary_us(origin_us),
+	last_summary_done(0) {}
+
+Tracer::~Tracer()
+{
+	close();
+}
+
+const char *Tracer::phase_name(TracePhase phase)
+{
+	return PHASE_NAMES[phase];
+}
+
+bool Tracer::open(const char *filename)
+{
+	MutexLock l(lock);
+
+	file = fopen(filename, "w");
+	if(file == NULL)
+	{
+		return false;
+	}
+
+	fprintf(file, "[\n");
+	first_event = true;
+
+	return true;
+}
+
+void Tracer::close()
+{
+	MutexLock l(lock);
+
+	if(file != NULL)
+	{
+		flush();
+
+		fprintf(file, "\n]\n");
+		fclose(file);
+
+		file = NULL;
+	}
+}
+
+/* Writes out buffered events, with the lock held. */
+void Tracer::flush()
+{
+	for(size_t i = 0; i < buffer.size(); ++i)
+	{
+		const Event &e = buffer[i];
+
+		fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":" UINT64_FMT ",\"dur\":" UINT64_FMT ",\"pid\":1,\"tid\":%u,\"args\":{\"id\":%u}}",
+			(first_event ? "" : ",\n"), PHASE_NAMES[e.phase], e.start_us, e.duration_us, e.tid, e.id);
+
+		first_event = false;
+	}
+
+	buffer.clear();
+	fflush(file);
+}
+
+void Tracer::record(TracePhase phase, unsigned int id, uint64 start_us, uint64 end_us)
+{
+	uint64 duration = end_us - start_us;
+
+	MutexLock l(lock);
+
+	/* Nothing would ever clear them without summaries. */
+	if(summary_interval_us != 0)
+	{
+		interval[phase].push_back(duration);
+	}
+
+	if(file == NULL)
+	{
+		return;
+	}
+
+	unsigned long thread = current_thread();
+
+	std::map<unsigned long, unsigned int>::iterator t = tids.find(thread);
+	if(t == tids.end())
+	{
+		t = tids.insert(std::make_pair(thread, (unsigned int)(tids.size() + 1))).first;
+	}
+
+	Event e;
+	e.phase = phase;
+	e.id = id;
+	e.start_us = start_us - origin_us;
+	e.duration_us = duration;
+	e.tid = t->second;
+
+	buffer.push_back(e);
+
+	if(buffer.size() >= FLUSH_EVENTS)
+	{
+		flush();
+	}
+}
+
+void Tracer::progress(unsigned long done, unsigned long known)
+{
+	uint64 now = clock_us();
+
+	MutexLock l(lock);
+
+	if(summary_interval_us == 0 || now - last_summary_us < summary_interval_us)
+	{
+		return;
+	}
+
+	double minutes = (double)(now - last_summary_us) / 60000000.0;
+	double per_minute = (double)(done - last_summary_done) / minutes;
+
+	if(stage.empty())
+	{
+		fprintf(stderr, "[%lu/%lu] %.1f entries/min", done, known, per_minute);
+	}
+	else{
+		fprintf(stderr, "[%s %lu/%lu] %.1f entries/min", stage.c_str(), done, known, per_minute);
+	}
+
+	if(per_minute > 0.0 && known > done)
+	{
+		/* While walking the index, this only counts entries found so far,
+		 * so it is really a lower bound.
+		*/
+		unsigned long eta = (unsigned long)((double)(known - done) / per_minute);
+		fprintf(stderr, ", ETA %luh%02lum%s", eta / 60, eta % 60, (stage.empty() ? "+" : ""));
+	}
+
+	for(int p = 0; p < TRACE_PHASE_COUNT; ++p)
+	{
+		std::vector<uint64> &d = interval[p];
+
+		if(d.empty())
+		{
+			continue;
+		}
+
+		std::sort(d.begin(), d.end());
+
+		fprintf(stderr, " | %s %.1f/%.1fms", PHASE_NAMES[p],
+			ms(d[(d.size() - 1) / 2]), ms(d[((d.size() - 1) * 99) / 100]));
+
+		d.clear();
+	}
+
+	fprintf(stderr, "\n");
+
+	last_summary_us = now;
+	last_summary_done = done;
+}
+
+void Tracer::set_stage(const char *name)
+{
+	MutexLock l(lock);
+
+	stage = name;
+
+	last_summary_us = clock_us();
+	last_summary_done = 0;
+}
+
+TraceScope::TraceScope(Tracer *tracer, TracePhase phase, unsigned int id):
+	tracer(tracer),
+	phase(phase),
+	id(id),
+	start_us(tracer != NULL ? clock_us() : 0) {}
+
+TraceScope::~TraceScope()
+{
+	if(tracer != NULL)
+	{
+		tracer->record(phase, id, start_us, clock_us());
+	}
+}
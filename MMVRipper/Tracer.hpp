@@ -0,0 +1,129 @@
+#ifndef MMVRIPPER_TRACER_HPP
+#define MMVRIPPER_TRACER_HPP
+
+#include <map>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "IntTypes.hpp"
+#include "Threading.hpp"
+
+enum TracePhase
+{
+	TRACE_NAVIGATE,    /* Moving the cursor to an entry. */
+	TRACE_EXPAND,      /* Expanding (or trying to expand) an entry. */
+	TRACE_COLLAPSE,
+	TRACE_CAPTURE,     /* Screenshot of an entry. */
+	TRACE_OPEN,        /* Opening a topic. */
+	TRACE_COPY_WAIT,   /* Waiting for the Copy dialog. */
+	TRACE_CLIPBOARD,   /* Reading the text back off the clipboard. */
+	TRACE_PRINT_WAIT,  /* Waiting for a print job to arrive. */
+	TRACE_SETTLE,      /* Waiting for the viewer to settle. */
+	TRACE_SAVE,        /* Handing an artifact to the store. */
+	TRACE_WRITE,       /* Writing an artifact out (in the background). */
+
+	TRACE_PHASE_COUNT
+};
+
+/* Records how long each phase of the crawl takes.
+ *
+ * Every phase can be written to a trace file in the Chrome trace event (JSON
+ * array) format, which chrome://tracing and Perfetto can open. Events are
+ * buffered and written out in batches. If MMVRipper dies, the file is only
+ * missing the closing "]", which both viewers tolerate.
+ *
+ * It also prints a summary line every so often, with throughput, median and
+ * 99th percentile times for each phase, and an estimate of how much longer
+ * the crawl will take.
+ *
+ * Safe to use from multiple threads.
+*/
+class Tracer
+{
+private:
+	struct Event
+	{
+		TracePhase phase;
+		unsigned int id;
+		uint64 start_us, duration_us;
+		unsigned int tid;
+	};
+
+	Mutex lock;
+
+	FILE *file;
+	bool first_event;
+	std::vector<Event> buffer;
+
+	uint64 origin_us;
+
+	/* Small numbers for each thread, so the trace reads better. */
+	std::map<unsigned long, unsigned int> tids;
+
+	/* Durations since the last summary, if there are summaries. */
+	std::vector<uint64> interval[TRACE_PHASE_COUNT];
+
+	uint64 summary_interval_us;
+	uint64 last_summary_us;
+	unsigned long last_summary_done;
+
+	std::string stage;
+
+	void flush();
+
+	Tracer(const Tracer&);
+	Tracer &operator=(const Tracer&);
+
+public:
+	/* Prints a summary every summary_interval seconds, or never if zero. */
+	Tracer(unsigned int summary_interval);
+	~Tracer();
+
+	/* Starts writing trace events to a file. Returns false if it can't be
+	 * created.
+	*/
+	bool open(const char *filename);
+
+	/* Writes out anything buffered and finishes the file. */
+	void close();
+
+	/* Records a phase for index entry id (0 if none) which started at
+	 * start_us and ended at end_us (see clock_us()).
+	*/
+	void record(TracePhase phase, unsigned int id, uint64 start_us, uint64 end_us);
+
+	/* Prints a summary line to stderr if it is time for one. done is how
+	 * many index entries have been finished so far and known how many have
+	 * been found.
+	*/
+	void progress(unsigned long done, unsigned long known);
+
+	/* Starts counting progress through a new stage of the crawl from zero,
+	 * with its name in the summaries.
+	*/
+	void set_stage(const char *name);
+
+	static const char *phase_name(TracePhase phase);
+};
+
+/* Records a phase lasting from construction to destruction. The tracer may be
+ * NULL.
+*/
+class TraceScope
+{
+private:
+	Tracer *tracer;
+	TracePhase phase;
+	unsigned int id;
+	uint64 start_us;
+
+	TraceScope(const TraceScope&);
+	TraceScope &operator=(const TraceScope&);
+
+public:
+	TraceScope(Tracer *tracer, TracePhase phase, unsigned int id = 0);
+	~TraceScope();
+};
+
+#endif /* !MMVRIPPER_TRACER_HPP */
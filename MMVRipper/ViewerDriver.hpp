@@ -0,0 +1,132 @@
+#ifndef MMVRIPPER_VIEWERDRIVER_HPP
+#define MMVRIPPER_VIEWERDRIVER_HPP
+
+#include <string>
+
+#include "ChunkPool.hpp"
+#include "GrayImage.hpp"
+#include "Tracer.hpp"
+#include "WindowEvents.hpp"
+
+/* Everything the crawler needs to do to a Multimedia Viewer instance, so it
+ * can be pointed at either the real thing (Win32ViewerDriver) or a simulated
+ * one (SimulatedViewer).
+ *
+ * Listbox items are identified by their index in the index (PopNav) listbox
+ * and carry the internal page ID as their item data.
+*/
+class ViewerDriver
+{
+public:
+	enum Key
+	{
+		KEY_UP,
+		KEY_DOWN,
+		KEY_LEFT,
+		KEY_RIGHT,
+		KEY_HOME,
+		KEY_END
+	};
+
+	struct Rect
+	{
+		int left, top, right, bottom;
+	};
+
+protected:
+	unsigned long messages;     /* Messages sent to the viewer so far. */
+	unsigned long navigations;  /* ...of which just moved the cursor. */
+
+	Tracer *tracer;  /* May be NULL. */
+
+public:
+	ViewerDriver():
+		messages(0),
+		navigations(0),
+		tracer(NULL) {}
+
+	virtual ~ViewerDriver() {}
+
+	/* Records the dialog and print waits to tracer. */
+	void set_tracer(Tracer *tracer)
+	{
+		this->tracer = tracer;
+	}
+
+	unsigned long get_message_count() const
+	{
+		return messages;
+	}
+
+	unsigned long get_navigation_count() const
+	{
+		return navigations;
+	}
+
+	/* Sends a key press to the index listbox. */
+	virtual void press_key(Key key) = 0;
+
+	/* Selects a listbox item directly rather than by pressing keys. Returns
+	 * false if the viewer doesn't support it, in which case the selection is
+	 * unchanged.
+	*/
+	virtual bool set_cursor(unsigned int idx) = 0;
+
+	virtual unsigned int get_count() = 0;
+	virtual unsigned int get_cursor() = 0;
+	virtual unsigned int get_item_data(unsigned int idx) = 0;
+
+	/* Item rects are relative to the listbox client area, so they move as
+	 * the listbox scrolls.
+	*/
+	virtual Rect get_item_rect(unsigned int idx) = 0;
+
+	/* First item scrolled into view. */
+	virtual unsigned int get_top_index() = 0;
+
+	/* Scrolls the listbox to put an item at the top (or as near as it will
+	 * go), without changing the selection.
+	*/
+	virtual void set_top_index(unsigned int idx) = 0;
+
+	virtual Rect get_client_rect() = 0;
+
+	/* Takes a grayscale screenshot of part of the index listbox. Returns false
+	 * if there is nothing to capture.
+	*/
+	virtual bool capture(const Rect &rect, GrayImage *image) = 0;
+
+	/* Navigates the main window to the selected topic. */
+	virtual void open_selected() = 0;
+
+	/* Gets the text of the current topic using the "Copy" dialog. */
+	virtual bool copy_text(std::string *text) = 0;
+
+	/* Prints the current topic and waits for the print job to arrive. The
+	 * viewer may still be busy afterwards, see is_idle().
+	*/
+	virtual bool print(PrintJob *job) = 0;
+
+	/* Whether the viewer has finished whatever it was doing and is ready to
+	 * be asked for something else.
+	*/
+	virtual bool is_idle() = 0;
+
+	/* Gets rid of the "The ... argument is not valid" popup if it is open. */
+	virtual void dismiss_popups() = 0;
+
+	/* Whether the viewer is still running. Once it isn't, everything else
+	 * fails or returns nonsense.
+	*/
+	virtual bool is_alive() = 0;
+
+	/* Kills a viewer which has stopped responding, so whatever is waiting on
+	 * it gives up. May be called from another thread.
+	*/
+	virtual void kill() = 0;
+
+	/* How quickly the driver noticed dialogs appearing. */
+	virtual WindowEvents::Stats get_event_stats() = 0;
+};
+
+#endif /* !MMVRIPPER_VIEWERDRIVER_HPP */
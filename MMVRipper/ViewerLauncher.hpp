@@ -0,0 +1,20 @@
+#ifndef MMVRIPPER_VIEWERLAUNCHER_HPP
+#define MMVRIPPER_VIEWERLAUNCHER_HPP
+
+#include "ViewerDriver.hpp"
+
+/* Starts a viewer (or finds one which is already running) for Supervisor, so
+ * it can start another if it dies.
+*/
+class ViewerLauncher
+{
+public:
+	virtual ~ViewerLauncher() {}
+
+	/* Returns a driver for a freshly started viewer, NULL if one couldn't be
+	 * started. The launcher keeps ownership of the drivers it returns.
+	*/
+	virtual ViewerDriver *launch() = 0;
+};
+
+#endif /* !MMVRIPPER_VIEWERLAUNCHER_HPP */
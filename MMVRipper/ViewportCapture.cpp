@@ -0,0 +1,100 @@
+#include <string.h>
+#include <vector>
+
+#include "ViewportCapture.hpp"
+
+ViewportCapture::ViewportCapture(ViewerDriver *viewer, const ListboxModel *listbox):
+	viewer(viewer),
+	listbox(listbox),
+	valid(false),
+	frame_top(0),
+	frame_cursor(0),
+	row_height(0)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+/* Scrolls row idx to the top of the listbox (or as far up as it goes) and
+ * captures everything in view.
+*/
+bool ViewportCapture::take_frame(unsigned int idx)
+{
+	valid = false;
+
+	viewer->set_top_index(idx);
+
+	ViewerDriver::Rect client = viewer->get_client_rect();
+	if(!viewer->capture(client, &frame))
+	{
+		return false;
+	}
+
+	++(stats.frames);
+
+	frame_top = viewer->get_top_index();
+	frame_cursor = listbox->get_cursor();
+
+	/* The model is only checked at the top row, the crawler keeps it right
+	 * everywhere else.
+	*/
+	if(frame_top >= listbox->size() || viewer->get_item_data(frame_top) != listbox->item(frame_top))
+	{
+		return false;
+	}
+
+	/* Listbox rows are all the same height. */
+
+	ViewerDriver::Rect r = viewer->get_item_rect(frame_top);
+	row_height = r.bottom - r.top;
+
+	if(r.top != 0 || row_height <= 0)
+	{
+		return false;
+	}
+
+	frame_items.clear();
+
+	for(unsigned int i = frame_top; i < listbox->size() && (int)(i - frame_top + 1) * row_height <= (int)(frame.height); ++i)
+	{
+		frame_items.push_back(listbox->item(i));
+	}
+
+	valid = true;
+	return true;
+}
+
+bool ViewportCapture::capture_row(unsigned int idx, unsigned int id, GrayImage *image)
+{
+	if(in_frame(idx) && frame_items[idx - frame_top] != id)
+	{
+		/* The rows moved since the frame was taken without anyone telling
+		 * us, get a fresh one.
+		*/
+		++(stats.mismatches);
+		valid = false;
+	}
+
+	if(!in_frame(idx) && !take_frame(idx))
+	{
+		return false;
+	}
+
+	if(!in_frame(idx) || frame_items[idx - frame_top] != id)
+	{
+		++(stats.mismatches);
+		valid = false;
+
+		return false;
+	}
+
+	image->crop(frame, 0, (idx - frame_top) * row_height, frame.width, row_height);
+
+	if(idx != frame_cursor)
+	{
+		image->invert();
+	}
+
+	++(stats.crops);
+
+	return true;
+}
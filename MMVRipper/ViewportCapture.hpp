@@ -0,0 +1,81 @@
+#ifndef MMVRIPPER_VIEWPORTCAPTURE_HPP
+#define MMVRIPPER_VIEWPORTCAPTURE_HPP
+
+#include <vector>
+
+#include "GrayImage.hpp"
+#include "ListboxModel.hpp"
+#include "ViewerDriver.hpp"
+
+/* Captures index rows by grabbing the whole visible part of the listbox once
+ * and cutting each row out of it, rather than capturing every row separately.
+ *
+ * Before taking a frame the listbox is scrolled to put the wanted row at the
+ * top, so the rows after it (which the crawler visits next) are in it too.
+ * Each frame remembers which item was in each row when it was taken (from the
+ * ListboxModel, checked against the listbox at the top row), and a row is
+ * only cut from a frame if the item in that row is the one being asked for.
+ * Call invalidate() when the rows in the listbox change.
+ *
+ * Rows are cropped to look like they did when selected, since that is how
+ * they looked when they were captured one at a time.
+*/
+class ViewportCapture
+{
+public:
+	struct Stats
+	{
+		unsigned long frames;      /* Captures of the whole listbox. */
+		unsigned long crops;       /* Rows cut out of a frame. */
+		unsigned long mismatches;  /* Row didn't hold the expected item. */
+	};
+
+private:
+	ViewerDriver *viewer;
+	const ListboxModel *listbox;
+
+	GrayImage frame;
+	bool valid;
+
+	unsigned int frame_top;     /* First row in the frame. */
+	unsigned int frame_cursor;  /* Row selected when it was taken. */
+	int row_height;
+	std::vector<unsigned int> frame_items;
+
+	Stats stats;
+
+	bool take_frame(unsigned int idx);
+
+	bool in_frame(unsigned int idx) const
+	{
+		return valid && idx >= frame_top && idx - frame_top < frame_items.size();
+	}
+
+public:
+	ViewportCapture(ViewerDriver *viewer, const ListboxModel *listbox);
+
+	/* Forgets the current frame. */
+	void invalidate()
+	{
+		valid = false;
+	}
+
+	/* Switches to a new viewer, after the old one died. */
+	void set_viewer(ViewerDriver *viewer)
+	{
+		this->viewer = viewer;
+		valid = false;
+	}
+
+	Stats get_stats() const
+	{
+		return stats;
+	}
+
+	/* Captures row idx, which should hold item id. Returns false if the row
+	 * couldn't be captured.
+	*/
+	bool capture_row(unsigned int idx, unsigned int id, GrayImage *image);
+};
+
+#endif /* !MMVRIPPER_VIEWPORTCAPTURE_HPP */
@@ -0,0 +1,688 @@
+#ifdef _WIN32
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <winsock2.h>
+#include <windows.h>
+
+#include "StupidMessageHandler.hpp"
+#include "Threading.hpp"
+#include "Win32ViewerDriver.hpp"
+
+/* How long to wait for a window event before looking for the window the old
+ * way, in case the event was missed.
+*/
+static const unsigned int WINDOW_TIMEOUT_MS = 250;
+
+/* How often to check for popups while waiting for a print job. */
+static const unsigned int PRINT_POLL_MS = 50;
+
+/* The clipboard is shared by every viewer, only one can copy through it at a
+ * time.
+*/
+static Mutex clipboard_lock;
+
+static int find_menu_item_id(HWND hWnd, const char *name)
+{
+	HMENU windoc_menu = GetMenu(hWnd);
+
+	int i, j;
+
+	for(i = 0; i < 10; ++i)
+	{
+		HMENU submenu = GetSubMenu(windoc_menu, i);
+
+		if(submenu != NULL)
+		{
+			int num_menu_items = GetMenuItemCount(submenu);
+
+			for(j = 0; j < num_menu_items; ++j)
+			{
+				char item_name[32];
+				int in_len = GetMenuString(submenu, j, item_name, sizeof(item_name), MF_BYPOSITION);
+
+				if(in_len > 0 && strcmp(item_name, name) == 0)
+				{
+					return GetMenuItemID(submenu, j);
+				}
+			}
+		}
+	}
+
+	return -1;
+}
+
+static BOOL CALLBACK find_listbox(HWND hWnd, LPARAM lParam)
+{
+	TCHAR class_name[128];
+	if(GetClassName(hWnd, class_name, sizeof(class_name)) == 0)
+	{
+		/* Keep searching. */
+		return TRUE;
+	}
+
+	if(strcmp(class_name, "ListBox") == 0)
+	{
+		HWND *dest_hwnd = (HWND*)(lParam);
+		*dest_hwnd = hWnd;
+		return FALSE;
+	}
+
+	/* Keep searching. */
+	return TRUE;
+}
+
+struct FindWindows
+{
+	const char *class_name;
+	std::vector< std::pair<DWORD, HWND> > found;  /* Sorted by process ID. */
+};
+
+static BOOL CALLBACK find_windows(HWND hWnd, LPARAM lParam)
+{
+	TCHAR class_name[128];
+	if(GetClassName(hWnd, class_name, sizeof(class_name)) == 0)
+	{
+		/* Keep searching. */
+		return TRUE;
+	}
+
+	FindWindows *fw = (FindWindows*)(lParam);
+
+	if(strcmp(class_name, fw->class_name) == 0)
+	{
+		DWORD process_id;
+		GetWindowThreadProcessId(hWnd, &process_id);
+
+		fw->found.push_back(std::make_pair(process_id, hWnd));
+	}
+
+	/* Keep searching. */
+	return TRUE;
+}
+
+/* Finds every top level window of a class, in order of which process they
+ * belong to so each viewer keeps the same number while they are running.
+*/
+static std::vector< std::pair<DWORD, HWND> > find_all_windows(const char *class_name)
+{
+	FindWindows fw;
+	fw.class_name = class_name;
+
+	EnumWindows(&find_windows, (LPARAM)(&fw));
+	std::sort(fw.found.begin(), fw.found.end());
+
+	return fw.found;
+}
+
+struct FindCopyDialog
+{
+	HWND windoc;
+	HWND dialog;
+};
+
+static BOOL CALLBACK find_copy_dialog(HWND hWnd, LPARAM lParam)
+{
+	char window_text[128];
+	if(GetWindowText(hWnd, window_text, sizeof(window_text)) == 0)
+	{
+		/* Keep searching. */
+		return TRUE;
+	}
+
+	FindCopyDialog *fcd = (FindCopyDialog*)(lParam);
+
+	HWND parent = GetParent(hWnd);
+
+	if(strcmp(window_text, "Copy") == 0 && parent == fcd->windoc)
+	{
+		fcd->dialog = hWnd;
+		return FALSE;
+	}
+
+	/* Keep searching. */
+	return TRUE;
+}
+
+static BOOL CALLBACK find_copy_edit(HWND hWnd, LPARAM lParam)
+{
+	TCHAR class_name[128];
+	if(GetClassName(hWnd, class_name, sizeof(class_name)) == 0)
+	{
+		/* Keep searching. */
+		return TRUE;
+	}
+
+	if(strcmp(class_name, "Edit") == 0)
+	{
+		HWND *dest_hwnd = (HWND*)(lParam);
+		*dest_hwnd = hWnd;
+		return FALSE;
+	}
+
+	/* Keep searching. */
+	return TRUE;
+}
+
+Win32ViewerDriver::Win32ViewerDriver(HWND windoc, HWND popnav, HWND listbox, DummyPrinter *print_server):
+	windoc(windoc),
+	popnav(popnav),
+	listbox(listbox),
+	print_server(print_server),
+	process(NULL),
+	print_menu_id(-1),
+	event_source(NULL),
+	hdcMemDC(NULL),
+	hbmScreen(NULL),
+	hbmOriginal(NULL),
+	dib_bits(NULL),
+	dib_width(0),
+	dib_height(0)
+{
+	/* Bring PopNav to the front so it actually draws and we can capture it. */
+	BringWindowToTop(popnav);
+
+	DWORD process_id;
+	GetWindowThreadProcessId(windoc, &process_id);
+
+	process = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_TERMINATE | SYNCHRONIZE, FALSE, process_id);
+	print_menu_id = find_menu_item_id(windoc, "&Print Topic...");
+
+	event_source = new Win32WindowEventSource(&events, process_id);
+
+	if(!event_source->start_hook())
+	{
+		fprintf(stderr, "Unable to watch the viewer's windows, will poll for them instead\n");
+
+		delete event_source;
+		event_source = NULL;
+	}
+}
+
+Win32ViewerDriver *Win32ViewerDriver::find(DummyPrinter *print_server, unsigned int instance)
+{
+	std::vector< std::pair<DWORD, HWND> > windocs = find_all_windows("MS_WINDOC");
+
+	if(instance >= windocs.size())
+	{
+		fprintf(stderr, "Unable to find MS_WINDOC window (viewer %u)\n", instance);
+		return NULL;
+	}
+
+	return find_process(print_server, windocs[instance].first, true);
+}
+
+Win32ViewerDriver *Win32ViewerDriver::find_process(DummyPrinter *print_server, DWORD process_id, bool verbose)
+{
+	std::vector< std::pair<DWORD, HWND> > windocs = find_all_windows("MS_WINDOC");
+	std::vector< std::pair<DWORD, HWND> > popnavs = find_all_windows("PopNav");
+
+	HWND windoc = NULL;
+
+	for(size_t i = 0; i < windocs.size() && windoc == NULL; ++i)
+	{
+		if(windocs[i].first == process_id)
+		{
+			windoc = windocs[i].second;
+		}
+	}
+
+	HWND popnav = NULL;
+
+	for(size_t i = 0; i < popnavs.size() && popnav == NULL; ++i)
+	{
+		if(popnavs[i].first == process_id)
+		{
+			popnav = popnavs[i].second;
+		}
+	}
+
+	if(windoc == NULL || popnav == NULL)
+	{
+		if(verbose)
+		{
+			fprintf(stderr, "Unable to find %s window of process %u\n",
+				(windoc == NULL ? "MS_WINDOC" : "PopNav (Index)"), (unsigned)(process_id));
+		}
+
+		return NULL;
+	}
+
+	HWND listbox = NULL;
+	EnumChildWindows(popnav, &find_listbox, (LPARAM)(&listbox));
+
+	if(listbox == NULL)
+	{
+		if(verbose)
+		{
+			fprintf(stderr, "Unable to find ListBox in PopNav (Index) window\n");
+		}
+
+		return NULL;
+	}
+
+	return new Win32ViewerDriver(windoc, popnav, listbox, print_server);
+}
+
+Win32ViewerDriver::~Win32ViewerDriver()
+{
+	if(event_source != NULL)
+	{
+		event_source->stop();
+		delete event_source;
+	}
+
+	if(process != NULL)
+	{
+		CloseHandle(process);
+	}
+
+	if(hdcMemDC != NULL)
+	{
+		SelectObject(hdcMemDC, hbmOriginal);
+		DeleteDC(hdcMemDC);
+	}
+
+	if(hbmScreen != NULL)
+	{
+		DeleteObject(hbmScreen);
+	}
+}
+
+void Win32ViewerDriver::press_key(Key key)
+{
+	static const int vk[] = { VK_UP, VK_DOWN, VK_LEFT, VK_RIGHT, VK_HOME, VK_END };
+	SendMessage(listbox, WM_KEYDOWN, vk[key], 0);
+
+	++messages;
+
+	if(key != KEY_LEFT && key != KEY_RIGHT)
+	{
+		++navigations;
+	}
+}
+
+bool Win32ViewerDriver::set_cursor(unsigned int idx)
+{
+	++messages;
+
+	if(SendMessage(listbox, LB_SETCURSEL, idx, 0) == LB_ERR)
+	{
+		return false;
+	}
+
+	/* LB_SETCURSEL doesn't notify the owner the way a real selection change
+	 * does, and PopNav only updates its idea of the selected item when it
+	 * gets LBN_SELCHANGE, so send that too.
+	*/
+	SendMessage(popnav, WM_COMMAND, MAKEWPARAM(GetDlgCtrlID(listbox), LBN_SELCHANGE), (LPARAM)(listbox));
+
+	++messages;
+	++navigations;
+
+	return true;
+}
+
+unsigned int Win32ViewerDriver::get_count()
+{
+	++messages;
+	return SendMessage(listbox, LB_GETCOUNT, 0, 0);
+}
+
+unsigned int Win32ViewerDriver::get_cursor()
+{
+	++messages;
+	return SendMessage(listbox, LB_GETCURSEL, 0, 0);
+}
+
+unsigned int Win32ViewerDriver::get_item_data(unsigned int idx)
+{
+	++messages;
+	return SendMessage(listbox, LB_GETITEMDATA, idx, 0);
+}
+
+ViewerDriver::Rect Win32ViewerDriver::get_item_rect(unsigned int idx)
+{
+	RECT r;
+	SendMessage(listbox, LB_GETITEMRECT, idx, (LPARAM)(&r));
+	++messages;
+
+	Rect rect = { r.left, r.top, r.right, r.bottom };
+	return rect;
+}
+
+unsigned int Win32ViewerDriver::get_top_index()
+{
+	++messages;
+	return SendMessage(listbox, LB_GETTOPINDEX, 0, 0);
+}
+
+void Win32ViewerDriver::set_top_index(unsigned int idx)
+{
+	++messages;
+	SendMessage(listbox, LB_SETTOPINDEX, idx, 0);
+}
+
+ViewerDriver::Rect Win32ViewerDriver::get_client_rect()
+{
+	RECT r;
+	GetClientRect(listbox, &r);
+
+	Rect rect = { r.left, r.top, r.right, r.bottom };
+	return rect;
+}
+
+void Win32ViewerDriver::open_selected()
+{
+	/* Pressing enter on the listbox navigates the main window to the
+	 * selected topic.
+	*/
+	SendMessage(listbox, WM_CHAR, '\r', 0);
+	++messages;
+}
+
+bool Win32ViewerDriver::copy_text(std::string *text)
+{
+	MutexLock cl(clipboard_lock);
+
+	BOOL x = OpenClipboard(NULL);
+	assert(x);
+
+	EmptyClipboard();
+	CloseClipboard();
+
+	/* A dialog found by looking for it last time leaves its event behind,
+	 * by now for a window which has gone away.
+	*/
+	events.discard("Copy", windoc);
+
+	/* The "Copy" commad from the "Edit" menu... */
+	PostMessage(windoc, WM_COMMAND, 1203, 0);
+
+	HWND copy_dialog = NULL;
+
+	{
+		TraceScope trace(tracer, TRACE_COPY_WAIT);
+
+		while(copy_dialog == NULL)
+		{
+			WindowEvent event;
+
+			if(events.try_take("Copy", windoc, &event))
+			{
+				/* Closed again already? Then it wasn't ours. */
+				if(IsWindow((HWND)(event.window)))
+				{
+					copy_dialog = (HWND)(event.window);
+					break;
+				}
+
+				continue;
+			}
+
+			/* The popup stops the dialog from opening. */
+			dismiss_popups();
+
+			if(!events.wait_any(WINDOW_TIMEOUT_MS))
+			{
+				/* Nothing happened for a while, make sure we didn't miss it. */
+
+				FindCopyDialog fcd = { windoc, NULL };
+				EnumWindows(&find_copy_dialog, (LPARAM)(&fcd));
+
+				copy_dialog = fcd.dialog;
+
+				if(copy_dialog == NULL && !is_alive())
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	HWND edit_ctl = NULL;
+	EnumChildWindows(copy_dialog, &find_copy_edit, (LPARAM)(&edit_ctl));
+
+	SendMessage(edit_ctl, EM_SETSEL, 0, -1);
+
+	SendMessage(copy_dialog, WM_COMMAND, MAKEWPARAM(IDOK, BN_CLICKED), 0);
+
+	/* WM_COMMAND, EM_SETSEL and IDOK. */
+	messages += 3;
+
+	TraceScope trace(tracer, TRACE_CLIPBOARD);
+
+	x = OpenClipboard(NULL);
+
+	HANDLE clipboard_data = GetClipboardData(CF_OEMTEXT);
+	if(clipboard_data == NULL)
+	{
+		/* The viewer went away before it copied anything. */
+		CloseClipboard();
+		return false;
+	}
+
+	const char *clipboard_text = (const char*)(GlobalLock(clipboard_data));
+	text->assign(clipboard_text);
+
+	GlobalUnlock(clipboard_data);
+	CloseClipboard();
+
+	return true;
+}
+
+bool Win32ViewerDriver::print(PrintJob *job)
+{
+	if(print_server == NULL)
+	{
+		return false;
+	}
+
+	/* Anything already waiting can't be the printout we're about to ask
+	 * for, and would be taken for it.
+	*/
+	unsigned int stale = print_server->discard_prints();
+	if(stale > 0)
+	{
+		fprintf(stderr, "Discarded %u print jobs nobody asked for\n", stale);
+	}
+
+	/* Command 1103 appears to be a fixed internal command for printing
+	 * the current topic in MMV. There is a dynamically generated ID
+	 * for the "Print Topic" menu command, however this acts as a proxy
+	 * and seems to randomly fail with an unhelpful error if you use it
+	 * enough.
+	*/
+
+	PostMessage(windoc, WM_COMMAND, 1103, 0);
+	++messages;
+
+	TraceScope trace(tracer, TRACE_PRINT_WAIT);
+
+	while(!print_server->wait_for_print(PRINT_POLL_MS))
+	{
+		if(!is_alive())
+		{
+			return false;
+		}
+
+		dismiss_popups();
+	}
+
+	unsigned int connection = print_server->get_next_print(job);
+
+	/* Each printout comes down its own connection. If the connection carried
+	 * more than one job, the printout was split where it shouldn't have been
+	 * and this is only part of it - and the rest would be taken for the next
+	 * page if we didn't wait for the connection to close and check.
+	*/
+
+	unsigned int jobs;
+	while(!print_server->wait_for_close(connection, PRINT_POLL_MS, &jobs))
+	{
+		if(!is_alive())
+		{
+			job->clear();
+			return false;
+		}
+
+		dismiss_popups();
+	}
+
+	if(jobs != 1)
+	{
+		fprintf(stderr, "Printout was split into %u jobs, not using it\n", jobs);
+
+		job->clear();
+		print_server->discard_prints();
+
+		return false;
+	}
+
+	return true;
+}
+
+bool Win32ViewerDriver::is_idle()
+{
+	/* The viewer is waiting for input again... */
+	if(process != NULL && WaitForInputIdle(process, 0) != 0)
+	{
+		return false;
+	}
+
+	/* ...and has put the print command back in its menu. */
+	if(print_menu_id >= 0)
+	{
+		UINT state = GetMenuState(GetMenu(windoc), print_menu_id, MF_BYCOMMAND);
+
+		if(state != (UINT)(-1) && (state & (MF_GRAYED | MF_DISABLED)) != 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void Win32ViewerDriver::dismiss_popups()
+{
+	if(event_source == NULL)
+	{
+		StupidMessageHandler::run();
+		return;
+	}
+
+	WindowEvent event;
+
+	while(events.try_take("Navigator", NULL, &event))
+	{
+		if(IsWindow((HWND)(event.window)) && StupidMessageHandler::dismiss((HWND)(event.window)))
+		{
+			++messages;
+		}
+	}
+}
+
+bool Win32ViewerDriver::is_alive()
+{
+	return process != NULL && WaitForSingleObject(process, 0) == WAIT_TIMEOUT && IsWindow(windoc);
+}
+
+void Win32ViewerDriver::kill()
+{
+	if(process != NULL)
+	{
+		TerminateProcess(process, 1);
+	}
+}
+
+bool Win32ViewerDriver::capture(const Rect &rect, GrayImage *image)
+{
+	int width = rect.right - rect.left;
+	int height = rect.bottom - rect.top;
+
+	if(width <= 0 || height <= 0)
+	{
+		return false;
+	}
+
+	HDC hdcWindow = GetDC(listbox);
+	bool ok = false;
+
+	if(hdcMemDC == NULL)
+	{
+		hdcMemDC = CreateCompatibleDC(hdcWindow);
+
+		if(hdcMemDC == NULL)
+		{
+			fprintf(stderr, "CreateCompatibleDC failed\n");
+			goto done;
+		}
+	}
+
+	if(hbmScreen == NULL || width != dib_width || height != dib_height)
+	{
+		if(hbmScreen != NULL)
+		{
+			SelectObject(hdcMemDC, hbmOriginal);
+			DeleteObject(hbmScreen);
+
+			hbmScreen = NULL;
+		}
+
+		/* A top-down 32bpp DIB section, so BitBlt draws straight into
+		 * memory we can read the pixels from without GetDIBits().
+		*/
+
+		BITMAPINFO bmi;
+		memset(&bmi, 0, sizeof(bmi));
+
+		bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+		bmi.bmiHeader.biWidth = width;
+		bmi.bmiHeader.biHeight = -height;
+		bmi.bmiHeader.biPlanes = 1;
+		bmi.bmiHeader.biBitCount = 32;
+		bmi.bmiHeader.biCompression = BI_RGB;
+
+		void *bits = NULL;
+		hbmScreen = CreateDIBSection(hdcWindow, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+
+		if(hbmScreen == NULL)
+		{
+			fprintf(stderr, "CreateDIBSection failed\n");
+			goto done;
+		}
+
+		dib_bits = (unsigned char*)(bits);
+		dib_width = width;
+		dib_height = height;
+
+		hbmOriginal = SelectObject(hdcMemDC, hbmScreen);
+	}
+
+	if(!BitBlt(hdcMemDC, 0, 0, width, height, hdcWindow, rect.left, rect.top, SRCCOPY))
+	{
+		fprintf(stderr, "BitBlt failed\n");
+		goto done;
+	}
+
+	/* Make sure GDI has finished drawing before we look at the bits. */
+	GdiFlush();
+
+	image->from_bgrx(dib_bits, width * 4, width, height);
+	ok = true;
+
+done:
+	ReleaseDC(listbox, hdcWindow);
+
+	return ok;
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,95 @@
+#ifndef MMVRIPPER_WIN32VIEWERDRIVER_HPP
+#define MMVRIPPER_WIN32VIEWERDRIVER_HPP
+
+#ifdef _WIN32
+
+#include <string>
+
+#include <winsock2.h>
+#include <windows.h>
+
+#include "DummyPrinter.hpp"
+#include "ViewerDriver.hpp"
+#include "Win32WindowEventSource.hpp"
+#include "WindowEvents.hpp"
+
+/* ViewerDriver which pokes at a real Multimedia Viewer window. */
+class Win32ViewerDriver: public ViewerDriver
+{
+private:
+	HWND windoc;
+	HWND popnav;
+	HWND listbox;
+
+	DummyPrinter *print_server;
+
+	/* For checking whether the viewer is busy. print_menu_id is -1 if the
+	 * print command couldn't be found in the menu.
+	*/
+	HANDLE process;
+	int print_menu_id;
+
+	/* Dialogs the viewer opens, NULL event_source if the hook couldn't be
+	 * installed (in which case we go back to looking for them).
+	*/
+	WindowEvents events;
+	Win32WindowEventSource *event_source;
+
+	/* Memory DC with a DIB section selected into it which captures are drawn
+	 * into, recreated whenever the size of the capture changes.
+	*/
+	HDC hdcMemDC;
+	HBITMAP hbmScreen;
+	HGDIOBJ hbmOriginal;
+	unsigned char *dib_bits;
+	int dib_width, dib_height;
+
+	Win32ViewerDriver(HWND windoc, HWND popnav, HWND listbox, DummyPrinter *print_server);
+
+public:
+	/* Finds the windows of a running viewer, returns NULL if they can't be
+	 * found. With more than one viewer running, instance picks which one
+	 * (they are numbered in order of process ID). Printing is only possible
+	 * if print_server is non-NULL.
+	*/
+	static Win32ViewerDriver *find(DummyPrinter *print_server, unsigned int instance = 0);
+
+	/* Finds the windows of the viewer running as process_id, returns NULL
+	 * (complaining about it if verbose is true) if they aren't there (yet).
+	*/
+	static Win32ViewerDriver *find_process(DummyPrinter *print_server, DWORD process_id, bool verbose);
+
+	virtual ~Win32ViewerDriver();
+
+	virtual void press_key(Key key);
+	virtual bool set_cursor(unsigned int idx);
+
+	virtual unsigned int get_count();
+	virtual unsigned int get_cursor();
+	virtual unsigned int get_item_data(unsigned int idx);
+	virtual Rect get_item_rect(unsigned int idx);
+	virtual unsigned int get_top_index();
+	virtual void set_top_index(unsigned int idx);
+	virtual Rect get_client_rect();
+
+	virtual bool capture(const Rect &rect, GrayImage *image);
+
+	virtual void open_selected();
+	virtual bool copy_text(std::string *text);
+	virtual bool print(PrintJob *job);
+
+	virtual bool is_idle();
+	virtual void dismiss_popups();
+
+	virtual bool is_alive();
+	virtual void kill();
+
+	virtual WindowEvents::Stats get_event_stats()
+	{
+		return events.get_stats();
+	}
+};
+
+#endif /* _WIN32 */
+
+#endif /* !MMVRIPPER_WIN32VIEWERDRIVER_HPP */
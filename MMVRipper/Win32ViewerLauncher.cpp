@@ -0,0 +1,86 @@
+#ifdef _WIN32
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <winsock2.h>
+#include <windows.h>
+
+#include "Win32ViewerLauncher.hpp"
+
+/* How long a new viewer gets to open its windows, and how often we look. */
+static const DWORD LAUNCH_TIMEOUT_MS = 60000;
+static const DWORD LAUNCH_POLL_MS = 500;
+
+Win32ViewerLauncher::Win32ViewerLauncher(DummyPrinter *print_server, unsigned int instance, const char *command):
+	print_server(print_server),
+	instance(instance),
+	command(command != NULL ? command : "") {}
+
+Win32ViewerLauncher::~Win32ViewerLauncher()
+{
+	for(size_t i = 0; i < drivers.size(); ++i)
+	{
+		delete drivers[i];
+	}
+}
+
+ViewerDriver *Win32ViewerLauncher::launch()
+{
+	Win32ViewerDriver *driver = NULL;
+
+	if(drivers.empty())
+	{
+		/* Use the one the user started, if they did. */
+		driver = Win32ViewerDriver::find(print_server, instance);
+	}
+
+	if(driver == NULL && !command.empty())
+	{
+		fprintf(stderr, "Starting %s\n", command.c_str());
+
+		std::vector<char> cmdline(command.begin(), command.end());
+		cmdline.push_back('\0');
+
+		STARTUPINFO si;
+		ZeroMemory(&si, sizeof(si));
+		si.cb = sizeof(si);
+
+		PROCESS_INFORMATION pi;
+
+		if(!CreateProcess(NULL, &cmdline[0], NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi))
+		{
+			fprintf(stderr, "CreateProcess: %u\n", (unsigned)(GetLastError()));
+			return NULL;
+		}
+
+		WaitForInputIdle(pi.hProcess, LAUNCH_TIMEOUT_MS);
+
+		DWORD start = GetTickCount();
+
+		while(driver == NULL && GetTickCount() - start < LAUNCH_TIMEOUT_MS
+			&& WaitForSingleObject(pi.hProcess, LAUNCH_POLL_MS) == WAIT_TIMEOUT)
+		{
+			driver = Win32ViewerDriver::find_process(print_server, pi.dwProcessId, false);
+		}
+
+		if(driver == NULL)
+		{
+			fprintf(stderr, "The viewer didn't open its index window, giving up on it\n");
+			TerminateProcess(pi.hProcess, 1);
+		}
+
+		CloseHandle(pi.hThread);
+		CloseHandle(pi.hProcess);
+	}
+
+	if(driver != NULL)
+	{
+		drivers.push_back(driver);
+	}
+
+	return driver;
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,48 @@
+#ifndef MMVRIPPER_WIN32VIEWERLAUNCHER_HPP
+#define MMVRIPPER_WIN32VIEWERLAUNCHER_HPP
+
+#ifdef _WIN32
+
+#include <string>
+#include <vector>
+
+#include <winsock2.h>
+#include <windows.h>
+
+#include "DummyPrinter.hpp"
+#include "ViewerLauncher.hpp"
+#include "Win32ViewerDriver.hpp"
+
+/* Uses a viewer which is already running the first time, then starts new
+ * ones by running a command (if there is one).
+ *
+ * The viewer has to come up with its index window open for the crawler to
+ * find it, so it should be set up to do that (or command should be something
+ * which does it).
+*/
+class Win32ViewerLauncher: public ViewerLauncher
+{
+private:
+	DummyPrinter *print_server;
+	unsigned int instance;
+	std::string command;
+
+	std::vector<Win32ViewerDriver*> drivers;
+
+	/* Not copyable. */
+	Win32ViewerLauncher(const Win32ViewerLauncher&);
+	Win32ViewerLauncher &operator=(const Win32ViewerLauncher&);
+
+public:
+	/* instance is passed to Win32ViewerDriver::find() the first time. If
+	 * command is NULL, a viewer which dies can't be replaced.
+	*/
+	Win32ViewerLauncher(DummyPrinter *print_server, unsigned int instance, const char *command);
+	virtual ~Win32ViewerLauncher();
+
+	virtual ViewerDriver *launch();
+};
+
+#endif /* _WIN32 */
+
+#endif /* !MMVRIPPER_WIN32VIEWERLAUNCHER_HPP */
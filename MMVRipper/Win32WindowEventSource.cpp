@@ -0,0 +1,130 @@
+#ifdef _WIN32
+
+#include <assert.h>
+#include <map>
+#include <stdio.h>
+
+#include <winsock2.h>
+#include <windows.h>
+
+#include "Win32WindowEventSource.hpp"
+
+Mutex Win32WindowEventSource::sources_lock;
+std::map<HWINEVENTHOOK, Win32WindowEventSource*> Win32WindowEventSource::sources;
+
+Win32WindowEventSource::Win32WindowEventSource(WindowEvents *events, DWORD process_id):
+	events(events),
+	process_id(process_id),
+	thread_id(0),
+	hooked(false) {}
+
+Win32WindowEventSource::~Win32WindowEventSource()
+{
+	stop();
+}
+
+bool Win32WindowEventSource::start_hook()
+{
+	if(!start())
+	{
+		return false;
+	}
+
+	/* Wait for the thread to say whether the hook went in. */
+	started.wait();
+
+	if(!hooked)
+	{
+		join();
+	}
+
+	return hooked;
+}
+
+void Win32WindowEventSource::stop()
+{
+	if(hooked)
+	{
+		PostThreadMessage(thread_id, WM_QUIT, 0, 0);
+		join();
+
+		hooked = false;
+	}
+}
+
+void Win32WindowEventSource::run()
+{
+	thread_id = GetCurrentThreadId();
+
+	/* Make sure the thread has a message queue before anyone posts to it. */
+	MSG msg;
+	PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
+
+	/* Events can't arrive until we pump messages, so the hook is in the map
+	 * before the callback needs it.
+	*/
+	HWINEVENTHOOK hook = SetWinEventHook(EVENT_OBJECT_SHOW, EVENT_OBJECT_SHOW,
+		NULL, &event_proc, process_id, 0, WINEVENT_OUTOFCONTEXT);
+
+	if(hook != NULL)
+	{
+		MutexLock l(sources_lock);
+		sources[hook] = this;
+	}
+
+	hooked = hook != NULL;
+	started.post();
+
+	if(hook == NULL)
+	{
+		fprintf(stderr, "SetWinEventHook: %u\n", (unsigned)(GetLastError()));
+		return;
+	}
+
+	/* Out of context events are delivered through this thread's message
+	 * queue.
+	*/
+	while(GetMessage(&msg, NULL, 0, 0) > 0)
+	{
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+
+	UnhookWinEvent(hook);
+
+	MutexLock l(sources_lock);
+	sources.erase(hook);
+}
+
+void CALLBACK Win32WindowEventSource::event_proc(HWINEVENTHOOK hook, DWORD event, HWND hwnd,
+	LONG id_object, LONG id_child, DWORD event_thread, DWORD event_time)
+{
+	if(id_object != OBJID_WINDOW || id_child != CHILDID_SELF || hwnd == NULL)
+	{
+		return;
+	}
+
+	Win32WindowEventSource *source;
+
+	{
+		MutexLock l(sources_lock);
+
+		std::map<HWINEVENTHOOK, Win32WindowEventSource*>::iterator s = sources.find(hook);
+		if(s == sources.end())
+		{
+			return;
+		}
+
+		source = s->second;
+	}
+
+	char title[128] = "";
+	GetWindowText(hwnd, title, sizeof(title));
+
+	char class_name[128] = "";
+	GetClassName(hwnd, class_name, sizeof(class_name));
+
+	source->events->post(hwnd, GetParent(hwnd), title, class_name);
+}
+
+#endif /* _WIN32 */
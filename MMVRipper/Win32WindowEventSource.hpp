@@ -0,0 +1,52 @@
+#ifndef MMVRIPPER_WIN32WINDOWEVENTSOURCE_HPP
+#define MMVRIPPER_WIN32WINDOWEVENTSOURCE_HPP
+
+#ifdef _WIN32
+
+#include <map>
+
+#include <winsock2.h>
+#include <windows.h>
+
+#include "Threading.hpp"
+#include "WindowEvents.hpp"
+
+/* Posts a WindowEvent whenever one of another process's windows is shown,
+ * using an out-of-context WinEvent hook. The hook runs on its own thread,
+ * which does nothing but pump messages for it.
+ *
+ * The hook callback finds its object by looking the hook up in a static map,
+ * so there can be one for each viewer.
+*/
+class Win32WindowEventSource: public Thread
+{
+private:
+	WindowEvents *events;
+	DWORD process_id;
+
+	DWORD thread_id;
+	Semaphore started;
+	bool hooked;
+
+	static Mutex sources_lock;
+	static std::map<HWINEVENTHOOK, Win32WindowEventSource*> sources;
+
+	static void CALLBACK event_proc(HWINEVENTHOOK hook, DWORD event, HWND hwnd,
+		LONG id_object, LONG id_child, DWORD event_thread, DWORD event_time);
+
+protected:
+	virtual void run();
+
+public:
+	Win32WindowEventSource(WindowEvents *events, DWORD process_id);
+	virtual ~Win32WindowEventSource();
+
+	/* Installs the hook. Returns false if it couldn't be. */
+	bool start_hook();
+
+	void stop();
+};
+
+#endif /* _WIN32 */
+
+#endif /* !MMVRIPPER_WIN32WINDOWEVENTSOURCE_HPP */
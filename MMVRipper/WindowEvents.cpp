@@ -0,0 +1,125 @@
+#include <string.h>
+#include <deque>
+#include <string>
+
+#include "Clock.hpp"
+#include "WindowEvents.hpp"
+
+/* Oldest events are thrown away once this many are waiting. */
+static const size_t MAX_QUEUED_EVENTS = 256;
+
+WindowEvents::WindowEvents()
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+void WindowEvents::post(void *window, void *parent, const char *title, const char *class_name)
+{
+	WindowEvent event;
+	event.window = window;
+	event.parent = parent;
+	event.title = title;
+	event.class_name = class_name;
+	event.time_us = clock_us();
+
+	{
+		MutexLock l(lock);
+
+		if(events.size() >= MAX_QUEUED_EVENTS)
+		{
+			events.pop_front();
+			++(stats.dropped);
+		}
+
+		events.push_back(event);
+		++(stats.events);
+	}
+
+	posted.post();
+}
+
+bool WindowEvents::try_take(const char *title, void *parent, WindowEvent *event)
+{
+	MutexLock l(lock);
+
+	for(std::deque<WindowEvent>::iterator e = events.begin(); e != events.end(); ++e)
+	{
+		if(e->title == title && (parent == NULL || e->parent == parent))
+		{
+			uint64 latency = clock_us() - e->time_us;
+
+			++(stats.waits);
+			stats.latency_us += latency;
+
+			if(latency > stats.latency_us_max)
+			{
+				stats.latency_us_max = latency;
+			}
+
+			if(event != NULL)
+			{
+				*event = *e;
+			}
+
+			events.erase(e);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool WindowEvents::wait_for(const char *title, void *parent, unsigned int timeout_ms, WindowEvent *event)
+{
+	uint64 deadline = clock_us() + ((uint64)(timeout_ms) * 1000);
+
+	while(!try_take(title, parent, event))
+	{
+		/* Sleep until something else is posted, then look again. */
+
+		uint64 now = clock_us();
+
+		if(now >= deadline || !posted.wait((unsigned int)((deadline - now + 999) / 1000)))
+		{
+			if(!try_take(title, parent, event))
+			{
+				MutexLock l(lock);
+				++(stats.timeouts);
+
+				return false;
+			}
+
+			return true;
+		}
+	}
+
+	return true;
+}
+
+unsigned int WindowEvents::discard(const char *title, void *parent)
+{
+	MutexLock l(lock);
+
+	unsigned int discarded = 0;
+
+	for(std::deque<WindowEvent>::iterator e = events.begin(); e != events.end();)
+	{
+		if(e->title == title && (parent == NULL || e->parent == parent))
+		{
+			e = events.erase(e);
+			++discarded;
+		}
+		else{
+			++e;
+		}
+	}
+
+	return discarded;
+}
+
+WindowEvents::Stats WindowEvents::get_stats()
+{
+	MutexLock l(lock);
+	return stats;
+}
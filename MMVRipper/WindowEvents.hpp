@@ -0,0 +1,91 @@
+#ifndef MMVRIPPER_WINDOWEVENTS_HPP
+#define MMVRIPPER_WINDOWEVENTS_HPP
+
+#include <deque>
+#include <string>
+
+#include "IntTypes.hpp"
+#include "Threading.hpp"
+
+/* A window which has just appeared. Window handles are kept as void* so
+ * this builds off Windows too.
+*/
+struct WindowEvent
+{
+	void *window;
+	void *parent;
+
+	std::string title;
+	std::string class_name;
+
+	uint64 time_us;  /* clock_us() when it was posted. */
+};
+
+/* Queue of windows which have appeared, filled in by an event source (a
+ * WinEvent hook, or the simulator) and waited on by whoever is expecting a
+ * dialog to turn up, so nobody has to keep enumerating windows to find one.
+ *
+ * Events nobody has waited for yet stay queued (up to a limit), so a popup
+ * which appears while waiting for something else can still be found later.
+*/
+class WindowEvents
+{
+public:
+	struct Stats
+	{
+		unsigned long events;
+		unsigned long dropped;   /* Pushed out of a full queue. */
+
+		unsigned long waits;     /* Successful waits. */
+		unsigned long timeouts;
+
+		/* Time from each event being posted to a waiter getting it. */
+		uint64 latency_us, latency_us_max;
+	};
+
+private:
+	Mutex lock;
+	std::deque<WindowEvent> events;
+	Semaphore posted;
+
+	Stats stats;
+
+	WindowEvents(const WindowEvents&);
+	WindowEvents &operator=(const WindowEvents&);
+
+public:
+	WindowEvents();
+
+	/* Called by the event source, from any thread. */
+	void post(void *window, void *parent, const char *title, const char *class_name);
+
+	/* Waits up to timeout_ms for a window titled title to appear, with the
+	 * given parent unless parent is NULL. The event is removed from the
+	 * queue and copied to event (if non-NULL). A timeout of zero only
+	 * checks what has already arrived.
+	*/
+	bool wait_for(const char *title, void *parent, unsigned int timeout_ms, WindowEvent *event);
+
+	/* Like wait_for() with a timeout of zero, but finding nothing isn't
+	 * counted as a timeout, for polling in between other things.
+	*/
+	bool try_take(const char *title, void *parent, WindowEvent *event);
+
+	/* Throws away any matching events already queued, so one left over from
+	 * an earlier window isn't taken for the next. Returns how many there were.
+	*/
+	unsigned int discard(const char *title, void *parent);
+
+	/* Sleeps until another event is posted or timeout_ms passes, for
+	 * waiting on more than one kind of window at once. May return early.
+	 * Returns false on timeout.
+	*/
+	bool wait_any(unsigned int timeout_ms)
+	{
+		return posted.wait(timeout_ms);
+	}
+
+	Stats get_stats();
+};
+
+#endif /* !MMVRIPPER_WINDOWEVENTS_HPP */
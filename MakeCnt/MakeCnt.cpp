@@ -0,0 +1,600 @@
+#include <algorithm>
+#include <errno.h>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "Clock.hpp"
+#include "TitleMatcher.hpp"
+
+/* After the passes makecnt.pl makes, rows can be matched to the nearest
+ * topic left if it is within this many edits (counting OCR mix-ups as half an
+ * edit, see NearestIndex) and nothing else is as near. Those matches are
+ * guesses which need checking by hand, so this is off (zero) unless asked
+ * for, and MakeCnt matches exactly what makecnt.pl would. 2 is a good start.
+*/
+#define NEAREST_EDITS 0
+
+/* Matches by edit distance less sure than this are counted up at the end
+ * as needing to be checked. Every match is listed in <output.cnt>.review
+ * with its confidence, least sure first.
+*/
+#define REVIEW_CONFIDENCE 0.8
+
+/* A row of the tree listing from ocr.pl or MMVOcr. */
+struct TreeRow
+{
+	size_t indent;
+	std::string id;
+	std::string title;
+};
+
+/* A row matched by how near its title was to a topic, for the review list. */
+struct ReviewRow
+{
+	double confidence;
+	std::string line;
+
+	bool operator<(const ReviewRow &rhs) const
+	{
+		return confidence < rhs.confidence;
+	}
+};
+
+static unsigned int count_processors()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+
+	return info.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? n : 1;
+#endif
+}
+
+static bool is_space(unsigned char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static bool is_digit(unsigned char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static std::string lowercase(const std::string &s)
+{
+	std::string lc(s);
+
+	for(size_t i = 0; i < lc.length(); ++i)
+	{
+		if(lc[i] >= 'A' && lc[i] <= 'Z')
+		{
+			lc[i] = lc[i] - 'A' + 'a';
+		}
+	}
+
+	return lc;
+}
+
+static bool read_file(const char *filename, std::string *data)
+{
+	FILE *f = fopen(filename, "rb");
+	if(f == NULL)
+	{
+		return false;
+	}
+
+	data->erase();
+
+	char buf[65536];
+	size_t n;
+
+	while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+	{
+		data->append(buf, n);
+	}
+
+	bool ok = !ferror(f);
+	fclose(f);
+
+	return ok;
+}
+
+static bool write_file(const char *filename, const std::string &data)
+{
+	FILE *f = fopen(filename, "wb");
+	if(f == NULL)
+	{
+		return false;
+	}
+
+	bool ok = fwrite(data.data(), 1, data.length(), f) == data.length();
+	ok = (fclose(f) == 0) && ok;
+
+	return ok;
+}
+
+/* Takes the next line (without the newline) from data, starting at *pos. */
+static bool next_line(const std::string &data, size_t *pos, std::string *line)
+{
+	if(*pos >= data.length())
+	{
+		return false;
+	}
+
+	size_t nl = data.find('\n', *pos);
+	if(nl == std::string::npos)
+	{
+		nl = data.length();
+	}
+
+	line->assign(data, *pos, nl - *pos);
+	*pos = nl + 1;
+
+	return true;
+}
+
+/* Splits up a line of the tree listing like makecnt.pl does, which only takes
+ * rows with a title at least two characters long and ignores the rest.
+*/
+static bool parse_tree_row(const std::string &line, TreeRow *row)
+{
+	size_t i = 0;
+	while(i < line.length() && is_space(line[i]))
+	{
+		++i;
+	}
+
+	size_t digits = i;
+	while(i < line.length() && is_digit(line[i]))
+	{
+		++i;
+	}
+
+	size_t gap = i;
+	while(i < line.length() && is_space(line[i]))
+	{
+		++i;
+	}
+
+	if(i == digits || gap == digits || i == gap || i + 2 > line.length()
+		|| line.find('\r', i) != std::string::npos)
+	{
+		return false;
+	}
+
+	row->indent = digits;
+	row->id.assign(line, digits, gap - digits);
+	row->title.assign(line, i, std::string::npos);
+
+	return true;
+}
+
+/* Splits up a "<depth> <title>=<topic ID>" line of the flat .cnt file. */
+static bool parse_cnt_topic(const std::string &line, std::string *title, std::string *id)
+{
+	size_t i = 0;
+	while(i < line.length() && is_digit(line[i]))
+	{
+		++i;
+	}
+
+	if(i == 0 || i >= line.length() || line[i] != ' ')
+	{
+		return false;
+	}
+
+	size_t eq = line.find('=', i + 1);
+	if(eq == std::string::npos || eq == i + 1 || eq + 1 == line.length()
+		|| line.find_first_of("=\r", eq + 1) != std::string::npos)
+	{
+		return false;
+	}
+
+	title->assign(line, i + 1, eq - (i + 1));
+	id->assign(line, eq + 1, std::string::npos);
+
+	return true;
+}
+
+/* Finds the topic ID MMVRipper put at the end of the text of a page, on the
+ * last line like "#:<topic ID>".
+*/
+static bool find_page_topic_id(const std::string &text, std::string *id)
+{
+	bool found = false;
+
+	size_t pos = 0;
+	std::string line;
+
+	while(next_line(text, &pos, &line))
+	{
+		if(!line.empty() && line[line.length() - 1] == '\r')
+		{
+			line.erase(line.length() - 1);
+		}
+
+		if(line.length() < 3 || line[0] != '#' || line[1] != ':')
+		{
+			continue;
+		}
+
+		size_t i = 2;
+		while(i < line.length() && !is_space(line[i]))
+		{
+			++i;
+		}
+
+		if(i == line.length())
+		{
+			id->assign(line, 2, std::string::npos);
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+static bool is_directory(const char *path)
+{
+	struct stat st;
+	return stat(path, &st) == 0 && (st.st_mode & S_IFDIR);
+}
+
+/* Formats the depth of a row in the .cnt file the way Perl would print it,
+ * which is a fraction if the indentation is odd.
+*/
+static std::string format_depth(size_t indent, size_t base_indent)
+{
+	char buf[64];
+	sprintf(buf, "%.15g", ((double)(indent) - (double)(base_indent)) / 2.0 + 1.0);
+
+	return buf;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [options] <titles-from-ocr.lst> <txt directory> <flat-cnt-from-helpdeco.cnt> <output.cnt>\n", argv0);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "  -e <edits>    Also match rows to the nearest topic within this many edits,\n");
+	fprintf(stderr, "                listing them in <output.cnt>.review (overrides NEAREST_EDITS,\n");
+	fprintf(stderr, "                0 matches exactly like makecnt.pl)\n");
+	fprintf(stderr, "  -j <threads>  Number of threads to search for the nearest topics on\n");
+	fprintf(stderr, "                (defaults to the number of processors)\n");
+}
+
+int main(int argc, char **argv)
+{
+	double nearest_edits = NEAREST_EDITS;
+	unsigned int threads = count_processors();
+
+	int arg = 1;
+
+	while(arg + 1 < argc && (strcmp(argv[arg], "-e") == 0 || strcmp(argv[arg], "-j") == 0))
+	{
+		if(argv[arg][1] == 'e')
+		{
+			nearest_edits = strtod(argv[arg + 1], NULL);
+		}
+		else{
+			unsigned int value = strtoul(argv[arg + 1], NULL, 10);
+			threads = value > 0 ? value : 1;
+		}
+
+		arg += 2;
+	}
+
+	if(argc - arg != 4)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	const char *title_tree = argv[arg];
+	const char *txt_directory = argv[arg + 1];
+	const char *flat_cnt = argv[arg + 2];
+	const char *output_cnt = argv[arg + 3];
+
+	uint64 start_us = clock_us();
+
+	TitleMatcher matcher(stdout);
+
+	/* Read in the tree produced by ocr.pl. */
+
+	std::vector<TreeRow> tree;
+
+	{
+		std::string data;
+		if(!read_file(title_tree, &data))
+		{
+			fprintf(stderr, "%s: %s\n", title_tree, strerror(errno));
+			return 1;
+		}
+
+		size_t pos = 0;
+		std::string line;
+		TreeRow row;
+
+		while(next_line(data, &pos, &line))
+		{
+			if(parse_tree_row(line, &row))
+			{
+				tree.push_back(row);
+				matcher.add_item(row.title);
+			}
+		}
+	}
+
+	/* The topic ID from the text of each page in the tree. */
+
+	if(!is_directory(txt_directory))
+	{
+		fprintf(stderr, "%s: Not a directory\n", txt_directory);
+		return 1;
+	}
+
+	std::map<std::string, std::string> txt_topic_ids;
+
+	for(size_t i = 0; i < tree.size(); ++i)
+	{
+		if(txt_topic_ids.find(tree[i].id) != txt_topic_ids.end())
+		{
+			continue;
+		}
+
+		std::string filename = std::string(txt_directory) + "/" + tree[i].id + ".txt";
+		std::string text, topic_id;
+
+		if(read_file(filename.c_str(), &text) && find_page_topic_id(text, &topic_id))
+		{
+			txt_topic_ids[tree[i].id] = topic_id;
+		}
+		else{
+			/* Don't look for it again. */
+			txt_topic_ids[tree[i].id] = "";
+		}
+	}
+
+	/* Read in the flat .cnt file produced by helpdeco, keeping any
+	 * directives to be copied into the output.
+	*/
+
+	std::vector<std::string> cnt_copy;
+
+	{
+		std::string data;
+		if(!read_file(flat_cnt, &data))
+		{
+			fprintf(stderr, "%s: %s\n", flat_cnt, strerror(errno));
+			return 1;
+		}
+
+		size_t pos = 0;
+		std::string line, title, id;
+
+		while(next_line(data, &pos, &line))
+		{
+			if(line.length() >= 2 && line[0] == ':' && line.find('\r') == std::string::npos)
+			{
+				cnt_copy.push_back(line);
+			}
+			else if(parse_cnt_topic(line, &title, &id))
+			{
+				matcher.add_topic(title, id);
+			}
+		}
+	}
+
+	/* Match up the rows with topics, with progressively fuzzier matching to
+	 * handle OCR errors. Each pass only matches rows which can only be ONE
+	 * topic, and takes the topic out of the running for the next.
+	*/
+
+	unsigned long total_matched_topics = 0;
+	unsigned int n;
+
+	n = matcher.match(TitleMatcher::MATCH_EXACT);
+	total_matched_topics += n;
+	printf("Matched topics: %u\n", n);
+
+	n = matcher.match(TitleMatcher::MATCH_SIMILAR);
+	total_matched_topics += n;
+	printf("Matched topics (allowing similar-looking characters): %u\n", n);
+
+	n = matcher.match(TitleMatcher::MATCH_ALNUM);
+	total_matched_topics += n;
+	printf("Matched topics (allowing whitespace/punctuation mismatches): %u\n", n);
+
+	n = matcher.match(TitleMatcher::MATCH_TRUNCATED);
+	total_matched_topics += n;
+	printf("Matched topics (truncated): %u\n", n);
+
+	/* Then the titles the OCR got too wrong for any of that. */
+
+	std::vector<TitleMatcher::NearestMatch> nearest;
+
+	if(nearest_edits > 0.0)
+	{
+		std::vector<std::string> page_ids;
+
+		for(size_t i = 0; i < tree.size(); ++i)
+		{
+			page_ids.push_back(txt_topic_ids[tree[i].id]);
+		}
+
+		n = matcher.match_nearest(nearest_edits, page_ids, threads, &nearest);
+		total_matched_topics += n;
+		printf("Matched topics (within %g edits): %u\n", nearest_edits, n);
+	}
+
+	/* See if there are any discrepencies between the topic IDs we merged
+	 * from the .cnt file and the topic IDs we scraped from the page text.
+	*/
+
+	for(size_t i = 0; i < tree.size(); ++i)
+	{
+		const TitleMatcher::Item &item = matcher.get_items()[i];
+		const std::string &txt_topic_id = txt_topic_ids[tree[i].id];
+
+		if(item.has_topic_id && !txt_topic_id.empty() && lowercase(item.topic_id) != lowercase(txt_topic_id))
+		{
+			fprintf(stderr, "Topic ID mismatch detected on %s (%s in the .cnt file, %s in the page text)\n",
+				tree[i].id.c_str(), item.topic_id.c_str(), txt_topic_id.c_str());
+		}
+	}
+
+	printf("Total matched topics from .cnt file: %lu / %lu\n", total_matched_topics, (unsigned long)(matcher.get_num_topics()));
+
+	/* Rows still without a topic get the one with the ID in their page text,
+	 * or just the ID if there isn't one, and keep the title from the OCR if
+	 * they didn't get one from the .cnt file.
+	*/
+
+	for(size_t i = 0; i < tree.size(); ++i)
+	{
+		const std::string &txt_topic_id = txt_topic_ids[tree[i].id];
+
+		if(!matcher.get_items()[i].has_topic_id && !txt_topic_id.empty())
+		{
+			total_matched_topics += matcher.match_topic_id(i, txt_topic_id);
+		}
+	}
+
+	/* Write out the new .cnt file. */
+
+	std::string cnt;
+
+	for(size_t i = 0; i < cnt_copy.size(); ++i)
+	{
+		cnt += cnt_copy[i] + "\r\n";
+	}
+
+	for(size_t i = 0; i < tree.size(); ++i)
+	{
+		const TitleMatcher::Item &item = matcher.get_items()[i];
+		const std::string &txt_topic_id = txt_topic_ids[tree[i].id];
+
+		cnt += format_depth(tree[i].indent, tree[0].indent) + " ";
+		cnt += item.has_title ? item.title : tree[i].title;
+
+		if(item.has_topic_id)
+		{
+			cnt += "=" + item.topic_id;
+		}
+		else if(!txt_topic_id.empty())
+		{
+			cnt += "=" + txt_topic_id;
+		}
+
+		cnt += "\r\n";
+	}
+
+	if(!write_file(output_cnt, cnt))
+	{
+		fprintf(stderr, "%s: %s\n", output_cnt, strerror(errno));
+		return 1;
+	}
+
+	if(total_matched_topics != matcher.get_num_topics())
+	{
+		/* Write out a .rej file with the remaining topics from the .cnt
+		 * file, in the order they were in it.
+		*/
+
+		std::string rej;
+		unsigned int rej_lines = 0;
+
+		const std::vector<TitleMatcher::Group> &groups = matcher.get_groups();
+
+		for(size_t g = 0; g < groups.size(); ++g)
+		{
+			for(size_t t = 0; !groups[g].matched && t < groups[g].topics.size(); ++t)
+			{
+				const TitleMatcher::Topic &topic = groups[g].topics[t];
+
+				if(!topic.taken)
+				{
+					rej += topic.title + "=" + topic.id + "\r\n";
+					++rej_lines;
+				}
+			}
+		}
+
+		std::string rej_file = std::string(flat_cnt) + ".rej";
+
+		if(!write_file(rej_file.c_str(), rej))
+		{
+			fprintf(stderr, "%s: %s\n", rej_file.c_str(), strerror(errno));
+			return 1;
+		}
+
+		printf("%u unmatched topics written to %s\n", rej_lines, rej_file.c_str());
+	}
+
+	if(!nearest.empty())
+	{
+		/* Write out the rows matched by edit distance, least sure first,
+		 * for someone to check.
+		*/
+
+		std::vector<ReviewRow> review;
+		unsigned int unsure = 0;
+
+		for(size_t i = 0; i < nearest.size(); ++i)
+		{
+			const TitleMatcher::NearestMatch &m = nearest[i];
+			const TitleMatcher::Topic &topic = matcher.get_groups()[m.group].topics[0];
+
+			char head[64];
+			sprintf(head, "%.2f  %.1f  ", m.confidence, m.edits);
+
+			ReviewRow r;
+			r.confidence = m.confidence;
+			r.line = std::string(head) + tree[m.item].id + "  " + tree[m.item].title + " => " + topic.title + "=" + topic.id + "\r\n";
+
+			review.push_back(r);
+
+			if(m.confidence < REVIEW_CONFIDENCE)
+			{
+				++unsure;
+			}
+		}
+
+		std::stable_sort(review.begin(), review.end());
+
+		std::string text = "Confidence  Edits  ID  OCR title => .cnt topic\r\n";
+		for(size_t i = 0; i < review.size(); ++i)
+		{
+			text += review[i].line;
+		}
+
+		std::string review_file = std::string(output_cnt) + ".review";
+
+		if(!write_file(review_file.c_str(), text))
+		{
+			fprintf(stderr, "%s: %s\n", review_file.c_str(), strerror(errno));
+			return 1;
+		}
+
+		printf("%u topics matched by edit distance written to %s, %u of them less than %.0f%% sure\n",
+			(unsigned)(nearest.size()), review_file.c_str(), unsure, REVIEW_CONFIDENCE * 100.0);
+	}
+
+	fprintf(stderr, "Matched %u rows in %.2f s\n", (unsigned)(tree.size()), (double)(clock_us() - start_us) / 1000000.0);
+
+	return 0;
+}
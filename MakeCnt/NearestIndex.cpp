@@ -0,0 +1,554 @@
+#include <algorithm>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "NearestIndex.hpp"
+
+const unsigned int NearestIndex::NO_COST = (unsigned int)(-1);
+
+/* Characters OCR mixes up, after TitleMatcher has already merged 1/l/I, O/0
+ * and G/Q (which it keys as "i", "o" and "q") and lowercased everything.
+*/
+static const char *CONFUSED_CHARS[] = {
+	"ce", "co", "eo", "ao", "uv", "vy", "bh", "hn", "nu", "ft", "ij",
+	"5s", "8b", "6b", "2z", "9q", "7t",
+	NULL
+};
+
+/* Pairs of characters OCR reads as one character, or the other way round. */
+static const char *CONFUSED_PAIRS[] = {
+	"rnm", "inm", "cid", "vvw", "iiu", "rin",
+	NULL
+};
+
+static const unsigned int COST_EDIT = 2;
+static const unsigned int COST_CONFUSED = 1;
+
+/* The cost of replacing any character with any other, and which character
+ * each pair of characters looks like (or zero).
+*/
+static struct ConfusionTable
+{
+	unsigned char replace[256][256];
+	unsigned char pair[256][256];
+
+	ConfusionTable()
+	{
+		for(int a = 0; a < 256; ++a)
+		{
+			for(int b = 0; b < 256; ++b)
+			{
+				replace[a][b] = a == b ? 0 : COST_EDIT;
+				pair[a][b] = 0;
+			}
+		}
+
+		for(int i = 0; CONFUSED_CHARS[i] != NULL; ++i)
+		{
+			unsigned char a = CONFUSED_CHARS[i][0], b = CONFUSED_CHARS[i][1];
+
+			replace[a][b] = COST_CONFUSED;
+			replace[b][a] = COST_CONFUSED;
+		}
+
+		for(int i = 0; CONFUSED_PAIRS[i] != NULL; ++i)
+		{
+			const unsigned char *p = (const unsigned char*)(CONFUSED_PAIRS[i]);
+			pair[p[0]][p[1]] = p[2];
+		}
+	}
+} confusions;
+
+static uint64 piece_hash(size_t length, size_t piece, const char *data, size_t data_length)
+{
+	/* FNV-1a. */
+
+	const uint64 FNV_OFFSET = ((uint64)(0xCBF29CE4) << 32) | 0x84222325;
+	const uint64 FNV_PRIME = ((uint64)(0x00000100) << 32) | 0x000001B3;
+
+	uint64 hash = FNV_OFFSET;
+
+	unsigned char header[4];
+	header[0] = length & 0xFF;
+	header[1] = (length >> 8) & 0xFF;
+	header[2] = piece & 0xFF;
+	header[3] = (piece >> 8) & 0xFF;
+
+	for(size_t i = 0; i < sizeof(header); ++i)
+	{
+		hash ^= header[i];
+		hash *= FNV_PRIME;
+	}
+
+	for(size_t i = 0; i < data_length; ++i)
+	{
+		hash ^= (unsigned char)(data[i]);
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/* Sets up the bitmasks of where each character is in pattern for myers(),
+ * which must be at most 64 characters.
+*/
+static void myers_prepare(const std::string &pattern, uint64 *peq)
+{
+	for(size_t i = 0; i < pattern.length(); ++i)
+	{
+		peq[(unsigned char)(pattern[i])] |= (uint64)(1) << i;
+	}
+}
+
+static void myers_clear(const std::string &pattern, uint64 *peq)
+{
+	for(size_t i = 0; i < pattern.length(); ++i)
+	{
+		peq[(unsigned char)(pattern[i])] = 0;
+	}
+}
+
+/* Edit distance between a pattern of m characters and text, working down a
+ * column of the distance matrix at a time in the bits of a word (Myers 1999,
+ * as Hyyrö put it for plain edit distance). Gives up and returns NO_COST as
+ * soon as the distance can't come back down to limit.
+*/
+static unsigned int myers(const uint64 *peq, size_t m, const std::string &text, unsigned int limit)
+{
+	if(m == 0)
+	{
+		return text.length() <= limit ? text.length() : NearestIndex::NO_COST;
+	}
+
+	uint64 last = (uint64)(1) << (m - 1);
+	uint64 pv = ~(uint64)(0);
+	uint64 mv = 0;
+
+	unsigned int score = m;
+
+	for(size_t j = 0; j < text.length(); ++j)
+	{
+		uint64 eq = peq[(unsigned char)(text[j])];
+
+		uint64 xv = eq | mv;
+		uint64 xh = (((eq & pv) + pv) ^ pv) | eq;
+
+		uint64 ph = mv | ~(xh | pv);
+		uint64 mh = pv & xh;
+
+		if(ph & last)
+		{
+			++score;
+		}
+		else if(mh & last)
+		{
+			--score;
+		}
+
+		/* The top row of the matrix goes up by one each column. */
+		ph = (ph << 1) | 1;
+		mh = mh << 1;
+
+		pv = mh | ~(xv | ph);
+		mv = ph & xv;
+
+		/* It can only come down by one a column from here. */
+		if(score > limit + (text.length() - j - 1))
+		{
+			return NearestIndex::NO_COST;
+		}
+	}
+
+	return score <= limit ? score : NearestIndex::NO_COST;
+}
+
+/* Plain edit distance, for strings too long for myers(). */
+static unsigned int levenshtein(const std::string &a, const std::string &b, unsigned int limit)
+{
+	std::vector<unsigned int> prev(b.length() + 1), cur(b.length() + 1);
+
+	for(size_t j = 0; j <= b.length(); ++j)
+	{
+		prev[j] = j;
+	}
+
+	for(size_t i = 1; i <= a.length(); ++i)
+	{
+		cur[0] = i;
+		unsigned int row_min = cur[0];
+
+		for(size_t j = 1; j <= b.length(); ++j)
+		{
+			unsigned int d = prev[j - 1] + (a[i - 1] != b[j - 1]);
+			d = std::min(d, prev[j] + 1);
+			d = std::min(d, cur[j - 1] + 1);
+
+			cur[j] = d;
+			row_min = std::min(row_min, d);
+		}
+
+		if(row_min > limit)
+		{
+			return NearestIndex::NO_COST;
+		}
+
+		prev.swap(cur);
+	}
+
+	return prev[b.length()] <= limit ? prev[b.length()] : NearestIndex::NO_COST;
+}
+
+NearestIndex::NearestIndex(unsigned int max_cost):
+	max_cost(max_cost) {}
+
+size_t NearestIndex::add(const std::string &key)
+{
+	keys.push_back(key);
+	return keys.size() - 1;
+}
+
+unsigned int NearestIndex::limit(size_t a_length, size_t b_length) const
+{
+	/* A quarter of an edit per character, in half edits. */
+	size_t quarter = std::max(a_length, b_length) / 2;
+
+	return quarter < max_cost ? quarter : max_cost;
+}
+
+/* Where a piece of a string of length characters starts and how long it is.
+ * The longer pieces go at the end.
+*/
+void NearestIndex::split(size_t length, size_t piece, size_t *start, size_t *piece_length) const
+{
+	size_t num_pieces = max_cost + 1;
+
+	size_t base = length / num_pieces;
+	size_t num_short = num_pieces - (length % num_pieces);
+
+	if(piece < num_short)
+	{
+		*start = piece * base;
+		*piece_length = base;
+	}
+	else{
+		*start = num_short * base + (piece - num_short) * (base + 1);
+		*piece_length = base + 1;
+	}
+}
+
+void NearestIndex::build()
+{
+	pieces.clear();
+	short_keys.clear();
+
+	for(size_t k = 0; k < keys.size(); ++k)
+	{
+		const std::string &key = keys[k];
+
+		if(key.length() <= max_cost)
+		{
+			if(short_keys.size() <= key.length())
+			{
+				short_keys.resize(key.length() + 1);
+			}
+
+			short_keys[key.length()].push_back(k);
+			continue;
+		}
+
+		for(size_t p = 0; p <= max_cost; ++p)
+		{
+			size_t start, length;
+			split(key.length(), p, &start, &length);
+
+			Piece piece;
+			piece.hash = piece_hash(key.length(), p, key.data() + start, length);
+			piece.key = k;
+
+			pieces.push_back(piece);
+		}
+	}
+
+	std::sort(pieces.begin(), pieces.end());
+}
+
+unsigned int NearestIndex::ocr_cost(const std::string &a, const std::string &b, unsigned int limit)
+{
+	/* Rows i - 2, i - 1 and i of the cost matrix. */
+	std::vector<unsigned int> rows[3];
+
+	for(int r = 0; r < 3; ++r)
+	{
+		rows[r].resize(b.length() + 1);
+	}
+
+	unsigned int prev_min = NO_COST;
+
+	for(size_t i = 0; i <= a.length(); ++i)
+	{
+		std::vector<unsigned int> &cur = rows[i % 3];
+		const std::vector<unsigned int> &up = rows[(i + 2) % 3];
+		const std::vector<unsigned int> &up2 = rows[(i + 1) % 3];
+
+		unsigned int row_min = NO_COST;
+
+		for(size_t j = 0; j <= b.length(); ++j)
+		{
+			unsigned int c;
+
+			if(i == 0)
+			{
+				c = j * COST_EDIT;
+			}
+			else if(j == 0)
+			{
+				c = i * COST_EDIT;
+			}
+			else{
+				unsigned char ac = a[i - 1], bc = b[j - 1];
+
+				c = up[j - 1] + confusions.replace[ac][bc];
+				c = std::min(c, up[j] + COST_EDIT);
+				c = std::min(c, cur[j - 1] + COST_EDIT);
+
+				if(i >= 2 && confusions.pair[(unsigned char)(a[i - 2])][ac] == bc)
+				{
+					c = std::min(c, up2[j - 1] + COST_EDIT);
+				}
+
+				if(j >= 2 && confusions.pair[(unsigned char)(b[j - 2])][bc] == ac)
+				{
+					c = std::min(c, up[j - 2] + COST_EDIT);
+				}
+			}
+
+			cur[j] = c;
+			row_min = std::min(row_min, c);
+		}
+
+		/* Costs only go up, and every way through the matrix passes
+		 * through one of any two rows in a row.
+		*/
+		if(row_min > limit && prev_min > limit)
+		{
+			return NO_COST;
+		}
+
+		prev_min = row_min;
+	}
+
+	unsigned int cost = rows[a.length() % 3][b.length()];
+	return cost <= limit ? cost : NO_COST;
+}
+
+unsigned int NearestIndex::edit_distance(const std::string &a, const std::string &b, unsigned int limit)
+{
+	size_t diff = a.length() > b.length() ? a.length() - b.length() : b.length() - a.length();
+	if(diff > limit)
+	{
+		return NO_COST;
+	}
+
+	const std::string &pattern = a.length() <= b.length() ? a : b;
+	const std::string &text = a.length() <= b.length() ? b : a;
+
+	if(pattern.length() > 64)
+	{
+		return levenshtein(pattern, text, limit);
+	}
+
+	uint64 peq[256];
+	memset(peq, 0, sizeof(peq));
+
+	myers_prepare(pattern, peq);
+
+	return myers(peq, pattern.length(), text, limit);
+}
+
+void NearestIndex::search_range(const std::vector<std::string> &queries, size_t first, size_t step, std::vector<Result> *results) const
+{
+	/* Keys already checked for the current query. */
+	std::vector<unsigned int> seen(keys.size(), 0);
+	unsigned int stamp = 0;
+
+	uint64 peq[256];
+	memset(peq, 0, sizeof(peq));
+
+	std::vector<size_t> candidates;
+
+	for(size_t q = first; q < queries.size(); q += step)
+	{
+		const std::string &query = queries[q];
+		Result &result = (*results)[q];
+
+		result.cost = NO_COST;
+		result.next_cost = NO_COST;
+		result.tied.clear();
+
+		++stamp;
+		candidates.clear();
+
+		/* Look up the substrings of the query which could be an unchanged
+		 * piece of a key within max_cost edits, for each length of key
+		 * it could be. A piece can only have moved as far as the edits
+		 * before it, and as far as the length difference give or take the
+		 * edits after it (Li et al, "Pass-Join").
+		*/
+
+		size_t s = query.length();
+		size_t min_length = s > max_cost ? s - max_cost : 0;
+
+		for(size_t l = std::max(min_length, (size_t)(max_cost + 1)); l <= s + max_cost; ++l)
+		{
+			long delta = (long)(s) - (long)(l);
+
+			for(size_t p = 0; p <= max_cost; ++p)
+			{
+				size_t start, length;
+				split(l, p, &start, &length);
+
+				if(length > s)
+				{
+					continue;
+				}
+
+				long lo = std::max((long)(start) - (long)(p), (long)(start) + delta - (long)(max_cost - p));
+				long hi = std::min((long)(start) + (long)(p), (long)(start) + delta + (long)(max_cost - p));
+
+				lo = std::max(lo, 0L);
+				hi = std::min(hi, (long)(s - length));
+
+				for(long at = lo; at <= hi; ++at)
+				{
+					Piece probe;
+					probe.hash = piece_hash(l, p, query.data() + at, length);
+
+					std::vector<Piece>::const_iterator i = std::lower_bound(pieces.begin(), pieces.end(), probe);
+
+					for(; i != pieces.end() && i->hash == probe.hash; ++i)
+					{
+						if(seen[i->key] != stamp)
+						{
+							seen[i->key] = stamp;
+							candidates.push_back(i->key);
+						}
+					}
+				}
+			}
+		}
+
+		for(size_t l = min_length; l < short_keys.size() && l <= s + max_cost; ++l)
+		{
+			candidates.insert(candidates.end(), short_keys[l].begin(), short_keys[l].end());
+		}
+
+		/* Check them, cheapest test first. */
+
+		bool short_query = s <= 64;
+
+		if(short_query)
+		{
+			myers_prepare(query, peq);
+		}
+
+		for(size_t c = 0; c < candidates.size(); ++c)
+		{
+			const std::string &key = keys[candidates[c]];
+
+			unsigned int lim = limit(s, key.length());
+			size_t diff = s > key.length() ? s - key.length() : key.length() - s;
+
+			if(diff > lim)
+			{
+				continue;
+			}
+
+			unsigned int distance = short_query
+				? myers(peq, s, key, lim)
+				: edit_distance(query, key, lim);
+
+			if(distance == NO_COST)
+			{
+				continue;
+			}
+
+			unsigned int cost = ocr_cost(query, key, lim);
+
+			if(cost == NO_COST)
+			{
+				continue;
+			}
+
+			if(cost < result.cost)
+			{
+				result.next_cost = result.cost;
+				result.cost = cost;
+
+				result.tied.clear();
+				result.tied.push_back(candidates[c]);
+			}
+			else if(cost == result.cost)
+			{
+				result.tied.push_back(candidates[c]);
+			}
+			else if(cost < result.next_cost)
+			{
+				result.next_cost = cost;
+			}
+		}
+
+		if(short_query)
+		{
+			myers_clear(query, peq);
+		}
+
+		std::sort(result.tied.begin(), result.tied.end());
+	}
+}
+
+void NearestIndex::search(const std::vector<std::string> &queries, unsigned int threads, std::vector<Result> *results) const
+{
+	results->resize(queries.size());
+
+	if(threads <= 1)
+	{
+		search_range(queries, 0, 1, results);
+		return;
+	}
+
+	std::vector<Searcher*> searchers;
+
+	for(unsigned int t = 0; t < threads; ++t)
+	{
+		searchers.push_back(new Searcher(this, &queries, results, t, threads));
+
+		if(!searchers.back()->start())
+		{
+			/* Couldn't start another thread, the others will have to do. */
+
+			delete searchers.back();
+			searchers.pop_back();
+
+			break;
+		}
+	}
+
+	if(searchers.empty())
+	{
+		search_range(queries, 0, 1, results);
+		return;
+	}
+
+	/* Any queries left over from threads which wouldn't start. */
+	for(size_t q = searchers.size(); q < threads; ++q)
+	{
+		search_range(queries, q, threads, results);
+	}
+
+	for(size_t i = 0; i < searchers.size(); ++i)
+	{
+		searchers[i]->join();
+		delete searchers[i];
+	}
+}
@@ -0,0 +1,126 @@
+#ifndef MAKECNT_NEARESTINDEX_HPP
+#define MAKECNT_NEARESTINDEX_HPP
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "IntTypes.hpp"
+#include "Threading.hpp"
+
+/* Finds the strings in a set which are within a few edits of another,
+ * counting the mistakes OCR tends to make (like "rn" for "m", or "e" for "c")
+ * as cheaper than other edits.
+ *
+ * Costs are counted in half edits. Inserting, deleting or replacing a
+ * character costs 2, replacing one with a character it is easily mistaken
+ * for costs 1, and replacing a pair of characters with the one character
+ * they look like (or the other way round) costs 2. A pair of strings can be
+ * no further apart than max_cost, or a quarter of the length of the longer
+ * one, so short strings can't match anything they happen to share a few
+ * letters with.
+ *
+ * No way of making edits costs less than one half edit per character
+ * changed, so strings within max_cost are within max_cost plain edits of each
+ * other too. Each string is split into max_cost + 1 pieces, and if two are
+ * within that many edits one of the pieces must turn up unchanged in the
+ * other, near where it was. The pieces are indexed by a hash of their text,
+ * length and where they came from, so a search only looks up the substrings
+ * of the query which could be one of them. Each candidate is checked with a
+ * bit-parallel (Myers) edit distance first, and only those near enough get
+ * the slower weighted comparison.
+*/
+class NearestIndex
+{
+public:
+	static const unsigned int NO_COST;
+
+	/* What a search found. tied is everything at the lowest cost, next_cost
+	 * is the next lowest cost of anything within reach.
+	*/
+	struct Result
+	{
+		unsigned int cost;
+		std::vector<size_t> tied;
+		unsigned int next_cost;
+	};
+
+private:
+	/* Searches every step'th query from first. */
+	class Searcher: public Thread
+	{
+	private:
+		const NearestIndex *index;
+		const std::vector<std::string> *queries;
+		std::vector<Result> *results;
+		size_t first, step;
+
+	protected:
+		virtual void run()
+		{
+			index->search_range(*queries, first, step, results);
+		}
+
+	public:
+		Searcher(const NearestIndex *index, const std::vector<std::string> *queries, std::vector<Result> *results, size_t first, size_t step):
+			index(index),
+			queries(queries),
+			results(results),
+			first(first),
+			step(step) {}
+	};
+
+	struct Piece
+	{
+		uint64 hash;
+		size_t key;
+
+		bool operator<(const Piece &rhs) const
+		{
+			return hash < rhs.hash;
+		}
+	};
+
+	unsigned int max_cost;
+
+	std::vector<std::string> keys;
+
+	std::vector<Piece> pieces;
+	/* Strings too short to split up, by length. */
+	std::vector< std::vector<size_t> > short_keys;
+
+	void split(size_t length, size_t piece, size_t *start, size_t *piece_length) const;
+	void search_range(const std::vector<std::string> &queries, size_t first, size_t step, std::vector<Result> *results) const;
+
+	/* Not copyable. */
+	NearestIndex(const NearestIndex&);
+	NearestIndex &operator=(const NearestIndex&);
+
+public:
+	/* max_cost is in half edits. */
+	NearestIndex(unsigned int max_cost);
+
+	/* Adds a string, returning its index in search results. */
+	size_t add(const std::string &key);
+
+	/* Indexes everything added so far. */
+	void build();
+
+	/* Searches for every query at once, on threads threads. */
+	void search(const std::vector<std::string> &queries, unsigned int threads, std::vector<Result> *results) const;
+
+	/* The cost (in half edits) of turning a into b, or NO_COST if it is more
+	 * than limit.
+	*/
+	static unsigned int ocr_cost(const std::string &a, const std::string &b, unsigned int limit);
+
+	/* The plain edit distance between a and b, or NO_COST if it is more than
+	 * limit.
+	*/
+	static unsigned int edit_distance(const std::string &a, const std::string &b, unsigned int limit);
+
+	/* The most a and b can cost to be within reach of each other. */
+	unsigned int limit(size_t a_length, size_t b_length) const;
+};
+
+#endif /* !MAKECNT_NEARESTINDEX_HPP */
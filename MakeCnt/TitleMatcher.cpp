@@ -0,0 +1,675 @@
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "NearestIndex.hpp"
+#include "TitleMatcher.hpp"
+
+static const size_t NO_ITEM = (size_t)(-1);
+static const size_t NO_TOPIC = (size_t)(-1);
+
+/* Rows with fewer letters and numbers than this are too short to match by
+ * how near they are to a topic.
+*/
+static const size_t NEAREST_MIN_LENGTH = 4;
+
+/* Characters Perl's \s matches. */
+static bool is_space(unsigned char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static bool is_alnum(unsigned char c)
+{
+	return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/* Perl's lc(), which only touches ASCII in byte strings. */
+static unsigned char to_lower(unsigned char c)
+{
+	return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+/* merge_similar_characters() in makecnt.pl. */
+static unsigned char merge_similar(unsigned char c)
+{
+	switch(c)
+	{
+		case '1': case 'l': case 'L': case 'i': case 'I':
+			return 'i';
+
+		case '0': case 'o': case 'O':
+			return 'o';
+
+		case 'g': case 'G': case 'q': case 'Q':
+			return 'q';
+
+		default:
+			return c;
+	}
+}
+
+static bool starts_with(const std::string &s, const std::string &prefix)
+{
+	return s.compare(0, prefix.length(), prefix) == 0;
+}
+
+/* For upper_bound(), true if everything starting with prefix sorts before s. */
+struct PrefixLess
+{
+	bool operator()(const std::string &prefix, const std::string &s) const
+	{
+		return s.compare(0, prefix.length(), prefix) > 0;
+	}
+};
+
+/* Finds the range of sorted keys which match probe, or start with it. */
+static void find_range(const std::vector<std::string> &keys, const std::string &probe, bool prefix, size_t *begin, size_t *end)
+{
+	std::vector<std::string>::const_iterator b = std::lower_bound(keys.begin(), keys.end(), probe);
+	std::vector<std::string>::const_iterator e = prefix
+		? std::upper_bound(b, keys.end(), probe, PrefixLess())
+		: std::upper_bound(b, keys.end(), probe);
+
+	*begin = b - keys.begin();
+	*end = e - keys.begin();
+}
+
+/* Fenwick tree of which of a sorted range of topics are still unmatched,
+ * counting them and XORing their positions together so the last one left in
+ * a range can be found without looking through it.
+*/
+class LiveSet
+{
+private:
+	std::vector<size_t> count;
+	std::vector<size_t> xor_pos;
+
+	void update(size_t pos)
+	{
+		size_t value = pos;
+
+		for(++pos; pos < count.size(); pos += pos & (0 - pos))
+		{
+			--(count[pos]);
+			xor_pos[pos] ^= value;
+		}
+	}
+
+	void prefix(size_t end, size_t *n, size_t *x) const
+	{
+		for(; end > 0; end -= end & (0 - end))
+		{
+			*n += count[end];
+			*x ^= xor_pos[end];
+		}
+	}
+
+public:
+	LiveSet(size_t size):
+		count(size + 1, 0),
+		xor_pos(size + 1, 0)
+	{
+		/* Everything starts out live, fill in each node directly. */
+
+		for(size_t i = 1; i <= size; ++i)
+		{
+			count[i] += 1;
+			xor_pos[i] ^= i - 1;
+
+			size_t parent = i + (i & (0 - i));
+			if(parent <= size)
+			{
+				count[parent] += count[i];
+				xor_pos[parent] ^= xor_pos[i];
+			}
+		}
+	}
+
+	void remove(size_t pos)
+	{
+		update(pos);
+	}
+
+	/* Counts the live positions from begin to end, and XORs them. */
+	size_t query(size_t begin, size_t end, size_t *x) const
+	{
+		size_t n_end = 0, n_begin = 0;
+		size_t x_end = 0, x_begin = 0;
+
+		prefix(end, &n_end, &x_end);
+		prefix(begin, &n_begin, &x_begin);
+
+		*x = x_end ^ x_begin;
+		return n_end - n_begin;
+	}
+};
+
+bool TitleMatcher::TopicRef::operator<(const TopicRef &rhs) const
+{
+	int c = id.compare(rhs.id);
+
+	if(c != 0)
+	{
+		return c < 0;
+	}
+
+	return group != rhs.group ? group < rhs.group : topic < rhs.topic;
+}
+
+TitleMatcher::TitleMatcher(FILE *log):
+	num_topics(0),
+	ids_indexed(false),
+	log(log) {}
+
+std::string TitleMatcher::normalise_title(const std::string &title)
+{
+	size_t begin = 0, end = title.length();
+
+	while(begin < end && is_space(title[begin]))
+	{
+		++begin;
+	}
+
+	while(end > begin && is_space(title[end - 1]))
+	{
+		--end;
+	}
+
+	std::string norm;
+	norm.reserve(end - begin);
+
+	for(size_t i = begin; i < end; ++i)
+	{
+		unsigned char c = title[i];
+
+		if(is_space(c) || c == '.')
+		{
+			if(i == begin || !(is_space(title[i - 1]) || title[i - 1] == '.'))
+			{
+				norm += ' ';
+			}
+		}
+		else{
+			norm += (char)(to_lower(c));
+		}
+	}
+
+	return norm;
+}
+
+std::string TitleMatcher::match_key(Level level, const std::string &norm_title)
+{
+	if(level == MATCH_EXACT)
+	{
+		return norm_title;
+	}
+
+	std::string key;
+	key.reserve(norm_title.length());
+
+	for(size_t i = 0; i < norm_title.length(); ++i)
+	{
+		unsigned char c = merge_similar(norm_title[i]);
+
+		if(level == MATCH_SIMILAR || is_alnum(c))
+		{
+			key += (char)(c);
+		}
+	}
+
+	return key;
+}
+
+void TitleMatcher::add_item(const std::string &title)
+{
+	items.push_back(Item());
+
+	Item &item = items.back();
+	item.norm_title = normalise_title(title);
+	item.has_title = false;
+	item.has_topic_id = false;
+	item.topic_order = NO_TOPIC;
+}
+
+void TitleMatcher::add_topic(const std::string &title, const std::string &id)
+{
+	std::string norm_title = normalise_title(title);
+
+	std::map<std::string, size_t>::iterator g = groups_by_title.find(norm_title);
+	if(g == groups_by_title.end())
+	{
+		g = groups_by_title.insert(std::make_pair(norm_title, groups.size())).first;
+
+		groups.push_back(Group());
+		groups.back().norm_title = norm_title;
+		groups.back().matched = false;
+	}
+
+	Topic t;
+	t.title = title;
+	t.id = id;
+	t.order = num_topics;
+	t.taken = false;
+
+	groups[g->second].topics.push_back(t);
+	++num_topics;
+
+	ids_indexed = false;
+}
+
+unsigned int TitleMatcher::match(Level level)
+{
+	bool truncated = level == MATCH_TRUNCATED;
+
+	/* Every row counts when looking for rows with the same title, even ones
+	 * which have already been matched.
+	*/
+
+	std::vector<std::string> item_keys(items.size());
+	for(size_t i = 0; i < items.size(); ++i)
+	{
+		item_keys[i] = match_key(level, items[i].norm_title);
+	}
+
+	std::vector<std::string> sorted_item_keys(item_keys);
+	std::sort(sorted_item_keys.begin(), sorted_item_keys.end());
+
+	/* Only groups which haven't been matched yet can be. */
+
+	std::vector< std::pair<std::string, size_t> > sorted_groups;
+	for(size_t g = 0; g < groups.size(); ++g)
+	{
+		if(!groups[g].matched)
+		{
+			sorted_groups.push_back(std::make_pair(match_key(level, groups[g].norm_title), g));
+		}
+	}
+
+	std::sort(sorted_groups.begin(), sorted_groups.end());
+
+	std::vector<std::string> group_keys(sorted_groups.size());
+	for(size_t i = 0; i < sorted_groups.size(); ++i)
+	{
+		group_keys[i].swap(sorted_groups[i].first);
+	}
+
+	LiveSet live(sorted_groups.size());
+
+	/* The row before, for spotting a container followed by its first page.
+	 * makecnt.pl starts off with an empty title, which (with enough stripped
+	 * off it) can still match a row.
+	*/
+	size_t prev = NO_ITEM;
+	std::string prev_key;
+
+	unsigned int matches = 0;
+
+	for(size_t i = 0; i < items.size(); ++i)
+	{
+		Item &item = items[i];
+
+		if(item.has_topic_id)
+		{
+			continue;
+		}
+
+		/* What the other titles must be, or start with, to match this one. */
+		std::string probe = truncated
+			? match_key(level, item.norm_title.substr(0, item.norm_title.length() - 1))
+			: item_keys[i];
+
+		/* If the title is in the tree more than once we can't tell which
+		 * topic goes where, UNLESS it is in there exactly twice, one after
+		 * the other, and only one topic matches. Then we assume the first is
+		 * an empty container and the second the first page in it, so the
+		 * topic goes on the second and its title on both, which seems to
+		 * mirror how at least some MMV projects were authored.
+		*/
+
+		size_t begin, end;
+		find_range(sorted_item_keys, probe, truncated, &begin, &end);
+
+		bool container = false;
+
+		if((end - begin) == 2 && (truncated ? starts_with(prev_key, probe) : prev_key == probe))
+		{
+			container = true;
+		}
+		else if((end - begin) > 1)
+		{
+			prev = i;
+			prev_key = item_keys[i];
+			continue;
+		}
+
+		find_range(group_keys, probe, truncated, &begin, &end);
+
+		size_t pos;
+		if(live.query(begin, end, &pos) != 1 || groups[sorted_groups[pos].second].topics.size() != 1)
+		{
+			/* We didn't find exactly ONE match. */
+
+			prev = i;
+			prev_key = item_keys[i];
+			continue;
+		}
+
+		Group &group = groups[sorted_groups[pos].second];
+		const Topic &topic = group.topics[0];
+
+		if(group.norm_title != item.norm_title && log != NULL)
+		{
+			fprintf(log, "Topic fuzzy matched: %s => %s\n", item.norm_title.c_str(), topic.title.c_str());
+		}
+
+		if(container && prev != NO_ITEM)
+		{
+			items[prev].title = topic.title;
+			items[prev].has_title = true;
+		}
+
+		item.title = topic.title;
+		item.has_title = true;
+		item.topic_id = topic.id;
+		item.has_topic_id = true;
+		item.topic_order = topic.order;
+
+		group.matched = true;
+		live.remove(pos);
+
+		++matches;
+
+		prev = i;
+		prev_key = item_keys[i];
+	}
+
+	return matches;
+}
+
+unsigned int TitleMatcher::match_nearest(double max_edits, const std::vector<std::string> &page_ids, unsigned int threads, std::vector<NearestMatch> *matches)
+{
+	unsigned int max_cost = (unsigned int)(max_edits * 2.0 + 0.5);
+
+	if(max_cost == 0)
+	{
+		return 0;
+	}
+
+	/* Topics which rows will get by the ID in their page text. */
+
+	std::set<std::string> reserved;
+
+	for(size_t i = 0; i < items.size(); ++i)
+	{
+		if(!items[i].has_topic_id && !page_ids[i].empty())
+		{
+			std::string id;
+			for(size_t c = 0; c < page_ids[i].length(); ++c)
+			{
+				id += (char)(to_lower(page_ids[i][c]));
+			}
+
+			reserved.insert(id);
+		}
+	}
+
+	NearestIndex index(max_cost);
+	std::vector<size_t> key_groups;
+
+	for(size_t g = 0; g < groups.size(); ++g)
+	{
+		if(groups[g].matched || groups[g].topics.size() != 1)
+		{
+			continue;
+		}
+
+		std::string id;
+		for(size_t c = 0; c < groups[g].topics[0].id.length(); ++c)
+		{
+			id += (char)(to_lower(groups[g].topics[0].id[c]));
+		}
+
+		if(reserved.find(id) == reserved.end())
+		{
+			index.add(match_key(MATCH_ALNUM, groups[g].norm_title));
+			key_groups.push_back(g);
+		}
+	}
+
+	index.build();
+
+	std::vector<std::string> queries;
+	std::vector<size_t> query_items;
+
+	for(size_t i = 0; i < items.size(); ++i)
+	{
+		if(items[i].has_topic_id || !page_ids[i].empty())
+		{
+			continue;
+		}
+
+		std::string key = match_key(MATCH_ALNUM, items[i].norm_title);
+
+		if(key.length() >= NEAREST_MIN_LENGTH)
+		{
+			queries.push_back(key);
+			query_items.push_back(i);
+		}
+	}
+
+	std::vector<NearestIndex::Result> results;
+	index.search(queries, threads, &results);
+
+	/* The topics of the nearest rows before and after each one which were
+	 * matched by title.
+	*/
+
+	std::vector<size_t> before(items.size(), NO_TOPIC), after(items.size(), NO_TOPIC);
+
+	for(size_t i = 1; i < items.size(); ++i)
+	{
+		before[i] = items[i - 1].topic_order != NO_TOPIC ? items[i - 1].topic_order : before[i - 1];
+	}
+
+	for(size_t i = items.size(); i > 1; --i)
+	{
+		after[i - 2] = items[i - 1].topic_order != NO_TOPIC ? items[i - 1].topic_order : after[i - 1];
+	}
+
+	/* Pick the nearest topic for each row, and which row is nearest to each
+	 * topic.
+	*/
+
+	std::vector<size_t> picked(queries.size(), NO_ITEM);
+	std::vector<bool> settled(queries.size(), false);
+
+	std::map<size_t, size_t> claims;
+	std::set<size_t> contested;
+
+	for(size_t q = 0; q < queries.size(); ++q)
+	{
+		const NearestIndex::Result &r = results[q];
+		size_t item = query_items[q];
+
+		if(r.tied.size() == 1)
+		{
+			picked[q] = r.tied[0];
+		}
+		else{
+			for(size_t t = 0; t < r.tied.size(); ++t)
+			{
+				size_t order = groups[key_groups[r.tied[t]]].topics[0].order;
+
+				if((before[item] == NO_TOPIC || order > before[item])
+					&& (after[item] == NO_TOPIC || order < after[item]))
+				{
+					if(picked[q] != NO_ITEM)
+					{
+						/* More than one fits there. */
+						picked[q] = NO_ITEM;
+						break;
+					}
+
+					picked[q] = r.tied[t];
+					settled[q] = true;
+				}
+			}
+		}
+
+		if(picked[q] == NO_ITEM)
+		{
+			continue;
+		}
+
+		std::map<size_t, size_t>::iterator c = claims.find(picked[q]);
+
+		if(c == claims.end())
+		{
+			claims[picked[q]] = q;
+		}
+		else if(r.cost < results[c->second].cost)
+		{
+			c->second = q;
+			contested.erase(picked[q]);
+		}
+		else if(r.cost == results[c->second].cost)
+		{
+			contested.insert(picked[q]);
+		}
+	}
+
+	unsigned int matched = 0;
+
+	for(size_t q = 0; q < queries.size(); ++q)
+	{
+		size_t key = picked[q];
+
+		if(key == NO_ITEM || claims[key] != q || contested.find(key) != contested.end())
+		{
+			continue;
+		}
+
+		const NearestIndex::Result &r = results[q];
+
+		Item &item = items[query_items[q]];
+		Group &group = groups[key_groups[key]];
+		const Topic &topic = group.topics[0];
+
+		item.title = topic.title;
+		item.has_title = true;
+		item.topic_id = topic.id;
+		item.has_topic_id = true;
+		item.topic_order = topic.order;
+
+		group.matched = true;
+
+		NearestMatch m;
+		m.item = query_items[q];
+		m.group = key_groups[key];
+		m.edits = r.cost / 2.0;
+
+		size_t length = std::max(queries[q].length(), match_key(MATCH_ALNUM, group.norm_title).length());
+		double similarity = 1.0 - m.edits / length;
+
+		double margin = settled[q] ? 0.0
+			: r.next_cost == NearestIndex::NO_COST ? 1.0
+			: std::min(1.0, (r.next_cost - r.cost) / 2.0);
+
+		m.confidence = similarity * margin;
+
+		matches->push_back(m);
+		++matched;
+	}
+
+	return matched;
+}
+
+void TitleMatcher::index_ids()
+{
+	topics_by_id.clear();
+
+	for(size_t g = 0; g < groups.size(); ++g)
+	{
+		for(size_t t = 0; t < groups[g].topics.size(); ++t)
+		{
+			TopicRef ref;
+			ref.group = g;
+			ref.topic = t;
+
+			const std::string &id = groups[g].topics[t].id;
+			for(size_t i = 0; i < id.length(); ++i)
+			{
+				ref.id += (char)(to_lower(id[i]));
+			}
+
+			topics_by_id.push_back(ref);
+		}
+	}
+
+	std::sort(topics_by_id.begin(), topics_by_id.end());
+	ids_indexed = true;
+}
+
+unsigned int TitleMatcher::match_topic_id(size_t item, const std::string &topic_id)
+{
+	if(!ids_indexed)
+	{
+		index_ids();
+	}
+
+	TopicRef probe;
+	probe.group = 0;
+	probe.topic = 0;
+
+	for(size_t i = 0; i < topic_id.length(); ++i)
+	{
+		probe.id += (char)(to_lower(topic_id[i]));
+	}
+
+	Item &it = items[item];
+	unsigned int found = 0;
+	size_t last_group = NO_ITEM;
+
+	for(std::vector<TopicRef>::const_iterator r = std::lower_bound(topics_by_id.begin(), topics_by_id.end(), probe);
+		r != topics_by_id.end() && r->id == probe.id; ++r)
+	{
+		Group &g = groups[r->group];
+		Topic &t = g.topics[r->topic];
+
+		if(g.matched || t.taken)
+		{
+			continue;
+		}
+
+		if(r->group != last_group)
+		{
+			/* The first one in a group is the one the row gets, if it
+			 * doesn't have one already.
+			*/
+
+			if(!it.has_title)
+			{
+				it.title = t.title;
+				it.has_title = true;
+			}
+
+			if(!it.has_topic_id)
+			{
+				it.topic_id = t.id;
+				it.has_topic_id = true;
+			}
+
+			last_group = r->group;
+			++found;
+		}
+
+		t.taken = true;
+	}
+
+	return found;
+}
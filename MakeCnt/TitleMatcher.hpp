@@ -0,0 +1,158 @@
+#ifndef MAKECNT_TITLEMATCHER_HPP
+#define MAKECNT_TITLEMATCHER_HPP
+
+#include <map>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/* Matches the titles read from the index by OCR with the topics in the flat
+ * .cnt file from helpdeco, the way match_topics() in makecnt.pl does.
+ *
+ * Each pass compares the titles at some level of fuzziness, from exactly the
+ * same to the same up to where the OCR'd title was cut off. makecnt.pl
+ * compared every title with every other title and every topic for each row,
+ * normalising both again for every comparison. Here each title and topic is
+ * normalised once at the start of a pass, and sorted so everything the same
+ * (or starting with the same thing) is next to each other and can be found
+ * with a binary search. Which topics are still unmatched is kept in a Fenwick
+ * tree alongside the sorted topics, so matching one takes it out of the range
+ * in O(log n).
+*/
+class TitleMatcher
+{
+public:
+	enum Level
+	{
+		MATCH_EXACT = 0,
+		MATCH_SIMILAR,    /* Similar looking characters, like 1/l/I. */
+		MATCH_ALNUM,      /* And only letters and numbers. */
+		MATCH_TRUNCATED   /* And the topic starts with the row, less its last character. */
+	};
+
+	/* A title and topic ID from the .cnt file. */
+	struct Topic
+	{
+		std::string title;
+		std::string id;
+		size_t order;  /* Where it was in the .cnt file. */
+		bool taken;    /* Given to a row by its topic ID. */
+	};
+
+	/* The topics with the same normalised title. */
+	struct Group
+	{
+		std::string norm_title;
+		std::vector<Topic> topics;
+		bool matched;
+	};
+
+	/* A row of the index. */
+	struct Item
+	{
+		std::string norm_title;
+
+		bool has_title, has_topic_id;
+		std::string title;
+		std::string topic_id;
+
+		size_t topic_order;  /* Of the topic it was matched to by title, if any. */
+	};
+
+	/* A row matched by match_nearest(). */
+	struct NearestMatch
+	{
+		size_t item;
+		size_t group;
+
+		double edits;
+		double confidence;
+	};
+
+private:
+	std::vector<Item> items;
+	std::vector<Group> groups;
+	size_t num_topics;
+
+	/* Where each normalised title is in groups. */
+	std::map<std::string, size_t> groups_by_title;
+
+	/* Every topic in a group, by its lowercased ID then where it is. Built
+	 * the first time match_topic_id() is called.
+	*/
+	struct TopicRef
+	{
+		std::string id;
+		size_t group, topic;
+
+		bool operator<(const TopicRef &rhs) const;
+	};
+
+	std::vector<TopicRef> topics_by_id;
+	bool ids_indexed;
+
+	FILE *log;
+
+	void index_ids();
+
+public:
+	TitleMatcher(FILE *log);
+
+	/* Trims, collapses whitespace and periods and lowercases a title, the
+	 * way normalise_title() in makecnt.pl does.
+	*/
+	static std::string normalise_title(const std::string &title);
+
+	/* The key titles are compared by at a level. */
+	static std::string match_key(Level level, const std::string &norm_title);
+
+	void add_item(const std::string &title);
+	void add_topic(const std::string &title, const std::string &id);
+
+	/* Matches each unmatched row which can only be one remaining topic at
+	 * this level, like one call to match_topics(). Fuzzy matches are printed
+	 * to the log. Returns the number of rows matched.
+	*/
+	unsigned int match(Level level);
+
+	/* Matches unmatched rows to the nearest remaining topic within
+	 * max_edits, on threads threads, for titles the OCR got too wrong for
+	 * the other passes. See NearestIndex for how near is counted.
+	 *
+	 * Rows with a topic ID in their page text are left for
+	 * match_topic_id(), which is sure to be right, and so are the topics
+	 * with those IDs. Only rows with a single nearest topic which isn't the
+	 * nearest to any other row are matched, except that a tie between
+	 * topics is settled by which is between the topics of the rows either
+	 * side in the .cnt file.
+	 *
+	 * The confidence of each match is how much of the title survived the
+	 * edits, times how far (up to one edit) the next nearest topic was
+	 * behind. So a tie settled by position has no confidence.
+	*/
+	unsigned int match_nearest(double max_edits, const std::vector<std::string> &page_ids, unsigned int threads, std::vector<NearestMatch> *matches);
+
+	/* Gives an unmatched row the (first) topic with this ID from each group
+	 * which has one, and takes all topics with it out of those groups.
+	 * Returns the number of groups it was found in.
+	*/
+	unsigned int match_topic_id(size_t item, const std::string &topic_id);
+
+	const std::vector<Item> &get_items() const
+	{
+		return items;
+	}
+
+	const std::vector<Group> &get_groups() const
+	{
+		return groups;
+	}
+
+	size_t get_num_topics() const
+	{
+		return num_topics;
+	}
+};
+
+#endif /* !MAKECNT_TITLEMATCHER_HPP */
@@ -0,0 +1,155 @@
+#!/usr/bin/perl
+# This script lists or unpacks the pack file MMVRipper writes when built with
+# PACK_FILE defined, producing the same <id>.bmp/<id>.txt/<id>.ps files it
+# would otherwise have written, for the other scripts to use.
+#
+# If the pack wasn't closed properly (MMVRipper crashed), the records are read
+# from the start of the file up to the last complete one instead.
+#
+# See MMVRipper/PackFormat.hpp for the format.
+#
+# Released to public domain.
+
+use strict;
+use warnings;
+
+use Compress::Zlib qw(crc32);
+use Fcntl qw(SEEK_SET);
+
+use constant {
+	RECORD_HEADER_SIZE => 24,
+	INDEX_ENTRY_SIZE   => 28,
+	TRAILER_SIZE       => 24,
+};
+
+if((scalar @ARGV) < 2 || ($ARGV[0] ne "list" && $ARGV[0] ne "unpack"))
+{
+	die "Usage: $0 list <pack file>\n"
+		."       $0 unpack <pack file> [<output directory>]\n";
+}
+
+my ($command, $pack_file, $output_dir) = @ARGV;
+$output_dir //= ".";
+
+open(my $pack, "<:raw", $pack_file) or die "$pack_file: $!\n";
+
+my $pack_size = -s $pack;
+
+sub read_at
+{
+	my ($offset, $length) = @_;
+
+	seek($pack, $offset, SEEK_SET) or die "$pack_file: $!\n";
+
+	my $data = "";
+	while(length($data) < $length)
+	{
+		my $got = read($pack, $data, $length - length($data), length($data));
+		die "$pack_file: $!\n" unless(defined $got);
+		last if($got == 0);
+	}
+
+	return $data;
+}
+
+# Unpacks a little endian uint64 without needing a 64-bit perl.
+sub u64
+{
+	my ($lo, $hi) = unpack("VV", $_[0]);
+	return $lo + ($hi * 4294967296);
+}
+
+# Returns the index as a list of { id, kind, offset, length, crc }, sorted by
+# ID and kind with only the last record of each.
+sub read_index
+{
+	if($pack_size >= TRAILER_SIZE)
+	{
+		my $trailer = read_at($pack_size - TRAILER_SIZE, TRAILER_SIZE);
+
+		my $index_offset = u64(substr($trailer, 0, 8));
+		my ($index_count, $index_crc, $magic) = unpack("VVa8", substr($trailer, 8));
+
+		if($magic eq "MMVPACK1" && $index_offset + ($index_count * INDEX_ENTRY_SIZE) == $pack_size - TRAILER_SIZE)
+		{
+			my $index = read_at($index_offset, $index_count * INDEX_ENTRY_SIZE);
+
+			if(crc32($index) == $index_crc)
+			{
+				my @entries = ();
+
+				for(my $i = 0; $i < $index_count; ++$i)
+				{
+					my $e = substr($index, $i * INDEX_ENTRY_SIZE, INDEX_ENTRY_SIZE);
+					my ($id, $kind) = unpack("VZ4", $e);
+
+					push(@entries, {
+						id     => $id,
+						kind   => $kind,
+						offset => u64(substr($e, 8, 8)),
+						length => u64(substr($e, 16, 8)),
+						crc    => unpack("V", substr($e, 24, 4)),
+					});
+				}
+
+				return @entries;
+			}
+		}
+	}
+
+	warn "$pack_file has no valid index, reading records\n";
+
+	my %latest = ();
+	my $offset = 0;
+
+	while($pack_size - $offset >= RECORD_HEADER_SIZE)
+	{
+		my $header = read_at($offset, RECORD_HEADER_SIZE);
+
+		my ($magic, $id, $kind) = unpack("a4VZ4", $header);
+		last if($magic ne "MMVR");
+
+		my $length = u64(substr($header, 12, 8));
+		my $crc = unpack("V", substr($header, 20, 4));
+
+		last if($length > $pack_size - $offset - RECORD_HEADER_SIZE);
+		last if(crc32(read_at($offset + RECORD_HEADER_SIZE, $length)) != $crc);
+
+		$latest{"$id.$kind"} = {
+			id     => $id,
+			kind   => $kind,
+			offset => $offset + RECORD_HEADER_SIZE,
+			length => $length,
+			crc    => $crc,
+		};
+
+		$offset += RECORD_HEADER_SIZE + $length;
+	}
+
+	return sort { $a->{id} <=> $b->{id} || $a->{kind} cmp $b->{kind} } values(%latest);
+}
+
+my @entries = read_index();
+
+foreach my $e(@entries)
+{
+	if($command eq "list")
+	{
+		printf("%u\t%s\t%s\t%s\t%08x\n", $e->{id}, $e->{kind}, $e->{offset}, $e->{length}, $e->{crc});
+	}
+	else{
+		my $data = read_at($e->{offset}, $e->{length});
+
+		if(crc32($data) != $e->{crc})
+		{
+			warn "Skipping $e->{id}.$e->{kind}, checksum doesn't match\n";
+			next;
+		}
+
+		my $filename = "${output_dir}/$e->{id}.$e->{kind}";
+
+		open(my $out, ">:raw", $filename) or die "$filename: $!\n";
+		print {$out} $data;
+		close($out) or die "$filename: $!\n";
+	}
+}
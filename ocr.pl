@@ -42,13 +42,18 @@ while(<STDIN>)
 	
 	my $crop = 20 + ($depth * 16);
 	
+	# MMVRipper now saves grayscale PGM (or 1-bit PBM) screenshots, older
+	# versions saved 32-bit BMPs.
+	my ($image) = grep { -e $_ } ("$id.pgm", "$id.pbm", "$id.bmp");
+	die "No screenshot of $id found\n" unless(defined $image);
+	
 	run([ "convert",
 		"-alpha" => "deactivate",
 		"-negate",
 		"-colorspace" => "gray",
 		"-fill" => "white",
 		"-crop" => "+$crop",
-		"$id.bmp", "${tmpdir}/tmp.png" ]) or die;
+		$image, "${tmpdir}/tmp.png" ]) or die;
 	
 	my $tesseract_out = "";
 	run([ "tesseract",
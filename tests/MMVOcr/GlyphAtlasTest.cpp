@@ -0,0 +1,180 @@
+/* Learns a glyph atlas from half the rows in each set of row fixtures (see
+ * RowFixtures.hpp) and checks it reads the other half back exactly, including
+ * the characters Tesseract tends to mix up, without being sure of a glyph it
+ * has never seen. Then times reading rows.
+ *
+ * GlyphAtlasTest [timing passes]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "Clock.hpp"
+#include "GlyphAtlas.hpp"
+#include "RowFixtures.hpp"
+#include "RowImage.hpp"
+#include "Test.hpp"
+
+/* Same as MMVOcr's GLYPH_CONFIDENCE. */
+static const double MIN_CONFIDENCE = 0.9;
+
+/* Characters Tesseract mixes up, which makecnt.pl has to allow for. */
+static const char CONFUSABLE[] = "1lIO0QG";
+
+int main(int argc, char **argv)
+{
+	unsigned int passes = argc > 1 ? strtoul(argv[1], NULL, 10) : 200;
+
+	/* The second row of each set, to check sets can't be mixed. */
+	std::vector<GrayImage> other_height;
+	std::string other_text;
+
+	for(const RowFixtureSet *set = ROW_FIXTURE_SETS; set->dir != NULL; ++set)
+	{
+		std::vector<RowFixture> rows;
+		CHECK(load_row_fixtures(*set, &rows));
+
+		/* Cropped where the text is known to start (RowLayoutTest checks
+		 * finding it), leaving a unit of background.
+		*/
+
+		std::vector<GrayImage> prepared(rows.size());
+
+		for(size_t i = 0; i < rows.size(); ++i)
+		{
+			unsigned int crop = fixture_text_start(*set, rows[i].indent / 2) - set->unit;
+
+			prepare_row(rows[i].shot, crop, &(prepared[i]));
+			CHECK(prepared[i].height == set->height);
+		}
+
+		other_height.push_back(prepared[1]);
+		other_text = rows[1].text;
+
+		/* Learn from the even rows. */
+
+		GlyphAtlas atlas;
+
+		for(size_t i = 0; i < rows.size(); i += 2)
+		{
+			CHECK(atlas.learn(prepared[i], rows[i].text));
+		}
+
+		/* A row can't be learned with the wrong number of characters. */
+		CHECK(!atlas.learn(prepared[0], rows[0].text + "x"));
+		CHECK(!atlas.learn(prepared[0], "x"));
+
+		/* Read back the odd rows. */
+
+		size_t confusable = 0;
+
+		for(size_t i = 1; i < rows.size(); i += 2)
+		{
+			std::string text;
+			double confidence;
+
+			bool read = atlas.read(prepared[i], &text, &confidence);
+
+			if(i == UNIQUE_GLYPH_ROW)
+			{
+				CHECK(!read || confidence < MIN_CONFIDENCE);
+				continue;
+			}
+
+			CHECK(read);
+			CHECK(confidence >= MIN_CONFIDENCE);
+			CHECK(text == rows[i].text);
+
+			if(text != rows[i].text)
+			{
+				printf("%s: read \"%s\" instead of \"%s\"\n", rows[i].id.c_str(), text.c_str(), rows[i].text.c_str());
+			}
+
+			for(size_t c = 0; c < rows[i].text.length(); ++c)
+			{
+				confusable += strchr(CONFUSABLE, rows[i].text[c]) != NULL;
+			}
+		}
+
+		CHECK(confusable >= 10);
+
+		/* Learning rows it already knows doesn't add anything. */
+
+		size_t glyphs = atlas.size();
+
+		for(size_t i = 0; i < rows.size(); i += 2)
+		{
+			CHECK(atlas.learn(prepared[i], rows[i].text));
+		}
+
+		CHECK(atlas.size() == glyphs);
+
+		/* Saved and loaded again, it reads the same. */
+
+		char path[] = "/tmp/GlyphAtlasTest.XXXXXX";
+		int fd = mkstemp(path);
+		CHECK(fd != -1);
+		close(fd);
+
+		CHECK(atlas.save(path));
+
+		GlyphAtlas loaded;
+		CHECK(loaded.load(path));
+		CHECK(loaded.size() == atlas.size());
+
+		for(size_t i = 1; i < rows.size(); i += 2)
+		{
+			std::string a_text, b_text;
+			double a_confidence, b_confidence;
+
+			bool a = atlas.read(prepared[i], &a_text, &a_confidence);
+			bool b = loaded.read(prepared[i], &b_text, &b_confidence);
+
+			CHECK(a == b && a_text == b_text && a_confidence == b_confidence);
+		}
+
+		remove(path);
+
+		/* Timing. */
+
+		uint64 start = clock_us();
+		unsigned long read = 0;
+
+		for(unsigned int pass = 0; pass < passes; ++pass)
+		{
+			for(size_t i = 1; i < rows.size(); i += 2)
+			{
+				std::string text;
+				double confidence;
+
+				atlas.read(prepared[i], &text, &confidence);
+				++read;
+			}
+		}
+
+		double seconds = (double)(clock_us() - start) / 1000000.0;
+
+		printf("%s%%: learned %u glyphs, read %lu rows in %.2f s (%.0f rows/s)\n",
+			set->dir, (unsigned)(atlas.size()), read, seconds, seconds > 0.0 ? (double)(read) / seconds : 0.0);
+	}
+
+	/* Rows drawn at a different size aren't read at all. */
+
+	if(other_height.size() == 2)
+	{
+		GlyphAtlas atlas;
+		CHECK(atlas.learn(other_height[1], other_text));
+
+		std::string text;
+		double confidence;
+
+		CHECK(!atlas.read(other_height[0], &text, &confidence));
+		CHECK(!atlas.learn(other_height[0], "anything"));
+	}
+
+	return test_result("GlyphAtlasTest");
+}
@@ -0,0 +1,362 @@
+/* Checks OcrCache finds what was added to it, across reopening, rebuilding
+ * the index and a crash leaving half a record at the end of the log, and
+ * only for rows prepared the same way and read by the same reader. Then
+ * times it over a synthetic index where some titles turn up again and again
+ * (like "Overview"), going over it twice as when an index is ripped again:
+ *
+ * OcrCacheTest [rows] [repeated titles %]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Clock.hpp"
+#include "OcrCache.hpp"
+#include "RowFixtures.hpp"
+#include "RowImage.hpp"
+#include "Test.hpp"
+
+static const char READER[] = "Tesseract 4.1.1 -l eng --dpi 240 --psm 7 /usr/share/tessdata";
+
+/* The size of a prepared row at 200%. */
+static const unsigned int ROW_WIDTH = 400;
+static const unsigned int ROW_HEIGHT = 26;
+
+/* How many different titles the repeated ones are picked from. */
+static const unsigned int COMMON_TITLES = 50;
+
+/* A row which looks different for every title. */
+static void synthetic_row(unsigned int title, GrayImage *row)
+{
+	row->resize(ROW_WIDTH, ROW_HEIGHT);
+
+	unsigned int x = (title + 1) * 2654435761U;
+
+	for(size_t i = 0; i < row->pixels.size(); ++i)
+	{
+		x = (x * 1103515245U) + 12345U;
+		row->pixels[i] = (unsigned char)(x >> 24);
+	}
+}
+
+static std::string title_text(unsigned int title)
+{
+	char text[32];
+	sprintf(text, "Title %u", title);
+
+	return text;
+}
+
+static long file_size(const std::string &path)
+{
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 ? (long)(st.st_size) : -1;
+}
+
+static bool copy_file(const std::string &from, const std::string &to)
+{
+	FILE *in = fopen(from.c_str(), "rb");
+	FILE *out = fopen(to.c_str(), "wb");
+
+	bool ok = in != NULL && out != NULL;
+
+	char buf[4096];
+	size_t len;
+
+	while(ok && (len = fread(buf, 1, sizeof(buf), in)) > 0)
+	{
+		ok = fwrite(buf, 1, len, out) == len;
+	}
+
+	if(in != NULL)
+	{
+		fclose(in);
+	}
+
+	if(out != NULL)
+	{
+		ok = fclose(out) == 0 && ok;
+	}
+
+	return ok;
+}
+
+/* Checks every title below titles is in the cache. */
+static bool finds_all(OcrCache *cache, unsigned int titles)
+{
+	bool ok = true;
+
+	for(unsigned int t = 0; t < titles; ++t)
+	{
+		GrayImage row;
+		synthetic_row(t, &row);
+
+		std::string text;
+		ok = cache->find(cache->key(row), &text) && text == title_text(t) && ok;
+	}
+
+	return ok;
+}
+
+/* Goes over rows rows, looking each up and adding it if it isn't there,
+ * like OcrPool. A repeat_percent share of them have one of a few common
+ * titles, the rest a title of their own, numbered from first_unique.
+*/
+static void time_pass(OcrCache *cache, const char *name, unsigned int rows, unsigned int repeat_percent, unsigned int first_unique)
+{
+	OcrCache::Stats before = cache->get_stats();
+
+	srand(1);
+
+	uint64 cache_us = 0;
+	unsigned int unique = first_unique;
+
+	for(unsigned int i = 0; i < rows; ++i)
+	{
+		unsigned int title = (unsigned int)(rand() % 100) < repeat_percent
+			? (unsigned int)(rand() % COMMON_TITLES) : unique++;
+
+		GrayImage row;
+		synthetic_row(title, &row);
+
+		uint64 start_us = clock_us();
+
+		OcrCache::Key key = cache->key(row);
+		std::string text;
+
+		if(!cache->find(key, &text))
+		{
+			cache->add(key, title_text(title), 0);
+		}
+		else{
+			CHECK(text == title_text(title));
+		}
+
+		cache_us += clock_us() - start_us;
+	}
+
+	OcrCache::Stats after = cache->get_stats();
+
+	unsigned long hits = after.hits - before.hits;
+	double us_per_row = (double)(cache_us) / (double)(rows);
+
+	printf("%s: %u rows, %.1f%% found, %.1f us a row in the cache, pays off if a row takes over %.0f us to read\n",
+		name, rows, (double)(hits) * 100.0 / (double)(rows), us_per_row,
+		hits > 0 ? us_per_row * (double)(rows) / (double)(hits) : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int rows = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000;
+	unsigned int repeat_percent = argc > 2 ? strtoul(argv[2], NULL, 10) : 20;
+
+	char dir[] = "/tmp/OcrCacheTest.XXXXXX";
+	CHECK(mkdtemp(dir) != NULL);
+
+	std::string log = std::string(dir) + "/cache";
+	std::string index = log + ".idx";
+
+	/* Adding and finding. */
+
+	{
+		OcrCache cache;
+		CHECK(cache.open(log.c_str(), READER));
+		CHECK(cache.size() == 0);
+
+		GrayImage row;
+		synthetic_row(0, &row);
+
+		OcrCache::Key key = cache.key(row);
+		std::string text;
+
+		CHECK(!cache.find(key, &text));
+
+		cache.add(key, title_text(0), 1000);
+		CHECK(cache.find(key, &text) && text == title_text(0));
+
+		/* Adding it again changes nothing. */
+		cache.add(key, "Something else", 1000);
+		CHECK(cache.find(key, &text) && text == title_text(0));
+		CHECK(cache.size() == 1);
+
+		/* Nothing read is worth keeping too. */
+		synthetic_row(100000, &row);
+		cache.add(cache.key(row), "", 1000);
+		CHECK(cache.find(cache.key(row), &text) && text.empty());
+
+		OcrCache::Stats s = cache.get_stats();
+		CHECK(s.lookups == 4 && s.hits == 3 && s.saved_us == 3000);
+	}
+
+	/* Enough rows to grow the index a few times, still there after
+	 * reopening.
+	*/
+
+	{
+		OcrCache cache;
+		CHECK(cache.open(log.c_str(), READER));
+		CHECK(cache.size() == 2);
+
+		for(unsigned int t = 0; t < 10000; ++t)
+		{
+			GrayImage row;
+			synthetic_row(t, &row);
+
+			cache.add(cache.key(row), title_text(t), 0);
+		}
+
+		CHECK(cache.size() == 10001);
+		CHECK(finds_all(&cache, 10000));
+	}
+
+	{
+		OcrCache cache;
+		CHECK(cache.open(log.c_str(), READER));
+		CHECK(cache.size() == 10001);
+		CHECK(finds_all(&cache, 10000));
+	}
+
+	/* A different reader finds nothing, and what it adds is kept apart. */
+
+	{
+		OcrCache cache;
+		CHECK(cache.open(log.c_str(), "Tesseract 5.3.0 -l eng --dpi 240 --psm 7 /usr/share/tessdata"));
+
+		GrayImage row;
+		synthetic_row(0, &row);
+
+		std::string text;
+		CHECK(!cache.find(cache.key(row), &text));
+
+		cache.add(cache.key(row), "Read differently", 0);
+		CHECK(cache.find(cache.key(row), &text) && text == "Read differently");
+	}
+
+	{
+		OcrCache cache;
+		CHECK(cache.open(log.c_str(), READER));
+		CHECK(cache.size() == 10002);
+		CHECK(finds_all(&cache, 10000));
+	}
+
+	/* The same screenshot cropped differently is a different row. */
+
+	{
+		std::vector<RowFixture> fixtures;
+		CHECK(load_row_fixtures(ROW_FIXTURE_SETS[0], &fixtures));
+
+		if(!fixtures.empty())
+		{
+			OcrCache cache;
+			CHECK(cache.open(log.c_str(), READER));
+
+			GrayImage a, b;
+			prepare_row(fixtures[0].shot, 20, &a);
+			prepare_row(fixtures[0].shot, 22, &b);
+
+			cache.add(cache.key(a), fixtures[0].text, 0);
+
+			std::string text;
+			CHECK(cache.find(cache.key(a), &text) && text == fixtures[0].text);
+			CHECK(!cache.find(cache.key(b), &text));
+		}
+	}
+
+	/* Without the index, or with one which is out of date, it is brought up
+	 * to date from the log.
+	*/
+
+	CHECK(remove(index.c_str()) == 0);
+
+	{
+		OcrCache cache;
+		CHECK(cache.open(log.c_str(), READER));
+		CHECK(cache.size() == 10003);
+		CHECK(finds_all(&cache, 10000));
+	}
+
+	CHECK(copy_file(index, index + ".old"));
+
+	{
+		OcrCache cache;
+		CHECK(cache.open(log.c_str(), READER));
+
+		for(unsigned int t = 10000; t < 10100; ++t)
+		{
+			GrayImage row;
+			synthetic_row(t, &row);
+
+			cache.add(cache.key(row), title_text(t), 0);
+		}
+	}
+
+	CHECK(rename((index + ".old").c_str(), index.c_str()) == 0);
+
+	{
+		OcrCache cache;
+		CHECK(cache.open(log.c_str(), READER));
+		CHECK(cache.size() == 10103);
+		CHECK(finds_all(&cache, 10100));
+	}
+
+	/* Half a record at the end is cut off, and what is added after that can
+	 * be found after reopening.
+	*/
+
+	long complete = file_size(log);
+
+	{
+		FILE *f = fopen(log.c_str(), "ab");
+		CHECK(f != NULL);
+
+		if(f != NULL)
+		{
+			CHECK(fwrite("half a record", 1, 13, f) == 13);
+			fclose(f);
+		}
+	}
+
+	{
+		OcrCache cache;
+		CHECK(cache.open(log.c_str(), READER));
+		CHECK(file_size(log) == complete);
+		CHECK(cache.size() == 10103);
+
+		GrayImage row;
+		synthetic_row(10100, &row);
+		cache.add(cache.key(row), title_text(10100), 0);
+	}
+
+	{
+		OcrCache cache;
+		CHECK(cache.open(log.c_str(), READER));
+		CHECK(cache.size() == 10104);
+		CHECK(finds_all(&cache, 10101));
+	}
+
+	remove(index.c_str());
+	remove(log.c_str());
+
+	/* Timing, from an empty cache. */
+
+	{
+		OcrCache cache;
+		CHECK(cache.open(log.c_str(), READER));
+
+		time_pass(&cache, "First time", rows, repeat_percent, COMMON_TITLES);
+		time_pass(&cache, "Second time", rows, repeat_percent, COMMON_TITLES);
+
+		printf("%u rows cached in %ld bytes of log and %ld of index\n", cache.size(), file_size(log), file_size(index));
+	}
+
+	remove(index.c_str());
+	remove(log.c_str());
+	rmdir(dir);
+
+	return test_result("OcrCacheTest");
+}
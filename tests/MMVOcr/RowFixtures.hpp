@@ -0,0 +1,109 @@
+#ifndef TESTS_MMVOCR_ROWFIXTURES_HPP
+#define TESTS_MMVOCR_ROWFIXTURES_HPP
+
+/* Screenshots of index rows for the MMVOcr tests, in tests/fixtures/rows/.
+ *
+ * They were drawn (not captured) at 200% and 300% in a small proportional
+ * font, selected like MMVRipper saves them: tree lines, a page icon and a
+ * title, light on a dark highlight. The 200% rows are grayscale PGMs with
+ * softened edges, the 300% rows are PBMs. Each directory has a titles.lst
+ * giving the true text of every row, in the format MMVOcr writes.
+ *
+ * At depth d the icon starts 3 + 8d units in and the text 10 units after
+ * that, a unit being 2 or 3 px. The text at even positions in the listing
+ * uses every glyph in the rest, and the 26th row (Q&A Index) has a glyph
+ * in no other row.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "GrayImage.hpp"
+#include "ReadLine.hpp"
+#include "RowImage.hpp"
+
+#define ROW_FIXTURES "tests/fixtures/rows/"
+
+struct RowFixture
+{
+	size_t indent;
+	std::string id;    /* Path without the extension, for load_screenshot(). */
+	std::string text;
+
+	GrayImage shot;
+};
+
+struct RowFixtureSet
+{
+	const char *dir;
+	unsigned int unit;    /* Pixels per unit of the layout above. */
+	unsigned int height;  /* Of every row. */
+};
+
+static const RowFixtureSet ROW_FIXTURE_SETS[] = {
+	{ "200", 2, 26 },
+	{ "300", 3, 39 },
+	{ NULL, 0, 0 }
+};
+
+/* Index of the row with a glyph in no other. */
+static const size_t UNIQUE_GLYPH_ROW = 25;
+
+/* Where the text starts at a depth. */
+inline unsigned int fixture_text_start(const RowFixtureSet &set, size_t depth)
+{
+	return set.unit * (3 + (8 * depth) + 10);
+}
+
+/* Loads every row in a set, returns false if any can't be. */
+inline bool load_row_fixtures(const RowFixtureSet &set, std::vector<RowFixture> *rows)
+{
+	std::string dir = std::string(ROW_FIXTURES) + set.dir + "/";
+
+	FILE *f = fopen((dir + "titles.lst").c_str(), "r");
+	if(f == NULL)
+	{
+		fprintf(stderr, "Unable to open %stitles.lst\n", dir.c_str());
+		return false;
+	}
+
+	rows->clear();
+
+	std::string line;
+	bool ok = true;
+
+	while(ok && read_line(f, &line))
+	{
+		size_t indent = line.find_first_not_of(' ');
+		size_t id_end = line.find("  ", indent);
+
+		if(indent == std::string::npos || id_end == std::string::npos)
+		{
+			ok = false;
+			break;
+		}
+
+		RowFixture r;
+		r.indent = indent;
+		r.id = dir + line.substr(indent, id_end - indent);
+		r.text = line.substr(id_end + 2);
+
+		std::string error;
+
+		if(!load_screenshot(r.id, &(r.shot), &error))
+		{
+			fprintf(stderr, "%s\n", error.c_str());
+			ok = false;
+		}
+
+		rows->push_back(r);
+	}
+
+	fclose(f);
+
+	return ok && !rows->empty();
+}
+
+#endif /* !TESTS_MMVOCR_ROWFIXTURES_HPP */
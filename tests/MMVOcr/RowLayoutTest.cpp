@@ -0,0 +1,225 @@
+/* Checks RowLayout finds where the text starts in the row fixtures (see
+ * RowFixtures.hpp) at both sizes, works out the depths with too few rows from
+ * the others, and falls back to ocr.pl's crops when it can't tell. At 300%
+ * every title's first letter is the same width with a blank column after it,
+ * which mustn't be taken for the icon.
+*/
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "GrayImage.hpp"
+#include "RowFixtures.hpp"
+#include "RowLayout.hpp"
+#include "Test.hpp"
+
+/* As in RowLayout.cpp. */
+static const unsigned int TEXT_MARGIN = 3;
+static const unsigned int CROP_BASE = 20;
+static const unsigned int CROP_PER_LEVEL = 16;
+static const unsigned int MIN_ROWS = 10;
+
+/* Made up rows: an icon from 8 px in, then text gap px after it. */
+static const unsigned int ROW_HEIGHT = 26;
+static const unsigned int ICON_LEFT = 8;
+static const unsigned int ICON_WIDTH = 16;
+
+static void fill(GrayImage *row, unsigned int x, unsigned int y, unsigned int width, unsigned int height)
+{
+	for(unsigned int i = y; i < y + height; ++i)
+	{
+		for(unsigned int j = x; j < x + width && j < row->width; ++j)
+		{
+			row->row(i)[j] = 0xFF;
+		}
+	}
+}
+
+/* A row with an icon and letters of random widths, with dots of tree line
+ * before the icon if dotted.
+*/
+static void made_up_row(unsigned int gap, bool dotted, GrayImage *row)
+{
+	row->resize(320, ROW_HEIGHT);
+	std::fill(row->pixels.begin(), row->pixels.end(), 0x33);
+
+	if(dotted)
+	{
+		for(unsigned int x = 1; x < ICON_LEFT - 1; x += 2)
+		{
+			fill(row, x, ROW_HEIGHT / 2, 1, 1);
+		}
+	}
+
+	fill(row, ICON_LEFT, 5, ICON_WIDTH, 16);
+
+	unsigned int x = ICON_LEFT + ICON_WIDTH + gap;
+	unsigned int end = x + 100 + (rand() % 150);
+
+	while(x < end)
+	{
+		unsigned int letter = 4 + (rand() % 7);
+
+		fill(row, x, 6, letter, 14);
+		x += letter + 2;
+	}
+}
+
+/* Calibrates from made up rows at depth 0, returning how many depths it
+ * found.
+*/
+static unsigned int calibrate_made_up(unsigned int gap, bool dotted, RowLayout *layout)
+{
+	for(unsigned int i = 0; i < 20; ++i)
+	{
+		GrayImage row;
+		made_up_row(gap, dotted, &row);
+
+		layout->sample(row, 0);
+	}
+
+	return layout->calibrate();
+}
+
+int main()
+{
+	srand(1);
+
+	/* Before calibrating, and with nothing to calibrate from, crops are
+	 * ocr.pl's, including half a level for odd indents.
+	*/
+
+	{
+		RowLayout layout;
+
+		for(size_t indent = 0; indent < 10; ++indent)
+		{
+			CHECK(layout.crop(indent) == CROP_BASE + ((indent * CROP_PER_LEVEL) / 2));
+		}
+
+		CHECK(layout.calibrate() == 0);
+		CHECK(layout.crop(3) == CROP_BASE + 24);
+	}
+
+	for(const RowFixtureSet *set = ROW_FIXTURE_SETS; set->dir != NULL; ++set)
+	{
+		std::vector<RowFixture> rows;
+		CHECK(load_row_fixtures(*set, &rows));
+
+		/* The text starts a unit into the gap between the icon and the text,
+		 * and the margin is a pixel less than that at either size.
+		*/
+
+		std::vector<unsigned int> expected;
+
+		for(size_t depth = 0; depth < 5; ++depth)
+		{
+			expected.push_back(fixture_text_start(*set, depth) - TEXT_MARGIN);
+		}
+
+		/* Every row: depths 0 to 2 have enough rows to go on, 3 and 4 are
+		 * on the line through them.
+		*/
+
+		{
+			RowLayout layout;
+
+			for(size_t i = 0; i < rows.size(); ++i)
+			{
+				layout.sample(rows[i].shot, rows[i].indent);
+			}
+
+			CHECK(layout.calibrate() == 3);
+
+			for(size_t depth = 0; depth < 5; ++depth)
+			{
+				CHECK(layout.crop(depth * 2) == expected[depth]);
+
+				if(layout.crop(depth * 2) != expected[depth])
+				{
+					printf("%s%%: cropping %u px at depth %u instead of %u\n",
+						set->dir, layout.crop(depth * 2), (unsigned)(depth), expected[depth]);
+				}
+			}
+		}
+
+		/* Only depth 0 has enough rows, so the rest are ocr.pl's distance
+		 * apart from it.
+		*/
+
+		{
+			RowLayout layout;
+			unsigned int deeper = 0;
+
+			for(size_t i = 0; i < rows.size(); ++i)
+			{
+				if(rows[i].indent == 0 || deeper < MIN_ROWS - 1)
+				{
+					layout.sample(rows[i].shot, rows[i].indent);
+					deeper += rows[i].indent > 0;
+				}
+			}
+
+			CHECK(layout.calibrate() == 1);
+			CHECK(layout.crop(0) == expected[0]);
+			CHECK(layout.crop(2) == expected[0] + CROP_PER_LEVEL);
+			CHECK(layout.crop(6) == expected[0] + (3 * CROP_PER_LEVEL));
+		}
+	}
+
+	/* Rows of a different height are left out of the sample. */
+
+	{
+		std::vector<RowFixture> small, large;
+		CHECK(load_row_fixtures(ROW_FIXTURE_SETS[0], &small));
+		CHECK(load_row_fixtures(ROW_FIXTURE_SETS[1], &large));
+
+		RowLayout layout;
+
+		for(size_t i = 0; i < small.size() && i < large.size(); ++i)
+		{
+			if(small[i].indent == 0)
+			{
+				layout.sample(small[i].shot, 0);
+			}
+
+			layout.sample(large[i].shot, 0);
+		}
+
+		CHECK(layout.calibrate() == 1);
+		CHECK(layout.crop(0) == fixture_text_start(ROW_FIXTURE_SETS[0], 0) - TEXT_MARGIN);
+	}
+
+	/* With a gap between the icon and the text, the text is found... */
+
+	{
+		RowLayout layout;
+		CHECK(calibrate_made_up(6, true, &layout) == 1);
+		CHECK(layout.crop(0) == ICON_LEFT + ICON_WIDTH + 6 - TEXT_MARGIN);
+	}
+
+	{
+		RowLayout layout;
+		CHECK(calibrate_made_up(6, false, &layout) == 1);
+		CHECK(layout.crop(0) == ICON_LEFT + ICON_WIDTH + 6 - TEXT_MARGIN);
+	}
+
+	/* ...but not when it runs into the icon, or is no further from it than
+	 * letters are from each other. Then it's cropped like ocr.pl did.
+	*/
+
+	for(unsigned int gap = 0; gap <= 2; gap += 2)
+	{
+		RowLayout dotted, plain;
+
+		CHECK(calibrate_made_up(gap, true, &dotted) == 0);
+		CHECK(dotted.crop(0) == CROP_BASE);
+
+		CHECK(calibrate_made_up(gap, false, &plain) == 0);
+		CHECK(plain.crop(0) == CROP_BASE);
+	}
+
+	return test_result("RowLayoutTest");
+}
@@ -0,0 +1,433 @@
+/* Checks AsyncStore against a store whose writes only finish when the test
+ * says so: write() waiting once the queue is full, completed() only counting
+ * writes once everything before them has finished, errors being there to
+ * see by the time a write counts as completed, exists() knowing about writes
+ * still queued, one write at a time to a store which isn't thread safe, and
+ * everything queued being written before it goes away. Then times saving to
+ * a slow store with different numbers of writers:
+ *
+ * AsyncStoreTest [writes] [delay per write in ms]
+*/
+
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "AsyncStore.hpp"
+#include "Clock.hpp"
+#include "CrawlFixtures.hpp"
+#include "SlowStore.hpp"
+#include "Test.hpp"
+#include "Threading.hpp"
+
+/* Longest to wait for something which should happen straight away. */
+static const unsigned int WAIT_MS = 5000;
+
+/* A store whose writes (after they have started) wait until they are let go,
+ * and fail for chosen IDs.
+*/
+class HeldStore: public ArtifactStore
+{
+private:
+	Mutex lock;
+	MemoryStore *backing;
+	bool safe;
+
+	bool holding;
+	std::set<unsigned int> released, started, finished, failing;
+
+	unsigned int writing, max_writing;
+
+	bool is_released(unsigned int id)
+	{
+		MutexLock l(lock);
+		return !holding || released.count(id) > 0;
+	}
+
+	bool has(std::set<unsigned int> &ids, unsigned int id, unsigned int timeout_ms)
+	{
+		for(unsigned int waited = 0; ; ++waited)
+		{
+			{
+				MutexLock l(lock);
+
+				if(ids.count(id) > 0)
+				{
+					return true;
+				}
+			}
+
+			if(waited >= timeout_ms)
+			{
+				return false;
+			}
+
+			sleep_ms(1);
+		}
+	}
+
+public:
+	HeldStore(MemoryStore *backing, bool safe):
+		backing(backing),
+		safe(safe),
+		holding(true),
+		writing(0),
+		max_writing(0) {}
+
+	void release(unsigned int id)
+	{
+		MutexLock l(lock);
+		released.insert(id);
+	}
+
+	void release_all()
+	{
+		MutexLock l(lock);
+		holding = false;
+	}
+
+	void fail(unsigned int id)
+	{
+		MutexLock l(lock);
+		failing.insert(id);
+	}
+
+	/* Whether a write of id has started (or finished) within timeout_ms. */
+	bool has_started(unsigned int id, unsigned int timeout_ms)
+	{
+		return has(started, id, timeout_ms);
+	}
+
+	bool has_finished(unsigned int id, unsigned int timeout_ms)
+	{
+		return has(finished, id, timeout_ms);
+	}
+
+	unsigned int get_max_writing()
+	{
+		MutexLock l(lock);
+		return max_writing;
+	}
+
+	virtual bool exists(unsigned int id, const char *kind)
+	{
+		return backing->exists(id, kind);
+	}
+
+	virtual bool write(unsigned int id, const char *kind, const void *data, size_t len)
+	{
+		{
+			MutexLock l(lock);
+
+			started.insert(id);
+
+			if(++writing > max_writing)
+			{
+				max_writing = writing;
+			}
+		}
+
+		while(!is_released(id))
+		{
+			sleep_ms(1);
+		}
+
+		bool ok;
+
+		{
+			MutexLock l(lock);
+			ok = failing.count(id) == 0;
+		}
+
+		if(ok)
+		{
+			backing->write(id, kind, data, len);
+		}
+
+		MutexLock l(lock);
+
+		finished.insert(id);
+		--writing;
+
+		return ok;
+	}
+
+	virtual bool write(unsigned int id, const char *kind, PrintJob &job)
+	{
+		return backing->write(id, kind, job);
+	}
+
+	virtual bool thread_safe() const
+	{
+		return safe;
+	}
+};
+
+/* Makes one write, so the test can see whether it has to wait. */
+class Writer: public Thread
+{
+private:
+	ArtifactStore *store;
+	unsigned int id;
+
+protected:
+	virtual void run()
+	{
+		store->write(id, "txt", "x", 1);
+		written.post();
+	}
+
+public:
+	Semaphore written;
+
+	Writer(ArtifactStore *store, unsigned int id):
+		store(store),
+		id(id) {}
+};
+
+/* Saves writes artifacts to a store which takes delay_ms over each, through
+ * threads writers (or straight to it if zero), and prints how long the
+ * crawler would have spent waiting.
+*/
+static uint64 time_writes(unsigned int writes, unsigned int delay_ms, unsigned int threads)
+{
+	MemoryStore memory;
+	SlowStore slow(&memory, delay_ms);
+
+	AsyncStore *async = threads > 0 ? new AsyncStore(&slow, threads, 64) : NULL;
+	ArtifactStore *store = async != NULL ? (ArtifactStore*)(async) : (ArtifactStore*)(&slow);
+
+	uint64 start = clock_us();
+	uint64 waiting_us = 0;
+
+	for(unsigned int i = 0; i < writes; ++i)
+	{
+		std::string data(4096, (char)(i));
+
+		uint64 write_start = clock_us();
+		store->write(i + 1, "txt", data);
+		waiting_us += clock_us() - write_start;
+
+		/* Something to do in between, like capturing the next entry. */
+		sleep_ms(delay_ms / 2);
+	}
+
+	uint64 flush_start = clock_us();
+	store->flush();
+	uint64 flush_us = clock_us() - flush_start;
+
+	uint64 total_us = clock_us() - start;
+
+	CHECK(memory.size() == writes);
+
+	printf("%u writers: %u writes in %.2f s, " UINT64_FMT " us waiting for write() and " UINT64_FMT " us for flush()\n",
+		threads, writes, (double)(total_us) / 1000000.0, waiting_us, flush_us);
+
+	delete async;
+
+	return total_us;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int writes = argc > 1 ? strtoul(argv[1], NULL, 10) : 200;
+	unsigned int delay_ms = argc > 2 ? strtoul(argv[2], NULL, 10) : 4;
+
+	/* With the only writer busy and the queue full, the next write waits
+	 * until there is space.
+	*/
+
+	{
+		MemoryStore memory;
+		HeldStore held(&memory, true);
+
+		{
+			AsyncStore store(&held, 1, 2);
+
+			store.write(1, "txt", "1", 1);
+			CHECK(held.has_started(1, WAIT_MS));
+
+			store.write(2, "txt", "2", 1);
+			store.write(3, "txt", "3", 1);
+
+			Writer writer(&store, 4);
+			CHECK(writer.start());
+
+			CHECK(!writer.written.wait(100));
+			CHECK(store.get_stats().full == 1);
+
+			held.release(1);
+			CHECK(writer.written.wait(WAIT_MS));
+
+			writer.join();
+
+			held.release_all();
+			store.flush();
+
+			AsyncStore::Stats stats = store.get_stats();
+			CHECK(stats.writes == 4 && stats.max_queued == 2 && stats.errors == 0);
+		}
+
+		CHECK(memory.size() == 4);
+	}
+
+	/* Writes finishing out of order only count as completed once everything
+	 * before them has. Queued and unfinished writes exist, failed ones
+	 * don't.
+	*/
+
+	{
+		MemoryStore memory;
+		HeldStore held(&memory, true);
+
+		AsyncStore store(&held, 3, 8);
+		held.fail(2);
+
+		store.write(1, "txt", "1", 1);
+		store.write(2, "txt", "2", 1);
+		store.write(3, "txt", "3", 1);
+
+		CHECK(store.submitted() == 3);
+		CHECK(store.exists(1, "txt") && store.exists(2, "txt") && store.exists(3, "txt"));
+		CHECK(!store.exists(1, "ps") && !store.exists(4, "txt"));
+
+		CHECK(held.has_started(3, WAIT_MS));
+
+		held.release(3);
+		CHECK(held.has_finished(3, WAIT_MS));
+		sleep_ms(10);
+		CHECK(store.completed() == 0);
+
+		held.release(2);
+		CHECK(held.has_finished(2, WAIT_MS));
+		sleep_ms(10);
+		CHECK(store.completed() == 0);
+
+		/* The failure is already there to see. */
+		unsigned int id;
+		std::string kind;
+		CHECK(store.get_error(&id, &kind) && id == 2 && kind == "txt");
+		CHECK(!store.get_error(&id, &kind));
+
+		CHECK(!store.exists(2, "txt"));
+		CHECK(store.exists(1, "txt") && store.exists(3, "txt"));
+
+		held.release(1);
+		store.flush();
+
+		CHECK(store.completed() == 3);
+		CHECK(store.get_stats().errors == 1);
+	}
+
+	/* Whenever a write counts as completed, its error can be seen. Checked
+	 * like the crawler does, reading completed() and then the errors.
+	*/
+
+	{
+		MemoryStore memory;
+		HeldStore held(&memory, true);
+		held.release_all();
+
+		for(unsigned int i = 1; i <= 2000; i += 3)
+		{
+			held.fail(i);
+		}
+
+		AsyncStore store(&held, 4, 16);
+
+		std::set<unsigned int> reported;
+		unsigned int late = 0;
+
+		for(unsigned int i = 1; i <= 2000; ++i)
+		{
+			store.write(i, "txt", "x", 1);
+
+			uint64 completed = store.completed();
+
+			unsigned int id;
+			std::string kind;
+
+			while(store.get_error(&id, &kind))
+			{
+				reported.insert(id);
+			}
+
+			/* IDs are the same as the write numbers. */
+			for(unsigned int f = 1; f <= completed; f += 3)
+			{
+				late += reported.count(f) == 0;
+			}
+		}
+
+		store.flush();
+
+		unsigned int id;
+		std::string kind;
+
+		while(store.get_error(&id, &kind))
+		{
+			reported.insert(id);
+		}
+
+		CHECK(late == 0);
+		CHECK(reported.size() == 667);
+		CHECK(memory.size() == 2000 - 667);
+	}
+
+	/* A store which isn't thread safe gets one write at a time, however many
+	 * writers there are.
+	*/
+
+	{
+		MemoryStore memory;
+		HeldStore held(&memory, false);
+		held.release_all();
+
+		AsyncStore store(&held, 4, 16);
+
+		for(unsigned int i = 1; i <= 200; ++i)
+		{
+			store.write(i, "txt", "x", 1);
+		}
+
+		store.flush();
+
+		CHECK(held.get_max_writing() == 1);
+		CHECK(memory.size() == 200);
+	}
+
+	/* Going away writes everything still queued first. */
+
+	{
+		MemoryStore memory;
+		HeldStore held(&memory, true);
+
+		{
+			AsyncStore store(&held, 2, 64);
+
+			for(unsigned int i = 1; i <= 50; ++i)
+			{
+				store.write(i, "txt", "x", 1);
+			}
+
+			CHECK(held.has_started(1, WAIT_MS));
+			held.release_all();
+		}
+
+		CHECK(memory.size() == 50);
+	}
+
+	/* Timing. */
+
+	uint64 direct_us = time_writes(writes, delay_ms, 0);
+	uint64 one_us = time_writes(writes, delay_ms, 1);
+	uint64 four_us = time_writes(writes, delay_ms, 4);
+
+	/* Writing alongside the work in between takes about as long as the
+	 * writes alone, rather than as long as both.
+	*/
+	CHECK(one_us < direct_us && four_us < direct_us);
+
+	return test_result("AsyncStoreTest");
+}
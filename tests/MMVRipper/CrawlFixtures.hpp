@@ -0,0 +1,405 @@
+#ifndef TESTS_MMVRIPPER_CRAWLFIXTURES_HPP
+#define TESTS_MMVRIPPER_CRAWLFIXTURES_HPP
+
+/* Bits shared by the tests which crawl a SimulatedViewer: index trees to load
+ * into it, a store which keeps everything in memory, and somewhere for the
+ * tree the crawler prints (and what it complains about) to go.
+*/
+
+#include <fcntl.h>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "ArtifactStore.hpp"
+#include "ChunkPool.hpp"
+#include "Crawler.hpp"
+#include "SimulatedViewer.hpp"
+#include "Threading.hpp"
+
+/* An entry in an index tree, in the order it is printed. */
+struct TreeEntry
+{
+	unsigned int id;
+	unsigned int depth;
+	bool group;
+};
+
+/* Makes up an index tree of num_nodes entries with IDs from 100, in the format
+ * MMVRipper prints (and SimulatedViewer::load() reads). The same seed always
+ * gives the same tree.
+*/
+inline std::string make_tree(unsigned int num_nodes, unsigned int seed)
+{
+	std::string tree;
+	unsigned int depth = 0;
+	unsigned int rng = seed;
+
+	for(unsigned int i = 0; i < num_nodes; ++i)
+	{
+		rng = (rng * 1103515245U) + 12345U;
+		unsigned int r = (rng >> 16) % 100;
+
+		if(i > 0 && r < 20 && depth < 5)
+		{
+			++depth;
+		}
+		else if(depth > 0 && r >= 80)
+		{
+			depth -= 1 + (r % 3 == 0 && depth > 1);
+		}
+
+		tree.append(depth * 2, ' ');
+
+		char id[16];
+		sprintf(id, "%u\n", 100 + i);
+		tree += id;
+	}
+
+	return tree;
+}
+
+/* Reads a tree back, returns false if it isn't one. */
+inline bool parse_tree(const std::string &tree, std::vector<TreeEntry> *entries)
+{
+	entries->clear();
+
+	size_t pos = 0;
+
+	while(pos < tree.length())
+	{
+		size_t end = tree.find('\n', pos);
+		if(end == std::string::npos)
+		{
+			return false;
+		}
+
+		size_t indent = tree.find_first_not_of(' ', pos) - pos;
+		if(indent % 2 != 0 || pos + indent >= end)
+		{
+			return false;
+		}
+
+		TreeEntry e;
+		e.id = strtoul(tree.c_str() + pos + indent, NULL, 10);
+		e.depth = indent / 2;
+		e.group = false;
+
+		if(!entries->empty() && e.depth > entries->back().depth)
+		{
+			if(e.depth != entries->back().depth + 1)
+			{
+				return false;
+			}
+
+			entries->back().group = true;
+		}
+
+		entries->push_back(e);
+		pos = end + 1;
+	}
+
+	return true;
+}
+
+inline bool write_file(const std::string &path, const std::string &data)
+{
+	FILE *f = fopen(path.c_str(), "wb");
+	if(f == NULL)
+	{
+		return false;
+	}
+
+	bool ok = fwrite(data.data(), 1, data.length(), f) == data.length();
+	return fclose(f) == 0 && ok;
+}
+
+inline std::string read_file(const std::string &path)
+{
+	std::string data;
+
+	FILE *f = fopen(path.c_str(), "rb");
+	if(f != NULL)
+	{
+		char buf[4096];
+		size_t len;
+
+		while((len = fread(buf, 1, sizeof(buf), f)) > 0)
+		{
+			data.append(buf, len);
+		}
+
+		fclose(f);
+	}
+
+	return data;
+}
+
+/* The text SimulatedViewer copies from a page, as in SimulatedViewer.cpp. */
+inline std::string simulated_text(unsigned int id)
+{
+	char buf[256];
+	sprintf(buf, "Topic %u\r\n\r\nSimulated caf\x82 text for topic %u.\r\n\r\n#:SIM_%u\r\n", id, id, id);
+
+	return buf;
+}
+
+/* Whether SimulatedViewer takes PRINT_SETTLE_SLOW_MS to settle after printing
+ * a page, as in SimulatedViewer.cpp.
+*/
+inline bool simulated_slow_print(unsigned int id)
+{
+	unsigned int h = id * 2654435761U;
+	return (h >> 24) % 200 == 0;
+}
+
+/* Reads back the item data SimulatedViewer drew in a saved PGM screenshot of a
+ * selected row, zero if it isn't one.
+*/
+inline unsigned int simulated_shot_id(const std::string &pgm)
+{
+	unsigned int width, height;
+	int header;
+
+	if(sscanf(pgm.c_str(), "P5\n%u %u\n255\n%n", &width, &height, &header) != 2 || header <= 0
+		|| pgm.length() != (size_t)(header) + (width * height) || width < 32 * SimulatedViewer::ID_BIT_WIDTH)
+	{
+		return 0;
+	}
+
+	const unsigned char *row = (const unsigned char*)(pgm.data()) + header + ((height / 2) * width);
+	unsigned int id = 0;
+
+	for(unsigned int bit = 0; bit < 32; ++bit)
+	{
+		if(row[(bit * SimulatedViewer::ID_BIT_WIDTH) + (SimulatedViewer::ID_BIT_WIDTH / 2)] == 255)
+		{
+			id |= 1U << bit;
+		}
+	}
+
+	return id;
+}
+
+/* Keeps every artifact in memory, for looking at afterwards. */
+class MemoryStore: public ArtifactStore
+{
+private:
+	Mutex lock;
+	std::map<std::string, std::string> artifacts;
+
+	static std::string name(unsigned int id, const char *kind)
+	{
+		char buf[32];
+		sprintf(buf, "%u.%s", id, kind);
+
+		return buf;
+	}
+
+	/* Not copyable. */
+	MemoryStore(const MemoryStore&);
+	MemoryStore &operator=(const MemoryStore&);
+
+public:
+	MemoryStore() {}
+
+	virtual bool exists(unsigned int id, const char *kind)
+	{
+		MutexLock l(lock);
+		return artifacts.find(name(id, kind)) != artifacts.end();
+	}
+
+	virtual bool write(unsigned int id, const char *kind, const void *data, size_t len)
+	{
+		MutexLock l(lock);
+		artifacts[name(id, kind)].assign((const char*)(data), len);
+
+		return true;
+	}
+
+	virtual bool write(unsigned int id, const char *kind, PrintJob &job)
+	{
+		std::string data;
+
+		for(size_t i = 0; i < job.chunk_count(); ++i)
+		{
+			size_t len;
+			const unsigned char *chunk = job.chunk(i, &len);
+
+			data.append((const char*)(chunk), len);
+		}
+
+		job.clear();
+
+		return write(id, kind, data.data(), data.length());
+	}
+
+	virtual bool thread_safe() const
+	{
+		return true;
+	}
+
+	/* Returns false if there is no such artifact. */
+	bool get(unsigned int id, const char *kind, std::string *data)
+	{
+		MutexLock l(lock);
+
+		std::map<std::string, std::string>::const_iterator a = artifacts.find(name(id, kind));
+		if(a == artifacts.end())
+		{
+			return false;
+		}
+
+		*data = a->second;
+		return true;
+	}
+
+	size_t size()
+	{
+		MutexLock l(lock);
+		return artifacts.size();
+	}
+
+	/* Every artifact by name, for comparing stores. */
+	std::map<std::string, std::string> contents()
+	{
+		MutexLock l(lock);
+		return artifacts;
+	}
+};
+
+/* Sends standard output and standard error to files in dir while it is
+ * around, so the tree the crawler prints can be checked and its messages
+ * don't get in the way of the test's.
+*/
+class OutputCapture
+{
+private:
+	std::string out_path, err_path;
+	int saved_out, saved_err;
+
+	/* Not copyable. */
+	OutputCapture(const OutputCapture&);
+	OutputCapture &operator=(const OutputCapture&);
+
+	static int redirect(FILE *stream, const std::string &path)
+	{
+		fflush(stream);
+
+		int saved = dup(fileno(stream));
+		int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+		dup2(fd, fileno(stream));
+		close(fd);
+
+		return saved;
+	}
+
+	static void restore(FILE *stream, int saved)
+	{
+		fflush(stream);
+
+		dup2(saved, fileno(stream));
+		close(saved);
+	}
+
+public:
+	OutputCapture(const std::string &dir):
+		out_path(dir + "/stdout"),
+		err_path(dir + "/stderr")
+	{
+		saved_out = redirect(stdout, out_path);
+		saved_err = redirect(stderr, err_path);
+	}
+
+	/* Puts things back, returning what was written to standard output.
+	 * Anything written to standard error is copied to errors, if non-NULL.
+	*/
+	std::string finish(std::string *errors = NULL)
+	{
+		if(saved_out >= 0)
+		{
+			restore(stdout, saved_out);
+			restore(stderr, saved_err);
+
+			saved_out = saved_err = -1;
+		}
+
+		if(errors != NULL)
+		{
+			*errors = read_file(err_path);
+		}
+
+		return read_file(out_path);
+	}
+
+	~OutputCapture()
+	{
+		finish();
+
+		remove(out_path.c_str());
+		remove(err_path.c_str());
+	}
+};
+
+/* What a crawl with no passes saves text and screenshots of. */
+inline CrawlOptions text_and_shot_options()
+{
+	CrawlOptions options;
+	memset(&options, 0, sizeof(options));
+
+	options.index_screenshots = true;
+	options.capture_format = CAPTURE_PGM;
+	options.page_text = true;
+
+	return options;
+}
+
+/* Checks store has a screenshot of every entry in the tree and the text of
+ * every page, and nothing else. Returns how many are wrong.
+*/
+inline unsigned int check_artifacts(MemoryStore *store, const std::vector<TreeEntry> &entries)
+{
+	unsigned int wrong = 0;
+	size_t expected = 0;
+
+	for(size_t i = 0; i < entries.size(); ++i)
+	{
+		const TreeEntry &e = entries[i];
+		std::string data;
+
+		if(!store->get(e.id, "pgm", &data) || simulated_shot_id(data) != e.id)
+		{
+			++wrong;
+		}
+
+		++expected;
+
+		if(!e.group)
+		{
+			if(!store->get(e.id, "txt", &data) || data != simulated_text(e.id))
+			{
+				++wrong;
+			}
+
+			++expected;
+		}
+		else if(store->exists(e.id, "txt"))
+		{
+			++wrong;
+		}
+	}
+
+	if(store->size() != expected)
+	{
+		++wrong;
+	}
+
+	return wrong;
+}
+
+#endif /* !TESTS_MMVRIPPER_CRAWLFIXTURES_HPP */
@@ -0,0 +1,164 @@
+/* Crawls SimulatedViewers and checks the tree printed has every entry at the
+ * right depth, and that the text of every page and a screenshot of every
+ * entry were saved: walking and collecting as it goes, collecting in passes
+ * afterwards, and with a store which has it all already. An entry seen before
+ * ends the walk of the group it is in, like scanning down the listbox did.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "CrawlFixtures.hpp"
+#include "Crawler.hpp"
+#include "SimulatedViewer.hpp"
+#include "Test.hpp"
+
+/* Crawls the tree in tree_file into store, returning the tree printed. */
+static std::string crawl(const std::string &dir, const std::string &tree_file, const CrawlOptions &options,
+	MemoryStore *store, SimulatedViewer::Stats *stats)
+{
+	SimulatedViewer viewer;
+	CHECK(viewer.load(tree_file.c_str()));
+
+	OutputCapture output(dir);
+
+	Crawler crawler(&viewer, store, options);
+	crawler.reset_listbox_state();
+	crawler.run();
+
+	std::string errors;
+	std::string tree = output.finish(&errors);
+
+	CHECK(!crawler.abandoned());
+
+	if(stats != NULL)
+	{
+		*stats = viewer.get_stats();
+	}
+
+	return tree;
+}
+
+int main()
+{
+	char dir[] = "/tmp/CrawlerTest.XXXXXX";
+	CHECK(mkdtemp(dir) != NULL);
+
+	std::string tree_file = std::string(dir) + "/tree";
+
+	std::string tree = make_tree(400, 1);
+	CHECK(write_file(tree_file, tree));
+
+	std::vector<TreeEntry> entries;
+	CHECK(parse_tree(tree, &entries));
+
+	unsigned int pages = 0, deepest = 0;
+
+	for(size_t i = 0; i < entries.size(); ++i)
+	{
+		pages += !entries[i].group;
+		deepest = entries[i].depth > deepest ? entries[i].depth : deepest;
+	}
+
+	/* Enough of a tree to be worth walking. */
+	CHECK(pages > 200 && pages < entries.size() && deepest >= 3);
+
+	/* Everything in one go, moving with the arrow keys. */
+
+	MemoryStore walked;
+
+	{
+		CrawlOptions options = text_and_shot_options();
+
+		SimulatedViewer::Stats stats;
+		CHECK(crawl(dir, tree_file, options, &walked, &stats) == tree);
+
+		CHECK(check_artifacts(&walked, entries) == 0);
+		CHECK(stats.topics_opened == pages);
+		CHECK(stats.busy_violations == 0);
+	}
+
+	/* In passes afterwards, jumping to rows and cutting screenshots out of
+	 * the whole listbox, gives the same tree and the same artifacts.
+	*/
+
+	{
+		CrawlOptions options = text_and_shot_options();
+		options.capture_viewport = true;
+		options.absolute_cursor = true;
+
+		options.passes[0] = PASS_TEXT;
+		options.passes[1] = PASS_SCREENSHOTS;
+		options.num_passes = 2;
+
+		MemoryStore passes;
+		CHECK(crawl(dir, tree_file, options, &passes, NULL) == tree);
+
+		CHECK(check_artifacts(&passes, entries) == 0);
+		CHECK(passes.contents() == walked.contents());
+
+		/* Going over it again only walks the index, everything is saved
+		 * already.
+		*/
+
+		SimulatedViewer::Stats stats;
+		CHECK(crawl(dir, tree_file, options, &passes, &stats) == tree);
+
+		CHECK(stats.topics_opened == 0);
+		CHECK(passes.contents() == walked.contents());
+	}
+
+	/* Without passes too. */
+
+	{
+		SimulatedViewer::Stats stats;
+		CHECK(crawl(dir, tree_file, text_and_shot_options(), &walked, &stats) == tree);
+		CHECK(stats.topics_opened == 0);
+	}
+
+	/* Coming across 102 again in 104 stops the walk of 104 there, after
+	 * which 104 is a group with nothing in it.
+	*/
+
+	{
+		const char *repeats =
+			"100\n"
+			"101\n"
+			"  102\n"
+			"  103\n"
+			"    105\n"
+			"104\n"
+			"  106\n"
+			"  102\n"
+			"  107\n"
+			"108\n";
+
+		const char *expected =
+			"100\n"
+			"101\n"
+			"  102\n"
+			"  103\n"
+			"    105\n"
+			"104\n"
+			"  106\n"
+			"108\n";
+
+		CHECK(write_file(tree_file, repeats));
+
+		MemoryStore store;
+		CHECK(crawl(dir, tree_file, text_and_shot_options(), &store, NULL) == expected);
+
+		std::string text;
+		CHECK(store.get(106, "txt", &text) && text == simulated_text(106));
+		CHECK(!store.exists(107, "txt") && !store.exists(107, "pgm"));
+		CHECK(!store.exists(104, "txt"));
+	}
+
+	remove(tree_file.c_str());
+	rmdir(dir);
+
+	return test_result("CrawlerTest");
+}
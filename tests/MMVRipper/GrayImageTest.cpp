@@ -0,0 +1,194 @@
+/* Checks GrayImage's conversion and encoding against stored images made by
+ * another program: a 13x5 row (so PBM rows and BMP rows are padded) with
+ * pure red, green, blue, black, white and greys either side of 128.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "GrayImage.hpp"
+#include "Test.hpp"
+
+#define FIXTURES "tests/fixtures/image/"
+
+static std::string read_fixture(const char *path)
+{
+	std::string data;
+
+	FILE *f = fopen(path, "rb");
+	CHECK(f != NULL);
+
+	if(f != NULL)
+	{
+		char buf[4096];
+		size_t len;
+
+		while((len = fread(buf, 1, sizeof(buf), f)) > 0)
+		{
+			data.append(buf, len);
+		}
+
+		fclose(f);
+	}
+
+	return data;
+}
+
+static bool decode(GrayImage *image, const std::string &data)
+{
+	return image->from_pnm((const unsigned char*)(data.data()), data.length());
+}
+
+int main()
+{
+	std::string pgm = read_fixture(FIXTURES "row.pgm");
+	std::string pbm = read_fixture(FIXTURES "row.pbm");
+
+	/* Both kinds of BMP convert to the stored PGM. */
+
+	const char *bmps[] = { FIXTURES "row24.bmp", FIXTURES "row32-top-down.bmp", NULL };
+
+	for(const char **bmp = bmps; *bmp != NULL; ++bmp)
+	{
+		GrayImage image;
+		CHECK(image.load(*bmp));
+		CHECK(image.width == 13 && image.height == 5);
+
+		std::string out;
+		image.to_pgm(&out);
+		CHECK(out == pgm);
+
+		image.to_pbm(128, &out);
+		CHECK(out == pbm);
+	}
+
+	/* Luma of the pure colours and the greys either side of the threshold. */
+
+	GrayImage image;
+	CHECK(image.load(FIXTURES "row.pgm"));
+	CHECK(image.width == 13 && image.height == 5);
+
+	CHECK(image.row(0)[0] == 0);
+	CHECK(image.row(0)[1] == 255);
+	CHECK(image.row(0)[2] == 77);
+	CHECK(image.row(0)[3] == 149);
+	CHECK(image.row(0)[4] == 29);
+	CHECK(image.row(1)[0] == 127);
+	CHECK(image.row(1)[1] == 128);
+
+	/* A PGM decodes and encodes back to the same bytes, however its header
+	 * was laid out.
+	*/
+
+	std::string out;
+	image.to_pgm(&out);
+	CHECK(out == pgm);
+
+	GrayImage commented;
+	CHECK(commented.load(FIXTURES "row-comments.pgm"));
+	CHECK(commented.width == image.width && commented.height == image.height);
+	CHECK(commented.pixels == image.pixels);
+
+	/* A PBM decodes to black and white on the same side of the threshold. */
+
+	GrayImage bilevel;
+	CHECK(decode(&bilevel, pbm));
+	CHECK(bilevel.width == 13 && bilevel.height == 5);
+
+	for(size_t i = 0; i < image.pixels.size() && i < bilevel.pixels.size(); ++i)
+	{
+		CHECK(bilevel.pixels[i] == (image.pixels[i] < 128 ? 0 : 255));
+	}
+
+	bilevel.to_pbm(128, &out);
+	CHECK(out == pbm);
+
+	/* from_bgrx() honours the stride and ignores the X byte. */
+
+	{
+		const unsigned char bgrx[] = {
+			0, 0, 255, 7,    255, 0, 0, 7,    1, 2, 3, 4,
+			0, 255, 0, 9,    255, 255, 255, 9, 5, 6, 7, 8,
+		};
+
+		GrayImage small;
+		small.from_bgrx(bgrx, 12, 2, 2);
+
+		CHECK(small.width == 2 && small.height == 2);
+		CHECK(small.row(0)[0] == 77);
+		CHECK(small.row(0)[1] == 29);
+		CHECK(small.row(1)[0] == 149);
+		CHECK(small.row(1)[1] == 255);
+	}
+
+	/* Cropping is clipped to the source. */
+
+	{
+		GrayImage part;
+
+		part.crop(image, 11, 3, 10, 10);
+		CHECK(part.width == 2 && part.height == 2);
+		CHECK(part.row(0)[0] == image.row(3)[11] && part.row(1)[1] == image.row(4)[12]);
+
+		part.crop(image, -2, -1, 4, 3);
+		CHECK(part.width == 2 && part.height == 2);
+		CHECK(part.row(0)[0] == image.row(0)[0] && part.row(1)[1] == image.row(1)[1]);
+
+		part.crop(image, 13, 0, 4, 4);
+		CHECK(part.width == 0 && part.height == 0);
+
+		part.crop(image, -20, 0, 4, 4);
+		CHECK(part.width == 0 && part.height == 0);
+	}
+
+	/* Inverting twice gives back the original. */
+
+	{
+		GrayImage inverted = image;
+
+		inverted.invert();
+		CHECK(inverted.row(0)[0] == 255 && inverted.row(0)[1] == 0 && inverted.row(1)[1] == 127);
+
+		inverted.invert();
+		CHECK(inverted.pixels == image.pixels);
+	}
+
+	/* Things which aren't images we write are refused. */
+
+	{
+		GrayImage bad;
+
+		CHECK(!decode(&bad, pgm.substr(0, pgm.length() - 1)));
+		CHECK(!decode(&bad, pbm.substr(0, pbm.length() - 1)));
+		CHECK(!decode(&bad, "P6\n1 1\n255\n\x01\x02\x03"));
+		CHECK(!decode(&bad, std::string("P5\n1 1\n65535\n\0\0", 15)));
+		CHECK(!decode(&bad, "P5\n1"));
+
+		std::string bmp = read_fixture(FIXTURES "row24.bmp");
+		CHECK(!bad.from_bmp((const unsigned char*)(bmp.data()), bmp.length() - 1));
+
+		/* 8-bit palette BMPs aren't something we ever wrote. */
+		bmp[28] = 8;
+		CHECK(!bad.from_bmp((const unsigned char*)(bmp.data()), bmp.length()));
+
+		CHECK(!bad.load(FIXTURES "does-not-exist.pgm"));
+	}
+
+	/* An empty image encodes and decodes. */
+
+	{
+		GrayImage empty;
+
+		empty.to_pgm(&out);
+		CHECK(out == "P5\n0 0\n255\n");
+		CHECK(decode(&empty, out) && empty.width == 0 && empty.height == 0);
+
+		empty.to_pbm(128, &out);
+		CHECK(out == "P4\n0 0\n");
+		CHECK(decode(&empty, out) && empty.width == 0 && empty.height == 0);
+	}
+
+	return test_result("GrayImageTest");
+}
@@ -0,0 +1,361 @@
+/* Feeds print streams to JobBoundaryScanner in arbitrary chunk sizes and
+ * checks it always splits them in the same places, then times how fast it
+ * scans a large stream.
+ *
+ * JobBoundaryScannerTest [fuzz iterations] [throughput MiB]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "Clock.hpp"
+#include "JobBoundaryScanner.hpp"
+#include "Test.hpp"
+
+static const char UEL[] = "\x1B%-12345X";
+
+static std::string read_fixture(const char *path)
+{
+	std::string data;
+
+	FILE *f = fopen(path, "rb");
+	CHECK(f != NULL);
+
+	if(f != NULL)
+	{
+		char buf[4096];
+		size_t len;
+
+		while((len = fread(buf, 1, sizeof(buf), f)) > 0)
+		{
+			data.append(buf, len);
+		}
+
+		fclose(f);
+	}
+
+	return data;
+}
+
+/* Splits a stream, giving the scanner chunks of between 1 and max_chunk bytes
+ * (or the whole stream at once if max_chunk is zero). Returns the offset of
+ * the end of each job.
+*/
+static std::vector<size_t> split(const std::string &stream, size_t max_chunk)
+{
+	JobBoundaryScanner scanner;
+	std::vector<size_t> ends;
+
+	const unsigned char *data = (const unsigned char*)(stream.data());
+
+	for(size_t pos = 0; pos < stream.length();)
+	{
+		size_t len = stream.length() - pos;
+
+		if(max_chunk > 0)
+		{
+			size_t chunk = 1 + (rand() % max_chunk);
+
+			if(chunk < len)
+			{
+				len = chunk;
+			}
+		}
+
+		/* Same as PrintServer::received(), scan whatever follows a
+		 * boundary again.
+		*/
+		while(len > 0)
+		{
+			size_t end = scanner.scan(data + pos, len);
+
+			if(end == JobBoundaryScanner::NO_BOUNDARY)
+			{
+				pos += len;
+				break;
+			}
+
+			ends.push_back(pos + end);
+
+			pos += end;
+			len -= end;
+		}
+	}
+
+	return ends;
+}
+
+/* Checks a stream splits at exactly expect, however it is chunked. */
+static void check_split(const std::string &stream, const std::vector<size_t> &expect, const char *what)
+{
+	static const size_t MAX_CHUNKS[] = { 0, 1, 2, 3, 7, 64, 1000 };
+
+	for(size_t i = 0; i < sizeof(MAX_CHUNKS) / sizeof(*MAX_CHUNKS); ++i)
+	{
+		std::vector<size_t> ends = split(stream, MAX_CHUNKS[i]);
+
+		if(ends != expect)
+		{
+			fprintf(stderr, "%s: wrong split with chunks of up to %u bytes\n", what, (unsigned)(MAX_CHUNKS[i]));
+		}
+
+		CHECK(ends == expect);
+	}
+}
+
+/* One job, in one of the ways a driver might send it. Returns where the job
+ * ends within it.
+*/
+static size_t random_job(std::string *job)
+{
+	static const char *EOLS[] = { "\n", "\r\n", "\r" };
+	const char *eol = EOLS[rand() % 3];
+
+	job->clear();
+
+	bool pjl = rand() % 2;
+	if(pjl)
+	{
+		*job += UEL;
+		*job += "@PJL JOB";
+		*job += eol;
+		*job += "@PJL ENTER LANGUAGE = POSTSCRIPT";
+		*job += eol;
+	}
+
+	if(rand() % 4 == 0)
+	{
+		*job += '\x04';
+	}
+
+	*job += "%!PS-Adobe-3.0";
+	*job += eol;
+
+	for(int i = rand() % 20; i > 0; --i)
+	{
+		switch(rand() % 5)
+		{
+			case 0:
+				/* An embedded EPS file, with its own header and %%EOF. */
+				*job += "%%BeginDocument: x.eps";
+				*job += eol;
+				*job += "%!PS-Adobe-3.0 EPSF-3.0";
+				*job += eol;
+				*job += "0 0 moveto";
+				*job += eol;
+				*job += "%%EOF";
+				*job += eol;
+				*job += "%%EndDocument";
+				*job += eol;
+				break;
+
+			case 1:
+				/* Looks like the trailer but isn't at the start of a line. */
+				*job += "(%%EOF) show";
+				*job += eol;
+				break;
+
+			case 2:
+				/* Starts like a UEL, but isn't one. */
+				*job += "\x1B%-123";
+				*job += eol;
+				break;
+
+			default:
+				*job += "300 200 (Some text) 0 Tx";
+				*job += eol;
+				break;
+		}
+	}
+
+	*job += "showpage";
+	*job += eol;
+
+	size_t end;
+
+	if(pjl && rand() % 2)
+	{
+		/* No %%EOF, ended by the UEL. */
+		*job += UEL;
+		end = job->length();
+	}
+	else{
+		*job += "%%EOF";
+
+		if(rand() % 2)
+		{
+			*job += "  ";
+		}
+
+		*job += eol;
+		end = job->length();
+
+		/* "%%EOF\r" is only known to be the end once the next byte turns out
+		 * not to be a "\n", so follow it with a blank line.
+		*/
+		if(std::string(eol) == "\r")
+		{
+			*job += eol;
+		}
+
+		if(pjl)
+		{
+			*job += UEL;
+			*job += "@PJL EOJ";
+			*job += eol;
+			*job += UEL;
+		}
+	}
+
+	return end;
+}
+
+/* Random mixes of the things the scanner looks for, to check the chunking
+ * never makes a difference even when the result isn't known.
+*/
+static std::string random_junk()
+{
+	static const char *TOKENS[] = {
+		"%!PS-Adobe-3.0", "%%EOF", "%%BeginDocument", "%%EndDocument",
+		"\x1B%-12345X", "\x1B%-123", "\x1B", "\r", "\n", "\r\n", "\x04",
+		" ", "x", "%%", "%!PS-Adob", "%%EO"
+	};
+
+	std::string junk;
+
+	for(int i = rand() % 200; i > 0; --i)
+	{
+		junk += TOKENS[rand() % (sizeof(TOKENS) / sizeof(*TOKENS))];
+	}
+
+	return junk;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+	unsigned int throughput_mib = argc > 2 ? atoi(argv[2]) : 256;
+
+	srand(1);
+
+	/* Captured style job, three times over. It ends at its last %%EOF
+	 * line, the one in the embedded EPS doesn't count.
+	*/
+
+	std::string fixture = read_fixture("tests/fixtures/print/adobe-pjl.ps");
+	size_t fixture_end = fixture.rfind("%%EOF\r\n") + 7;
+
+	{
+		std::string stream;
+		std::vector<size_t> expect;
+
+		for(int i = 0; i < 3; ++i)
+		{
+			expect.push_back(stream.length() + fixture_end);
+			stream += fixture;
+		}
+
+		check_split(stream, expect, "adobe-pjl.ps");
+	}
+
+	/* Nothing without a header is a job, and neither is anything inside an
+	 * embedded document.
+	*/
+
+	check_split("%%EOF\n%%EOF\r\n\x1B%-12345X", std::vector<size_t>(), "no header");
+	check_split("%!PS-Adobe-3.0\n%%BeginDocument\n%%EOF\n\x1B%-12345X", std::vector<size_t>(1, 46), "UEL inside document");
+	check_split("%!PS-Adobe-3.0\n%%BeginDocument\n%%EOF\n%%EndDocument\n%%EOFS\n", std::vector<size_t>(), "not quite %%EOF");
+
+	/* Random jobs one after another, where the answer is known. */
+
+	for(unsigned int i = 0; i < iterations; ++i)
+	{
+		std::string stream;
+		std::vector<size_t> expect;
+
+		for(int j = 1 + rand() % 5; j > 0; --j)
+		{
+			std::string job;
+			size_t end = random_job(&job);
+
+			expect.push_back(stream.length() + end);
+			stream += job;
+		}
+
+		check_split(stream, expect, "random jobs");
+	}
+
+	/* Random junk, where it only has to split the same way every time. */
+
+	for(unsigned int i = 0; i < iterations; ++i)
+	{
+		std::string junk = random_junk();
+		check_split(junk, split(junk, 0), "random junk");
+	}
+
+	/* Throughput over a big stream of big jobs, in the 64 KiB pieces the
+	 * print server reads.
+	*/
+
+	std::string big_job = fixture.substr(0, fixture.find("%%Trailer"));
+	while(big_job.length() < 1024 * 1024)
+	{
+		big_job += "300 260 (The quick brown fox jumps over the lazy dog) 0 Tx\r\n";
+	}
+	big_job += fixture.substr(fixture.find("%%Trailer"));
+
+	std::string stream;
+	while(stream.length() < 16 * 1024 * 1024)
+	{
+		stream += big_job;
+	}
+
+	size_t jobs_per_stream = stream.length() / big_job.length();
+	size_t rounds = (throughput_mib * 1024 * 1024) / stream.length();
+	if(rounds == 0)
+	{
+		rounds = 1;
+	}
+
+	JobBoundaryScanner scanner;
+	const unsigned char *data = (const unsigned char*)(stream.data());
+	size_t jobs = 0;
+
+	uint64 start = clock_us();
+
+	for(size_t r = 0; r < rounds; ++r)
+	{
+		for(size_t pos = 0; pos < stream.length();)
+		{
+			size_t len = stream.length() - pos;
+			if(len > 65536)
+			{
+				len = 65536;
+			}
+
+			size_t end = scanner.scan(data + pos, len);
+
+			if(end == JobBoundaryScanner::NO_BOUNDARY)
+			{
+				pos += len;
+			}
+			else{
+				pos += end;
+				++jobs;
+			}
+		}
+	}
+
+	uint64 elapsed = clock_us() - start;
+
+	CHECK(jobs == jobs_per_stream * rounds);
+
+	printf("Scanned %u MiB in %u ms (%.0f MiB/s), found %u jobs\n",
+		(unsigned)((stream.length() * rounds) >> 20), (unsigned)(elapsed / 1000),
+		((double)(stream.length() * rounds) / 1048576.0) / ((double)(elapsed ? elapsed : 1) / 1000000.0),
+		(unsigned)(jobs));
+
+	return test_result("JobBoundaryScannerTest");
+}
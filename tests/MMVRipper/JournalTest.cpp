@@ -0,0 +1,426 @@
+/* Checks the journal reads back what was written to it, including after a
+ * crash cut the last record short at any point, and that a crawl picks up
+ * from a journal cut off part way through: printing the same tree, skipping
+ * everything the journal says was finished and nothing else. Then crawls
+ * with a store which finishes writes well after they are made, and checks an
+ * entry is never in the journal before everything saved for it is written.
+*/
+
+#include <deque>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "CrawlFixtures.hpp"
+#include "Crawler.hpp"
+#include "Journal.hpp"
+#include "SimulatedViewer.hpp"
+#include "Test.hpp"
+
+/* Writes out the first length bytes of data as the journal. */
+static bool cut_journal(const std::string &path, const std::string &data, size_t length)
+{
+	return write_file(path, data.substr(0, length));
+}
+
+/* A store which only finishes writes once LAG more have been made after
+ * them, checking each time the journal doesn't already say one which hasn't
+ * finished has.
+*/
+class LaggingStore: public ArtifactStore
+{
+private:
+	enum { LAG = 5 };
+
+	struct Write
+	{
+		unsigned int id;
+		std::string kind;
+		std::string data;
+	};
+
+	MemoryStore *backing;
+	std::string journal;
+
+	std::deque<Write> pending;
+	uint64 made, finished;
+
+	void finish(size_t keep)
+	{
+		check_journal();
+
+		while(pending.size() > keep)
+		{
+			Write &w = pending.front();
+			backing->write(w.id, w.kind.c_str(), w.data.data(), w.data.length());
+
+			pending.pop_front();
+			++finished;
+		}
+	}
+
+public:
+	unsigned long early;  /* Records for writes which hadn't finished. */
+	unsigned long checks;
+
+	LaggingStore(MemoryStore *backing, const char *journal):
+		backing(backing),
+		journal(journal),
+		made(0),
+		finished(0),
+		early(0),
+		checks(0) {}
+
+	virtual bool exists(unsigned int id, const char *kind)
+	{
+		return backing->exists(id, kind);
+	}
+
+	virtual bool write(unsigned int id, const char *kind, const void *data, size_t len)
+	{
+		Write w;
+		w.id = id;
+		w.kind = kind;
+		w.data.assign((const char*)(data), len);
+
+		pending.push_back(w);
+		++made;
+
+		finish(LAG);
+
+		return true;
+	}
+
+	virtual bool write(unsigned int, const char *, PrintJob &)
+	{
+		return false;
+	}
+
+	virtual uint64 submitted()
+	{
+		return made;
+	}
+
+	virtual uint64 completed()
+	{
+		return finished;
+	}
+
+	virtual void flush()
+	{
+		finish(0);
+	}
+
+	/* Counts any A or D records in the journal for writes still pending. */
+	void check_journal()
+	{
+		std::set<unsigned int> unfinished;
+		std::set<std::string> unfinished_artifacts;
+
+		for(size_t i = 0; i < pending.size(); ++i)
+		{
+			char name[32];
+			sprintf(name, "%u %s", pending[i].id, pending[i].kind.c_str());
+
+			unfinished.insert(pending[i].id);
+			unfinished_artifacts.insert(name);
+		}
+
+		std::string data = read_file(journal);
+		size_t pos = 0, end;
+
+		while((end = data.find('\n', pos)) != std::string::npos)
+		{
+			std::string line = data.substr(pos, end - pos);
+			unsigned int id;
+
+			if(line.length() > 2 && line[0] == 'A' && unfinished_artifacts.count(line.substr(2)) > 0)
+			{
+				++early;
+			}
+			else if(sscanf(line.c_str(), "D %u", &id) == 1 && unfinished.count(id) > 0)
+			{
+				++early;
+			}
+
+			pos = end + 1;
+		}
+
+		++checks;
+	}
+};
+
+/* Crawls the tree in tree_file with a journal, returning the tree printed and
+ * anything complained about.
+*/
+static std::string crawl(const std::string &dir, const std::string &tree_file, const std::string &journal,
+	ArtifactStore *store, SimulatedViewer::Stats *stats, std::string *errors)
+{
+	SimulatedViewer viewer;
+	CHECK(viewer.load(tree_file.c_str()));
+
+	CrawlOptions options = text_and_shot_options();
+	options.journal = journal.c_str();
+
+	OutputCapture output(dir);
+
+	{
+		Crawler crawler(&viewer, store, options);
+		crawler.reset_listbox_state();
+		crawler.run();
+	}
+
+	if(stats != NULL)
+	{
+		*stats = viewer.get_stats();
+	}
+
+	return output.finish(errors);
+}
+
+int main()
+{
+	char dir[] = "/tmp/JournalTest.XXXXXX";
+	CHECK(mkdtemp(dir) != NULL);
+
+	std::string journal = std::string(dir) + "/journal";
+
+	/* Written and read back. */
+
+	{
+		Journal j;
+		CHECK(j.open(journal.c_str()));
+
+		j.visited(12, 0, 0);
+		j.visited(1234, 12, 1);
+		j.visited(1235, 12, 1);
+		j.artifact(1234, "txt");
+		j.done(1234);
+		j.visited(13, 0, 0);
+		j.done(1235);
+		j.done(12);
+	}
+
+	{
+		Journal j;
+		CHECK(j.open(journal.c_str()));
+
+		const Journal::Node *n = j.find(12);
+		CHECK(n != NULL && n->done && n->done_before && n->depth == 0 && n->parent == 0);
+		CHECK(n != NULL && n->children.size() == 2 && n->children[0] == 1234 && n->children[1] == 1235);
+
+		n = j.find(1235);
+		CHECK(n != NULL && n->done_before && n->depth == 1 && n->parent == 12);
+
+		n = j.find(13);
+		CHECK(n != NULL && !n->done && !n->done_before);
+
+		CHECK(j.find(14) == NULL);
+
+		/* Done now, but not before. */
+		j.done(13);
+
+		n = j.find(13);
+		CHECK(n != NULL && n->done && !n->done_before);
+	}
+
+	/* Cut short anywhere in the last record ("D 1234"), the record is lost
+	 * but nothing else: not 12 being done, and the next record starts on a
+	 * line of its own.
+	*/
+
+	remove(journal.c_str());
+
+	{
+		Journal j;
+		CHECK(j.open(journal.c_str()));
+
+		j.visited(12, 0, 0);
+		j.visited(1234, 12, 1);
+		j.done(1234);
+	}
+
+	std::string whole = read_file(journal);
+	size_t last = whole.rfind('\n', whole.length() - 2) + 1;
+
+	for(size_t cut = last; cut < whole.length(); ++cut)
+	{
+		CHECK(cut_journal(journal, whole, cut));
+
+		{
+			Journal j;
+			CHECK(j.open(journal.c_str()));
+
+			const Journal::Node *n = j.find(1234);
+			CHECK(n != NULL && !n->done_before);
+
+			n = j.find(12);
+			CHECK(n != NULL && !n->done_before);
+
+			CHECK(read_file(journal) == whole.substr(0, last));
+
+			j.visited(99, 0, 0);
+		}
+
+		{
+			Journal j;
+			CHECK(j.open(journal.c_str()));
+
+			CHECK(j.find(99) != NULL);
+			CHECK(j.find(12) != NULL && !j.find(12)->done_before);
+		}
+	}
+
+	remove(journal.c_str());
+
+	/* A crawl, then one carrying on from its journal cut off half way
+	 * through a record, into a store of its own so what it saved again
+	 * shows. It opens exactly the pages not under something the journal
+	 * says was done.
+	*/
+
+	std::string tree_file = std::string(dir) + "/tree";
+
+	std::string tree = make_tree(300, 5);
+	CHECK(write_file(tree_file, tree));
+
+	std::vector<TreeEntry> entries;
+	CHECK(parse_tree(tree, &entries));
+
+	{
+		MemoryStore store;
+		CHECK(crawl(dir, tree_file, journal, &store, NULL, NULL) == tree);
+		CHECK(check_artifacts(&store, entries) == 0);
+	}
+
+	whole = read_file(journal);
+
+	for(unsigned int tenths = 2; tenths <= 8; tenths += 3)
+	{
+		size_t cut = (whole.length() * tenths) / 10;
+		if(whole[cut - 1] == '\n')
+		{
+			++cut;
+		}
+
+		CHECK(cut_journal(journal, whole, cut));
+
+		/* What the cut journal says was done, by hand. */
+
+		std::set<unsigned int> done;
+		size_t pos = 0, end;
+
+		while((end = whole.find('\n', pos)) != std::string::npos && end < cut)
+		{
+			unsigned int id;
+
+			if(sscanf(whole.c_str() + pos, "D %u", &id) == 1)
+			{
+				done.insert(id);
+			}
+
+			pos = end + 1;
+		}
+
+		CHECK(!done.empty());
+
+		/* Entries under (or at) something done aren't visited, the rest
+		 * are.
+		*/
+
+		std::vector<unsigned int> path;
+		unsigned int skipped = 0, pages = 0, wrong = 0;
+
+		MemoryStore store;
+		SimulatedViewer::Stats stats;
+		std::string errors;
+
+		CHECK(crawl(dir, tree_file, journal, &store, &stats, &errors) == tree);
+
+		for(size_t i = 0; i < entries.size(); ++i)
+		{
+			const TreeEntry &e = entries[i];
+
+			path.resize(e.depth);
+			path.push_back(e.id);
+
+			bool under_done = false;
+
+			for(size_t p = 0; p < path.size(); ++p)
+			{
+				under_done = under_done || done.count(path[p]) > 0;
+			}
+
+			skipped += under_done;
+			pages += !under_done && !e.group;
+
+			wrong += store.exists(e.id, "pgm") == under_done;
+			wrong += !e.group && store.exists(e.id, "txt") == under_done;
+		}
+
+		CHECK(skipped > 0 && skipped < entries.size());
+		CHECK(wrong == 0);
+		CHECK(stats.topics_opened == pages);
+
+		char skipped_message[64];
+		sprintf(skipped_message, "Skipped %u index entries", skipped);
+		CHECK(errors.find(skipped_message) != std::string::npos);
+
+		/* Everything is done now. */
+
+		Journal j;
+		CHECK(j.open(journal.c_str()));
+
+		for(size_t i = 0; i < entries.size(); ++i)
+		{
+			CHECK(j.find(entries[i].id) != NULL && j.find(entries[i].id)->done_before);
+		}
+	}
+
+	remove(journal.c_str());
+
+	/* With writes finishing late, nothing is in the journal before it is
+	 * written, and it all is at the end.
+	*/
+
+	{
+		MemoryStore store;
+		LaggingStore lagging(&store, journal.c_str());
+
+		CHECK(crawl(dir, tree_file, journal, &lagging, NULL, NULL) == tree);
+
+		CHECK(lagging.checks > entries.size());
+		CHECK(lagging.early == 0);
+		CHECK(check_artifacts(&store, entries) == 0);
+
+		Journal j;
+		CHECK(j.open(journal.c_str()));
+
+		for(size_t i = 0; i < entries.size(); ++i)
+		{
+			CHECK(j.find(entries[i].id) != NULL && j.find(entries[i].id)->done_before);
+		}
+
+		/* Every artifact is recorded too. */
+
+		std::string data = read_file(journal);
+		unsigned long artifacts = 0;
+
+		for(size_t pos = 0; (pos = data.find("\nA ", pos)) != std::string::npos; ++pos)
+		{
+			++artifacts;
+		}
+
+		CHECK(artifacts == store.size());
+	}
+
+	remove(journal.c_str());
+	remove(tree_file.c_str());
+	rmdir(dir);
+
+	return test_result("JournalTest");
+}
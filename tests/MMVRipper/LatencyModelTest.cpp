@@ -0,0 +1,280 @@
+/* Checks how long LatencyModel says to wait: the default until it has 8
+ * samples, then the slowest recent one plus half again plus 20ms, never less
+ * than 50ms or more than 10s, with a timeout counting as twice as long as was
+ * waited. Then crawls SimulatedViewer printing every page, and checks the
+ * crawler never does anything while the viewer is still busy after printing
+ * (even when it looks idle for a moment part way through), and that it gives
+ * up waiting and learns from it when the limit is too tight.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "CrawlFixtures.hpp"
+#include "Crawler.hpp"
+#include "LatencyModel.hpp"
+#include "SimulatedViewer.hpp"
+#include "Test.hpp"
+
+static const uint64 DEFAULT_US = 500000;
+
+/* Counts the lines in text starting with prefix. */
+static unsigned int count_lines(const std::string &text, const char *prefix)
+{
+	unsigned int count = 0;
+	size_t pos = 0;
+
+	while(pos < text.length())
+	{
+		count += text.compare(pos, strlen(prefix), prefix) == 0;
+
+		size_t end = text.find('\n', pos);
+		pos = end == std::string::npos ? text.length() : end + 1;
+	}
+
+	return count;
+}
+
+/* Reads the samples for op from a file saved by LatencyModel::save(). */
+static std::vector<unsigned long> saved_samples(const std::string &path, const char *op)
+{
+	std::vector<unsigned long> samples;
+
+	std::string data = read_file(path);
+	std::string prefix = std::string(op) + " ";
+
+	size_t pos = data.find(prefix);
+
+	if(pos == 0 || (pos != std::string::npos && data[pos - 1] == '\n'))
+	{
+		const char *p = data.c_str() + pos + prefix.length();
+
+		while(*p != '\n' && *p != '\0')
+		{
+			char *end;
+			samples.push_back(strtoul(p, &end, 10));
+
+			p = end;
+		}
+	}
+
+	return samples;
+}
+
+/* Crawls the tree in tree_file printing every page, returning what was
+ * printed to stdout.
+*/
+static std::string crawl(const std::string &dir, const std::string &tree_file, const std::string &latency_file,
+	SimulatedViewer::Stats *stats, std::string *errors)
+{
+	SimulatedViewer viewer;
+	CHECK(viewer.load(tree_file.c_str()));
+
+	CrawlOptions options;
+	memset(&options, 0, sizeof(options));
+
+	options.page_printout = true;
+	options.latency_file = latency_file.c_str();
+
+	MemoryStore store;
+	OutputCapture output(dir);
+
+	{
+		Crawler crawler(&viewer, &store, options);
+		crawler.reset_listbox_state();
+		crawler.run();
+	}
+
+	*stats = viewer.get_stats();
+
+	return output.finish(errors);
+}
+
+int main()
+{
+	/* The default until there are enough samples. */
+
+	{
+		LatencyModel model(DEFAULT_US);
+		CHECK(model.limit_us("print") == DEFAULT_US);
+
+		for(int i = 0; i < 7; ++i)
+		{
+			model.settled("print", 100000);
+		}
+
+		CHECK(model.limit_us("print") == DEFAULT_US);
+
+		model.settled("print", 100000);
+		CHECK(model.limit_us("print") == 100000 + 50000 + 20000);
+
+		/* The slowest counts. */
+		model.settled("print", 200000);
+		model.settled("print", 10);
+		CHECK(model.limit_us("print") == 200000 + 100000 + 20000);
+
+		/* Operations are separate. */
+		CHECK(model.limit_us("open") == DEFAULT_US);
+	}
+
+	/* Clamped at both ends. */
+
+	{
+		LatencyModel model(DEFAULT_US);
+
+		for(int i = 0; i < 8; ++i)
+		{
+			model.settled("fast", 1000);
+			model.settled("slow", 9000000);
+		}
+
+		CHECK(model.limit_us("fast") == 50000);
+		CHECK(model.limit_us("slow") == 10000000);
+	}
+
+	/* A timeout counts twice what was waited, and drops out again once
+	 * enough newer samples have come in.
+	*/
+
+	{
+		LatencyModel model(DEFAULT_US);
+
+		for(int i = 0; i < 8; ++i)
+		{
+			model.settled("print", 40000);
+		}
+
+		CHECK(model.limit_us("print") == 80000);
+
+		model.timed_out("print", 80000);
+		CHECK(model.limit_us("print") == 160000 + 80000 + 20000);
+
+		for(int i = 0; i < LatencyModel::MAX_SAMPLES - 1; ++i)
+		{
+			model.settled("print", 40000);
+		}
+
+		CHECK(model.limit_us("print") == 260000);
+
+		model.settled("print", 40000);
+		CHECK(model.limit_us("print") == 80000);
+	}
+
+	char dir[] = "/tmp/LatencyModelTest.XXXXXX";
+	CHECK(mkdtemp(dir) != NULL);
+
+	std::string latency_file = std::string(dir) + "/latency";
+
+	/* Saved oldest first, and loaded back the same. */
+
+	{
+		LatencyModel model(DEFAULT_US);
+
+		for(unsigned int i = 1; i <= LatencyModel::MAX_SAMPLES + 2; ++i)
+		{
+			model.settled("print", i * 1000);
+		}
+
+		CHECK(model.save(latency_file.c_str()));
+
+		std::vector<unsigned long> samples = saved_samples(latency_file, "print");
+		CHECK(samples.size() == LatencyModel::MAX_SAMPLES);
+		CHECK(!samples.empty() && samples.front() == 3000 && samples.back() == (LatencyModel::MAX_SAMPLES + 2) * 1000);
+
+		LatencyModel loaded(DEFAULT_US);
+		CHECK(loaded.load(latency_file.c_str()));
+		CHECK(loaded.limit_us("print") == model.limit_us("print"));
+
+		/* Another sample pushes out the oldest loaded one. */
+		loaded.settled("print", 1);
+		CHECK(loaded.save(latency_file.c_str()));
+		CHECK(saved_samples(latency_file, "print").front() == 4000);
+
+		remove(latency_file.c_str());
+	}
+
+	/* Crawls printing every page, including ones which take a long time to
+	 * settle.
+	*/
+
+	std::string tree_file = std::string(dir) + "/tree";
+
+	std::string tree = make_tree(150, 4);
+	CHECK(write_file(tree_file, tree));
+
+	std::vector<TreeEntry> entries;
+	CHECK(parse_tree(tree, &entries));
+
+	unsigned int pages = 0, slow = 0;
+
+	for(size_t i = 0; i < entries.size(); ++i)
+	{
+		pages += !entries[i].group;
+		slow += !entries[i].group && simulated_slow_print(entries[i].id);
+	}
+
+	CHECK(slow > 0);
+
+	/* Starting from a model which has seen slow prints, it waits long enough
+	 * every time. The model is filled in as it goes and saved at the end.
+	*/
+
+	{
+		CHECK(write_file(latency_file, "print 150000 150000 150000 150000 150000 150000 150000 150000\n"));
+
+		SimulatedViewer::Stats stats;
+		std::string errors;
+
+		std::string out = crawl(dir, tree_file, latency_file, &stats, &errors);
+
+		CHECK(count_lines(out, "Printed page ") == pages);
+		CHECK(count_lines(errors, "Viewer still busy") == 0);
+		CHECK(stats.topics_opened == pages);
+		CHECK(stats.busy_violations == 0);
+
+		std::vector<unsigned long> samples = saved_samples(latency_file, "print");
+		CHECK(samples.size() == (pages + 8 < LatencyModel::MAX_SAMPLES ? pages + 8 : (unsigned int)(LatencyModel::MAX_SAMPLES)));
+
+		for(size_t i = 0; i < samples.size(); ++i)
+		{
+			CHECK(samples[i] < (SimulatedViewer::PRINT_SETTLE_SLOW_MS + 50) * 1000);
+		}
+	}
+
+	/* Starting from a model which only ever saw fast prints, the first slow
+	 * one times out and is recorded as twice as long as was waited, which is
+	 * long enough for the rest.
+	*/
+
+	{
+		CHECK(write_file(latency_file, "print 1000 1000 1000 1000 1000 1000 1000 1000\n"));
+
+		SimulatedViewer::Stats stats;
+		std::string errors;
+
+		std::string out = crawl(dir, tree_file, latency_file, &stats, &errors);
+
+		CHECK(count_lines(out, "Printed page ") == pages);
+		CHECK(count_lines(errors, "Viewer still busy") == 1);
+
+		std::vector<unsigned long> samples = saved_samples(latency_file, "print");
+		bool doubled = false;
+
+		for(size_t i = 0; i < samples.size(); ++i)
+		{
+			doubled = doubled || samples[i] >= 2 * 50000;
+		}
+
+		CHECK(doubled);
+	}
+
+	remove(latency_file.c_str());
+	remove(tree_file.c_str());
+	rmdir(dir);
+
+	return test_result("LatencyModelTest");
+}
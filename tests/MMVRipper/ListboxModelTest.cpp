@@ -0,0 +1,229 @@
+/* Drives ListboxModel around SimulatedViewer's listbox at random in
+ * verification mode, expanding and collapsing groups and moving with the
+ * arrow keys, HOME/END and (if allowed) set_cursor(), and checks the model
+ * never disagrees with the listbox. Then changes the listbox behind its back
+ * and checks it notices and reads it again.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "ListboxModel.hpp"
+#include "SimulatedViewer.hpp"
+#include "Test.hpp"
+
+/* Whether the model has the same rows and cursor as the listbox. */
+static bool same(SimulatedViewer *viewer, const ListboxModel &listbox)
+{
+	if(viewer->get_count() != listbox.size() || viewer->get_cursor() != listbox.get_cursor())
+	{
+		return false;
+	}
+
+	for(unsigned int i = 0; i < listbox.size(); ++i)
+	{
+		if(viewer->get_item_data(i) != listbox.item(i))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Makes steps random moves, expands and collapses like the crawler's, with
+ * groups only expanded under the last one expanded and collapsed from one of
+ * their children. Returns false if the model was ever wrong.
+*/
+static bool wander(SimulatedViewer *viewer, ListboxModel *listbox, unsigned int steps)
+{
+	std::vector<unsigned int> open_rows, open_counts;
+	bool ok = true;
+
+	for(unsigned int s = 0; s < steps; ++s)
+	{
+		unsigned int begin = open_rows.empty() ? 0 : open_rows.back() + 1;
+		unsigned int end = open_rows.empty() ? listbox->size() : begin + open_counts.back();
+
+		unsigned int r = rand() % 100;
+
+		if(r < 10)
+		{
+			/* HOME or END, or anywhere. */
+			unsigned int last = listbox->size() - 1;
+			listbox->move_to(r < 3 ? 0 : r < 6 ? last : rand() % listbox->size());
+		}
+		else if(r < 70)
+		{
+			listbox->move_to(begin + (rand() % (end - begin)));
+
+			unsigned int idx = listbox->get_cursor();
+			unsigned int num_children = listbox->expand();
+
+			if(num_children > 0)
+			{
+				open_rows.push_back(idx);
+				open_counts.push_back(num_children);
+			}
+		}
+		else if(!open_rows.empty())
+		{
+			listbox->move_to(begin + (rand() % (end - begin)));
+			listbox->collapse(open_rows.back(), open_counts.back());
+
+			open_rows.pop_back();
+			open_counts.pop_back();
+		}
+
+		ok = same(viewer, *listbox) && ok;
+	}
+
+	return ok;
+}
+
+/* Finds the first two groups in the listbox (which has nothing expanded),
+ * expanding and collapsing them through the model. Returns false if there
+ * aren't two.
+*/
+static bool first_groups(ListboxModel *listbox, unsigned int *first, unsigned int *first_count,
+	unsigned int *second, unsigned int *second_count)
+{
+	std::vector<unsigned int> rows, counts;
+
+	for(unsigned int i = 0; i < listbox->size() && rows.size() < 2; ++i)
+	{
+		listbox->move_to(i);
+
+		unsigned int num_children = listbox->expand();
+
+		if(num_children > 0)
+		{
+			rows.push_back(i);
+			counts.push_back(num_children);
+
+			listbox->collapse(i, num_children);
+		}
+	}
+
+	if(rows.size() < 2)
+	{
+		return false;
+	}
+
+	*first = rows[0];
+	*first_count = counts[0];
+	*second = rows[1];
+	*second_count = counts[1];
+
+	return true;
+}
+
+int main()
+{
+	srand(1);
+
+	/* Arrow keys and HOME/END, then set_cursor() as well. */
+
+	for(int absolute = 0; absolute <= 1; ++absolute)
+	{
+		SimulatedViewer viewer;
+		viewer.generate(2000, 3);
+
+		ListboxModel listbox(&viewer, (absolute != 0), true);
+		listbox.load();
+
+		CHECK(wander(&viewer, &listbox, 3000));
+
+		ListboxModel::Stats stats = listbox.get_stats();
+
+		CHECK(stats.mismatches == 0);
+		CHECK(stats.resyncs == 0);
+		CHECK(stats.expand_tests > 1000 && stats.collapses > 100);
+		CHECK(stats.snapshots == stats.expand_tests + stats.collapses + stats.moves);
+	}
+
+	/* A viewer which ignores set_cursor() is moved with the keys instead. */
+
+	{
+		SimulatedViewer viewer;
+		viewer.generate(2000, 3);
+		viewer.reject_set_cursor();
+
+		ListboxModel listbox(&viewer, true, true);
+		listbox.load();
+
+		CHECK(wander(&viewer, &listbox, 1000));
+		CHECK(listbox.get_stats().mismatches == 0);
+	}
+
+	/* Groups expanded and collapsed behind the model's back. Expanding or
+	 * collapsing through the model notices and reads the listbox again.
+	*/
+
+	{
+		SimulatedViewer viewer;
+		viewer.generate(2000, 3);
+
+		ListboxModel listbox(&viewer, true, false);
+		listbox.load();
+
+		unsigned int first, second, first_count, second_count;
+		CHECK(first_groups(&listbox, &first, &first_count, &second, &second_count));
+
+		/* The first group is expanded, and the cursor put back on the
+		 * second where it now is.
+		*/
+
+		viewer.set_cursor(first);
+		viewer.press_key(ViewerDriver::KEY_RIGHT);
+		viewer.set_cursor(second + first_count);
+
+		listbox.move_to(second);
+		listbox.expand();
+
+		CHECK(listbox.get_stats().resyncs == 1);
+		CHECK(same(&viewer, listbox));
+
+		/* The first group is collapsed again, and the cursor put back on the
+		 * second's first child.
+		*/
+
+		viewer.set_cursor(first);
+		viewer.press_key(ViewerDriver::KEY_LEFT);
+		viewer.set_cursor(second + 1);
+
+		listbox.collapse(second + first_count, second_count);
+
+		CHECK(listbox.get_stats().resyncs == 2);
+		CHECK(same(&viewer, listbox));
+	}
+
+	/* Moving doesn't notice, but verification does. */
+
+	{
+		SimulatedViewer viewer;
+		viewer.generate(2000, 3);
+
+		ListboxModel listbox(&viewer, true, true);
+		listbox.load();
+
+		unsigned int first, second, first_count, second_count;
+		CHECK(first_groups(&listbox, &first, &first_count, &second, &second_count));
+		CHECK(listbox.get_stats().mismatches == 0);
+
+		viewer.set_cursor(first);
+		viewer.press_key(ViewerDriver::KEY_RIGHT);
+		viewer.set_cursor(listbox.get_cursor());
+
+		listbox.move_to(listbox.size() / 2);
+
+		CHECK(listbox.get_stats().mismatches == 1);
+		CHECK(same(&viewer, listbox));
+
+		CHECK(wander(&viewer, &listbox, 500));
+		CHECK(listbox.get_stats().mismatches == 1);
+	}
+
+	return test_result("ListboxModelTest");
+}
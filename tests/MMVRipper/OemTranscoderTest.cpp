@@ -0,0 +1,261 @@
+/* Checks OemTranscoder against the top half of each codepage as decoded by
+ * another program, that what it writes maps back to the original bytes
+ * (line endings aside), and that the output doesn't depend on how the text
+ * is split into pieces.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <string>
+
+#include "OemTranscoder.hpp"
+#include "Test.hpp"
+
+#define FIXTURES "tests/fixtures/text/"
+
+static const unsigned int CODEPAGES[] = { 437, 850, 0 };
+
+static std::string read_fixture(const char *path)
+{
+	std::string data;
+
+	FILE *f = fopen(path, "rb");
+	CHECK(f != NULL);
+
+	if(f != NULL)
+	{
+		char buf[4096];
+		size_t len;
+
+		while((len = fread(buf, 1, sizeof(buf), f)) > 0)
+		{
+			data.append(buf, len);
+		}
+
+		fclose(f);
+	}
+
+	return data;
+}
+
+static std::string convert(unsigned int codepage, const std::string &text)
+{
+	OemTranscoder transcoder(codepage);
+	std::string out;
+
+	transcoder.convert(text.data(), text.length(), &out);
+	transcoder.finish(&out);
+
+	return out;
+}
+
+/* Converts text fed in pieces of between 1 and max_piece bytes. */
+static std::string convert_pieces(unsigned int codepage, const std::string &text, size_t max_piece)
+{
+	OemTranscoder transcoder(codepage);
+	std::string out;
+
+	for(size_t pos = 0; pos < text.length();)
+	{
+		size_t len = 1 + (rand() % max_piece);
+		if(len > text.length() - pos)
+		{
+			len = text.length() - pos;
+		}
+
+		transcoder.convert(text.data() + pos, len, &out);
+		pos += len;
+	}
+
+	transcoder.finish(&out);
+
+	return out;
+}
+
+/* What the converted text should be back in the codepage: CRLF and lone CRs
+ * become LF.
+*/
+static std::string normalise_eol(const std::string &text)
+{
+	std::string out;
+
+	for(size_t i = 0; i < text.length(); ++i)
+	{
+		if(text[i] == '\r')
+		{
+			out += '\n';
+
+			if(i + 1 < text.length() && text[i + 1] == '\n')
+			{
+				++i;
+			}
+		}
+		else{
+			out += text[i];
+		}
+	}
+
+	return out;
+}
+
+/* Maps UTF-8 back to the codepage using what each byte converts to, returns
+ * false if it finds something no byte converts to.
+*/
+static bool convert_back(const std::map<std::string, char> &inverse, const std::string &utf8, std::string *out)
+{
+	out->erase();
+
+	for(size_t i = 0; i < utf8.length();)
+	{
+		unsigned char lead = utf8[i];
+		size_t len = lead < 0x80 ? 1 : (lead & 0xE0) == 0xC0 ? 2 : (lead & 0xF0) == 0xE0 ? 3 : 4;
+
+		std::map<std::string, char>::const_iterator c = inverse.find(utf8.substr(i, len));
+		if(c == inverse.end())
+		{
+			return false;
+		}
+
+		*out += c->second;
+		i += len;
+	}
+
+	return true;
+}
+
+/* Random text weighted towards the awkward bits: line endings and runs of
+ * plain ASCII long enough to be copied a word at a time.
+*/
+static std::string random_text(size_t len)
+{
+	std::string text;
+
+	while(text.length() < len)
+	{
+		switch(rand() % 6)
+		{
+			case 0:
+				text += "\r\n";
+				break;
+
+			case 1:
+				text += (rand() % 2) ? '\r' : '\n';
+				break;
+
+			case 2:
+				text += (char)(0x80 + (rand() % 0x80));
+				break;
+
+			default:
+				for(int n = rand() % 40; n > 0; --n)
+				{
+					text += (char)(' ' + (rand() % 95));
+				}
+
+				break;
+		}
+	}
+
+	return text;
+}
+
+int main()
+{
+	srand(1);
+
+	for(const unsigned int *cp = CODEPAGES; *cp != 0; ++cp)
+	{
+		CHECK(OemTranscoder::supported(*cp));
+
+		char path[64];
+
+		sprintf(path, FIXTURES "cp%u.txt", *cp);
+		std::string oem = read_fixture(path);
+
+		sprintf(path, FIXTURES "cp%u.utf8", *cp);
+		std::string expected = read_fixture(path);
+
+		/* Matches the stored conversion. */
+
+		std::string utf8 = convert(*cp, oem);
+		CHECK(utf8 == expected);
+
+		CHECK(OemTranscoder::is_converted(utf8.data(), utf8.length()));
+		CHECK(!OemTranscoder::is_converted(oem.data(), oem.length()));
+
+		/* Every byte other than CR converts to something different, so it
+		 * can be mapped back.
+		*/
+
+		std::map<std::string, char> inverse;
+
+		for(unsigned int b = 0; b < 256; ++b)
+		{
+			if(b == '\r')
+			{
+				continue;
+			}
+
+			std::string one(1, (char)(b));
+			std::string seq = convert(*cp, one);
+
+			CHECK(inverse.find(seq) == inverse.end());
+			CHECK(OemTranscoder::is_converted(seq.data(), seq.length()));
+
+			inverse[seq] = (char)(b);
+		}
+
+		CHECK(inverse.size() == 255);
+
+		/* Random text survives the round trip, however it is split. */
+
+		for(unsigned int i = 0; i < 200; ++i)
+		{
+			std::string text = random_text(1 + (rand() % 2000));
+
+			std::string whole = convert(*cp, text);
+			std::string back;
+
+			CHECK(convert_back(inverse, whole, &back));
+			CHECK(back == normalise_eol(text));
+
+			CHECK(convert_pieces(*cp, text, 1) == whole);
+			CHECK(convert_pieces(*cp, text, 3) == whole);
+			CHECK(convert_pieces(*cp, text, 64) == whole);
+
+			CHECK(OemTranscoder::is_converted(whole.data(), whole.length()));
+		}
+	}
+
+	/* Line endings, including a CRLF split across pieces and a CR at the
+	 * very end.
+	*/
+
+	CHECK(convert(437, "a\r\nb\rc\nd\r\r\ne\r") == "a\nb\nc\nd\n\ne\n");
+
+	{
+		OemTranscoder transcoder(437);
+		std::string out;
+
+		transcoder.convert("one\r", 4, &out);
+		transcoder.convert("\ntwo\r", 5, &out);
+		transcoder.convert("three", 5, &out);
+		transcoder.finish(&out);
+
+		CHECK(out == "one\ntwo\nthree");
+	}
+
+	/* Text which isn't from the viewer. */
+
+	CHECK(OemTranscoder::is_converted("", 0));
+	CHECK(!OemTranscoder::is_converted("\xC3", 1));
+	CHECK(!OemTranscoder::is_converted("\xE2\x94", 2));
+	CHECK(!OemTranscoder::is_converted("\xC3\x41", 2));
+	CHECK(!OemTranscoder::is_converted("\xFF", 1));
+	CHECK(OemTranscoder::is_converted("\xF0\x9F\x98\x80", 4));
+
+	CHECK(!OemTranscoder::supported(1252));
+
+	return test_result("OemTranscoderTest");
+}
@@ -0,0 +1,292 @@
+/* Checks PackStore keeps its index in step with its records: when resuming a
+ * pack (including one too big to map in a 32-bit process), after a crash,
+ * and when a write fails partway.
+*/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Crc32.hpp"
+#include "PackReader.hpp"
+#include "PackStore.hpp"
+#include "Test.hpp"
+
+static std::string pack_path;
+
+static std::string artifact(unsigned int id, size_t len)
+{
+	std::string data;
+
+	for(size_t i = 0; i < len; ++i)
+	{
+		data += (char)('a' + ((id + i) % 26));
+	}
+
+	return data;
+}
+
+static bool write_artifact(PackStore *store, unsigned int id, size_t len)
+{
+	std::string data = artifact(id, len);
+	return store->write(id, "txt", data.data(), data.length());
+}
+
+/* Checks the pack has a valid index holding exactly ids (ending in zero), each
+ * with the data write_artifact() gave it.
+*/
+static void check_pack(const unsigned int *ids, size_t len)
+{
+	PackReader reader;
+	CHECK(reader.open(pack_path.c_str()));
+	CHECK(!reader.recovered());
+
+	size_t count = 0;
+
+	for(; ids[count] != 0; ++count)
+	{
+		size_t length;
+		const unsigned char *data = reader.find(ids[count], "txt", &length);
+
+		CHECK(data != NULL);
+
+		if(data != NULL)
+		{
+			CHECK(std::string((const char*)(data), length) == artifact(ids[count], len));
+		}
+	}
+
+	CHECK(reader.count() == count);
+
+	for(size_t i = 0; i < reader.count(); ++i)
+	{
+		CHECK(reader.verify(reader.entry(i)));
+	}
+}
+
+static off_t file_size()
+{
+	struct stat st;
+	return stat(pack_path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+static void set_file_limit(rlim_t limit)
+{
+	struct rlimit rl;
+	getrlimit(RLIMIT_FSIZE, &rl);
+
+	rl.rlim_cur = limit;
+	CHECK(setrlimit(RLIMIT_FSIZE, &rl) == 0);
+}
+
+int main()
+{
+	char dir_template[] = "/tmp/PackStoreTest.XXXXXX";
+	CHECK(mkdtemp(dir_template) != NULL);
+
+	pack_path = std::string(dir_template) + "/test.pack";
+
+	/* Writes past RLIMIT_FSIZE fail with EFBIG rather than killing us. */
+	signal(SIGXFSZ, SIG_IGN);
+
+	struct rlimit original_limit;
+	getrlimit(RLIMIT_FSIZE, &original_limit);
+
+	/* Closed properly, reopened and added to. */
+
+	{
+		PackStore store;
+		CHECK(store.open(pack_path.c_str()));
+		CHECK(write_artifact(&store, 1, 1000));
+		CHECK(write_artifact(&store, 2, 1000));
+		CHECK(store.close());
+
+		CHECK(store.open(pack_path.c_str()));
+		CHECK(store.exists(1, "txt"));
+		CHECK(store.exists(2, "txt"));
+		CHECK(write_artifact(&store, 3, 1000));
+		CHECK(store.close());
+
+		const unsigned int ids[] = { 1, 2, 3, 0 };
+		check_pack(ids, 1000);
+	}
+
+	/* Left by a crash partway through a record. */
+
+	{
+		/* A child adds a record and dies without writing the index. */
+		pid_t child = fork();
+		if(child == 0)
+		{
+			PackStore store;
+			_exit((store.open(pack_path.c_str()) && write_artifact(&store, 4, 1000)) ? 0 : 1);
+		}
+
+		int status;
+		CHECK(waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+		off_t good_size = file_size();
+
+		FILE *f = fopen(pack_path.c_str(), "ab");
+		fwrite("MMVR\x05\0\0\0txt\0\xE8\x03\0\0\0\0\0\0\0\0\0\0partial", 1, 31, f);
+		fclose(f);
+
+		PackStore store;
+		CHECK(store.open(pack_path.c_str()));
+		CHECK(file_size() == good_size);
+		CHECK(store.exists(4, "txt"));
+		CHECK(!store.exists(5, "txt"));
+		CHECK(store.close());
+
+		const unsigned int ids[] = { 1, 2, 3, 4, 0 };
+		check_pack(ids, 1000);
+	}
+
+	/* A write which fails partway is cut back off, and the ones after it
+	 * go where the index says.
+	*/
+
+	{
+		PackStore store;
+		CHECK(store.open(pack_path.c_str()));
+
+		off_t before = file_size();
+
+		set_file_limit(before + PACK_RECORD_HEADER_SIZE + 500);
+		CHECK(!write_artifact(&store, 6, 1000));
+		set_file_limit(original_limit.rlim_cur);
+
+		CHECK(file_size() == before);
+		CHECK(!store.exists(6, "txt"));
+
+		CHECK(write_artifact(&store, 7, 1000));
+		CHECK(store.close());
+
+		const unsigned int ids[] = { 1, 2, 3, 4, 7, 0 };
+		check_pack(ids, 1000);
+	}
+
+	/* If the failed write can't be undone, nothing more is written and the
+	 * pack is closed without an index.
+	*/
+
+	{
+		std::string moved = pack_path + ".moved";
+
+		PackStore store;
+		CHECK(store.open(pack_path.c_str()));
+
+		/* Truncating the pack by name fails once it isn't there. */
+		CHECK(rename(pack_path.c_str(), moved.c_str()) == 0);
+
+		struct stat st;
+		CHECK(stat(moved.c_str(), &st) == 0);
+
+		set_file_limit(st.st_size + 100);
+
+		CHECK(!write_artifact(&store, 8, 1000));
+		set_file_limit(original_limit.rlim_cur);
+
+		CHECK(!write_artifact(&store, 9, 10));
+		CHECK(!store.close());
+
+		CHECK(rename(moved.c_str(), pack_path.c_str()) == 0);
+
+		/* Recovered by walking the records next time. */
+		CHECK(store.open(pack_path.c_str()));
+		CHECK(!store.exists(8, "txt"));
+		CHECK(!store.exists(9, "txt"));
+		CHECK(store.close());
+
+		const unsigned int ids[] = { 1, 2, 3, 4, 7, 0 };
+		check_pack(ids, 1000);
+	}
+
+	/* A pack bigger than 4 GiB (sparse, so it takes no space) is resumed
+	 * without mapping it, and offsets past 4 GiB come out right.
+	*/
+
+	{
+		remove(pack_path.c_str());
+
+		const unsigned long long BIG = 5ULL * 1024 * 1024 * 1024;
+
+		FILE *f = fopen(pack_path.c_str(), "wb");
+
+		unsigned char header[PACK_RECORD_HEADER_SIZE];
+		memcpy(header, PACK_RECORD_MAGIC, 4);
+		pack_put32(header + 4, 100);
+		pack_put_kind(header + 8, "bmp");
+		pack_put64(header + 12, BIG);
+		pack_put32(header + 20, 0);
+
+		CHECK(fwrite(header, sizeof(header), 1, f) == 1);
+		fclose(f);
+
+		CHECK(truncate(pack_path.c_str(), (off_t)(PACK_RECORD_HEADER_SIZE + BIG)) == 0);
+
+		/* The big record's CRC is made up, but only the last record in a
+		 * pack without an index is checked.
+		*/
+		std::string small = artifact(99, 1000);
+
+		pack_put32(header + 4, 99);
+		pack_put_kind(header + 8, "txt");
+		pack_put64(header + 12, small.length());
+		pack_put32(header + 20, crc32(0, small.data(), small.length()));
+
+		f = fopen(pack_path.c_str(), "ab");
+		CHECK(fwrite(header, sizeof(header), 1, f) == 1);
+		CHECK(fwrite(small.data(), small.length(), 1, f) == 1);
+		fclose(f);
+
+		{
+			PackStore store;
+			CHECK(store.open(pack_path.c_str()));
+			CHECK(store.exists(100, "bmp"));
+			CHECK(store.exists(99, "txt"));
+			CHECK(write_artifact(&store, 101, 1000));
+			CHECK(store.close());
+		}
+
+		{
+			/* Walked up to the index this time. */
+			PackStore store;
+			CHECK(store.open(pack_path.c_str()));
+			CHECK(store.exists(100, "bmp"));
+			CHECK(store.exists(101, "txt"));
+			CHECK(write_artifact(&store, 102, 1000));
+			CHECK(store.close());
+		}
+
+		PackReader reader;
+		if(reader.open(pack_path.c_str()))
+		{
+			CHECK(!reader.recovered());
+			CHECK(reader.count() == 4);
+
+			size_t length;
+			const unsigned char *data = reader.find(102, "txt", &length);
+
+			CHECK(data != NULL);
+			CHECK(data != NULL && std::string((const char*)(data), length) == artifact(102, 1000));
+
+			/* Record 101 follows 100 and 99. */
+			CHECK(reader.count() == 4 && reader.entry(2).offset == PACK_RECORD_HEADER_SIZE * 3 + BIG + small.length());
+		}
+		else{
+			printf("Can't map a 5 GiB pack here, not checking what was written to it\n");
+		}
+	}
+
+	remove(pack_path.c_str());
+	rmdir(dir_template);
+
+	return test_result("PackStoreTest");
+}
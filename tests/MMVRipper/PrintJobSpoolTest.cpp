@@ -0,0 +1,331 @@
+/* Sends one huge print job through a spooling PrintServer over loopback and
+ * checks it arrives intact without the memory use growing with it, then that
+ * saving a spooled job replaces stale files and works across volumes.
+ *
+ * PrintJobSpoolTest [job size in MiB]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "ChunkPool.hpp"
+#include "Crc32.hpp"
+#include "PrintServer.hpp"
+#include "Test.hpp"
+#include "Threading.hpp"
+
+/* Spool jobs with no more than this held in memory. */
+static const size_t MAX_BUFFERED = 1024 * 1024;
+
+class SpoolListener: public PrintServer::Listener
+{
+public:
+	Semaphore completed;
+	PrintJob job;
+
+	virtual void print_job_completed(PrintJob &job, unsigned int connection)
+	{
+		this->job.swap(job);
+		completed.post();
+	}
+};
+
+class ServerThread: public Thread
+{
+private:
+	PrintServer *server;
+
+protected:
+	virtual void run()
+	{
+		server->run();
+	}
+
+public:
+	ServerThread(PrintServer *server):
+		server(server) {}
+};
+
+/* Peak resident memory of this process in KiB. */
+static unsigned long peak_rss_kb()
+{
+	FILE *f = fopen("/proc/self/status", "r");
+	if(f == NULL)
+	{
+		return 0;
+	}
+
+	unsigned long kb = 0;
+	char line[256];
+
+	while(fgets(line, sizeof(line), f) != NULL)
+	{
+		sscanf(line, "VmHWM: %lu kB", &kb);
+	}
+
+	fclose(f);
+
+	return kb;
+}
+
+static bool file_crc(const std::string &path, unsigned int *crc, unsigned long long *size)
+{
+	FILE *f = fopen(path.c_str(), "rb");
+	if(f == NULL)
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> buf(1024 * 1024);
+
+	*crc = 0;
+	*size = 0;
+
+	size_t len;
+	while((len = fread(&(buf[0]), 1, buf.size(), f)) > 0)
+	{
+		*crc = crc32(*crc, &(buf[0]), len);
+		*size += len;
+	}
+
+	fclose(f);
+	return true;
+}
+
+static bool write_file(const std::string &path, const char *text)
+{
+	FILE *f = fopen(path.c_str(), "wb");
+	if(f == NULL)
+	{
+		return false;
+	}
+
+	fputs(text, f);
+	return fclose(f) == 0;
+}
+
+static bool exists(const std::string &path)
+{
+	struct stat st;
+	return stat(path.c_str(), &st) == 0;
+}
+
+/* Streams a PostScript job of size bytes to port, returning its CRC. */
+static bool send_job(unsigned short port, unsigned long long size, unsigned int *crc)
+{
+	SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if(sock == INVALID_SOCKET)
+	{
+		return false;
+	}
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+
+	if(connect(sock, (struct sockaddr*)(&addr), sizeof(addr)) != 0)
+	{
+		closesocket(sock);
+		return false;
+	}
+
+	const std::string header = "%!PS-Adobe-3.0\n%%Title: spool test\n";
+	const std::string trailer = "showpage\n%%EOF\n";
+
+	std::vector<char> block(1024 * 1024);
+	unsigned long long sent = 0;
+	bool ok = true;
+
+	*crc = 0;
+
+	while(ok && sent < size)
+	{
+		size_t len = block.size();
+		if(size - sent < len)
+		{
+			len = size - sent;
+		}
+
+		/* Lines of text which change from block to block, with the header at
+		 * the start and the trailer at the end.
+		*/
+		for(size_t i = 0; i < len; ++i)
+		{
+			unsigned long long pos = sent + i;
+
+			if(pos < header.length())
+			{
+				block[i] = header[pos];
+			}
+			else if(pos >= size - trailer.length())
+			{
+				block[i] = trailer[pos - (size - trailer.length())];
+			}
+			else if(pos % 80 == 79)
+			{
+				block[i] = '\n';
+			}
+			else{
+				block[i] = 'A' + ((pos / 80 + pos) % 26);
+			}
+		}
+
+		*crc = crc32(*crc, &(block[0]), len);
+
+		for(size_t done = 0; ok && done < len;)
+		{
+			int s = send(sock, &(block[done]), len - done, 0);
+			ok = s > 0;
+
+			if(ok)
+			{
+				done += s;
+			}
+		}
+
+		sent += len;
+	}
+
+	closesocket(sock);
+
+	return ok;
+}
+
+/* Spools a small job to spool_path and returns it finished. */
+static void make_spooled_job(PrintJob *job, const std::string &spool_path, const char *text)
+{
+	CHECK(job->spool_to(spool_path.c_str(), MAX_BUFFERED));
+	job->append((const unsigned char*)(text), strlen(text));
+	CHECK(job->finish_spool());
+}
+
+static void check_file(const std::string &path, const char *text)
+{
+	FILE *f = fopen(path.c_str(), "rb");
+	CHECK(f != NULL);
+
+	if(f != NULL)
+	{
+		char buf[256];
+		size_t len = fread(buf, 1, sizeof(buf), f);
+		fclose(f);
+
+		CHECK(std::string(buf, len) == text);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long job_size = (argc > 1 ? atoi(argv[1]) : 500) * 1024ULL * 1024ULL;
+
+	char dir_template[] = "/tmp/PrintJobSpoolTest.XXXXXX";
+	CHECK(mkdtemp(dir_template) != NULL);
+	std::string dir = dir_template;
+
+	/* Saving a finished spool file over a stale .tmp from an earlier run. */
+
+	{
+		ChunkPool pool;
+		PrintJob job(&pool);
+
+		make_spooled_job(&job, dir + "/small.spool", "%!PS-Adobe-3.0\nsmall\n%%EOF\n");
+
+		CHECK(write_file(dir + "/stale.ps.tmp", "left over from a killed run"));
+		CHECK(job.save((dir + "/stale.ps.tmp").c_str()));
+
+		check_file(dir + "/stale.ps.tmp", "%!PS-Adobe-3.0\nsmall\n%%EOF\n");
+		CHECK(!exists(dir + "/small.spool"));
+
+		remove((dir + "/stale.ps.tmp").c_str());
+	}
+
+	/* Saving a spool file onto another volume has to copy it. */
+
+	struct stat tmp_st, shm_st;
+	if(stat(dir.c_str(), &tmp_st) == 0 && stat("/dev/shm", &shm_st) == 0 && tmp_st.st_dev != shm_st.st_dev)
+	{
+		ChunkPool pool;
+		PrintJob job(&pool);
+
+		make_spooled_job(&job, dir + "/moved.spool", "%!PS-Adobe-3.0\nmoved\n%%EOF\n");
+
+		char shm_name[64];
+		sprintf(shm_name, "/dev/shm/PrintJobSpoolTest.%u.ps", (unsigned)(getpid()));
+
+		CHECK(job.save(shm_name));
+
+		check_file(shm_name, "%!PS-Adobe-3.0\nmoved\n%%EOF\n");
+		CHECK(!exists(dir + "/moved.spool"));
+
+		remove(shm_name);
+	}
+	else{
+		printf("/dev/shm is on the same volume, not testing saving across volumes\n");
+	}
+
+	/* The huge job. The server is gone by the end of the block, taking the
+	 * spool file it opened for a next job with it.
+	*/
+
+	{
+		ChunkPool pool;
+		SpoolListener listener;
+
+		PrintServer server(0, &listener, &pool);
+		server.spool_to_disk(dir.c_str(), MAX_BUFFERED);
+
+		ServerThread server_thread(&server);
+		CHECK(server_thread.start());
+
+		unsigned long rss_before = peak_rss_kb();
+
+		unsigned int sent_crc;
+		CHECK(send_job(server.get_port(), job_size, &sent_crc));
+
+		CHECK(listener.completed.wait(60000));
+
+		unsigned long rss_after = peak_rss_kb();
+
+		server.stop();
+		server_thread.join();
+
+		ChunkPool::Stats stats = pool.get_stats();
+
+		CHECK(listener.job.is_spooled());
+		CHECK(listener.job.size() == job_size);
+
+		/* Never more than MAX_BUFFERED, the chunk being filled and the one
+		 * after a boundary held at once.
+		*/
+		CHECK(stats.chunks_allocated <= (MAX_BUFFERED / ChunkPool::CHUNK_SIZE) + 2);
+		CHECK(stats.bytes_spooled == job_size);
+
+		/* A generous limit, the point is it doesn't grow with the job. */
+		CHECK(rss_after - rss_before < 32 * 1024);
+
+		std::string saved = dir + "/huge.ps.tmp";
+		CHECK(write_file(saved, "stale"));
+		CHECK(listener.job.save(saved.c_str()));
+
+		unsigned int saved_crc;
+		unsigned long long saved_size;
+		CHECK(file_crc(saved, &saved_crc, &saved_size));
+		CHECK(saved_size == job_size);
+		CHECK(saved_crc == sent_crc);
+
+		printf("%llu MiB job: %u chunks allocated, peak memory grew by %lu KiB\n",
+			job_size / (1024 * 1024), (unsigned)(stats.chunks_allocated), rss_after - rss_before);
+
+		remove(saved.c_str());
+	}
+
+	rmdir(dir.c_str());
+
+	return test_result("PrintJobSpoolTest");
+}
@@ -0,0 +1,240 @@
+/* Loopback load test for PrintServer. Opens a few thousand raw print
+ * connections in waves of up to <concurrency> at once, sends a small
+ * PostScript job down each and checks every job arrives intact, then reports
+ * the rate and how long each job took from connecting to being handed over.
+ *
+ * PrintServerLoadTest [jobs] [concurrency] [job size]
+*/
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "ChunkPool.hpp"
+#include "Clock.hpp"
+#include "PrintServer.hpp"
+#include "Test.hpp"
+#include "Threading.hpp"
+
+class LoadListener: public PrintServer::Listener
+{
+private:
+	size_t job_size;
+
+public:
+	Mutex lock;
+
+	std::vector<uint64> completed_at;  /* By job number, zero until received. */
+	unsigned int received, bad;
+
+	LoadListener(unsigned int jobs, size_t job_size):
+		job_size(job_size),
+		completed_at(jobs, 0),
+		received(0),
+		bad(0) {}
+
+	virtual void print_job_completed(PrintJob &job, unsigned int connection)
+	{
+		uint64 now = clock_us();
+
+		size_t len;
+		const unsigned char *data = job.chunk_count() > 0 ? job.chunk(0, &len) : NULL;
+
+		std::string head = data != NULL ? std::string((const char*)(data), (len < 64 ? len : 64)) : "";
+
+		unsigned int seq;
+		bool ok = sscanf(head.c_str(), "%%!PS-Adobe-3.0\n%%%%Title: job %u", &seq) == 1
+			&& job.size() == job_size;
+
+		MutexLock l(lock);
+
+		if(ok && seq < completed_at.size() && completed_at[seq] == 0)
+		{
+			completed_at[seq] = now;
+		}
+		else{
+			++bad;
+		}
+
+		++received;
+	}
+};
+
+class ServerThread: public Thread
+{
+private:
+	PrintServer *server;
+
+protected:
+	virtual void run()
+	{
+		server->run();
+	}
+
+public:
+	ServerThread(PrintServer *server):
+		server(server) {}
+};
+
+static std::string make_job(unsigned int seq, size_t size)
+{
+	char header[64];
+	sprintf(header, "%%!PS-Adobe-3.0\n%%%%Title: job %06u\n", seq);
+
+	std::string job = header;
+	const std::string trailer = "showpage\n%%EOF\n";
+
+	while(job.length() + trailer.length() < size)
+	{
+		job += (char)('a' + (job.length() % 26));
+
+		if(job.length() % 64 == 63)
+		{
+			job += '\n';
+		}
+	}
+
+	return job.substr(0, size - trailer.length()) + trailer;
+}
+
+static SOCKET connect_to(unsigned short port)
+{
+	SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if(sock == INVALID_SOCKET)
+	{
+		return INVALID_SOCKET;
+	}
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+
+	if(connect(sock, (struct sockaddr*)(&addr), sizeof(addr)) != 0)
+	{
+		closesocket(sock);
+		return INVALID_SOCKET;
+	}
+
+	return sock;
+}
+
+static bool send_all(SOCKET sock, const std::string &data)
+{
+	for(size_t done = 0; done < data.length();)
+	{
+		int s = send(sock, data.data() + done, data.length() - done, 0);
+		if(s <= 0)
+		{
+			return false;
+		}
+
+		done += s;
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int jobs = argc > 1 ? atoi(argv[1]) : 4000;
+	unsigned int concurrency = argc > 2 ? atoi(argv[2]) : 1000;
+	size_t job_size = argc > 3 ? atoi(argv[3]) : 32 * 1024;
+
+	ChunkPool pool;
+	LoadListener listener(jobs, job_size);
+
+	PrintServer server(0, &listener, &pool);
+	ServerThread server_thread(&server);
+	CHECK(server_thread.start());
+
+	std::vector<uint64> started_at(jobs, 0);
+	unsigned int send_failures = 0;
+
+	uint64 start = clock_us();
+
+	for(unsigned int first = 0; first < jobs; first += concurrency)
+	{
+		unsigned int last = std::min(jobs, first + concurrency);
+		std::vector<SOCKET> socks;
+
+		/* Open the whole wave before sending anything, so the server has
+		 * them all open at once.
+		*/
+		for(unsigned int seq = first; seq < last; ++seq)
+		{
+			started_at[seq] = clock_us();
+			socks.push_back(connect_to(server.get_port()));
+		}
+
+		for(unsigned int seq = first; seq < last; ++seq)
+		{
+			SOCKET sock = socks[seq - first];
+
+			if(sock == INVALID_SOCKET || !send_all(sock, make_job(seq, job_size)))
+			{
+				++send_failures;
+			}
+
+			if(sock != INVALID_SOCKET)
+			{
+				closesocket(sock);
+			}
+		}
+	}
+
+	/* Give the server up to 30 seconds to catch up. */
+
+	bool all_received = false;
+
+	for(unsigned int waited = 0; !all_received && waited < 30000; waited += 10)
+	{
+		{
+			MutexLock l(listener.lock);
+			all_received = listener.received >= jobs;
+		}
+
+		if(!all_received)
+		{
+			sleep_ms(10);
+		}
+	}
+
+	uint64 elapsed = clock_us() - start;
+
+	server.stop();
+	server_thread.join();
+
+	CHECK(send_failures == 0);
+	CHECK(all_received);
+	CHECK(listener.bad == 0);
+
+	std::vector<uint64> latency;
+	for(unsigned int seq = 0; seq < jobs; ++seq)
+	{
+		CHECK(listener.completed_at[seq] != 0);
+
+		if(listener.completed_at[seq] != 0)
+		{
+			latency.push_back(listener.completed_at[seq] - started_at[seq]);
+		}
+	}
+
+	if(!latency.empty())
+	{
+		std::sort(latency.begin(), latency.end());
+
+		printf("%u jobs of %u bytes, %u at once: %.0f jobs/s, latency p50 %u us, p99 %u us, max %u us\n",
+			jobs, (unsigned)(job_size), concurrency,
+			(double)(jobs) * 1000000.0 / (double)(elapsed ? elapsed : 1),
+			(unsigned)(latency[latency.size() / 2]),
+			(unsigned)(latency[(latency.size() * 99) / 100]),
+			(unsigned)(latency.back()));
+	}
+
+	return test_result("PrintServerLoadTest");
+}
@@ -0,0 +1,192 @@
+/* Sends several jobs down each of a few connections to a PrintServer, in
+ * random sized pieces, and checks each comes out whole and is counted against
+ * the right connection.
+*/
+
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "ChunkPool.hpp"
+#include "Clock.hpp"
+#include "PrintServer.hpp"
+#include "Test.hpp"
+#include "Threading.hpp"
+
+class SplitListener: public PrintServer::Listener
+{
+public:
+	Mutex lock;
+
+	std::vector< std::pair<unsigned int, std::string> > jobs;
+	std::map<unsigned int, unsigned int> closed;
+
+	virtual void print_job_completed(PrintJob &job, unsigned int connection)
+	{
+		std::string data;
+
+		for(size_t i = 0; i < job.chunk_count(); ++i)
+		{
+			size_t len;
+			const unsigned char *chunk = job.chunk(i, &len);
+
+			data.append((const char*)(chunk), len);
+		}
+
+		MutexLock l(lock);
+		jobs.push_back(std::make_pair(connection, data));
+	}
+
+	virtual void connection_closed(unsigned int connection, unsigned int jobs)
+	{
+		MutexLock l(lock);
+		closed[connection] = jobs;
+	}
+};
+
+class ServerThread: public Thread
+{
+private:
+	PrintServer *server;
+
+protected:
+	virtual void run()
+	{
+		server->run();
+	}
+
+public:
+	ServerThread(PrintServer *server):
+		server(server) {}
+};
+
+static std::string make_job(const char *title)
+{
+	std::string job = "\x1B%-12345X@PJL ENTER LANGUAGE = POSTSCRIPT\r\n%!PS-Adobe-3.0\r\n%%Title: ";
+	job += title;
+	job += "\r\n";
+
+	for(int i = 0; i < 2000; ++i)
+	{
+		job += "300 200 (Some text) 0 Tx\r\n";
+	}
+
+	job += "showpage\r\n%%EOF\r\n";
+
+	return job;
+}
+
+/* Sends data down a new connection in pieces of up to max_piece bytes. */
+static bool send_stream(unsigned short port, const std::string &data, size_t max_piece)
+{
+	SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if(sock == INVALID_SOCKET)
+	{
+		return false;
+	}
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+
+	bool ok = connect(sock, (struct sockaddr*)(&addr), sizeof(addr)) == 0;
+
+	for(size_t done = 0; ok && done < data.length();)
+	{
+		size_t len = 1 + (rand() % max_piece);
+		if(len > data.length() - done)
+		{
+			len = data.length() - done;
+		}
+
+		int s = send(sock, data.data() + done, len, 0);
+		ok = s > 0;
+
+		if(ok)
+		{
+			done += s;
+		}
+	}
+
+	closesocket(sock);
+
+	return ok;
+}
+
+int main()
+{
+	srand(1);
+
+	ChunkPool pool;
+	SplitListener listener;
+
+	PrintServer server(0, &listener, &pool);
+	ServerThread server_thread(&server);
+	CHECK(server_thread.start());
+
+	/* Connection 1 carries three jobs, connection 2 one job followed by the
+	 * PJL trailer, and connection 3 one printout which has a second header
+	 * in it (what print() has to catch).
+	*/
+
+	std::string three = make_job("one") + make_job("two") + make_job("three");
+	std::string one = make_job("single") + "\x1B%-12345X@PJL EOJ\r\n\x1B%-12345X";
+	std::string torn = make_job("torn").substr(0, 5000) + make_job("rest");
+
+	CHECK(send_stream(server.get_port(), three, 3000));
+	CHECK(send_stream(server.get_port(), one, 17));
+	CHECK(send_stream(server.get_port(), torn, 70000));
+
+	bool done = false;
+
+	for(unsigned int waited = 0; !done && waited < 10000; waited += 10)
+	{
+		{
+			MutexLock l(listener.lock);
+			done = listener.closed.size() == 3;
+		}
+
+		if(!done)
+		{
+			sleep_ms(10);
+		}
+	}
+
+	server.stop();
+	server_thread.join();
+
+	CHECK(done);
+
+	/* The connections are read in whatever order their data turns up, but
+	 * each one's jobs come out in order.
+	*/
+
+	std::map< unsigned int, std::vector<std::string> > by_connection;
+	for(size_t i = 0; i < listener.jobs.size(); ++i)
+	{
+		by_connection[listener.jobs[i].first].push_back(listener.jobs[i].second);
+	}
+
+	std::vector<std::string> expect;
+	expect.push_back(make_job("one"));
+	expect.push_back(make_job("two"));
+	expect.push_back(make_job("three"));
+	CHECK(by_connection[1] == expect);
+
+	CHECK(by_connection[2] == std::vector<std::string>(1, make_job("single")));
+
+	/* Split at the UEL before the second header. */
+	CHECK(by_connection[3].size() == 2);
+	CHECK(by_connection[3].size() == 2 && by_connection[3][0] + by_connection[3][1] == torn);
+
+	CHECK(listener.closed[1] == 3);
+	CHECK(listener.closed[2] == 1);
+	CHECK(listener.closed[3] == 2);
+
+	return test_result("PrintServerSplitTest");
+}
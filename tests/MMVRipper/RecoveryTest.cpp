@@ -0,0 +1,258 @@
+/* Crawls SimulatedViewers which crash on some pages and hang on another, with
+ * a Supervisor to restart them and a quarantine file, and checks the crawler
+ * restarts the viewer and carries on where it was, visiting everything else
+ * and quarantining the pages which killed it. Then crawls again with the
+ * quarantine read back from the file, and checks those pages aren't opened
+ * at all. Finally checks it gives up once the viewer keeps dying without
+ * getting anywhere.
+*/
+
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "CrawlFixtures.hpp"
+#include "Crawler.hpp"
+#include "Quarantine.hpp"
+#include "SimulatedViewer.hpp"
+#include "SimulatedViewerLauncher.hpp"
+#include "Supervisor.hpp"
+#include "Test.hpp"
+
+/* As in Crawler.cpp. */
+static const unsigned int MAX_RECOVERIES = 3;
+
+/* Long enough for the viewer not to be killed for being slow. */
+static const unsigned int HANG_TIMEOUT_MS = 500;
+
+/* Starts viewers which are dead as soon as anyone looks, after the first. */
+class DyingLauncher: public ViewerLauncher
+{
+private:
+	SimulatedViewerLauncher *launcher;
+	unsigned int launched;
+
+public:
+	DyingLauncher(SimulatedViewerLauncher *launcher):
+		launcher(launcher),
+		launched(0) {}
+
+	virtual ViewerDriver *launch()
+	{
+		ViewerDriver *viewer = launcher->launch();
+
+		if(viewer != NULL && launched++ > 0)
+		{
+			viewer->kill();
+		}
+
+		return viewer;
+	}
+};
+
+struct CrawlResult
+{
+	std::string tree;
+	std::string errors;
+	bool abandoned;
+
+	Supervisor::Stats supervisor;
+	SimulatedViewer::Stats viewers;
+};
+
+/* Crawls with viewers from launcher, which simulated is the inner launcher
+ * of (if it isn't the same), into store.
+*/
+static CrawlResult crawl(const std::string &dir, ViewerLauncher *launcher, SimulatedViewerLauncher *simulated,
+	Quarantine *quarantine, MemoryStore *store)
+{
+	CrawlResult result;
+
+	Supervisor supervisor(launcher, HANG_TIMEOUT_MS);
+
+	ViewerDriver *viewer = supervisor.start();
+	CHECK(viewer != NULL);
+
+	OutputCapture output(dir);
+
+	{
+		Crawler crawler(viewer, store, text_and_shot_options());
+		crawler.set_supervisor(&supervisor);
+		crawler.set_quarantine(quarantine);
+
+		crawler.reset_listbox_state();
+		crawler.run();
+
+		result.abandoned = crawler.abandoned();
+	}
+
+	result.tree = output.finish(&result.errors);
+	result.supervisor = supervisor.get_stats();
+	result.viewers = simulated->get_stats();
+
+	return result;
+}
+
+/* Whether errors has a line saying page id killed the viewer. */
+static bool blamed(const std::string &errors, unsigned int id)
+{
+	char line[64];
+	sprintf(line, "The viewer died showing page %u\n", id);
+
+	return errors.find(line) != std::string::npos;
+}
+
+int main()
+{
+	char dir[] = "/tmp/RecoveryTest.XXXXXX";
+	CHECK(mkdtemp(dir) != NULL);
+
+	std::string tree_file = std::string(dir) + "/tree";
+	std::string quarantine_file = std::string(dir) + "/quarantine";
+
+	std::string tree = make_tree(200, 7);
+	CHECK(write_file(tree_file, tree));
+
+	std::vector<TreeEntry> entries;
+	CHECK(parse_tree(tree, &entries));
+
+	/* Two pages to crash the viewer and one to hang it, from the start,
+	 * middle and end of the index, including the very last page.
+	*/
+
+	std::vector<unsigned int> pages;
+
+	for(size_t i = 0; i < entries.size(); ++i)
+	{
+		if(!entries[i].group)
+		{
+			pages.push_back(entries[i].id);
+		}
+	}
+
+	CHECK(pages.size() > 100);
+
+	unsigned int crash_first = pages[3];
+	unsigned int hang = pages[pages.size() / 2];
+	unsigned int crash_last = pages.back();
+
+	std::set<unsigned int> culprits;
+	culprits.insert(crash_first);
+	culprits.insert(hang);
+	culprits.insert(crash_last);
+
+	/* Restarted three times, carrying on where it was each time. */
+
+	{
+		SimulatedViewerLauncher launcher(tree_file.c_str());
+		launcher.add_crash(crash_first, false);
+		launcher.add_crash(hang, true);
+		launcher.add_crash(crash_last, false);
+
+		Quarantine quarantine;
+		CHECK(quarantine.open(quarantine_file.c_str()));
+
+		MemoryStore store;
+		CrawlResult r = crawl(dir, &launcher, &launcher, &quarantine, &store);
+
+		CHECK(r.tree == tree);
+		CHECK(!r.abandoned);
+
+		CHECK(r.supervisor.restarts == 3);
+		CHECK(r.supervisor.hangs == 1);
+
+		CHECK(blamed(r.errors, crash_first) && blamed(r.errors, hang) && blamed(r.errors, crash_last));
+
+		/* Each page opened once, the culprits included. */
+		CHECK(r.viewers.topics_opened == pages.size());
+
+		/* Everything else was saved. */
+
+		unsigned int wrong = 0;
+
+		for(size_t i = 0; i < entries.size(); ++i)
+		{
+			const TreeEntry &e = entries[i];
+
+			wrong += !store.exists(e.id, "pgm");
+
+			if(!e.group)
+			{
+				wrong += store.exists(e.id, "txt") == (culprits.count(e.id) > 0);
+			}
+		}
+
+		CHECK(wrong == 0);
+
+		CHECK(quarantine.size() == 3);
+		CHECK(quarantine.contains(crash_first) && quarantine.contains(hang) && quarantine.contains(crash_last));
+	}
+
+	/* The file has them, and a crawl with it read back doesn't open them. */
+
+	{
+		std::string saved = read_file(quarantine_file);
+		CHECK(saved.find("# Killed the viewer") != std::string::npos);
+
+		Quarantine quarantine;
+		CHECK(quarantine.open(quarantine_file.c_str()));
+
+		CHECK(quarantine.size() == 3);
+		CHECK(quarantine.contains(crash_first) && quarantine.contains(hang) && quarantine.contains(crash_last));
+
+		SimulatedViewerLauncher launcher(tree_file.c_str());
+		launcher.add_crash(crash_first, false);
+		launcher.add_crash(hang, true);
+		launcher.add_crash(crash_last, false);
+
+		MemoryStore store;
+		CrawlResult r = crawl(dir, &launcher, &launcher, &quarantine, &store);
+
+		CHECK(r.tree == tree);
+		CHECK(!r.abandoned);
+		CHECK(r.supervisor.restarts == 0 && r.supervisor.hangs == 0);
+		CHECK(r.viewers.topics_opened == pages.size() - 3);
+
+		for(std::set<unsigned int>::const_iterator i = culprits.begin(); i != culprits.end(); ++i)
+		{
+			CHECK(!store.exists(*i, "txt") && store.exists(*i, "pgm"));
+		}
+
+		/* Nothing new was added. */
+		CHECK(read_file(quarantine_file) == saved);
+	}
+
+	/* Every viewer after the first is dead on arrival, so after the first
+	 * crash it gets nowhere and gives up after MAX_RECOVERIES more goes.
+	*/
+
+	{
+		remove(quarantine_file.c_str());
+
+		SimulatedViewerLauncher launcher(tree_file.c_str());
+		launcher.add_crash(crash_first, false);
+
+		DyingLauncher dying(&launcher);
+
+		Quarantine quarantine;
+		CHECK(quarantine.open(quarantine_file.c_str()));
+
+		MemoryStore store;
+		CrawlResult r = crawl(dir, &dying, &launcher, &quarantine, &store);
+
+		CHECK(r.abandoned);
+		CHECK(r.supervisor.restarts == 1 + MAX_RECOVERIES);
+
+		CHECK(quarantine.size() == 1 && quarantine.contains(crash_first));
+		CHECK(!store.exists(pages.back(), "txt"));
+	}
+
+	remove(quarantine_file.c_str());
+	remove(tree_file.c_str());
+	rmdir(dir);
+
+	return test_result("RecoveryTest");
+}
@@ -0,0 +1,39 @@
+/* Checks SelectPoller reports readable sockets and refuses sockets it can't
+ * fit in an fd_set rather than writing past the end of it.
+*/
+
+#include <vector>
+
+#include "SelectPoller.hpp"
+#include "Test.hpp"
+
+int main()
+{
+	SelectPoller poller;
+
+	int fds[2];
+	CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+	CHECK(poller.add(fds[0]));
+	CHECK(poller.add(fds[1]));
+
+	CHECK(send(fds[1], "x", 1, 0) == 1);
+
+	std::vector<SOCKET> ready;
+	poller.wait(&ready);
+
+	CHECK(ready.size() == 1);
+	CHECK(ready.size() == 1 && ready[0] == fds[0]);
+
+	/* Descriptors at or past FD_SETSIZE don't fit. */
+	CHECK(!poller.add(FD_SETSIZE));
+	CHECK(!poller.add(FD_SETSIZE + 100));
+
+	poller.remove(fds[0]);
+	poller.remove(fds[1]);
+
+	closesocket(fds[0]);
+	closesocket(fds[1]);
+
+	return test_result("SelectPollerTest");
+}
@@ -0,0 +1,198 @@
+/* Crawls the same index with one SimulatedViewer and with several sharing it
+ * through ShardCoordinator, and checks the tree printed and everything saved
+ * are the same byte for byte, with parts of the index stolen by the other
+ * viewers. Covers collecting as it goes and in passes afterwards, and an ID
+ * which turns up again in a group near the top. Collecting as it goes, the
+ * pages after the repeat are saved as well (but not printed), as whoever
+ * walks that group can't tell it would have stopped there.
+*/
+
+#include <stdio.h>
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "CrawlFixtures.hpp"
+#include "Crawler.hpp"
+#include "ShardCoordinator.hpp"
+#include "SimulatedViewer.hpp"
+#include "Test.hpp"
+
+/* Crawls the tree in tree_file into store with one viewer, like MMVRipper
+ * with SHARD_WORKERS 1, returning the tree printed.
+*/
+static std::string crawl_serial(const std::string &dir, const std::string &tree_file, const CrawlOptions &options,
+	MemoryStore *store)
+{
+	SimulatedViewer viewer;
+	CHECK(viewer.load(tree_file.c_str()));
+
+	OutputCapture output(dir);
+
+	{
+		Crawler crawler(&viewer, store, options);
+		crawler.reset_listbox_state();
+		crawler.run();
+	}
+
+	return output.finish();
+}
+
+/* Crawls the tree in tree_file into store with num_viewers viewers, returning
+ * the tree printed. topics_opened is how many pages each viewer opened.
+*/
+static std::string crawl_sharded(const std::string &dir, const std::string &tree_file, const CrawlOptions &options,
+	MemoryStore *store, unsigned int num_viewers, ShardCoordinator::Stats *stats, std::vector<unsigned long> *topics_opened)
+{
+	std::vector<SimulatedViewer*> viewers;
+
+	for(unsigned int i = 0; i < num_viewers; ++i)
+	{
+		viewers.push_back(new SimulatedViewer);
+		CHECK(viewers.back()->load(tree_file.c_str()));
+	}
+
+	OutputCapture output(dir);
+
+	{
+		ShardCoordinator coordinator(options, NULL);
+
+		for(unsigned int i = 0; i < num_viewers; ++i)
+		{
+			coordinator.add_worker(viewers[i], store, NULL);
+		}
+
+		CHECK(coordinator.run(stdout));
+		fflush(stdout);
+
+		*stats = coordinator.get_stats();
+	}
+
+	std::string tree = output.finish();
+
+	topics_opened->clear();
+
+	for(unsigned int i = 0; i < num_viewers; ++i)
+	{
+		topics_opened->push_back(viewers[i]->get_stats().topics_opened);
+		delete viewers[i];
+	}
+
+	return tree;
+}
+
+/* Whether sharded saved the same as serial, byte for byte. When collecting
+ * as it goes, the viewer which walks a group doesn't know where a single
+ * crawler would have stopped, so what it saved past there is allowed if it
+ * starts with extra.
+*/
+static bool same_contents(MemoryStore *sharded, MemoryStore *serial, const char *extra)
+{
+	std::map<std::string, std::string> s = sharded->contents();
+	std::map<std::string, std::string> expected = serial->contents();
+
+	for(std::map<std::string, std::string>::iterator i = s.begin(); i != s.end(); )
+	{
+		if(expected.find(i->first) == expected.end() && extra != NULL && i->first.compare(0, strlen(extra), extra) == 0)
+		{
+			s.erase(i++);
+		}
+		else{
+			++i;
+		}
+	}
+
+	return s == expected;
+}
+
+int main()
+{
+	char dir[] = "/tmp/ShardedCrawlTest.XXXXXX";
+	CHECK(mkdtemp(dir) != NULL);
+
+	std::string tree_file = std::string(dir) + "/tree";
+
+	/* A made-up index, then a group at the top with one of its pages in it
+	 * again, which stops the walk of that group there.
+	*/
+
+	std::string tree = make_tree(400, 6);
+
+	std::vector<TreeEntry> entries;
+	CHECK(parse_tree(tree, &entries));
+
+	unsigned int repeated = 0;
+
+	for(size_t i = 0; i < entries.size() && repeated == 0; ++i)
+	{
+		if(!entries[i].group && entries[i].depth > 0)
+		{
+			repeated = entries[i].id;
+		}
+	}
+
+	CHECK(repeated != 0);
+
+	char tail[64];
+	sprintf(tail, "9000\n  9001\n  %u\n  9002\n9003\n", repeated);
+
+	CHECK(write_file(tree_file, tree + tail));
+
+	for(int in_passes = 0; in_passes <= 1; ++in_passes)
+	{
+		CrawlOptions options = text_and_shot_options();
+
+		if(in_passes)
+		{
+			options.passes[0] = PASS_TEXT;
+			options.passes[1] = PASS_SCREENSHOTS;
+			options.num_passes = 2;
+		}
+
+		MemoryStore serial;
+		std::string serial_tree = crawl_serial(dir, tree_file, options, &serial);
+
+		/* The walk of 9000 stopped at the page seen before. */
+		CHECK(serial_tree == tree + "9000\n  9001\n9003\n");
+		CHECK(serial.exists(9001, "txt") && !serial.exists(9002, "txt"));
+
+		for(unsigned int num_viewers = 2; num_viewers <= 4; num_viewers += 2)
+		{
+			MemoryStore sharded;
+			ShardCoordinator::Stats stats;
+			std::vector<unsigned long> topics_opened;
+
+			std::string sharded_tree = crawl_sharded(dir, tree_file, options, &sharded, num_viewers, &stats, &topics_opened);
+
+			CHECK(sharded_tree == serial_tree);
+			CHECK(same_contents(&sharded, &serial, in_passes ? NULL : "9002."));
+
+			/* Some of the index was stolen and visited by another viewer.
+			 * Walking without collecting anything is too quick for that to
+			 * be sure of, but the passes are shared out.
+			*/
+			CHECK(stats.groups > 0 && (in_passes || stats.steals > 0));
+
+			unsigned long others = 0;
+
+			for(size_t i = 1; i < topics_opened.size(); ++i)
+			{
+				others += topics_opened[i];
+			}
+
+			CHECK(others > 0);
+
+			printf("%s, %u viewers: %lu groups offered up, %lu entries stolen, %lu of %lu pages opened by the others\n",
+				in_passes ? "In passes" : "As it goes", num_viewers, stats.groups, stats.steals,
+				others, others + topics_opened[0]);
+		}
+	}
+
+	remove(tree_file.c_str());
+	rmdir(dir);
+
+	return test_result("ShardedCrawlTest");
+}
@@ -0,0 +1,256 @@
+/* Checks the trace file Tracer writes is a Chrome trace event array with
+ * every event recorded (from more than one thread) in it, that it is usable
+ * before being closed, and that recording without summaries doesn't use up
+ * memory.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "Clock.hpp"
+#include "Test.hpp"
+#include "Threading.hpp"
+#include "Tracer.hpp"
+
+/* More than Tracer buffers before writing them out. */
+static const unsigned int EVENTS_PER_THREAD = 5000;
+
+struct ParsedEvent
+{
+	std::string name;
+	unsigned long long ts, dur;
+	unsigned int tid, id;
+};
+
+/* Records EVENTS_PER_THREAD events with made up times. */
+class RecordThread: public Thread
+{
+private:
+	Tracer *tracer;
+	unsigned int first_id;
+
+protected:
+	virtual void run()
+	{
+		uint64 base = clock_us();
+
+		for(unsigned int i = 0; i < EVENTS_PER_THREAD; ++i)
+		{
+			unsigned int id = first_id + i;
+			tracer->record((TracePhase)(id % TRACE_PHASE_COUNT), id, base + id, base + id + (id % 1000));
+		}
+	}
+
+public:
+	RecordThread(Tracer *tracer, unsigned int first_id):
+		tracer(tracer),
+		first_id(first_id) {}
+};
+
+static std::string read_file(const char *path)
+{
+	std::string data;
+
+	FILE *f = fopen(path, "rb");
+	CHECK(f != NULL);
+
+	if(f != NULL)
+	{
+		char buf[4096];
+		size_t len;
+
+		while((len = fread(buf, 1, sizeof(buf), f)) > 0)
+		{
+			data.append(buf, len);
+		}
+
+		fclose(f);
+	}
+
+	return data;
+}
+
+/* Parses the events out of a trace, one per line after the opening "[".
+ * Returns false if any line isn't an event in the format Tracer writes.
+*/
+static bool parse_trace(const std::string &trace, std::vector<ParsedEvent> *events)
+{
+	events->clear();
+
+	if(trace.compare(0, 2, "[\n") != 0)
+	{
+		return false;
+	}
+
+	for(size_t pos = 2; pos < trace.length();)
+	{
+		size_t eol = trace.find('\n', pos);
+		if(eol == std::string::npos)
+		{
+			eol = trace.length();
+		}
+
+		std::string line = trace.substr(pos, eol - pos);
+		pos = eol + 1;
+
+		if(line.empty() || line == "]")
+		{
+			continue;
+		}
+
+		char name[32];
+		ParsedEvent e;
+		int end = 0;
+
+		if(sscanf(line.c_str(), "{\"name\":\"%31[a-z_]\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":1,\"tid\":%u,\"args\":{\"id\":%u}}%n",
+			name, &(e.ts), &(e.dur), &(e.tid), &(e.id), &end) != 5 || end == 0)
+		{
+			return false;
+		}
+
+		/* Every event but the last is followed by a comma. */
+		std::string rest = line.substr(end);
+		if(rest != "," && rest != "")
+		{
+			return false;
+		}
+
+		e.name = name;
+		events->push_back(e);
+	}
+
+	return true;
+}
+
+/* Peak resident memory of this process in KiB. */
+static unsigned long peak_rss_kb()
+{
+	FILE *f = fopen("/proc/self/status", "r");
+	if(f == NULL)
+	{
+		return 0;
+	}
+
+	unsigned long kb = 0;
+	char line[256];
+
+	while(fgets(line, sizeof(line), f) != NULL)
+	{
+		sscanf(line, "VmHWM: %lu kB", &kb);
+	}
+
+	fclose(f);
+
+	return kb;
+}
+
+int main()
+{
+	char path[] = "/tmp/TracerTest.XXXXXX";
+	int fd = mkstemp(path);
+	CHECK(fd != -1);
+	close(fd);
+
+	{
+		Tracer tracer(0);
+		CHECK(tracer.open(path));
+
+		RecordThread a(&tracer, 1);
+		RecordThread b(&tracer, 1 + EVENTS_PER_THREAD);
+
+		CHECK(a.start());
+		CHECK(b.start());
+		a.join();
+		b.join();
+
+		/* Whatever has been written out so far reads as a trace which is
+		 * only missing the "]", like after a crash.
+		*/
+
+		std::vector<ParsedEvent> events;
+		CHECK(parse_trace(read_file(path), &events));
+		CHECK(events.size() >= 4096 && events.size() < 2 * EVENTS_PER_THREAD);
+
+		tracer.close();
+
+		std::string trace = read_file(path);
+		CHECK(trace.length() >= 3 && trace.compare(trace.length() - 3, 3, "\n]\n") == 0);
+
+		CHECK(parse_trace(trace, &events));
+		CHECK(events.size() == 2 * EVENTS_PER_THREAD);
+
+		/* Each event once, with its times relative to the start and a thread
+		 * number for each thread.
+		*/
+
+		std::vector<bool> seen(2 * EVENTS_PER_THREAD + 1, false);
+		std::vector<unsigned int> thread_of(3, 0);
+
+		for(size_t i = 0; i < events.size(); ++i)
+		{
+			const ParsedEvent &e = events[i];
+
+			CHECK(e.id >= 1 && e.id <= 2 * EVENTS_PER_THREAD && !seen[e.id]);
+			if(e.id < 1 || e.id > 2 * EVENTS_PER_THREAD)
+			{
+				continue;
+			}
+
+			seen[e.id] = true;
+
+			CHECK(e.name == Tracer::phase_name((TracePhase)(e.id % TRACE_PHASE_COUNT)));
+			CHECK(e.dur == e.id % 1000);
+			CHECK(e.ts < 60000000);
+
+			/* Both threads' events carry the same, small, thread number. */
+			unsigned int thread = e.id <= EVENTS_PER_THREAD ? 1 : 2;
+			CHECK(e.tid == 1 || e.tid == 2);
+
+			if(thread_of[thread] == 0)
+			{
+				thread_of[thread] = e.tid;
+			}
+
+			CHECK(e.tid == thread_of[thread]);
+		}
+
+		CHECK(thread_of[1] != thread_of[2]);
+	}
+
+	/* An empty trace is still a valid one. */
+
+	{
+		Tracer tracer(0);
+		CHECK(tracer.open(path));
+		tracer.close();
+
+		CHECK(read_file(path) == "[\n\n]\n");
+	}
+
+	/* Without summaries, durations aren't kept for them. */
+
+	{
+		Tracer tracer(0);
+		unsigned long rss_before = peak_rss_kb();
+
+		uint64 now = clock_us();
+
+		for(unsigned int i = 0; i < 8 * 1024 * 1024; ++i)
+		{
+			tracer.record(TRACE_NAVIGATE, i, now, now + 1);
+		}
+
+		unsigned long growth = peak_rss_kb() - rss_before;
+		printf("Peak memory grew by %lu KiB after 8M events\n", growth);
+
+		CHECK(growth < 8 * 1024);
+	}
+
+	remove(path);
+
+	return test_result("TracerTest");
+}
@@ -0,0 +1,145 @@
+/* Checks ViewportCapture cuts the same images out of whole-listbox frames as
+ * capturing each selected row on its own gives, using SimulatedViewer's
+ * synthetic screenshots, and that it notices when the rows have moved.
+*/
+
+#include <stdio.h>
+
+#include "GrayImage.hpp"
+#include "ListboxModel.hpp"
+#include "SimulatedViewer.hpp"
+#include "Test.hpp"
+#include "ViewportCapture.hpp"
+
+/* Reads back the item data SimulatedViewer drew in a row, which should look
+ * selected (set bits white on black).
+*/
+static unsigned int decode_selected(const GrayImage &image)
+{
+	unsigned int id = 0;
+
+	for(unsigned int bit = 0; bit < 32; ++bit)
+	{
+		unsigned int x = (bit * SimulatedViewer::ID_BIT_WIDTH) + (SimulatedViewer::ID_BIT_WIDTH / 2);
+
+		if(image.row(image.height / 2)[x] == 255)
+		{
+			id |= 1U << bit;
+		}
+	}
+
+	return id;
+}
+
+/* Selects row idx and captures it through the viewport, then checks it
+ * against the row captured directly like the crawler does without it.
+*/
+static bool check_row(SimulatedViewer *viewer, ListboxModel *listbox, ViewportCapture *viewport, unsigned int idx)
+{
+	listbox->move_to(idx);
+
+	GrayImage cut;
+	if(!viewport->capture_row(idx, listbox->item(idx), &cut))
+	{
+		return false;
+	}
+
+	GrayImage direct;
+	CHECK(viewer->capture(viewer->get_item_rect(idx), &direct));
+
+	CHECK(cut.width == direct.width && cut.height == direct.height);
+	CHECK(cut.pixels == direct.pixels);
+	CHECK(decode_selected(cut) == listbox->item(idx));
+
+	return true;
+}
+
+int main()
+{
+	SimulatedViewer viewer;
+	viewer.generate(2000, 1);
+
+	ListboxModel listbox(&viewer, true, false);
+	listbox.load();
+
+	ViewportCapture viewport(&viewer, &listbox);
+
+	const unsigned int rows = listbox.size();
+	CHECK(rows > 3 * SimulatedViewer::VISIBLE_ROWS);
+
+	/* Walking down the listbox takes one frame per screenful. */
+
+	for(unsigned int idx = 0; idx < rows; ++idx)
+	{
+		CHECK(check_row(&viewer, &listbox, &viewport, idx));
+	}
+
+	ViewportCapture::Stats stats = viewport.get_stats();
+
+	CHECK(stats.crops == rows);
+	CHECK(stats.mismatches == 0);
+	CHECK(stats.frames <= (rows + SimulatedViewer::VISIBLE_ROWS - 1) / SimulatedViewer::VISIBLE_ROWS);
+
+	printf("%u rows in %lu frames\n", rows, stats.frames);
+
+	/* Going back up within the last frame doesn't need another. */
+
+	for(unsigned int idx = rows; idx-- > rows - SimulatedViewer::VISIBLE_ROWS;)
+	{
+		CHECK(check_row(&viewer, &listbox, &viewport, idx));
+	}
+
+	CHECK(viewport.get_stats().frames == stats.frames);
+
+	/* Expanding a group without calling invalidate() moves the rows after
+	 * it. The stale frame is noticed and replaced.
+	*/
+
+	viewport.invalidate();
+
+	unsigned int group = 0;
+	unsigned int children = 0;
+
+	for(; group < rows && children == 0; ++group)
+	{
+		CHECK(check_row(&viewer, &listbox, &viewport, group));
+
+		listbox.move_to(group);
+		children = listbox.expand();
+	}
+
+	CHECK(children > 0);
+
+	stats = viewport.get_stats();
+
+	for(unsigned int idx = group; idx < group + children; ++idx)
+	{
+		CHECK(check_row(&viewer, &listbox, &viewport, idx));
+	}
+
+	CHECK(viewport.get_stats().mismatches > stats.mismatches);
+	CHECK(viewport.get_stats().frames > stats.frames);
+
+	/* Asking for the wrong item in a row fails rather than returning the
+	 * wrong image.
+	*/
+
+	stats = viewport.get_stats();
+
+	GrayImage image;
+	CHECK(!viewport.capture_row(group, listbox.item(group) + 1, &image));
+	CHECK(viewport.get_stats().mismatches > stats.mismatches);
+
+	/* A new viewer means a new frame. */
+
+	CHECK(check_row(&viewer, &listbox, &viewport, group));
+
+	stats = viewport.get_stats();
+
+	viewport.set_viewer(&viewer);
+
+	CHECK(check_row(&viewer, &listbox, &viewport, group));
+	CHECK(viewport.get_stats().frames == stats.frames + 1);
+
+	return test_result("ViewportCaptureTest");
+}
@@ -0,0 +1,225 @@
+/* Checks windows "appearing" through FakeWindowEventSource are found by
+ * WindowEvents waits: in the order they are due rather than scheduled, by
+ * title and parent, after other windows have turned up first, and not at
+ * all once the source is stopped. Then goes through Win32ViewerDriver's
+ * wait for the Copy dialog when a Copy dialog found by looking for it left
+ * its event behind.
+*/
+
+#include <set>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Clock.hpp"
+#include "FakeWindowEventSource.hpp"
+#include "Test.hpp"
+#include "WindowEvents.hpp"
+
+static void *const MAIN_WINDOW = (void*)(0x100);
+static void *const OTHER_WINDOW = (void*)(0x200);
+
+static void *const COPY_DIALOG = (void*)(0x1001);
+static void *const POPUP = (void*)(0x1002);
+
+/* Milliseconds since start. */
+static unsigned int since(uint64 start)
+{
+	return (unsigned int)((clock_us() - start) / 1000);
+}
+
+/* Win32ViewerDriver::copy_text()'s wait for the dialog, less the Windows
+ * calls: throws away what earlier Copies left behind, asks for the dialog
+ * to appear after delay_ms, then polls for it in between waiting for
+ * anything, skipping dialogs which aren't open. Gives up after timeout_ms
+ * with nothing happening, where the driver goes looking for the dialog.
+*/
+static void *copy_dialog(WindowEvents *events, FakeWindowEventSource *source, const std::set<void*> &open,
+	void *dialog, unsigned int delay_ms, unsigned int timeout_ms)
+{
+	events->discard("Copy", MAIN_WINDOW);
+
+	source->schedule(delay_ms, dialog, MAIN_WINDOW, "Copy", "#32770");
+
+	while(true)
+	{
+		WindowEvent event;
+
+		if(events->try_take("Copy", MAIN_WINDOW, &event))
+		{
+			if(open.find(event.window) != open.end())
+			{
+				return event.window;
+			}
+
+			continue;
+		}
+
+		if(!events->wait_any(timeout_ms))
+		{
+			return NULL;
+		}
+	}
+}
+
+int main()
+{
+	WindowEvents events;
+	FakeWindowEventSource source(&events);
+
+	CHECK(source.start());
+
+	/* Nothing there, nothing found, without waiting. */
+
+	uint64 start = clock_us();
+	CHECK(!events.wait_for("Copy", NULL, 0, NULL));
+	CHECK(since(start) < 50);
+
+	/* Scheduled out of order, found when each is due. */
+
+	start = clock_us();
+	source.schedule(60, POPUP, NULL, "Navigator", "#32770");
+	source.schedule(20, COPY_DIALOG, MAIN_WINDOW, "Copy", "#32770");
+
+	WindowEvent event;
+	CHECK(events.wait_for("Copy", NULL, 1000, &event));
+
+	unsigned int copy_ms = since(start);
+	CHECK(copy_ms >= 19 && copy_ms < 500);
+
+	CHECK(event.window == COPY_DIALOG);
+	CHECK(event.parent == MAIN_WINDOW);
+	CHECK(event.title == "Copy");
+	CHECK(event.class_name == "#32770");
+
+	/* Once found it is gone. */
+	CHECK(!events.wait_for("Copy", NULL, 0, NULL));
+
+	CHECK(events.wait_for("Navigator", NULL, 1000, &event));
+	CHECK(event.window == POPUP);
+	CHECK(since(start) >= 59);
+
+	/* A window which turns up while nobody is waiting for it is still there
+	 * when someone does.
+	*/
+
+	source.schedule(0, POPUP, NULL, "Navigator", "#32770");
+	sleep_ms(50);
+
+	CHECK(events.wait_for("Navigator", NULL, 0, &event));
+
+	/* Only windows with the right parent count, unless the parent is NULL. */
+
+	source.schedule(0, COPY_DIALOG, OTHER_WINDOW, "Copy", "#32770");
+
+	start = clock_us();
+	CHECK(!events.wait_for("Copy", MAIN_WINDOW, 100, NULL));
+	CHECK(since(start) >= 99);
+
+	CHECK(events.wait_for("Copy", OTHER_WINDOW, 0, &event));
+	CHECK(event.parent == OTHER_WINDOW);
+
+	source.schedule(0, COPY_DIALOG, OTHER_WINDOW, "Copy", "#32770");
+	CHECK(events.wait_for("Copy", NULL, 1000, NULL));
+
+	/* Waiting for one window isn't ended by others appearing first. */
+
+	for(unsigned int i = 0; i < 20; ++i)
+	{
+		source.schedule(i * 2, (void*)(uintptr_t)(0x2000 + i), MAIN_WINDOW, "Print", "#32770");
+	}
+
+	source.schedule(60, COPY_DIALOG, MAIN_WINDOW, "Copy", "#32770");
+
+	start = clock_us();
+	CHECK(events.wait_for("Copy", MAIN_WINDOW, 1000, &event));
+	CHECK(since(start) >= 59);
+
+	/* ...and they are all still waiting, in order. */
+
+	for(unsigned int i = 0; i < 20; ++i)
+	{
+		CHECK(events.wait_for("Print", NULL, 0, &event));
+		CHECK(event.window == (void*)(uintptr_t)(0x2000 + i));
+	}
+
+	/* wait_any() wakes up for anything. */
+
+	while(events.wait_any(0)) {}
+
+	source.schedule(10, POPUP, NULL, "Navigator", "#32770");
+	CHECK(events.wait_any(1000));
+	CHECK(events.wait_for("Navigator", NULL, 0, NULL));
+
+	/* Only so many are kept, the oldest go first. */
+
+	WindowEvents::Stats before = events.get_stats();
+
+	for(unsigned int i = 0; i < 300; ++i)
+	{
+		char title[16];
+		sprintf(title, "W%u", i);
+
+		events.post((void*)(uintptr_t)(0x3000 + i), NULL, title, "#32770");
+	}
+
+	WindowEvents::Stats stats = events.get_stats();
+	CHECK(stats.events == before.events + 300);
+	CHECK(stats.dropped == before.dropped + 44);
+
+	CHECK(!events.wait_for("W43", NULL, 0, NULL));
+	CHECK(events.wait_for("W44", NULL, 0, NULL));
+	CHECK(events.wait_for("W299", NULL, 0, NULL));
+
+	/* A Copy dialog which took too long is looked for and found instead,
+	 * then its event turns up late. The next Copy gets its own dialog, not
+	 * the old one (even if its handle has been used again since), and none
+	 * of the polling counts as timing out.
+	*/
+
+	{
+		std::set<void*> open;
+		open.insert(COPY_DIALOG);
+
+		WindowEvents::Stats before = events.get_stats();
+
+		CHECK(copy_dialog(&events, &source, open, COPY_DIALOG, 100, 20) == NULL);
+		sleep_ms(150);
+
+		void *const NEXT_DIALOG = (void*)(0x1003);
+		open.insert(NEXT_DIALOG);
+
+		CHECK(copy_dialog(&events, &source, open, NEXT_DIALOG, 20, 1000) == NEXT_DIALOG);
+
+		/* One which has closed again by the time it is taken is skipped. */
+
+		open.erase(NEXT_DIALOG);
+
+		source.schedule(5, NEXT_DIALOG, MAIN_WINDOW, "Copy", "#32770");
+		CHECK(copy_dialog(&events, &source, open, COPY_DIALOG, 40, 1000) == COPY_DIALOG);
+		CHECK(!events.try_take("Copy", NULL, NULL));
+
+		WindowEvents::Stats after = events.get_stats();
+		CHECK(after.timeouts == before.timeouts);
+	}
+
+	/* Stopping throws away anything not due yet, without waiting for it. */
+
+	source.schedule(2000, POPUP, NULL, "Navigator", "#32770");
+
+	start = clock_us();
+	source.stop();
+	CHECK(since(start) < 1000);
+
+	CHECK(!events.wait_for("Navigator", NULL, 100, NULL));
+
+	stats = events.get_stats();
+
+	/* Every wait which came back empty, including those with no timeout. */
+	CHECK(stats.timeouts == 5);
+	CHECK(stats.latency_us_max >= stats.latency_us / (stats.waits > 0 ? stats.waits : 1));
+
+	printf("%lu waits, %lu us average latency, %lu us worst\n", stats.waits,
+		(unsigned long)(stats.latency_us / (stats.waits > 0 ? stats.waits : 1)), (unsigned long)(stats.latency_us_max));
+
+	return test_result("WindowEventsTest");
+}
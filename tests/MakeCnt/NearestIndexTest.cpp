@@ -0,0 +1,518 @@
+/* Checks the costs NearestIndex counts between strings: plain edits, the
+ * characters and pairs of characters OCR mixes up, empty strings, the cap of
+ * a quarter of the length and giving up past the limit. Checks searches find
+ * exactly what comparing with every key would, on one thread and several.
+ * Then times searching for titles with OCR mistakes made up in them among as
+ * many others, and counts how many were matched to the wrong one:
+ *
+ * NearestIndexTest [titles] [threads]
+*/
+
+#include <algorithm>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "Clock.hpp"
+#include "NearestIndex.hpp"
+#include "Test.hpp"
+
+static const unsigned int NO_COST = NearestIndex::NO_COST;
+
+/* Half edits, like MakeCnt's default of 2 edits. */
+static const unsigned int MAX_COST = 4;
+
+/* What titles are made of once TitleMatcher has keyed them: no l, g, 1 or 0,
+ * which it merges with i, q and o.
+*/
+static const char ALPHABET[] = "abcdefhijkmnopqrstuvwxyz23456789";
+
+/* Some of the mistakes NearestIndex expects OCR to make. */
+static const char *CONFUSED_CHARS[] = { "ce", "co", "eo", "uv", "bh", "hn", "5s", "ft", NULL };
+static const char *CONFUSED_PAIRS[] = { "rnm", "inm", "cid", "vvw", "iiu", "rin", NULL };
+
+/* Plain edit distance, the slow way. */
+static unsigned int reference_distance(const std::string &a, const std::string &b)
+{
+	std::vector< std::vector<unsigned int> > d(a.length() + 1, std::vector<unsigned int>(b.length() + 1));
+
+	for(size_t i = 0; i <= a.length(); ++i)
+	{
+		for(size_t j = 0; j <= b.length(); ++j)
+		{
+			if(i == 0 || j == 0)
+			{
+				d[i][j] = i + j;
+			}
+			else{
+				d[i][j] = std::min(d[i - 1][j - 1] + (a[i - 1] != b[j - 1]), std::min(d[i - 1][j], d[i][j - 1]) + 1);
+			}
+		}
+	}
+
+	return d[a.length()][b.length()];
+}
+
+static std::string random_word(unsigned int min_length, unsigned int max_length)
+{
+	std::string word;
+	unsigned int length = min_length + rand() % (max_length - min_length + 1);
+
+	for(unsigned int i = 0; i < length; ++i)
+	{
+		word += ALPHABET[rand() % (sizeof(ALPHABET) - 1)];
+	}
+
+	return word;
+}
+
+/* A title of a few words from vocabulary, keyed like TitleMatcher does (so
+ * without the spaces).
+*/
+static std::string random_title(const std::vector<std::string> &vocabulary)
+{
+	std::string title;
+	unsigned int words = 2 + rand() % 3;
+
+	for(unsigned int i = 0; i < words; ++i)
+	{
+		title += vocabulary[rand() % vocabulary.size()];
+	}
+
+	return title;
+}
+
+/* Makes a mistake in s like OCR might, mostly one of the ones NearestIndex
+ * knows about.
+*/
+static void make_mistake(std::string *s)
+{
+	if(s->empty())
+	{
+		return;
+	}
+
+	size_t at = rand() % s->length();
+	unsigned int kind = rand() % 10;
+
+	if(kind < 4)
+	{
+		const char *c = CONFUSED_CHARS[rand() % 8];
+		(*s)[at] = (*s)[at] == c[0] ? c[1] : c[0];
+	}
+	else if(kind < 7)
+	{
+		const char *p = CONFUSED_PAIRS[rand() % 6];
+
+		if(rand() % 2 == 0)
+		{
+			s->replace(at, 1, p, 2);
+		}
+		else{
+			s->replace(at, std::min((size_t)(2), s->length() - at), p + 2, 1);
+		}
+	}
+	else if(kind < 8)
+	{
+		(*s)[at] = ALPHABET[rand() % (sizeof(ALPHABET) - 1)];
+	}
+	else if(kind < 9)
+	{
+		s->erase(at, 1);
+	}
+	else{
+		s->insert(at, 1, ALPHABET[rand() % (sizeof(ALPHABET) - 1)]);
+	}
+}
+
+/* What a search should find, by comparing query with every key. */
+static NearestIndex::Result brute_force(const NearestIndex &index, const std::vector<std::string> &keys, const std::string &query)
+{
+	NearestIndex::Result r;
+	r.cost = NO_COST;
+	r.next_cost = NO_COST;
+
+	for(size_t k = 0; k < keys.size(); ++k)
+	{
+		unsigned int cost = NearestIndex::ocr_cost(query, keys[k], index.limit(query.length(), keys[k].length()));
+
+		if(cost == NO_COST)
+		{
+			continue;
+		}
+
+		if(cost < r.cost)
+		{
+			r.next_cost = r.cost;
+			r.cost = cost;
+
+			r.tied.clear();
+			r.tied.push_back(k);
+		}
+		else if(cost == r.cost)
+		{
+			r.tied.push_back(k);
+		}
+		else if(cost < r.next_cost)
+		{
+			r.next_cost = cost;
+		}
+	}
+
+	return r;
+}
+
+static bool same_result(const NearestIndex::Result &a, const NearestIndex::Result &b)
+{
+	return a.cost == b.cost && a.tied == b.tied && a.next_cost == b.next_cost;
+}
+
+/* Searches for a title with mistakes made in it among num_titles others,
+ * printing how long it took and how the matches turned out. Returns how many
+ * were matched to the wrong title.
+*/
+static unsigned int time_search(unsigned int num_titles, unsigned int threads)
+{
+	std::vector<std::string> vocabulary;
+
+	for(unsigned int i = 0; i < 5000; ++i)
+	{
+		vocabulary.push_back(random_word(3, 9));
+	}
+
+	std::set<std::string> unique;
+	std::vector<std::string> titles;
+
+	while(titles.size() < num_titles)
+	{
+		std::string title = random_title(vocabulary);
+
+		if(unique.insert(title).second)
+		{
+			titles.push_back(title);
+		}
+	}
+
+	/* Nothing wrong with a fifth of them, one mistake in a third, two in a
+	 * third and three (more than can be matched) in the rest.
+	*/
+
+	std::vector<std::string> queries;
+
+	for(size_t i = 0; i < titles.size(); ++i)
+	{
+		unsigned int r = rand() % 15;
+		unsigned int mistakes = r < 3 ? 0 : r < 8 ? 1 : r < 13 ? 2 : 3;
+
+		std::string query = titles[i];
+
+		for(unsigned int m = 0; m < mistakes; ++m)
+		{
+			make_mistake(&query);
+		}
+
+		queries.push_back(query);
+	}
+
+	uint64 start = clock_us();
+
+	NearestIndex index(MAX_COST);
+
+	for(size_t i = 0; i < titles.size(); ++i)
+	{
+		index.add(titles[i]);
+	}
+
+	index.build();
+
+	uint64 built = clock_us();
+
+	std::vector<NearestIndex::Result> results;
+	index.search(queries, threads, &results);
+
+	uint64 searched = clock_us();
+
+	unsigned int right = 0, wrong = 0, tied = 0, none = 0;
+
+	for(size_t q = 0; q < queries.size(); ++q)
+	{
+		const NearestIndex::Result &r = results[q];
+
+		if(r.tied.empty())
+		{
+			++none;
+		}
+		else if(r.tied.size() > 1)
+		{
+			++tied;
+		}
+		else if(r.tied[0] == q)
+		{
+			++right;
+		}
+		else{
+			++wrong;
+		}
+	}
+
+	printf("%u titles, %u threads: built in %.2f s, searched in %.2f s; %u right, %u wrong, %u tied, %u not found\n",
+		num_titles, threads, (double)(built - start) / 1000000.0, (double)(searched - built) / 1000000.0,
+		right, wrong, tied, none);
+
+	return wrong;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int num_titles = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000;
+	unsigned int threads = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+
+	srand(1);
+
+	/* Empty strings. */
+
+	CHECK(NearestIndex::ocr_cost("", "", 0) == 0);
+	CHECK(NearestIndex::ocr_cost("", "abc", 6) == 6);
+	CHECK(NearestIndex::ocr_cost("abc", "", 6) == 6);
+	CHECK(NearestIndex::ocr_cost("", "abc", 5) == NO_COST);
+
+	CHECK(NearestIndex::edit_distance("", "", 0) == 0);
+	CHECK(NearestIndex::edit_distance("", "abc", 3) == 3);
+	CHECK(NearestIndex::edit_distance("abc", "", 3) == 3);
+	CHECK(NearestIndex::edit_distance("", "abc", 2) == NO_COST);
+
+	/* Plain edits cost two half edits. */
+
+	CHECK(NearestIndex::ocr_cost("abc", "abc", 0) == 0);
+	CHECK(NearestIndex::ocr_cost("abc", "abd", 4) == 2);
+	CHECK(NearestIndex::ocr_cost("abc", "abxc", 4) == 2);
+	CHECK(NearestIndex::ocr_cost("abc", "ac", 4) == 2);
+	CHECK(NearestIndex::ocr_cost("abcd", "axcy", 4) == 4);
+
+	/* Easily mistaken characters cost one, either way round. */
+
+	for(int i = 0; CONFUSED_CHARS[i] != NULL; ++i)
+	{
+		std::string a = std::string("xx") + CONFUSED_CHARS[i][0] + "xx";
+		std::string b = std::string("xx") + CONFUSED_CHARS[i][1] + "xx";
+
+		CHECK(NearestIndex::ocr_cost(a, b, 4) == 1);
+		CHECK(NearestIndex::ocr_cost(b, a, 4) == 1);
+		CHECK(NearestIndex::edit_distance(a, b, 4) == 1);
+	}
+
+	CHECK(NearestIndex::ocr_cost("cat", "eat", 4) == 1);
+	CHECK(NearestIndex::ocr_cost("cat", "bat", 4) == 2);
+
+	/* So do pairs read as one character, "rn" for "m" and so on, which are
+	 * two plain edits.
+	*/
+
+	for(int i = 0; CONFUSED_PAIRS[i] != NULL; ++i)
+	{
+		std::string pair(CONFUSED_PAIRS[i], 2);
+		std::string one(CONFUSED_PAIRS[i] + 2, 1);
+
+		CHECK(NearestIndex::ocr_cost("x" + pair + "x", "x" + one + "x", 4) == 2);
+		CHECK(NearestIndex::ocr_cost("x" + one + "x", "x" + pair + "x", 4) == 2);
+		CHECK(NearestIndex::edit_distance("x" + pair + "x", "x" + one + "x", 4) == 2);
+	}
+
+	CHECK(NearestIndex::ocr_cost("rn", "m", 2) == 2);
+	CHECK(NearestIndex::ocr_cost("modern", "rnodern", 2) == 2);
+	CHECK(NearestIndex::ocr_cost("ab", "m", 4) == 4);
+
+	/* Up to the limit and no further. */
+
+	CHECK(NearestIndex::ocr_cost("abcdef", "abcxyz", 6) == 6);
+	CHECK(NearestIndex::ocr_cost("abcdef", "abcxyz", 5) == NO_COST);
+	CHECK(NearestIndex::ocr_cost("cat", "eat", 0) == NO_COST);
+	CHECK(NearestIndex::edit_distance("abcdef", "abcxyz", 3) == 3);
+	CHECK(NearestIndex::edit_distance("abcdef", "abcxyz", 2) == NO_COST);
+	CHECK(NearestIndex::edit_distance("abcdefgh", "ab", 5) == NO_COST);
+
+	/* Plain edit distance is right either side of 64 characters (where it
+	 * stops working a word at a time), and OCR mistakes cost between one and
+	 * two half edits per plain edit.
+	*/
+
+	{
+		unsigned int wrong = 0, out_of_range = 0;
+
+		for(int i = 0; i < 2000; ++i)
+		{
+			std::string a = random_word(0, 80);
+			std::string b = a;
+
+			unsigned int mistakes = rand() % 5;
+			for(unsigned int m = 0; m < mistakes; ++m)
+			{
+				make_mistake(&b);
+			}
+
+			unsigned int expected = reference_distance(a, b);
+			unsigned int limit = rand() % 6;
+
+			wrong += NearestIndex::edit_distance(a, b, limit) != (expected <= limit ? expected : NO_COST);
+
+			unsigned int cost = NearestIndex::ocr_cost(a, b, 1000);
+			out_of_range += cost < expected || cost > expected * 2;
+		}
+
+		CHECK(wrong == 0);
+		CHECK(out_of_range == 0);
+	}
+
+	/* No further apart than a quarter of the length of the longer string,
+	 * or max_cost.
+	*/
+
+	{
+		NearestIndex index(MAX_COST);
+
+		CHECK(index.limit(0, 0) == 0);
+		CHECK(index.limit(3, 3) == 1);
+		CHECK(index.limit(6, 4) == 3);
+		CHECK(index.limit(4, 6) == 3);
+		CHECK(index.limit(8, 8) == 4);
+		CHECK(index.limit(40, 38) == MAX_COST);
+
+		/* Three characters can be half an edit apart but not one, six can be
+		 * one edit apart but not two.
+		*/
+
+		index.add("cat");
+		index.add("abcdef");
+		index.add("someting");
+		index.build();
+
+		std::vector<std::string> queries;
+		queries.push_back("eat");
+		queries.push_back("bat");
+		queries.push_back("abcdxf");
+		queries.push_back("abxdxf");
+		queries.push_back("something");
+		queries.push_back("sorneting");
+
+		std::vector<NearestIndex::Result> results;
+		index.search(queries, 1, &results);
+
+		CHECK(results[0].tied.size() == 1 && results[0].tied[0] == 0 && results[0].cost == 1);
+		CHECK(results[1].tied.empty() && results[1].cost == NO_COST);
+		CHECK(results[2].tied.size() == 1 && results[2].tied[0] == 1 && results[2].cost == 2);
+		CHECK(results[3].tied.empty());
+		CHECK(results[4].tied.size() == 1 && results[4].tied[0] == 2 && results[4].cost == 2);
+		CHECK(results[5].tied.size() == 1 && results[5].tied[0] == 2 && results[5].cost == 2);
+	}
+
+	/* Ties, the next nearest, and keys too short to split into pieces. */
+
+	{
+		NearestIndex index(MAX_COST);
+
+		index.add("backuptapez");
+		index.add("backuptaped");
+		index.add("backuptapes");
+		index.add("abcd");
+		index.build();
+
+		std::vector<std::string> queries;
+		queries.push_back("backuptapex");
+		queries.push_back("backuptapes");
+		queries.push_back("abce");
+
+		std::vector<NearestIndex::Result> results;
+		index.search(queries, 1, &results);
+
+		CHECK(results[0].cost == 2 && results[0].tied.size() == 3 && results[0].next_cost == NO_COST);
+		CHECK(results[1].cost == 0 && results[1].tied.size() == 1 && results[1].tied[0] == 2 && results[1].next_cost == 2);
+		CHECK(results[2].cost == 2 && results[2].tied.size() == 1 && results[2].tied[0] == 3);
+	}
+
+	/* Searches find exactly what comparing with every key does, with plenty
+	 * of keys near each other.
+	*/
+
+	{
+		std::vector<std::string> vocabulary;
+
+		for(int i = 0; i < 40; ++i)
+		{
+			vocabulary.push_back(random_word(1, 6));
+		}
+
+		NearestIndex index(MAX_COST);
+
+		std::set<std::string> unique;
+		std::vector<std::string> keys;
+
+		while(keys.size() < 600)
+		{
+			std::string key;
+
+			if(rand() % 10 == 0)
+			{
+				key = random_word(1, 4);
+			}
+			else if(rand() % 3 == 0 && !keys.empty())
+			{
+				/* Another title a mistake away from one already there. */
+				key = keys[rand() % keys.size()];
+				make_mistake(&key);
+			}
+			else{
+				key = random_title(vocabulary);
+			}
+
+			if(unique.insert(key).second)
+			{
+				keys.push_back(key);
+				index.add(key);
+			}
+		}
+
+		index.build();
+
+		std::vector<std::string> queries;
+
+		for(int i = 0; i < 600; ++i)
+		{
+			std::string query = keys[rand() % keys.size()];
+
+			unsigned int mistakes = rand() % 4;
+			for(unsigned int m = 0; m < mistakes; ++m)
+			{
+				make_mistake(&query);
+			}
+
+			queries.push_back(query);
+		}
+
+		std::vector<NearestIndex::Result> results, threaded;
+		index.search(queries, 1, &results);
+		index.search(queries, 4, &threaded);
+
+		unsigned int wrong = 0, found = 0, ties = 0;
+
+		for(size_t q = 0; q < queries.size(); ++q)
+		{
+			wrong += !same_result(results[q], brute_force(index, keys, queries[q]));
+			wrong += !same_result(results[q], threaded[q]);
+
+			found += !results[q].tied.empty();
+			ties += results[q].tied.size() > 1;
+		}
+
+		CHECK(wrong == 0);
+		CHECK(found > 300 && ties > 0);
+	}
+
+	/* Timing. Matching to the wrong title should be rare. */
+
+	unsigned int wrong = time_search(num_titles, threads);
+	CHECK(wrong < num_titles / 1000);
+
+	return test_result("NearestIndexTest");
+}
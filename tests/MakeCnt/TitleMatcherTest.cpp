@@ -0,0 +1,180 @@
+/* Checks how TitleMatcher::match_nearest() settles rows the OCR got wrong:
+ * a row with one topic nearest gets it, a tie between topics goes to the one
+ * which fits between the rows either side in the .cnt file (and nowhere if
+ * more than one does), two rows equally near the same topic both go without,
+ * and of two rows at different distances the nearer one gets it. Also checks
+ * topics a row will get by the ID in its page text are left alone.
+*/
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "TitleMatcher.hpp"
+#include "Test.hpp"
+
+/* Matches rows to topics (both in order, topics given as titles and IDs
+ * alternately) exactly, then by how near they are. Returns the topic ID each
+ * row ended up with, "" for none.
+*/
+static std::vector<std::string> match(const char **topics, const char **rows, std::vector<TitleMatcher::NearestMatch> *matches,
+	const std::vector<std::string> *page_ids = NULL)
+{
+	TitleMatcher matcher(NULL);
+
+	for(int i = 0; topics[i] != NULL; i += 2)
+	{
+		matcher.add_topic(topics[i], topics[i + 1]);
+	}
+
+	size_t num_rows = 0;
+
+	for(; rows[num_rows] != NULL; ++num_rows)
+	{
+		matcher.add_item(rows[num_rows]);
+	}
+
+	matcher.match(TitleMatcher::MATCH_EXACT);
+
+	std::vector<std::string> no_ids(num_rows);
+	matches->clear();
+	matcher.match_nearest(2.0, page_ids != NULL ? *page_ids : no_ids, 1, matches);
+
+	std::vector<std::string> ids;
+
+	for(size_t i = 0; i < num_rows; ++i)
+	{
+		const TitleMatcher::Item &item = matcher.get_items()[i];
+		ids.push_back(item.has_topic_id ? item.topic_id : "");
+	}
+
+	return ids;
+}
+
+int main()
+{
+	std::vector<TitleMatcher::NearestMatch> matches;
+
+	/* Two topics one edit from "Backup Tapes", in different places in the
+	 * .cnt file.
+	*/
+
+	const char *tied_topics[] = {
+		"Start Here", "START",
+		"Backup Tapez", "TAPEZ",
+		"Middle Page", "MIDDLE",
+		"Backup Taped", "TAPED",
+		"End Page", "END",
+		NULL
+	};
+
+	/* Between the first two, it's the first one. */
+
+	{
+		const char *rows[] = { "Start Here", "Backup Tapes", "Middle Page", NULL };
+		std::vector<std::string> ids = match(tied_topics, rows, &matches);
+
+		CHECK(ids[1] == "TAPEZ");
+		CHECK(matches.size() == 1 && matches[0].item == 1 && matches[0].edits == 1.0);
+
+		/* Settled by position, so no confidence in it. */
+		CHECK(matches.size() == 1 && matches[0].confidence == 0.0);
+	}
+
+	/* Between the last two, the other one. */
+
+	{
+		const char *rows[] = { "Middle Page", "Backup Tapes", "End Page", NULL };
+		std::vector<std::string> ids = match(tied_topics, rows, &matches);
+
+		CHECK(ids[1] == "TAPED");
+		CHECK(matches.size() == 1);
+	}
+
+	/* Where either would fit, neither. */
+
+	{
+		const char *rows[] = { "Start Here", "Backup Tapes", "End Page", NULL };
+		std::vector<std::string> ids = match(tied_topics, rows, &matches);
+
+		CHECK(ids[1] == "");
+		CHECK(matches.empty());
+	}
+
+	/* With nothing either side matched, neither. */
+
+	{
+		const char *rows[] = { "Backup Tapes", NULL };
+		std::vector<std::string> ids = match(tied_topics, rows, &matches);
+
+		CHECK(ids[0] == "");
+	}
+
+	/* Two rows nearest the same topic. */
+
+	const char *contested_topics[] = {
+		"Start Here", "START",
+		"Remote Access", "REMOTE",
+		"End Page", "END",
+		NULL
+	};
+
+	/* Both one edit away, so neither gets it. */
+
+	{
+		const char *rows[] = { "Start Here", "Remote Acxess", "Remote Acvess", "End Page", NULL };
+		std::vector<std::string> ids = match(contested_topics, rows, &matches);
+
+		CHECK(ids[1] == "" && ids[2] == "");
+		CHECK(matches.empty());
+	}
+
+	/* One only half an edit away ("c" read as "e"), which gets it. */
+
+	{
+		const char *rows[] = { "Start Here", "Remote Acxess", "Remote Aceess", "End Page", NULL };
+		std::vector<std::string> ids = match(contested_topics, rows, &matches);
+
+		CHECK(ids[1] == "" && ids[2] == "REMOTE");
+		CHECK(matches.size() == 1 && matches[0].item == 2 && matches[0].edits == 0.5);
+
+		/* Nothing else within reach, so all that counts is how much of the
+		 * title is left.
+		*/
+		CHECK(matches.size() == 1 && matches[0].confidence > 0.9 && matches[0].confidence < 1.0);
+	}
+
+	/* A row alone, "rn" read for "m". */
+
+	{
+		const char *rows[] = { "Start Here", "Remote Access", "Printing Forrns", "End Page", NULL };
+		const char *topics[] = {
+			"Start Here", "START",
+			"Remote Access", "REMOTE",
+			"Printing Forms", "FORMS",
+			"End Page", "END",
+			NULL
+		};
+
+		std::vector<std::string> ids = match(topics, rows, &matches);
+
+		CHECK(ids[2] == "FORMS");
+		CHECK(matches.size() == 1 && matches[0].edits == 1.0);
+	}
+
+	/* A topic another row has the ID of in its page text is left for it. */
+
+	{
+		const char *rows[] = { "Start Here", "Remote Acxess", "Something Else", "End Page", NULL };
+
+		std::vector<std::string> page_ids(4);
+		page_ids[2] = "remote";
+
+		std::vector<std::string> ids = match(contested_topics, rows, &matches, &page_ids);
+
+		CHECK(ids[1] == "" && ids[2] == "");
+		CHECK(matches.empty());
+	}
+
+	return test_result("TitleMatcherTest");
+}
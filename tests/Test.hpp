@@ -0,0 +1,38 @@
+#ifndef TESTS_TEST_HPP
+#define TESTS_TEST_HPP
+
+#include <stdio.h>
+
+/* Just enough to write the tests with. Each test is a program which CHECK()s
+ * things as it goes and returns test_result() from main().
+*/
+
+inline unsigned int &test_failures()
+{
+	static unsigned int failures = 0;
+	return failures;
+}
+
+#define CHECK(cond) \
+	do { \
+		if(!(cond)) \
+		{ \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			++test_failures(); \
+		} \
+	} while(0)
+
+inline int test_result(const char *name)
+{
+	if(test_failures() == 0)
+	{
+		printf("%s: passed\n", name);
+		return 0;
+	}
+	else{
+		printf("%s: %u checks failed\n", name, test_failures());
+		return 1;
+	}
+}
+
+#endif /* !TESTS_TEST_HPP */
@@ -0,0 +1,119 @@
+#!/bin/sh
+# Runs makecnt.pl and MakeCnt (with -e 0) over the same files and checks they
+# write the same .cnt file, print the same matches and leave the same topics
+# unmatched. Run from the top of the repository:
+#
+#   tests/compare-makecnt.sh                  # Every case in tests/fixtures/makecnt/
+#   tests/compare-makecnt.sh <case directory>...
+#
+# Each case directory holds a tree listing (titles.lst), a flat .cnt file
+# from helpdeco (flat.cnt) and a txt/ directory of page text dumps, which may
+# be empty. Topic IDs in flat.cnt must be unique, or which title a row gets
+# by the ID in its page text is random in makecnt.pl. makecnt.pl needs Perl's
+# File::Slurp, point PERL5LIB at it if it isn't installed.
+#
+# MakeCnt is built into tests/build/bin first, or set MAKECNT to use one built
+# already. CXX, CXXFLAGS and BUILD work like in run-tests.sh.
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2 -Wall}
+BUILD=${BUILD:-tests/build}
+
+set -e
+
+if [ $# -eq 0 ]
+then
+	set -- tests/fixtures/makecnt/*/
+fi
+
+top=`pwd`
+
+mkdir -p "$BUILD"
+BUILD=`cd "$BUILD" && pwd`
+
+if [ -z "$MAKECNT" ]
+then
+	mkdir -p "$BUILD/bin"
+	MAKECNT="$BUILD/bin/makecnt"
+	$CXX $CXXFLAGS -IMMVRipper -o "$MAKECNT" MakeCnt/*.cpp MMVRipper/Clock.cpp MMVRipper/Threading.cpp -lpthread
+fi
+
+# run <pl|makecnt> <arguments...>: runs makecnt.pl or MakeCnt.
+run()
+{
+	program=$1
+	shift
+
+	if [ $program = pl ]
+	then
+		perl "$top/makecnt.pl" "$@"
+	else
+		"$MAKECNT" -e 0 "$@"
+	fi
+}
+
+differ=""
+
+for case in "$@"
+do
+	case=`cd "$case" && pwd`
+	name=`basename "$case"`
+
+	out="$BUILD/compare-makecnt/$name"
+	rm -rf "$out"
+	mkdir -p "$out"
+
+	# Both write the .rej file next to the .cnt file they were given, so
+	# give them a copy.
+
+	for program in pl makecnt
+	do
+		cp "$case/flat.cnt" "$out/flat.cnt"
+		rm -f "$out/flat.cnt.rej"
+
+		if ! run $program "$case/titles.lst" "$case/txt" "$out/flat.cnt" "$out/output-$program.cnt" > "$out/matched-$program.txt" 2> "$out/errors-$program.txt"
+		then
+			echo "$name: `[ $program = pl ] && echo makecnt.pl || echo MakeCnt` failed:"
+			cat "$out/errors-$program.txt"
+			exit 1
+		fi
+
+		# makecnt.pl writes the unmatched topics in a random order.
+
+		if [ -f "$out/flat.cnt.rej" ]
+		then
+			tr -d '\r' < "$out/flat.cnt.rej" | sort > "$out/rej-$program.txt"
+		else
+			: > "$out/rej-$program.txt"
+		fi
+	done
+
+	same=1
+
+	for file in output.cnt matched.txt rej.txt
+	do
+		pl="$out/${file%.*}-pl.${file#*.}"
+		makecnt="$out/${file%.*}-makecnt.${file#*.}"
+
+		if ! cmp -s "$pl" "$makecnt"
+		then
+			[ $same = 1 ] && echo "$name: differs, see $out:"
+			same=0
+
+			diff "$pl" "$makecnt" | head -20 || true
+		fi
+	done
+
+	if [ $same = 1 ]
+	then
+		echo "$name: same, `grep -c . "$out/rej-pl.txt" || true` topics unmatched"
+	else
+		differ="$differ $name"
+	fi
+done
+
+if [ -n "$differ" ]
+then
+	echo "Differ:$differ"
+	exit 1
+fi
@@ -0,0 +1,77 @@
+#!/bin/sh
+# Times ocr.pl and MMVOcr reading the same screenshots and checks they write
+# the same listing. Run from the top of the repository, giving the directory
+# MMVRipper saved its screenshots (and tree listing) in:
+#
+#   tests/compare-ocr.sh <rip directory> [tree listing]
+#
+# The tree listing defaults to tree.lst in that directory. Both programs need
+# everything they normally do: ImageMagick, Tesseract (the program and the
+# library) and Perl's IPC::Run and File::Slurp.
+#
+# MMVOcr is run with -r 0, so it crops rows like ocr.pl and the listings
+# should match byte for byte. Put any other options for it in MMVOCR_OPTIONS,
+# like "-j 4". It is built into tests/build/bin first, or set MMVOCR to use one
+# built already. CXX, CXXFLAGS and BUILD work like in run-tests.sh.
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2 -Wall}
+BUILD=${BUILD:-tests/build}
+
+set -e
+
+if [ $# -lt 1 ] || [ $# -gt 2 ]
+then
+	echo "Usage: $0 <rip directory> [tree listing]" >&2
+	exit 1
+fi
+
+top=`pwd`
+rip=`cd "$1" && pwd`
+tree=${2:-$rip/tree.lst}
+
+case "$tree" in /*) ;; *) tree="$top/$tree" ;; esac
+
+mkdir -p "$BUILD"
+BUILD=`cd "$BUILD" && pwd`
+
+if [ -z "$MMVOCR" ]
+then
+	mkdir -p "$BUILD/bin"
+	MMVOCR="$BUILD/bin/mmvocr"
+	$CXX $CXXFLAGS -IMMVRipper -o "$MMVOCR" MMVOcr/*.cpp MMVRipper/GrayImage.cpp MMVRipper/Threading.cpp MMVRipper/Clock.cpp -ltesseract -lpthread
+fi
+
+out="$BUILD/compare-ocr"
+rm -rf "$out"
+mkdir -p "$out"
+
+rows=`grep -c '^ *[0-9]' "$tree" || true`
+
+# seconds <command...>: runs a command in the rip directory and prints how
+# long it took.
+seconds()
+{
+	start=`perl -MTime::HiRes=time -e 'printf "%.3f", time'`
+	(cd "$rip" && "$@")
+	perl -MTime::HiRes=time -e 'printf "%.3f", time - $ARGV[0]' "$start"
+}
+
+echo "Reading $rows rows with ocr.pl..."
+ocr_pl=`seconds sh -c "perl '$top/ocr.pl' < '$tree' > '$out/ocr.pl.lst'"`
+
+echo "Reading $rows rows with MMVOcr..."
+mmvocr=`seconds sh -c "'$MMVOCR' -r 0 $MMVOCR_OPTIONS < '$tree' > '$out/mmvocr.lst' 2> '$out/mmvocr.log'"`
+
+perl -e 'printf "ocr.pl: %.1f s (%.1f rows/s)\nMMVOcr: %.1f s (%.1f rows/s), %.1f times as fast\n",
+	$ARGV[1], $ARGV[0] / ($ARGV[1] || 1), $ARGV[2], $ARGV[0] / ($ARGV[2] || 1), $ARGV[1] / ($ARGV[2] || 1)' \
+	"$rows" "$ocr_pl" "$mmvocr"
+
+if cmp -s "$out/ocr.pl.lst" "$out/mmvocr.lst"
+then
+	echo "Listings match"
+else
+	echo "Listings differ, see $out:"
+	diff "$out/ocr.pl.lst" "$out/mmvocr.lst" | head -20
+	exit 1
+fi
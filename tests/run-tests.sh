@@ -0,0 +1,96 @@
+#!/bin/sh
+# Builds and runs the tests. Run from the top of the repository:
+#
+#   tests/run-tests.sh              # Every test
+#   tests/run-tests.sh PackStore    # Just the tests with PackStore in their name
+#
+# Each tests/<program>/*Test.cpp is linked against everything in <program>/
+# (and MMVRipper/, which the others share code with) except its main(). The
+# MMVOcr tests don't need Tesseract. Set CXX and CXXFLAGS to use a different
+# compiler, and BUILD to build somewhere other than tests/build.
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2 -Wall}
+BUILD=${BUILD:-tests/build}
+
+set -e
+
+mkdir -p "$BUILD"
+BUILD=`cd "$BUILD" && pwd`
+
+# build_lib <name> <source dir> <sources to leave out...>
+build_lib()
+{
+	name=$1
+	dir=$2
+	shift 2
+
+	mkdir -p "$BUILD/$name"
+	objs=""
+
+	for src in "$dir"/*.cpp
+	do
+		base=`basename "$src" .cpp`
+
+		skip=0
+		for leave_out in "$@"
+		do
+			[ "$base" = "$leave_out" ] && skip=1
+		done
+		[ $skip = 1 ] && continue
+
+		obj="$BUILD/$name/$base.o"
+		if [ ! -f "$obj" ] || [ "$src" -nt "$obj" ] || [ -n "`find "$dir" -name '*.hpp' -newer "$obj"`" ]
+		then
+			$CXX $CXXFLAGS -IMMVRipper -c -o "$obj" "$src"
+		fi
+
+		objs="$objs $obj"
+	done
+
+	rm -f "$BUILD/lib$name.a"
+	ar rcs "$BUILD/lib$name.a" $objs
+}
+
+build_lib mmvripper MMVRipper MMVRipper
+build_lib mmvocr MMVOcr MMVOcr OcrPool TesseractEngine
+build_lib makecnt MakeCnt MakeCnt
+
+failed=""
+
+for test in tests/MMVRipper/*Test.cpp tests/MMVOcr/*Test.cpp tests/MakeCnt/*Test.cpp
+do
+	[ -f "$test" ] || continue
+
+	program=`basename \`dirname "$test"\``
+	name=`basename "$test" .cpp`
+
+	if [ $# -gt 0 ]
+	then
+		wanted=0
+		for filter in "$@"
+		do
+			case "$name" in *"$filter"*) wanted=1 ;; esac
+		done
+		[ $wanted = 1 ] || continue
+	fi
+
+	case "$program" in
+		MMVRipper) libs="-lmmvripper" ;;
+		MMVOcr)    libs="-lmmvocr -lmmvripper" ;;
+		MakeCnt)   libs="-lmakecnt -lmmvripper" ;;
+	esac
+
+	$CXX $CXXFLAGS -Itests -IMMVRipper -I"$program" -o "$BUILD/$name" "$test" -L"$BUILD" $libs -lpthread
+
+	if ! "$BUILD/$name"
+	then
+		failed="$failed $name"
+	fi
+done
+
+if [ -n "$failed" ]
+then
+	echo "Failed:$failed"
+	exit 1
+fi